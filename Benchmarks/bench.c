@@ -0,0 +1,467 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <relic.h>
+
+#include "elgamal.h"
+#include "elgamal_aggregate.h"
+#include "elgamal_dlog.h"
+#include "bulletproof.h"
+#include "metrics.h"
+
+// Repetitions of every case unless -r is given
+#define BENCH_DEFAULT_REPS 16
+
+// Exclusive bound on the plaintexts decrypted by the benchmark
+#define BENCH_DLOG_MAX ((uint64_t)1 << 32)
+
+static const size_t bench_nbits[] = { 8, 16, 32, 64 };
+static const size_t bench_n_commits[] = { 1, 2, 4, 8 };
+static const size_t bench_n_proofs[] = { 1, 4, 16 };
+static const size_t bench_batch[] = { 1, 64, 1024, 16384 };
+
+#define BENCH_COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+/*
+ * Latencies of the repetitions of one case. Every sample times a batch of
+ * ops_per_sample operations, so throughput is reported per operation and
+ * latency per batch.
+ */
+typedef struct {
+    double *ns;
+    size_t n;
+    size_t ops_per_sample;
+} bench_samples_t;
+
+typedef struct {
+    size_t reps;
+    const char *filter;
+    int prometheus;
+} bench_options_t;
+
+static double bench_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int bench_cmp(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Returns the p-th percentile of sorted samples by the nearest-rank method.
+ */
+static double bench_percentile(const double *sorted, size_t n, double p) {
+    size_t rank = (size_t)(p / 100.0 * (double)n + 0.999999);
+
+    if (rank == 0) {
+        rank = 1;
+    }
+    return sorted[(rank > n ? n : rank) - 1];
+}
+
+/**
+ * Returns the peak resident set size of the process in KiB.
+ */
+static long bench_peak_rss(void) {
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+    return usage.ru_maxrss;
+}
+
+static int bench_selected(const bench_options_t *opt, const char *name) {
+    return opt->filter == NULL || strstr(name, opt->filter) != NULL;
+}
+
+static void bench_header(void) {
+    printf("%-24s %-28s %12s %12s %12s %12s %12s %12s\n",
+           "primitive", "parameters", "ops/s", "p50 us", "p90 us", "p99 us", "max us", "peak KiB");
+}
+
+static void bench_report(const char *name, const char *params, bench_samples_t *s) {
+    double total = 0;
+    size_t i;
+
+    for (i = 0; i < s->n; i++) {
+        total += s->ns[i];
+    }
+    qsort(s->ns, s->n, sizeof(*s->ns), bench_cmp);
+    printf("%-24s %-28s %12.1f %12.1f %12.1f %12.1f %12.1f %12ld\n", name, params,
+           total > 0 ? (double)(s->n * s->ops_per_sample) * 1e9 / total : 0.0,
+           bench_percentile(s->ns, s->n, 50) / 1e3,
+           bench_percentile(s->ns, s->n, 90) / 1e3,
+           bench_percentile(s->ns, s->n, 99) / 1e3,
+           s->ns[s->n - 1] / 1e3,
+           bench_peak_rss());
+    fflush(stdout);
+}
+
+static void bench_samples_init(bench_samples_t *s, size_t reps, size_t ops_per_sample) {
+    s->ns = (double *)malloc(reps * sizeof(*s->ns));
+    if (s->ns == NULL) {
+        abort();
+    }
+    s->n = 0;
+    s->ops_per_sample = ops_per_sample;
+}
+
+static void bench_fail(const char *name) {
+    fprintf(stderr, "bench: %s failed\n", name);
+    exit(EXIT_FAILURE);
+}
+
+static void bench_keygen(const bench_options_t *opt) {
+    bench_samples_t s;
+    bn_t sk;
+    ec_t B;
+    size_t r;
+
+    if (!bench_selected(opt, "elgamal_keygen")) {
+        return;
+    }
+    bn_null(sk);
+    ec_null(B);
+    bn_new(sk);
+    ec_new(B);
+    bench_samples_init(&s, opt->reps, 1);
+    for (r = 0; r < opt->reps; r++) {
+        double t0 = bench_now();
+        if (elgamal_keygen(sk, B) != RLC_OK) {
+            bench_fail("elgamal_keygen");
+        }
+        s.ns[s.n++] = bench_now() - t0;
+    }
+    bench_report("elgamal_keygen", "-", &s);
+    free(s.ns);
+    bn_free(sk);
+    ec_free(B);
+}
+
+/**
+ * Times encryption, aggregation and decryption for every ElGamal batch size.
+ */
+static void bench_elgamal(const bench_options_t *opt) {
+    char params[64];
+    bench_samples_t s;
+    elgamal_ciphertext_t *cts, sum;
+    elgamal_ctx_t ctx;
+    elgamal_ws_t ws;
+    bn_t sk, m, *ms;
+    ec_t B;
+    size_t b, i, r, n;
+
+    if (!bench_selected(opt, "elgamal_encrypt") && !bench_selected(opt, "elgamal_encrypt_ctx") && !bench_selected(opt, "elgamal_encrypt_ws")
+        && !bench_selected(opt, "elgamal_encrypt_batch") && !bench_selected(opt, "elgamal_aggregate")
+        && !bench_selected(opt, "elgamal_decrypt") && !bench_selected(opt, "elgamal_decrypt_ws")) {
+        return;
+    }
+    bn_null(sk);
+    bn_null(m);
+    ec_null(B);
+    bn_new(sk);
+    bn_new(m);
+    ec_new(B);
+    // The table is installed first, since workspaces capture it at init
+    if ((bench_selected(opt, "elgamal_decrypt") || bench_selected(opt, "elgamal_decrypt_ws")) && elgamal_dlog_setup(BENCH_DLOG_MAX, 0) != RLC_OK) {
+        bench_fail("elgamal_dlog_setup");
+    }
+    if (elgamal_keygen(sk, B) != RLC_OK || elgamal_ctx_init(&ctx, B) != RLC_OK || elgamal_ws_init(&ws) != RLC_OK || elgamal_ciphertext_init(&sum) != RLC_OK) {
+        bench_fail("elgamal setup");
+    }
+
+    for (b = 0; b < BENCH_COUNT(bench_batch); b++) {
+        n = bench_batch[b];
+        snprintf(params, sizeof(params), "batch=%zu", n);
+        cts = (elgamal_ciphertext_t *)malloc(n * sizeof(*cts));
+        ms = (bn_t *)malloc(n * sizeof(*ms));
+        if (cts == NULL || ms == NULL) {
+            bench_fail("malloc");
+        }
+        for (i = 0; i < n; i++) {
+            bn_null(ms[i]);
+            bn_new(ms[i]);
+            // Plaintexts of a few kWh so that their sums stay decryptable
+            bn_set_dig(ms[i], (dig_t)(rand() % 100000));
+            if (elgamal_ciphertext_init(&cts[i]) != RLC_OK) {
+                bench_fail("elgamal_ciphertext_init");
+            }
+        }
+
+        if (bench_selected(opt, "elgamal_encrypt")) {
+            bench_samples_init(&s, opt->reps, n);
+            for (r = 0; r < opt->reps; r++) {
+                double t0 = bench_now();
+                for (i = 0; i < n; i++) {
+                    if (elgamal_encrypt(B, ms[i], cts[i].M1, cts[i].M2) != RLC_OK) {
+                        bench_fail("elgamal_encrypt");
+                    }
+                }
+                s.ns[s.n++] = bench_now() - t0;
+            }
+            bench_report("elgamal_encrypt", params, &s);
+            free(s.ns);
+        }
+
+        if (bench_selected(opt, "elgamal_encrypt_ws")) {
+            bench_samples_init(&s, opt->reps, n);
+            for (r = 0; r < opt->reps; r++) {
+                double t0 = bench_now();
+                for (i = 0; i < n; i++) {
+                    if (elgamal_encrypt_ws(&ctx, &ws, ms[i], cts[i].M1, cts[i].M2) != RLC_OK) {
+                        bench_fail("elgamal_encrypt_ws");
+                    }
+                }
+                s.ns[s.n++] = bench_now() - t0;
+            }
+            bench_report("elgamal_encrypt_ws", params, &s);
+            free(s.ns);
+        }
+
+        if (bench_selected(opt, "elgamal_encrypt_batch")) {
+            bench_samples_init(&s, opt->reps, n);
+            for (r = 0; r < opt->reps; r++) {
+                double t0 = bench_now();
+                if (elgamal_encrypt_batch(&ctx, ms, cts, n) != RLC_OK) {
+                    bench_fail("elgamal_encrypt_batch");
+                }
+                s.ns[s.n++] = bench_now() - t0;
+            }
+            bench_report("elgamal_encrypt_batch", params, &s);
+            free(s.ns);
+        }
+
+        // The remaining cases need valid ciphertexts whatever the filter
+        bench_samples_init(&s, opt->reps, n);
+        for (r = 0; r < opt->reps; r++) {
+            double t0 = bench_now();
+            for (i = 0; i < n; i++) {
+                if (elgamal_encrypt_ctx(&ctx, ms[i], cts[i].M1, cts[i].M2) != RLC_OK) {
+                    bench_fail("elgamal_encrypt_ctx");
+                }
+            }
+            s.ns[s.n++] = bench_now() - t0;
+        }
+        if (bench_selected(opt, "elgamal_encrypt_ctx")) {
+            bench_report("elgamal_encrypt_ctx", params, &s);
+        }
+        free(s.ns);
+
+        if (bench_selected(opt, "elgamal_aggregate")) {
+            bench_samples_init(&s, opt->reps, n);
+            for (r = 0; r < opt->reps; r++) {
+                double t0 = bench_now();
+                if (elgamal_aggregate(&sum, cts, n) != RLC_OK) {
+                    bench_fail("elgamal_aggregate");
+                }
+                s.ns[s.n++] = bench_now() - t0;
+            }
+            bench_report("elgamal_aggregate", params, &s);
+            free(s.ns);
+        }
+
+        if (bench_selected(opt, "elgamal_decrypt")) {
+            size_t n_dec = n < 64 ? n : 64;
+            bench_samples_init(&s, opt->reps, n_dec);
+            for (r = 0; r < opt->reps; r++) {
+                double t0 = bench_now();
+                for (i = 0; i < n_dec; i++) {
+                    if (elgamal_decrypt(sk, cts[i].M1, cts[i].M2, &m) != RLC_OK || bn_cmp(m, ms[i]) != RLC_EQ) {
+                        bench_fail("elgamal_decrypt");
+                    }
+                }
+                s.ns[s.n++] = bench_now() - t0;
+            }
+            snprintf(params, sizeof(params), "batch=%zu", n_dec);
+            bench_report("elgamal_decrypt", params, &s);
+            free(s.ns);
+        }
+
+        if (bench_selected(opt, "elgamal_decrypt_ws")) {
+            size_t n_dec = n < 64 ? n : 64;
+            bench_samples_init(&s, opt->reps, n_dec);
+            for (r = 0; r < opt->reps; r++) {
+                double t0 = bench_now();
+                for (i = 0; i < n_dec; i++) {
+                    if (elgamal_decrypt_ws(&ws, sk, cts[i].M1, cts[i].M2, m) != RLC_OK || bn_cmp(m, ms[i]) != RLC_EQ) {
+                        bench_fail("elgamal_decrypt_ws");
+                    }
+                }
+                s.ns[s.n++] = bench_now() - t0;
+            }
+            snprintf(params, sizeof(params), "batch=%zu", n_dec);
+            bench_report("elgamal_decrypt_ws", params, &s);
+            free(s.ns);
+        }
+
+        for (i = 0; i < n; i++) {
+            bn_free(ms[i]);
+            elgamal_ciphertext_free(&cts[i]);
+        }
+        free(ms);
+        free(cts);
+    }
+
+    elgamal_ciphertext_free(&sum);
+    elgamal_ws_free(&ws);
+    elgamal_ctx_free(&ctx);
+    bn_free(sk);
+    bn_free(m);
+    ec_free(B);
+}
+
+/**
+ * Times commitment, proving and verification for one bulletproof shape.
+ */
+static void bench_rangeproof_case(const bench_options_t *opt, bulletproof_context_t *context, size_t nbits, size_t n_commits, size_t n_proofs) {
+    char params[64];
+    bench_samples_t commit, prove, verify;
+    bulletproof_rangeproof_t data;
+    size_t i, r;
+
+    snprintf(params, sizeof(params), "nbits=%zu commits=%zu proofs=%zu", nbits, n_commits, n_proofs);
+    bench_samples_init(&commit, opt->reps, n_commits);
+    bench_samples_init(&prove, opt->reps, n_proofs);
+    bench_samples_init(&verify, opt->reps, n_proofs);
+
+    memset(&data, 0, sizeof(data));
+    data.context = context;
+    data.nbits = nbits;
+    data.n_commits = n_commits;
+    data.n_proofs = n_proofs;
+    bulletproof_rangeproof_setup(&data);
+
+    for (r = 0; r < opt->reps; r++) {
+        double t0;
+
+        for (i = 0; i < n_commits; i++) {
+            data.value[i] = nbits == 64 ? (size_t)rand() : (size_t)rand() & (((size_t)1 << nbits) - 1);
+        }
+        t0 = bench_now();
+        bulletproof_rangeproof_pedersen_commit(&data);
+        commit.ns[commit.n++] = bench_now() - t0;
+
+        data.plen = MAX_PROOF_SIZE;
+        t0 = bench_now();
+        bulletproof_rangeproof_prove(&data);
+        prove.ns[prove.n++] = bench_now() - t0;
+
+        t0 = bench_now();
+        bulletproof_rangeproof_verify(&data);
+        verify.ns[verify.n++] = bench_now() - t0;
+    }
+    bulletproof_rangeproof_teardown(&data);
+
+    if (bench_selected(opt, "rangeproof_commit")) {
+        bench_report("rangeproof_commit", params, &commit);
+    }
+    if (bench_selected(opt, "rangeproof_prove")) {
+        bench_report("rangeproof_prove", params, &prove);
+    }
+    if (bench_selected(opt, "rangeproof_verify")) {
+        bench_report("rangeproof_verify", params, &verify);
+    }
+    free(commit.ns);
+    free(prove.ns);
+    free(verify.ns);
+}
+
+static void bench_rangeproof(const bench_options_t *opt) {
+    bulletproof_context_t *context;
+    size_t a, b, c;
+
+    if (!bench_selected(opt, "rangeproof")) {
+        return;
+    }
+    context = bulletproof_context_create(BULLETPROOF_N_GENERATORS);
+    if (context == NULL) {
+        bench_fail("bulletproof_context_create");
+    }
+    for (a = 0; a < BENCH_COUNT(bench_nbits); a++) {
+        for (b = 0; b < BENCH_COUNT(bench_n_commits); b++) {
+            for (c = 0; c < BENCH_COUNT(bench_n_proofs); c++) {
+                bench_rangeproof_case(opt, context, bench_nbits[a], bench_n_commits[b], bench_n_proofs[c]);
+            }
+        }
+    }
+    bulletproof_context_destroy(context);
+}
+
+/**
+ * Prints the instrumentation counters gathered over the whole run.
+ */
+static void bench_prometheus(void) {
+    metrics_snapshot_t snapshot;
+    size_t len;
+    char *text;
+
+    metrics_snapshot(&snapshot);
+    len = metrics_format_prometheus(&snapshot, NULL, 0);
+    text = (char *)malloc(len + 1);
+    if (text == NULL) {
+        bench_fail("malloc");
+    }
+    metrics_format_prometheus(&snapshot, text, len + 1);
+    fputs(text, stdout);
+    free(text);
+}
+
+static void bench_usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-r repetitions] [-f filter] [-p]\n"
+                    "  -r  repetitions of every case (default %d)\n"
+                    "  -f  only run primitives whose name contains filter\n"
+                    "  -p  print the instrumentation counters in Prometheus format\n", prog, BENCH_DEFAULT_REPS);
+}
+
+int main(int argc, char **argv) {
+    bench_options_t opt = { BENCH_DEFAULT_REPS, NULL, 0 };
+    int c;
+
+    while ((c = getopt(argc, argv, "r:f:ph")) != -1) {
+        switch (c) {
+        case 'r':
+            opt.reps = strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            opt.filter = optarg;
+            break;
+        case 'p':
+            opt.prometheus = 1;
+            break;
+        default:
+            bench_usage(argv[0]);
+            return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (opt.reps == 0) {
+        bench_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (core_init() != RLC_OK) {
+        bench_fail("core_init");
+    }
+    ep_param_set(SECG_K256);
+
+    bench_header();
+    bench_keygen(&opt);
+    bench_elgamal(&opt);
+    bench_rangeproof(&opt);
+
+    if (opt.prometheus) {
+        bench_prometheus();
+    }
+
+    core_clean();
+    return EXIT_SUCCESS;
+}
@@ -1,27 +1,157 @@
-#include "bulletproof_rangeproof.h"
+#include <pthread.h>
+
+#include "bulletproof.h"
+#include "metrics.h"
+
+// Process-wide contexts of bulletproof_context_shared, guarded by shared_lock
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static bulletproof_context_t **shared_contexts = NULL;
+static size_t n_shared = 0;
 
 /**
  * Generates a specified number of secure random bytes.
  * 
- * This function reads random data from `/dev/urandom`, which is a special file
- * in Unix-like systems that serves as a pseudo-random number generator. It is
- * commonly used for generating cryptographic keys and other applications where 
- * high-quality randomness is required.
+ * The bytes are served from the calling thread's buffered ChaCha20 generator
+ * (see csprng_bytes), which is seeded from the kernel and only returns to it to
+ * reseed, so nonces, blinds and seeds no longer cost a system call each.
  * 
  * @param buffer A pointer to an array where the random bytes will be stored.
  * @param num_bytes The number of random bytes to generate.
  * 
  */
 void generate_secure_random_bytes(unsigned char *buffer, size_t num_bytes) {
-    int fd = open("/dev/urandom", O_RDONLY);    //unix based not portable
-    if (fd < 0) 
-    {abort();}    // Error opening /dev/urandom
+    csprng_bytes(buffer, num_bytes);    // Aborts if the generator cannot be seeded
+}
 
-    ssize_t read_bytes = read(fd, buffer, num_bytes);   // Read specified number of bytes from the file descriptor into buffer
-    close(fd);
+/**
+ * Creates a long-lived bulletproof prover/verifier context.
+ *
+ * The context holds the secp256k1 context and the bulletproof generators,
+ * whose creation dominates the cost of bulletproof_rangeproof_setup. It is
+ * meant to be created once per process and shared by every proof job: both
+ * members are only read by proving and verification, so the context may be
+ * used from several threads at once. Per-job state such as the scratch space
+ * is not part of the context.
+ *
+ * @param n_gens The number of bulletproof generators to create. This must be
+ *               at least 2 * n_commits * nbits for every proof made or checked
+ *               with the context, since secp256k1-zkp uses a G_i and an H_i
+ *               generator per proven bit (see bulletproof_context_covers).
+ *               BULLETPROOF_N_GENERATORS covers every proof of this library.
+ *
+ * @return A pointer to the new context.
+ *
+ * @note This function aborts the program if memory allocation or generator
+ *       creation fails.
+ */
+bulletproof_context_t *bulletproof_context_create(size_t n_gens) {
+    bulletproof_context_t *context = (bulletproof_context_t *)malloc(sizeof(*context));
+    if (context == NULL) {abort();}
 
-    if (read_bytes < 0 || (size_t)read_bytes != num_bytes) 
-    {abort();}    // Error reading the required number of bytes
+    context->blind_gen = secp256k1_generator_const_g;
+    context->n_gens = n_gens;
+    context->ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    if (context->ctx == NULL) {abort();}
+    context->generators = secp256k1_bulletproof_generators_create(context->ctx, &context->blind_gen, n_gens);
+    if (context->generators == NULL) {abort();}
+
+    return context;
+}
+
+/**
+ * Destroys a context created with bulletproof_context_create.
+ *
+ * @param context The context to destroy. It must no longer be used by any
+ *                bulletproof_rangeproof_t structure.
+ */
+void bulletproof_context_destroy(bulletproof_context_t *context) {
+    if (context == NULL) {
+        return;
+    }
+    secp256k1_bulletproof_generators_destroy(context->ctx, context->generators);
+    secp256k1_context_destroy(context->ctx);
+    free(context);
+}
+
+/**
+ * Returns a process-wide context with at least n_gens generators.
+ *
+ * The bulletproof generators are NUMS points that secp256k1-zkp derives from
+ * the blinding generator and their index, so every context with the same
+ * blinding generator holds the same points and only their number differs.
+ * The first call creates the context; later calls asking for no more
+ * generators than an existing context holds return that context, so the
+ * generators are created once per process instead of once per caller.
+ * The function may be called from several threads at once.
+ *
+ * @param n_gens The minimum number of bulletproof generators.
+ *
+ * @return A pointer to the shared context. It lives until the process exits
+ *         and must not be passed to bulletproof_context_destroy.
+ *
+ * @note This function aborts the program if memory allocation or generator
+ *       creation fails.
+ */
+bulletproof_context_t *bulletproof_context_shared(size_t n_gens) {
+    bulletproof_context_t *context = NULL;
+    bulletproof_context_t **grown;
+    size_t i;
+
+    pthread_mutex_lock(&shared_lock);
+    // Reuse the smallest context with enough generators
+    for (i = 0; i < n_shared; i++) {
+        if (shared_contexts[i]->n_gens >= n_gens && (context == NULL || shared_contexts[i]->n_gens < context->n_gens)) {
+            context = shared_contexts[i];
+        }
+    }
+    // Created under the lock, so concurrent first callers wait instead of creating it twice
+    if (context == NULL) {
+        grown = (bulletproof_context_t **)realloc(shared_contexts, (n_shared + 1) * sizeof(*grown));
+        if (grown == NULL) {abort();}
+        shared_contexts = grown;
+        context = bulletproof_context_create(n_gens);
+        shared_contexts[n_shared++] = context;
+    }
+    pthread_mutex_unlock(&shared_lock);
+
+    return context;
+}
+
+/**
+ * Checks whether a context can prove or verify a proof of the given shape.
+ *
+ * secp256k1-zkp aborts the process through an argument check when a proof
+ * needs more generators than the context holds, so anything derived from
+ * untrusted input must pass this check before it reaches the library.
+ *
+ * @param context The bulletproof context.
+ * @param n_commits The number of commitments the proof covers.
+ * @param nbits The number of bits proven per commitment.
+ *
+ * @return 1 if nbits is in [1, 64], n_commits is nonzero and the context
+ *         holds the 2 * n_commits * nbits generators the proof needs, 0
+ *         otherwise.
+ */
+int bulletproof_context_covers(const bulletproof_context_t *context, size_t n_commits, size_t nbits) {
+    // Written as a division, so 2 * n_commits * nbits cannot overflow
+    return n_commits != 0 && nbits != 0 && nbits <= 64 && n_commits <= context->n_gens / (2 * nbits);
+}
+
+/**
+ * Derives the value generator every proof of this library commits with.
+ *
+ * The generator is that of the fixed seed BULLETPROOF_VALUE_GEN_SEED, looked
+ * up through bulletproof_value_gen, so provers and verifiers agree on it
+ * without exchanging it and a file loaded with bulletproof_value_gen_load
+ * spares its derivation at start-up.
+ *
+ * @param context The bulletproof context.
+ * @param gen The generator to set.
+ *
+ * @return 1 on success, 0 if the generator cannot be derived.
+ */
+int bulletproof_value_gen_default(const bulletproof_context_t *context, secp256k1_generator *gen) {
+    return bulletproof_value_gen(context->ctx, gen, (const unsigned char *)BULLETPROOF_VALUE_GEN_SEED);
 }
 
 /**
@@ -33,10 +163,33 @@ void generate_secure_random_bytes(unsigned char *buffer, size_t num_bytes) {
  * it handles the allocation and initialization of the proof, value generator, 
  * commitments, blinding factors, and values arrays.
  * 
- * The function generates random bytes for the nonce and generator blind, and 
- * sets up the blind generator. It also ensures that each value generator is 
- * properly generated and the necessary memory is allocated for storing proofs,
- * commitments, and blinding factors.
+ * The function generates random bytes for the nonce and sets up the blind
+ * generator. It also ensures that each value generator is properly derived
+ * and the necessary memory is allocated for storing proofs, commitments, and
+ * blinding factors.
+ * 
+ * If the `context` member is set, the secp256k1 context, blind generator and
+ * bulletproof generators are borrowed from it, so only the light per-batch
+ * state is allocated. Otherwise the context of bulletproof_context_shared for
+ * BULLETPROOF_N_GENERATORS generators is borrowed, so the generators are
+ * created once per process rather than once per structure.
+ * 
+ * All proofs of the structure share the value generator of
+ * bulletproof_value_gen_default, which is therefore derived once and copied.
+ * 
+ * The scratch space is taken from the `scratch_pool` member if it is set and
+ * its spaces hold bulletproof_scratch_size for n_commits, nbits and n_proofs.
+ * Otherwise a scratch space of that size is created for this structure alone
+ * and destroyed again by bulletproof_rangeproof_teardown. The scratch gauge
+ * records the size of the space actually used.
+ * 
+ * All per-batch buffers (proofs, value generators, commitments, blinding
+ * factors and values) are carved from a single arena. The `commit` rows
+ * point into the flat `commits` array and the `blind` entries into the flat
+ * `blinds` array. If the `arena` member is set, that arena is reset and
+ * reused, so a batch of the same shape as the previous one allocates no
+ * memory at all; otherwise a private arena is created and released again by
+ * bulletproof_rangeproof_teardown.
  * 
  * @param arg A void pointer to a bulletproof_rangeproof_t structure that will 
  *            be initialized for bulletproof range proof generation.
@@ -50,49 +203,90 @@ void generate_secure_random_bytes(unsigned char *buffer, size_t num_bytes) {
  *       bulletproof_rangeproof_t structure. The created secp256k1_context is 
  *       configured for both signing and verification purposes.
  */
-static void bulletproof_rangeproof_setup(void* arg){
+void bulletproof_rangeproof_setup(void* arg){
     bulletproof_rangeproof_t *data = (bulletproof_rangeproof_t*)arg;
+    unsigned char *proofs;
+    size_t scratch_size = bulletproof_scratch_size(data->n_commits, data->nbits, data->n_proofs);
     size_t i;
 
-    data->blind_gen = secp256k1_generator_const_g;
-    data->ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
-    data->scratch = secp256k1_scratch_space_create(data->ctx, 1024 * 1024 * 1024);
-    data->generators = secp256k1_bulletproof_generators_create(data->ctx, &data->blind_gen, 64 * 1024);
+    if (data->context == NULL) {
+        data->context = bulletproof_context_shared(BULLETPROOF_N_GENERATORS);
+    }
+    data->blind_gen = data->context->blind_gen;
+    data->ctx = data->context->ctx;
+    data->generators = data->context->generators;
+    // A pool sized for smaller batches would make the prover fail, so such a
+    // batch gets a private scratch space instead
+    data->owned_scratch = NULL;
+    if (data->scratch_pool != NULL && data->scratch_pool->size >= scratch_size) {
+        data->scratch = bulletproof_scratch_pool_acquire(data->scratch_pool);
+        scratch_size = data->scratch_pool->size;
+    } else {
+        data->owned_scratch = secp256k1_scratch_space_create(data->ctx, scratch_size);
+        data->scratch = data->owned_scratch;
+    }
+    if (data->scratch == NULL) {abort();}
+    METRICS_HIGH_WATER(METRICS_GAUGE_SCRATCH_BYTES, scratch_size);
 
-    const unsigned char genbd[32];
     unsigned char u_nonce[32];
-    unsigned char u_genbd[32];
 
     generate_secure_random_bytes(u_nonce, sizeof(u_nonce));  //Make u_nonce random
-    
-    generate_secure_random_bytes(u_genbd, sizeof(u_genbd));  //Make u_genbd random
 
     memcpy(data->nonce, u_nonce, 32);
-    memcpy((unsigned char*) genbd, u_genbd, 32);
 
-    data->proof = (unsigned char **)malloc(data->n_proofs * sizeof(*data->proof));                      //check this
-    data->value_gen = (secp256k1_generator *)malloc(data->n_proofs * sizeof(*data->value_gen));
-    if (data->proof == NULL || data->value_gen == NULL) {
-        abort();
+    // Carve every per-batch buffer from one arena
+    data->owned_arena = NULL;
+    if (data->arena == NULL) {
+        data->owned_arena = bulletproof_arena_create(bulletproof_rangeproof_arena_size(data->n_proofs, data->n_commits));
+        data->arena = data->owned_arena;
+    } else {
+        bulletproof_arena_reset(data->arena, bulletproof_rangeproof_arena_size(data->n_proofs, data->n_commits));
     }
+
+    data->proof = (unsigned char **)bulletproof_arena_alloc(data->arena, data->n_proofs * sizeof(*data->proof));
+    proofs = (unsigned char *)bulletproof_arena_alloc(data->arena, data->n_proofs * MAX_PROOF_SIZE);
+    data->value_gen = (secp256k1_generator *)bulletproof_arena_alloc(data->arena, data->n_proofs * sizeof(*data->value_gen));
+    // Every proof uses the default value generator, so derive it once; abort if derivation fails
+    if (data->n_proofs > 0 && bulletproof_value_gen_default(data->context, &data->value_gen[0]) != 1) {abort();}
     for (i = 0; i < data->n_proofs; i++) {
-        data->proof[i] = (unsigned char *)malloc(MAX_PROOF_SIZE);
-        if (data->proof[i] == NULL) {abort();}
-        // Generate a value generator for each proof; abort if generation fails
-        if(secp256k1_generator_generate(data->ctx, &data->value_gen[i], genbd) != 1) {abort();}
+        data->proof[i] = proofs + i * MAX_PROOF_SIZE;
+        data->value_gen[i] = data->value_gen[0];
     }
     data->plen = MAX_PROOF_SIZE;
     
     //Pedersen init
-    data->commit = (secp256k1_pedersen_commitment **)malloc(data->n_proofs * sizeof(*data->commit));    //check these
-    data->blind = (const unsigned char **)malloc(data->n_commits * sizeof(*data->blind));
-    data->value = (size_t *)malloc(data->n_commits * sizeof(*data->commit));
-    if (data->commit == NULL || data->blind == NULL || data->value == NULL) {abort();}
+    data->commit = (secp256k1_pedersen_commitment **)bulletproof_arena_alloc(data->arena, data->n_proofs * sizeof(*data->commit));
+    data->commits = (secp256k1_pedersen_commitment *)bulletproof_arena_alloc(data->arena, data->n_proofs * data->n_commits * sizeof(*data->commits));
+    data->blind = (const unsigned char **)bulletproof_arena_alloc(data->arena, data->n_commits * sizeof(*data->blind));
+    data->blinds = (unsigned char *)bulletproof_arena_alloc(data->arena, data->n_commits * 32);
+    data->value = (size_t *)bulletproof_arena_alloc(data->arena, data->n_commits * sizeof(*data->value));
 
     for (i = 0; i < data->n_proofs; i++) {
-        data->commit[i] = (secp256k1_pedersen_commitment *)malloc(data->n_commits * sizeof(*data->commit[i]));
-        if (data->commit[i] == NULL) {abort();}
+        data->commit[i] = data->commits + i * data->n_commits;
+    }
+    for (i = 0; i < data->n_commits; i++) {
+        data->blind[i] = data->blinds + i * 32;
     }
+    METRICS_HIGH_WATER(METRICS_GAUGE_ARENA_BYTES, data->arena->used);
+}
+
+/**
+ * Computes the arena size bulletproof_rangeproof_setup needs for a batch.
+ *
+ * @param n_proofs The number of proofs of the batch.
+ * @param n_commits The number of commitments per proof.
+ *
+ * @return The number of bytes to reserve, including alignment padding.
+ */
+size_t bulletproof_rangeproof_arena_size(size_t n_proofs, size_t n_commits) {
+    return BULLETPROOF_ARENA_ROUND(n_proofs * sizeof(unsigned char *))
+        + BULLETPROOF_ARENA_ROUND(n_proofs * MAX_PROOF_SIZE)
+        + BULLETPROOF_ARENA_ROUND(n_proofs * sizeof(secp256k1_generator))
+        + BULLETPROOF_ARENA_ROUND(n_proofs * sizeof(secp256k1_pedersen_commitment *))
+        + BULLETPROOF_ARENA_ROUND(n_proofs * n_commits * sizeof(secp256k1_pedersen_commitment))
+        + BULLETPROOF_ARENA_ROUND(n_commits * sizeof(const unsigned char *))
+        + BULLETPROOF_ARENA_ROUND(n_commits * 32)
+        + BULLETPROOF_ARENA_ROUND(n_commits * sizeof(size_t));
 }
 
 /**
@@ -117,22 +311,21 @@ static void bulletproof_rangeproof_setup(void* arg){
  *       are stored in the provided bulletproof_rangeproof_t structure, and each
  *       blinding factor is slightly modified to maintain uniqueness.
  */
-static void bulletproof_rangeproof_pedersen_commit(void* arg){
+void bulletproof_rangeproof_pedersen_commit(void* arg){
     bulletproof_rangeproof_t *data = (bulletproof_rangeproof_t*)arg;
     size_t i;
 
     unsigned char blind[32];
+    METRICS_BEGIN(start);
 
     generate_secure_random_bytes(blind, sizeof(blind));   //random init
 
     for (i = 0; i < data->n_commits; i++) {
-        // Allocate memory for the blinding factor for each commitment
-        data->blind[i] = malloc(32);
         // Modify the blinding factor to ensure uniqueness
         blind[0] = i;
         blind[1] = i >> 8;
-        // Copy the modified blinding factor to the allocated memory
-        memcpy((unsigned char*) data->blind[i], blind, 32);
+        // Copy the modified blinding factor to its slot of the flat array
+        memcpy(data->blinds + i * 32, blind, 32);
         // Create a Pedersen commitment; abort if it fails
         if(secp256k1_pedersen_commit(data->ctx, &data->commit[0][i], data->blind[i], data->value[i], &data->value_gen[0], &data->blind_gen) != 1) {abort();}
     }
@@ -140,15 +333,16 @@ static void bulletproof_rangeproof_pedersen_commit(void* arg){
     for (i = 1; i < data->n_proofs; i++) {
         memcpy(data->commit[i], data->commit[0], data->n_commits * sizeof(*data->commit[0]));
     }
+    METRICS_END(METRICS_OP_COMMIT, start, 1);
 }
 
 /**
  * Cleans up and frees resources allocated for the bulletproof range proof.
  *
  * This function is responsible for safely deallocating all memory that was
- * allocated for a bulletproof range proof operation. It iterates through
- * the arrays of blinding factors, Pedersen commitments, proofs, and value
- * generators, freeing each element and then the array itself.
+ * allocated for a bulletproof range proof operation. The blinding factors,
+ * Pedersen commitments, proofs and value generators all live in one arena,
+ * so they are released together instead of one by one.
  *
  * The function ensures that all memory allocated during the bulletproof
  * range proof process is properly released, preventing memory leaks.
@@ -160,30 +354,34 @@ static void bulletproof_rangeproof_pedersen_commit(void* arg){
  * @note This function should be called after the bulletproof range proof
  *       process is complete, to ensure that all allocated resources are
  *       released. Failing to call this function can result in memory leaks.
+ *       A shared context set through the `context` member is left intact,
+ *       a pooled scratch space is returned to its pool, and an arena set
+ *       through the `arena` member is kept for the next batch.
  */
-static void bulletproof_rangeproof_teardown(void* arg) {
+void bulletproof_rangeproof_teardown(void* arg) {
     bulletproof_rangeproof_t *data = (bulletproof_rangeproof_t*)arg;
-    size_t i;
 
-    if (data->blind != NULL) {
-        for (i = 0; i < data->n_commits; i++) {
-            free((unsigned char*) data->blind[i]);
-        }
-    }
-    if (data->commit != NULL) {
-        for (i = 0; i < data->n_proofs; i++) {
-            free(data->commit[i]);
-        }
-        free(data->commit);
+    // The per-batch buffers all live in the arena
+    data->proof = NULL;
+    data->value_gen = NULL;
+    data->commit = NULL;
+    data->commits = NULL;
+    data->blind = NULL;
+    data->blinds = NULL;
+    data->value = NULL;
+    if (data->owned_arena != NULL) {
+        bulletproof_arena_destroy(data->owned_arena);
+        data->owned_arena = NULL;
+        data->arena = NULL;
     }
-    free(data->blind);
-    free(data->value);
 
-    for (i = 0; i < data->n_proofs; i++) {
-        free(data->proof[i]);
+    if (data->owned_scratch != NULL) {
+        secp256k1_scratch_space_destroy(data->owned_scratch);
+        data->owned_scratch = NULL;
+    } else {
+        bulletproof_scratch_pool_release(data->scratch_pool, data->scratch);
     }
-    free(data->proof);
-    free(data->value_gen);
+    data->scratch = NULL;
 }
 
 /**
@@ -203,13 +401,15 @@ static void bulletproof_rangeproof_teardown(void* arg) {
  * @note This function will abort the program if the range proof generation fails.
  *       Ensure that all parameters are correctly set before calling this function.
  */
-static void bulletproof_rangeproof_prove(void* arg) {
+void bulletproof_rangeproof_prove(void* arg) {
     bulletproof_rangeproof_t *data = (bulletproof_rangeproof_t*)arg;
     size_t i;
+    METRICS_BEGIN(start);
 
     for (i = 0; i < data->n_proofs; i++) {
         if(secp256k1_bulletproof_rangeproof_prove(data->ctx, data->scratch, data->generators, data->proof[i], &data->plen, data->value, NULL, data->blind, data->n_commits, data->value_gen, data->nbits, data->nonce, NULL, 0) != 1){abort();}
     }
+    METRICS_END(METRICS_OP_PROVE, start, 1);
 }
 
 /**
@@ -230,10 +430,12 @@ static void bulletproof_rangeproof_prove(void* arg) {
  *       the bulletproof_rangeproof_t structure) to perform the verification.
  *       It aborts the program if any of the range proofs fail verification.
  */
-static void bulletproof_rangeproof_verify(void* arg) {
+void bulletproof_rangeproof_verify(void* arg) {
     bulletproof_rangeproof_t *data = (bulletproof_rangeproof_t*)arg;
     size_t i;
+    METRICS_BEGIN(start);
     
     if(secp256k1_bulletproof_rangeproof_verify_multi(data->ctx, data->scratch, data->generators, (const unsigned char **) data->proof, data->n_proofs, data->plen, NULL, (const secp256k1_pedersen_commitment **) data->commit, data->n_commits, data->nbits, data->value_gen, NULL, 0) != 1){abort();}
+    METRICS_END(METRICS_OP_VERIFY, start, 1);
     
 }
\ No newline at end of file
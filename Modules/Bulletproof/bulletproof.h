@@ -12,13 +12,36 @@
 #include "secp256k1_commitment.h"
 #include "secp256k1_bulletproofs.h"
 
+#include "bulletproof_scratch.h"
+#include "bulletproof_arena.h"
+#include "bulletproof_gens.h"
+#include "csprng.h"
+
 #define MAX_PROOF_SIZE 2000
+#define BULLETPROOF_N_GENERATORS (64 * 1024)
+
+// Seed of the value generator shared by every prover and verifier
+#define BULLETPROOF_VALUE_GEN_SEED "bulletproof/value-generator/v1\0\0"
+
+typedef struct {
+    secp256k1_context *ctx;
+    secp256k1_bulletproof_generators *generators;
+    secp256k1_generator blind_gen;
+    size_t n_gens;
+} bulletproof_context_t;
 
 typedef struct {
+    bulletproof_context_t *context;
+    bulletproof_scratch_pool_t *scratch_pool;
+    bulletproof_arena_t *arena;
+    bulletproof_arena_t *owned_arena;
     secp256k1_context *ctx;
     secp256k1_scratch_space *scratch;
+    secp256k1_scratch_space *owned_scratch;
     secp256k1_pedersen_commitment **commit;
+    secp256k1_pedersen_commitment *commits;
     const unsigned char **blind;
+    unsigned char *blinds;
     unsigned char nonce[32];
     unsigned char **proof;
     secp256k1_bulletproof_generators *generators;
@@ -34,10 +57,9 @@ typedef struct {
 /**
  * Generates a specified number of secure random bytes.
  * 
- * This function reads random data from `/dev/urandom`, which is a special file
- * in Unix-like systems that serves as a pseudo-random number generator. It is
- * commonly used for generating cryptographic keys and other applications where 
- * high-quality randomness is required.
+ * The bytes are served from the calling thread's buffered ChaCha20 generator
+ * (see csprng_bytes), which is seeded from the kernel and only returns to it to
+ * reseed, so nonces, blinds and seeds no longer cost a system call each.
  * 
  * @param buffer A pointer to an array where the random bytes will be stored.
  * @param num_bytes The number of random bytes to generate.
@@ -45,6 +67,90 @@ typedef struct {
  */
 void generate_secure_random_bytes(unsigned char *buffer, size_t num_bytes);
 
+/**
+ * Creates a long-lived bulletproof prover/verifier context.
+ *
+ * The context holds the secp256k1 context and the bulletproof generators,
+ * whose creation dominates the cost of bulletproof_rangeproof_setup. It is
+ * meant to be created once per process and shared by every proof job: both
+ * members are only read by proving and verification, so the context may be
+ * used from several threads at once. Per-job state such as the scratch space
+ * is not part of the context.
+ *
+ * @param n_gens The number of bulletproof generators to create. This must be
+ *               at least 2 * n_commits * nbits for every proof made or checked
+ *               with the context, since secp256k1-zkp uses a G_i and an H_i
+ *               generator per proven bit (see bulletproof_context_covers).
+ *               BULLETPROOF_N_GENERATORS covers every proof of this library.
+ *
+ * @return A pointer to the new context.
+ *
+ * @note This function aborts the program if memory allocation or generator
+ *       creation fails.
+ */
+bulletproof_context_t *bulletproof_context_create(size_t n_gens);
+
+/**
+ * Destroys a context created with bulletproof_context_create.
+ *
+ * @param context The context to destroy. It must no longer be used by any
+ *                bulletproof_rangeproof_t structure.
+ */
+void bulletproof_context_destroy(bulletproof_context_t *context);
+
+/**
+ * Returns a process-wide context with at least n_gens generators.
+ *
+ * The bulletproof generators are NUMS points that secp256k1-zkp derives from
+ * the blinding generator and their index, so every context with the same
+ * blinding generator holds the same points and only their number differs.
+ * The first call creates the context; later calls asking for no more
+ * generators than an existing context holds return that context, so the
+ * generators are created once per process instead of once per caller.
+ * The function may be called from several threads at once.
+ *
+ * @param n_gens The minimum number of bulletproof generators.
+ *
+ * @return A pointer to the shared context. It lives until the process exits
+ *         and must not be passed to bulletproof_context_destroy.
+ *
+ * @note This function aborts the program if memory allocation or generator
+ *       creation fails.
+ */
+bulletproof_context_t *bulletproof_context_shared(size_t n_gens);
+
+/**
+ * Checks whether a context can prove or verify a proof of the given shape.
+ *
+ * secp256k1-zkp aborts the process through an argument check when a proof
+ * needs more generators than the context holds, so anything derived from
+ * untrusted input must pass this check before it reaches the library.
+ *
+ * @param context The bulletproof context.
+ * @param n_commits The number of commitments the proof covers.
+ * @param nbits The number of bits proven per commitment.
+ *
+ * @return 1 if nbits is in [1, 64], n_commits is nonzero and the context
+ *         holds the 2 * n_commits * nbits generators the proof needs, 0
+ *         otherwise.
+ */
+int bulletproof_context_covers(const bulletproof_context_t *context, size_t n_commits, size_t nbits);
+
+/**
+ * Derives the value generator every proof of this library commits with.
+ *
+ * The generator is that of the fixed seed BULLETPROOF_VALUE_GEN_SEED, looked
+ * up through bulletproof_value_gen, so provers and verifiers agree on it
+ * without exchanging it and a file loaded with bulletproof_value_gen_load
+ * spares its derivation at start-up.
+ *
+ * @param context The bulletproof context.
+ * @param gen The generator to set.
+ *
+ * @return 1 on success, 0 if the generator cannot be derived.
+ */
+int bulletproof_value_gen_default(const bulletproof_context_t *context, secp256k1_generator *gen);
+
 /**
  * Initializes and sets up the bulletproof range proof structure.
  * 
@@ -54,10 +160,33 @@ void generate_secure_random_bytes(unsigned char *buffer, size_t num_bytes);
  * it handles the allocation and initialization of the proof, value generator, 
  * commitments, blinding factors, and values arrays.
  * 
- * The function generates random bytes for the nonce and generator blind, and 
- * sets up the blind generator. It also ensures that each value generator is 
- * properly generated and the necessary memory is allocated for storing proofs,
- * commitments, and blinding factors.
+ * The function generates random bytes for the nonce and sets up the blind
+ * generator. It also ensures that each value generator is properly derived
+ * and the necessary memory is allocated for storing proofs, commitments, and
+ * blinding factors.
+ * 
+ * If the `context` member is set, the secp256k1 context, blind generator and
+ * bulletproof generators are borrowed from it, so only the light per-batch
+ * state is allocated. Otherwise the context of bulletproof_context_shared for
+ * BULLETPROOF_N_GENERATORS generators is borrowed, so the generators are
+ * created once per process rather than once per structure.
+ * 
+ * All proofs of the structure share the value generator of
+ * bulletproof_value_gen_default, which is therefore derived once and copied.
+ * 
+ * The scratch space is taken from the `scratch_pool` member if it is set and
+ * its spaces hold bulletproof_scratch_size for n_commits, nbits and n_proofs.
+ * Otherwise a scratch space of that size is created for this structure alone
+ * and destroyed again by bulletproof_rangeproof_teardown. The scratch gauge
+ * records the size of the space actually used.
+ * 
+ * All per-batch buffers (proofs, value generators, commitments, blinding
+ * factors and values) are carved from a single arena. The `commit` rows
+ * point into the flat `commits` array and the `blind` entries into the flat
+ * `blinds` array. If the `arena` member is set, that arena is reset and
+ * reused, so a batch of the same shape as the previous one allocates no
+ * memory at all; otherwise a private arena is created and released again by
+ * bulletproof_rangeproof_teardown.
  * 
  * @param arg A void pointer to a bulletproof_rangeproof_t structure that will 
  *            be initialized for bulletproof range proof generation.
@@ -71,7 +200,17 @@ void generate_secure_random_bytes(unsigned char *buffer, size_t num_bytes);
  *       bulletproof_rangeproof_t structure. The created secp256k1_context is 
  *       configured for both signing and verification purposes.
  */
-static void bulletproof_rangeproof_setup(void* arg);
+void bulletproof_rangeproof_setup(void* arg);
+
+/**
+ * Computes the arena size bulletproof_rangeproof_setup needs for a batch.
+ *
+ * @param n_proofs The number of proofs of the batch.
+ * @param n_commits The number of commitments per proof.
+ *
+ * @return The number of bytes to reserve, including alignment padding.
+ */
+size_t bulletproof_rangeproof_arena_size(size_t n_proofs, size_t n_commits);
 
 /**
  * Performs Pedersen commitments for the bulletproof range proof.
@@ -95,15 +234,15 @@ static void bulletproof_rangeproof_setup(void* arg);
  *       are stored in the provided bulletproof_rangeproof_t structure, and each
  *       blinding factor is slightly modified to maintain uniqueness.
  */
-static void bulletproof_rangeproof_pedersen_commit(void* arg);
+void bulletproof_rangeproof_pedersen_commit(void* arg);
 
 /**
  * Cleans up and frees resources allocated for the bulletproof range proof.
  *
  * This function is responsible for safely deallocating all memory that was
- * allocated for a bulletproof range proof operation. It iterates through
- * the arrays of blinding factors, Pedersen commitments, proofs, and value
- * generators, freeing each element and then the array itself.
+ * allocated for a bulletproof range proof operation. The blinding factors,
+ * Pedersen commitments, proofs and value generators all live in one arena,
+ * so they are released together instead of one by one.
  *
  * The function ensures that all memory allocated during the bulletproof
  * range proof process is properly released, preventing memory leaks.
@@ -115,8 +254,11 @@ static void bulletproof_rangeproof_pedersen_commit(void* arg);
  * @note This function should be called after the bulletproof range proof
  *       process is complete, to ensure that all allocated resources are
  *       released. Failing to call this function can result in memory leaks.
+ *       A shared context set through the `context` member is left intact,
+ *       a pooled scratch space is returned to its pool, and an arena set
+ *       through the `arena` member is kept for the next batch.
  */
-static void bulletproof_rangeproof_teardown(void* arg);
+void bulletproof_rangeproof_teardown(void* arg);
 
 /**
  * Generates bulletproof range proofs for a set of values.
@@ -135,7 +277,7 @@ static void bulletproof_rangeproof_teardown(void* arg);
  * @note This function will abort the program if the range proof generation fails.
  *       Ensure that all parameters are correctly set before calling this function.
  */
-static void bulletproof_rangeproof_prove(void* arg);
+void bulletproof_rangeproof_prove(void* arg);
 
 /**
  * Verifies bulletproof range proofs for a set of commitments.
@@ -155,6 +297,6 @@ static void bulletproof_rangeproof_prove(void* arg);
  *       the bulletproof_rangeproof_t structure) to perform the verification.
  *       It aborts the program if any of the range proofs fail verification.
  */
-static void bulletproof_rangeproof_verify(void* arg);
+void bulletproof_rangeproof_verify(void* arg);
 
 #endif // BULLETPROOF_RANGEPROOF_H
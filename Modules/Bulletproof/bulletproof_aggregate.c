@@ -0,0 +1,241 @@
+#include "bulletproof_aggregate.h"
+
+// Public blinding factor 1 of the padding commitments
+static const unsigned char bulletproof_aggregate_pad_blind[32] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1
+};
+
+/**
+ * Returns the number of commitments an aggregated proof over n readings
+ * covers: n rounded up to the next power of two.
+ *
+ * The inner-product argument of a bulletproof works on vectors whose length
+ * is a power of two, so the readings are padded with public commitments to
+ * zero (see bulletproof_aggregate_pad).
+ *
+ * @param n_readings The number of readings proven together.
+ *
+ * @return The padded number of commitments.
+ */
+size_t bulletproof_aggregate_padded(size_t n_readings) {
+    size_t n = 1;
+
+    while (n < n_readings) {
+        n <<= 1;
+    }
+    return n;
+}
+
+/**
+ * Fills the padding commitments of an aggregated proof.
+ *
+ * Every padding commitment commits to the value 0 with the public blinding
+ * factor 1, so verifiers recompute them instead of receiving them.
+ *
+ * @param context The shared bulletproof context.
+ * @param commit An array of bulletproof_aggregate_padded(n_readings)
+ *               commitments whose first n_readings entries hold the readings.
+ * @param n_readings The number of reading commitments.
+ * @param value_gen The value generator of the commitments.
+ *
+ * @return 1 on success, 0 if a commitment could not be computed.
+ */
+int bulletproof_aggregate_pad(const bulletproof_context_t *context, secp256k1_pedersen_commitment *commit, size_t n_readings, const secp256k1_generator *value_gen) {
+    size_t n_commits = bulletproof_aggregate_padded(n_readings);
+    size_t i;
+
+    if (n_readings == n_commits) {
+        return 1;
+    }
+    if (secp256k1_pedersen_commit(context->ctx, &commit[n_readings], bulletproof_aggregate_pad_blind, 0, value_gen, &context->blind_gen) != 1) {
+        return 0;
+    }
+    for (i = n_readings + 1; i < n_commits; i++) {
+        commit[i] = commit[n_readings];
+    }
+    return 1;
+}
+
+/**
+ * Creates a meter-side buffer that collects readings for one aggregated proof.
+ *
+ * @param context The shared bulletproof context. It must hold at least
+ *                2 * bulletproof_aggregate_padded(capacity) * nbits
+ *                generators (see bulletproof_context_covers).
+ * @param scratch A scratch space for exclusive use while proving.
+ * @param value_gen The value generator of the reading commitments.
+ * @param nbits The number of bits proven per reading.
+ * @param capacity The maximum number of readings per proof, for example
+ *                 BULLETPROOF_READINGS_PER_DAY.
+ *
+ * @return A pointer to the new buffer.
+ *
+ * @note This function aborts the program if memory allocation fails.
+ */
+bulletproof_aggregate_t *bulletproof_aggregate_create(const bulletproof_context_t *context, secp256k1_scratch_space *scratch, const secp256k1_generator *value_gen, size_t nbits, size_t capacity) {
+    bulletproof_aggregate_t *agg = (bulletproof_aggregate_t *)malloc(sizeof(*agg));
+    size_t n_commits = bulletproof_aggregate_padded(capacity);
+    size_t i;
+
+    if (agg == NULL) {abort();}
+
+    // Buffers are sized for the padded proof; padding entries follow the readings
+    agg->value = (uint64_t *)calloc(n_commits, sizeof(*agg->value));
+    agg->blind = (unsigned char *)malloc(n_commits * 32);
+    agg->blind_ptr = (const unsigned char **)malloc(n_commits * sizeof(*agg->blind_ptr));
+    agg->commit = (secp256k1_pedersen_commitment *)malloc(n_commits * sizeof(*agg->commit));
+    if (agg->value == NULL || agg->blind == NULL || agg->blind_ptr == NULL || agg->commit == NULL) {abort();}
+
+    for (i = 0; i < n_commits; i++) {
+        agg->blind_ptr[i] = &agg->blind[32 * i];
+    }
+    agg->context = context;
+    agg->scratch = scratch;
+    agg->value_gen = *value_gen;
+    agg->nbits = nbits;
+    agg->capacity = capacity;
+    agg->n_readings = 0;
+
+    return agg;
+}
+
+/**
+ * Destroys a reading buffer, wiping the buffered blinding factors.
+ *
+ * @param agg The buffer to destroy.
+ */
+void bulletproof_aggregate_destroy(bulletproof_aggregate_t *agg) {
+    if (agg == NULL) {
+        return;
+    }
+    memset(agg->blind, 0, bulletproof_aggregate_padded(agg->capacity) * 32);
+    free(agg->value);
+    free(agg->blind);
+    free(agg->blind_ptr);
+    free(agg->commit);
+    free(agg);
+}
+
+/**
+ * Commits to one reading and buffers it for the next aggregated proof.
+ *
+ * @param agg The buffer to add the reading to.
+ * @param value The reading, which must be smaller than 2^nbits.
+ * @param blind The 32-byte blinding factor of the commitment, or NULL to
+ *              draw a fresh random one.
+ * @param commit Receives the Pedersen commitment to the reading, to be
+ *               uploaded alongside the proof.
+ *
+ * @return 1 on success, 0 if the buffer is full, the value is out of range
+ *         or the commitment could not be computed.
+ */
+int bulletproof_aggregate_add(bulletproof_aggregate_t *agg, uint64_t value, const unsigned char *blind, secp256k1_pedersen_commitment *commit) {
+    unsigned char *slot;
+
+    if (agg->n_readings == agg->capacity || (agg->nbits < 64 && (value >> agg->nbits) != 0)) {
+        return 0;
+    }
+
+    slot = &agg->blind[32 * agg->n_readings];
+    if (blind != NULL) {
+        memcpy(slot, blind, 32);
+    } else {
+        generate_secure_random_bytes(slot, 32);
+    }
+    if (secp256k1_pedersen_commit(agg->context->ctx, &agg->commit[agg->n_readings], slot, value, &agg->value_gen, &agg->context->blind_gen) != 1) {
+        return 0;
+    }
+
+    agg->value[agg->n_readings] = value;
+    *commit = agg->commit[agg->n_readings];
+    agg->n_readings++;
+
+    return 1;
+}
+
+/**
+ * Proves that every buffered reading lies in [0, 2^nbits) with a single
+ * aggregated bulletproof, then empties the buffer.
+ *
+ * One aggregated proof is logarithmic in the number of readings, so a day
+ * of readings costs a few hundred bytes more than a single reading instead
+ * of one full proof per interval.
+ *
+ * @param agg The buffer holding the readings.
+ * @param proof Receives the proof; MAX_PROOF_SIZE bytes suffice.
+ * @param plen On input the size of proof, on output the proof length.
+ *
+ * @return 1 on success, 0 if the buffer is empty or proving fails. The buffer
+ *         is kept on failure so that proving can be retried.
+ */
+int bulletproof_aggregate_prove(bulletproof_aggregate_t *agg, unsigned char *proof, size_t *plen) {
+    size_t n_commits = bulletproof_aggregate_padded(agg->n_readings);
+    unsigned char nonce[32];
+    size_t i;
+
+    if (agg->n_readings == 0) {
+        return 0;
+    }
+
+    // Padding entries commit to 0 with the public blinding factor
+    for (i = agg->n_readings; i < n_commits; i++) {
+        agg->value[i] = 0;
+        memcpy(&agg->blind[32 * i], bulletproof_aggregate_pad_blind, 32);
+    }
+
+    generate_secure_random_bytes(nonce, sizeof(nonce));
+    if (secp256k1_bulletproof_rangeproof_prove(agg->context->ctx, agg->scratch, agg->context->generators, proof, plen, agg->value, NULL, agg->blind_ptr, n_commits, &agg->value_gen, agg->nbits, nonce, NULL, 0) != 1) {
+        return 0;
+    }
+
+    memset(agg->blind, 0, n_commits * 32);
+    agg->n_readings = 0;
+
+    return 1;
+}
+
+/**
+ * Verifies an aggregated proof over the uploaded reading commitments.
+ *
+ * @param context The shared bulletproof context.
+ * @param scratch A scratch space for exclusive use while verifying.
+ * @param proof The aggregated proof.
+ * @param plen The length of the proof in bytes.
+ * @param commit The n_readings uploaded reading commitments.
+ * @param n_readings The number of readings the proof covers.
+ * @param nbits The number of bits proven per reading, from 1 to 64.
+ * @param value_gen The value generator of the commitments.
+ *
+ * @return 1 if the proof is valid, 0 if it is invalid or if the context's
+ *         generators cannot cover the padded readings (see
+ *         bulletproof_context_covers).
+ */
+int bulletproof_aggregate_verify(const bulletproof_context_t *context, secp256k1_scratch_space *scratch, const unsigned char *proof, size_t plen, const secp256k1_pedersen_commitment *commit, size_t n_readings, size_t nbits, const secp256k1_generator *value_gen) {
+    size_t n_commits;
+    secp256k1_pedersen_commitment *padded;
+    int ok;
+
+    // Both bounds come from the upload; shapes the generators cannot cover
+    // would abort inside secp256k1-zkp. The unpadded count is checked first
+    // so that padding it cannot overflow.
+    if (!bulletproof_context_covers(context, n_readings, nbits)) {
+        return 0;
+    }
+    n_commits = bulletproof_aggregate_padded(n_readings);
+    if (!bulletproof_context_covers(context, n_commits, nbits)) {
+        return 0;
+    }
+
+    padded = (secp256k1_pedersen_commitment *)malloc(n_commits * sizeof(*padded));
+    if (padded == NULL) {
+        return 0;
+    }
+    memcpy(padded, commit, n_readings * sizeof(*padded));
+
+    ok = bulletproof_aggregate_pad(context, padded, n_readings, value_gen)
+        && secp256k1_bulletproof_rangeproof_verify(context->ctx, scratch, context->generators, proof, plen, NULL, padded, n_commits, nbits, value_gen, NULL, 0) == 1;
+
+    free(padded);
+    return ok;
+}
@@ -0,0 +1,126 @@
+#ifndef BULLETPROOF_AGGREGATE_H
+#define BULLETPROOF_AGGREGATE_H
+
+#include "bulletproof.h"
+
+#define BULLETPROOF_READINGS_PER_DAY 96
+
+typedef struct {
+    const bulletproof_context_t *context;
+    secp256k1_scratch_space *scratch;
+    secp256k1_generator value_gen;
+    size_t nbits;
+    size_t capacity;
+    size_t n_readings;
+    uint64_t *value;
+    unsigned char *blind;
+    const unsigned char **blind_ptr;
+    secp256k1_pedersen_commitment *commit;
+} bulletproof_aggregate_t;
+
+/**
+ * Returns the number of commitments an aggregated proof over n readings
+ * covers: n rounded up to the next power of two.
+ *
+ * The inner-product argument of a bulletproof works on vectors whose length
+ * is a power of two, so the readings are padded with public commitments to
+ * zero (see bulletproof_aggregate_pad).
+ *
+ * @param n_readings The number of readings proven together.
+ *
+ * @return The padded number of commitments.
+ */
+size_t bulletproof_aggregate_padded(size_t n_readings);
+
+/**
+ * Fills the padding commitments of an aggregated proof.
+ *
+ * Every padding commitment commits to the value 0 with the public blinding
+ * factor 1, so verifiers recompute them instead of receiving them.
+ *
+ * @param context The shared bulletproof context.
+ * @param commit An array of bulletproof_aggregate_padded(n_readings)
+ *               commitments whose first n_readings entries hold the readings.
+ * @param n_readings The number of reading commitments.
+ * @param value_gen The value generator of the commitments.
+ *
+ * @return 1 on success, 0 if a commitment could not be computed.
+ */
+int bulletproof_aggregate_pad(const bulletproof_context_t *context, secp256k1_pedersen_commitment *commit, size_t n_readings, const secp256k1_generator *value_gen);
+
+/**
+ * Creates a meter-side buffer that collects readings for one aggregated proof.
+ *
+ * @param context The shared bulletproof context. It must hold at least
+ *                2 * bulletproof_aggregate_padded(capacity) * nbits
+ *                generators (see bulletproof_context_covers).
+ * @param scratch A scratch space for exclusive use while proving.
+ * @param value_gen The value generator of the reading commitments.
+ * @param nbits The number of bits proven per reading.
+ * @param capacity The maximum number of readings per proof, for example
+ *                 BULLETPROOF_READINGS_PER_DAY.
+ *
+ * @return A pointer to the new buffer.
+ *
+ * @note This function aborts the program if memory allocation fails.
+ */
+bulletproof_aggregate_t *bulletproof_aggregate_create(const bulletproof_context_t *context, secp256k1_scratch_space *scratch, const secp256k1_generator *value_gen, size_t nbits, size_t capacity);
+
+/**
+ * Destroys a reading buffer, wiping the buffered blinding factors.
+ *
+ * @param agg The buffer to destroy.
+ */
+void bulletproof_aggregate_destroy(bulletproof_aggregate_t *agg);
+
+/**
+ * Commits to one reading and buffers it for the next aggregated proof.
+ *
+ * @param agg The buffer to add the reading to.
+ * @param value The reading, which must be smaller than 2^nbits.
+ * @param blind The 32-byte blinding factor of the commitment, or NULL to
+ *              draw a fresh random one.
+ * @param commit Receives the Pedersen commitment to the reading, to be
+ *               uploaded alongside the proof.
+ *
+ * @return 1 on success, 0 if the buffer is full, the value is out of range
+ *         or the commitment could not be computed.
+ */
+int bulletproof_aggregate_add(bulletproof_aggregate_t *agg, uint64_t value, const unsigned char *blind, secp256k1_pedersen_commitment *commit);
+
+/**
+ * Proves that every buffered reading lies in [0, 2^nbits) with a single
+ * aggregated bulletproof, then empties the buffer.
+ *
+ * One aggregated proof is logarithmic in the number of readings, so a day
+ * of readings costs a few hundred bytes more than a single reading instead
+ * of one full proof per interval.
+ *
+ * @param agg The buffer holding the readings.
+ * @param proof Receives the proof; MAX_PROOF_SIZE bytes suffice.
+ * @param plen On input the size of proof, on output the proof length.
+ *
+ * @return 1 on success, 0 if the buffer is empty or proving fails. The buffer
+ *         is kept on failure so that proving can be retried.
+ */
+int bulletproof_aggregate_prove(bulletproof_aggregate_t *agg, unsigned char *proof, size_t *plen);
+
+/**
+ * Verifies an aggregated proof over the uploaded reading commitments.
+ *
+ * @param context The shared bulletproof context.
+ * @param scratch A scratch space for exclusive use while verifying.
+ * @param proof The aggregated proof.
+ * @param plen The length of the proof in bytes.
+ * @param commit The n_readings uploaded reading commitments.
+ * @param n_readings The number of readings the proof covers.
+ * @param nbits The number of bits proven per reading, from 1 to 64.
+ * @param value_gen The value generator of the commitments.
+ *
+ * @return 1 if the proof is valid, 0 if it is invalid or if the context's
+ *         generators cannot cover the padded readings (see
+ *         bulletproof_context_covers).
+ */
+int bulletproof_aggregate_verify(const bulletproof_context_t *context, secp256k1_scratch_space *scratch, const unsigned char *proof, size_t plen, const secp256k1_pedersen_commitment *commit, size_t n_readings, size_t nbits, const secp256k1_generator *value_gen);
+
+#endif // BULLETPROOF_AGGREGATE_H
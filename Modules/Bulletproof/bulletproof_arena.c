@@ -0,0 +1,90 @@
+#include <stdlib.h>
+
+#include "bulletproof_arena.h"
+
+/**
+ * Creates a bump allocator over one contiguous buffer.
+ *
+ * Blocks are carved from the buffer in order and never freed one by one:
+ * the whole arena is reset at once, so a batch costs a single allocation
+ * and a reused arena costs none.
+ *
+ * @param capacity The initial size of the buffer in bytes.
+ *
+ * @return A pointer to the new arena.
+ *
+ * @note This function aborts the program if memory allocation fails.
+ */
+bulletproof_arena_t *bulletproof_arena_create(size_t capacity) {
+    bulletproof_arena_t *arena = (bulletproof_arena_t *)malloc(sizeof(*arena));
+    if (arena == NULL) {abort();}
+
+    arena->capacity = BULLETPROOF_ARENA_ROUND(capacity);
+    arena->base = NULL;
+    if (arena->capacity != 0) {
+        arena->base = (unsigned char *)aligned_alloc(BULLETPROOF_ARENA_ALIGN, arena->capacity);
+        if (arena->base == NULL) {abort();}
+    }
+    arena->used = 0;
+    return arena;
+}
+
+/**
+ * Destroys an arena and the buffer it manages.
+ *
+ * @param arena The arena to destroy.
+ */
+void bulletproof_arena_destroy(bulletproof_arena_t *arena) {
+    if (arena == NULL) {
+        return;
+    }
+    free(arena->base);
+    free(arena);
+}
+
+/**
+ * Empties an arena and makes sure it can hold at least size bytes.
+ *
+ * Every block previously carved from the arena becomes invalid. The buffer
+ * is only reallocated if it is too small, so an arena reused for batches of
+ * the same shape never allocates again.
+ *
+ * @param arena The arena to reset.
+ * @param size The number of bytes the next batch needs, for example from
+ *             bulletproof_rangeproof_arena_size.
+ *
+ * @note This function aborts the program if memory allocation fails.
+ */
+void bulletproof_arena_reset(bulletproof_arena_t *arena, size_t size) {
+    size = BULLETPROOF_ARENA_ROUND(size);
+    if (size > arena->capacity) {
+        // The old contents are discarded anyway, so there is nothing to copy
+        free(arena->base);
+        arena->base = (unsigned char *)aligned_alloc(BULLETPROOF_ARENA_ALIGN, size);
+        if (arena->base == NULL) {abort();}
+        arena->capacity = size;
+    }
+    arena->used = 0;
+}
+
+/**
+ * Carves a block of BULLETPROOF_ARENA_ALIGN-aligned memory from an arena.
+ *
+ * @param arena The arena to allocate from.
+ * @param size The size of the block in bytes.
+ *
+ * @return A pointer to the block, valid until the arena is reset or destroyed.
+ *
+ * @note This function aborts the program if the arena is exhausted; size the
+ *       arena with bulletproof_arena_reset beforehand.
+ */
+void *bulletproof_arena_alloc(bulletproof_arena_t *arena, size_t size) {
+    void *block;
+
+    size = BULLETPROOF_ARENA_ROUND(size);
+    if (size > arena->capacity - arena->used) {abort();}
+
+    block = arena->base + arena->used;
+    arena->used += size;
+    return block;
+}
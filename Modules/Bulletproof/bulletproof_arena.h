@@ -0,0 +1,68 @@
+#ifndef BULLETPROOF_ARENA_H
+#define BULLETPROOF_ARENA_H
+
+#include <stddef.h>
+
+// Alignment of every block carved from an arena
+#define BULLETPROOF_ARENA_ALIGN 16
+
+// Size of a block of size bytes once carved from an arena
+#define BULLETPROOF_ARENA_ROUND(size) (((size) + BULLETPROOF_ARENA_ALIGN - 1) & ~(size_t)(BULLETPROOF_ARENA_ALIGN - 1))
+
+typedef struct {
+    unsigned char *base;
+    size_t capacity;
+    size_t used;
+} bulletproof_arena_t;
+
+/**
+ * Creates a bump allocator over one contiguous buffer.
+ *
+ * Blocks are carved from the buffer in order and never freed one by one:
+ * the whole arena is reset at once, so a batch costs a single allocation
+ * and a reused arena costs none.
+ *
+ * @param capacity The initial size of the buffer in bytes.
+ *
+ * @return A pointer to the new arena.
+ *
+ * @note This function aborts the program if memory allocation fails.
+ */
+bulletproof_arena_t *bulletproof_arena_create(size_t capacity);
+
+/**
+ * Destroys an arena and the buffer it manages.
+ *
+ * @param arena The arena to destroy.
+ */
+void bulletproof_arena_destroy(bulletproof_arena_t *arena);
+
+/**
+ * Empties an arena and makes sure it can hold at least size bytes.
+ *
+ * Every block previously carved from the arena becomes invalid. The buffer
+ * is only reallocated if it is too small, so an arena reused for batches of
+ * the same shape never allocates again.
+ *
+ * @param arena The arena to reset.
+ * @param size The number of bytes the next batch needs, for example from
+ *             bulletproof_rangeproof_arena_size.
+ *
+ * @note This function aborts the program if memory allocation fails.
+ */
+void bulletproof_arena_reset(bulletproof_arena_t *arena, size_t size);
+
+/**
+ * Carves a block of BULLETPROOF_ARENA_ALIGN-aligned memory from an arena.
+ *
+ * @param arena The arena to allocate from.
+ * @param size The size of the block in bytes.
+ *
+ * @return A pointer to the block, valid until the arena is reset or destroyed.
+ *
+ * @note This function aborts the program if the arena is exhausted; size the
+ *       arena with bulletproof_arena_reset beforehand.
+ */
+void *bulletproof_arena_alloc(bulletproof_arena_t *arena, size_t size);
+
+#endif // BULLETPROOF_ARENA_H
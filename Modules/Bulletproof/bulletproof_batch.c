@@ -0,0 +1,265 @@
+#include "bulletproof_batch.h"
+#include "metrics.h"
+
+typedef struct {
+    size_t n_commits;
+    size_t nbits;
+    size_t plen;
+    size_t index;
+} bulletproof_batch_key_t;
+
+typedef struct {
+    const unsigned char **proof;
+    const secp256k1_pedersen_commitment **commit;
+    secp256k1_generator *value_gen;
+} bulletproof_batch_args_t;
+
+static int bulletproof_backend_cpu_verify(void *state, const bulletproof_context_t *context, secp256k1_scratch_space *scratch, const unsigned char **proof, size_t n, size_t plen, const secp256k1_pedersen_commitment **commit, size_t n_commits, size_t nbits, const secp256k1_generator *value_gen) {
+    (void)state;
+    return secp256k1_bulletproof_rangeproof_verify_multi(context->ctx, scratch, context->generators, proof, n, plen, NULL, commit, n_commits, nbits, value_gen, NULL, 0) == 1;
+}
+
+const bulletproof_backend_t bulletproof_backend_cpu = { "cpu", bulletproof_backend_cpu_verify, NULL };
+
+/**
+ * Creates a batch verifier for range proofs coming from many meters.
+ *
+ * Each item of the batch is an independent (proof, commitments, value_gen)
+ * tuple, so proofs over different commitment sets and value generators can
+ * be verified together.
+ *
+ * @param context The shared context whose generators the proofs were made with.
+ * @param scratch A scratch space for exclusive use by this batch, for example
+ *                one acquired from a bulletproof_scratch_pool_t.
+ * @param scratch_size The size of the scratch space in bytes. Groups of
+ *                     proofs are split so that each verification fits.
+ * @param capacity The initial number of items; the batch grows as needed.
+ *
+ * @return A pointer to the new batch.
+ *
+ * @note This function aborts the program if memory allocation fails.
+ */
+bulletproof_batch_t *bulletproof_batch_create(const bulletproof_context_t *context, secp256k1_scratch_space *scratch, size_t scratch_size, size_t capacity) {
+    bulletproof_batch_t *batch = (bulletproof_batch_t *)malloc(sizeof(*batch));
+    if (batch == NULL) {abort();}
+
+    if (capacity == 0) {
+        capacity = 1;
+    }
+    batch->items = (bulletproof_batch_item_t *)malloc(capacity * sizeof(*batch->items));
+    if (batch->items == NULL) {abort();}
+
+    batch->context = context;
+    batch->scratch = scratch;
+    batch->scratch_size = scratch_size;
+    batch->n_items = 0;
+    batch->capacity = capacity;
+    batch->backend = &bulletproof_backend_cpu;
+
+    return batch;
+}
+
+/**
+ * Destroys a batch verifier. The scratch space is not destroyed.
+ *
+ * @param batch The batch to destroy.
+ */
+void bulletproof_batch_destroy(bulletproof_batch_t *batch) {
+    if (batch == NULL) {
+        return;
+    }
+    free(batch->items);
+    free(batch);
+}
+
+/**
+ * Selects the backend that verifies the groups of a batch.
+ *
+ * Whenever the backend returns BULLETPROOF_BACKEND_UNAVAILABLE, for example
+ * because its device is busy, missing or lacks memory for the group, the
+ * group is verified on the CPU instead. A proof is only reported invalid once
+ * the CPU verifier has rejected it as well, so a faulty backend cannot reject
+ * valid meters.
+ *
+ * @param batch The batch.
+ * @param backend The backend, or NULL for bulletproof_backend_cpu. It must
+ *                outlive the batch.
+ */
+void bulletproof_batch_set_backend(bulletproof_batch_t *batch, const bulletproof_backend_t *backend) {
+    batch->backend = backend != NULL ? backend : &bulletproof_backend_cpu;
+}
+
+/**
+ * Removes every item from a batch so that it can be reused.
+ *
+ * @param batch The batch to clear.
+ */
+void bulletproof_batch_clear(bulletproof_batch_t *batch) {
+    batch->n_items = 0;
+}
+
+/**
+ * Adds one range proof to a batch.
+ *
+ * The proof and commitment buffers are not copied: they must stay valid and
+ * unchanged until the batch is verified or cleared.
+ *
+ * @param batch The batch to add the proof to.
+ * @param proof The serialized range proof.
+ * @param plen The length of the proof in bytes.
+ * @param commit The n_commits Pedersen commitments the proof covers.
+ * @param n_commits The number of commitments.
+ * @param nbits The number of bits proven per commitment.
+ * @param value_gen The value generator of the commitments.
+ *
+ * @return The index of the item within the batch.
+ *
+ * @note This function aborts the program if memory allocation fails.
+ */
+size_t bulletproof_batch_add(bulletproof_batch_t *batch, const unsigned char *proof, size_t plen, const secp256k1_pedersen_commitment *commit, size_t n_commits, size_t nbits, const secp256k1_generator *value_gen) {
+    bulletproof_batch_item_t *item;
+
+    if (batch->n_items == batch->capacity) {
+        batch->capacity *= 2;
+        batch->items = (bulletproof_batch_item_t *)realloc(batch->items, batch->capacity * sizeof(*batch->items));
+        if (batch->items == NULL) {abort();}
+    }
+
+    item = &batch->items[batch->n_items];
+    item->proof = proof;
+    item->plen = plen;
+    item->commit = commit;
+    item->n_commits = n_commits;
+    item->nbits = nbits;
+    item->value_gen = *value_gen;
+
+    return batch->n_items++;
+}
+
+/**
+ * Orders items by shape, so that proofs verifiable together are adjacent.
+ */
+static int bulletproof_batch_compare(const void *a, const void *b) {
+    const bulletproof_batch_key_t *x = (const bulletproof_batch_key_t *)a;
+    const bulletproof_batch_key_t *y = (const bulletproof_batch_key_t *)b;
+
+    if (x->n_commits != y->n_commits) {
+        return x->n_commits < y->n_commits ? -1 : 1;
+    }
+    if (x->nbits != y->nbits) {
+        return x->nbits < y->nbits ? -1 : 1;
+    }
+    if (x->plen != y->plen) {
+        return x->plen < y->plen ? -1 : 1;
+    }
+    // Keep the submission order within a group
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+/**
+ * Verifies the items key[0..n) of one shape with a single verify_multi call
+ * on the backend of the batch, bisecting on failure. The CPU verifier takes
+ * over groups the backend cannot handle and confirms every rejection.
+ * Returns the number of invalid proofs found.
+ */
+static size_t bulletproof_batch_verify_range(const bulletproof_batch_t *batch, const bulletproof_batch_key_t *key, size_t n, bulletproof_batch_args_t *args, unsigned char *valid) {
+    size_t i;
+    int ok;
+
+    for (i = 0; i < n; i++) {
+        args->proof[i] = batch->items[key[i].index].proof;
+        args->commit[i] = batch->items[key[i].index].commit;
+        args->value_gen[i] = batch->items[key[i].index].value_gen;
+    }
+    ok = batch->backend->verify_multi(batch->backend->state, batch->context, batch->scratch, args->proof, n, key[0].plen, args->commit, key[0].n_commits, key[0].nbits, args->value_gen);
+    if (ok != 1 && batch->backend != &bulletproof_backend_cpu && (ok == BULLETPROOF_BACKEND_UNAVAILABLE || n == 1)) {
+        ok = bulletproof_backend_cpu_verify(NULL, batch->context, batch->scratch, args->proof, n, key[0].plen, args->commit, key[0].n_commits, key[0].nbits, args->value_gen);
+    }
+
+    if (ok == 1) {
+        for (i = 0; i < n; i++) {
+            valid[key[i].index] = 1;
+        }
+        return 0;
+    }
+    if (n == 1) {
+        valid[key[0].index] = 0;
+        return 1;
+    }
+    // Bisect to isolate the invalid proofs
+    return bulletproof_batch_verify_range(batch, key, n / 2, args, valid) + bulletproof_batch_verify_range(batch, key + n / 2, n - n / 2, args, valid);
+}
+
+/**
+ * Verifies every range proof of a batch.
+ *
+ * Items are grouped by shape (n_commits, nbits and proof length), because
+ * secp256k1_bulletproof_rangeproof_verify_multi checks proofs of one shape
+ * at a time. Each group is verified with a single verify_multi call, that is
+ * a single multi-exponentiation, as far as the scratch space allows, on the
+ * backend of the batch. If a group fails, it is bisected until the invalid
+ * proofs are isolated, so a few bad meters cost only a logarithmic number of
+ * extra verifications.
+ *
+ * @param batch The batch to verify.
+ * @param valid An array of batch->n_items flags that receives 1 for every
+ *              valid proof and 0 for every invalid one.
+ *
+ * @return The number of invalid proofs; 0 if the whole batch is valid.
+ */
+size_t bulletproof_batch_verify(bulletproof_batch_t *batch, unsigned char *valid) {
+    bulletproof_batch_args_t args;
+    bulletproof_batch_key_t *key;
+    size_t begin, end, chunk, max_chunk;
+    size_t n_invalid = 0;
+    size_t i;
+    METRICS_BEGIN(start);
+
+    if (batch->n_items == 0) {
+        return 0;
+    }
+
+    key = (bulletproof_batch_key_t *)malloc(batch->n_items * sizeof(*key));
+    args.proof = (const unsigned char **)malloc(batch->n_items * sizeof(*args.proof));
+    args.commit = (const secp256k1_pedersen_commitment **)malloc(batch->n_items * sizeof(*args.commit));
+    args.value_gen = (secp256k1_generator *)malloc(batch->n_items * sizeof(*args.value_gen));
+    if (key == NULL || args.proof == NULL || args.commit == NULL || args.value_gen == NULL) {abort();}
+
+    // Group the items by shape
+    for (i = 0; i < batch->n_items; i++) {
+        key[i].n_commits = batch->items[i].n_commits;
+        key[i].nbits = batch->items[i].nbits;
+        key[i].plen = batch->items[i].plen;
+        key[i].index = i;
+    }
+    qsort(key, batch->n_items, sizeof(*key), bulletproof_batch_compare);
+
+    for (begin = 0; begin < batch->n_items; begin = end) {
+        for (end = begin + 1; end < batch->n_items && key[end].n_commits == key[begin].n_commits && key[end].nbits == key[begin].nbits && key[end].plen == key[begin].plen; end++);
+
+        // Proofs that the shared generators cannot cover are rejected outright
+        if (!bulletproof_context_covers(batch->context, key[begin].n_commits, key[begin].nbits)) {
+            for (i = begin; i < end; i++) {
+                valid[key[i].index] = 0;
+            }
+            n_invalid += end - begin;
+            continue;
+        }
+
+        // Largest number of proofs of this shape whose verification fits the scratch space
+        for (max_chunk = 1; max_chunk < end - begin && bulletproof_scratch_size(key[begin].n_commits, key[begin].nbits, 2 * max_chunk) <= batch->scratch_size; max_chunk *= 2);
+
+        for (i = begin; i < end; i += chunk) {
+            chunk = (end - i < max_chunk) ? end - i : max_chunk;
+            n_invalid += bulletproof_batch_verify_range(batch, key + i, chunk, &args, valid);
+        }
+    }
+
+    free(key);
+    free(args.proof);
+    free(args.commit);
+    free(args.value_gen);
+
+    METRICS_END(METRICS_OP_VERIFY, start, n_invalid == 0);
+    return n_invalid;
+}
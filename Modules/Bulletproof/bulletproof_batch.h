@@ -0,0 +1,136 @@
+#ifndef BULLETPROOF_BATCH_H
+#define BULLETPROOF_BATCH_H
+
+#include "bulletproof.h"
+
+// Returned by a backend that cannot verify a group, which is then verified on the CPU
+#define BULLETPROOF_BACKEND_UNAVAILABLE (-1)
+
+/*
+ * Verifies n proofs of one shape at once, with the arguments of
+ * secp256k1_bulletproof_rangeproof_verify_multi. Returns 1 if every proof is
+ * valid, 0 if any is invalid, or BULLETPROOF_BACKEND_UNAVAILABLE.
+ */
+typedef int (*bulletproof_verify_multi_fn)(void *state, const bulletproof_context_t *context, secp256k1_scratch_space *scratch, const unsigned char **proof, size_t n, size_t plen, const secp256k1_pedersen_commitment **commit, size_t n_commits, size_t nbits, const secp256k1_generator *value_gen);
+
+/*
+ * A verification backend of the batch verifier, for example one offloading
+ * the multi-exponentiation to an accelerator.
+ */
+typedef struct {
+    const char *name;
+    bulletproof_verify_multi_fn verify_multi;
+    void *state;              // Passed to verify_multi
+} bulletproof_backend_t;
+
+typedef struct {
+    const unsigned char *proof;
+    size_t plen;
+    const secp256k1_pedersen_commitment *commit;
+    size_t n_commits;
+    size_t nbits;
+    secp256k1_generator value_gen;
+} bulletproof_batch_item_t;
+
+typedef struct {
+    const bulletproof_context_t *context;
+    secp256k1_scratch_space *scratch;
+    size_t scratch_size;
+    bulletproof_batch_item_t *items;
+    size_t n_items;
+    size_t capacity;
+    const bulletproof_backend_t *backend;
+} bulletproof_batch_t;
+
+// The default backend, which calls secp256k1_bulletproof_rangeproof_verify_multi
+extern const bulletproof_backend_t bulletproof_backend_cpu;
+
+/**
+ * Creates a batch verifier for range proofs coming from many meters.
+ *
+ * Each item of the batch is an independent (proof, commitments, value_gen)
+ * tuple, so proofs over different commitment sets and value generators can
+ * be verified together.
+ *
+ * @param context The shared context whose generators the proofs were made with.
+ * @param scratch A scratch space for exclusive use by this batch, for example
+ *                one acquired from a bulletproof_scratch_pool_t.
+ * @param scratch_size The size of the scratch space in bytes. Groups of
+ *                     proofs are split so that each verification fits.
+ * @param capacity The initial number of items; the batch grows as needed.
+ *
+ * @return A pointer to the new batch.
+ *
+ * @note This function aborts the program if memory allocation fails.
+ */
+bulletproof_batch_t *bulletproof_batch_create(const bulletproof_context_t *context, secp256k1_scratch_space *scratch, size_t scratch_size, size_t capacity);
+
+/**
+ * Destroys a batch verifier. The scratch space is not destroyed.
+ *
+ * @param batch The batch to destroy.
+ */
+void bulletproof_batch_destroy(bulletproof_batch_t *batch);
+
+/**
+ * Selects the backend that verifies the groups of a batch.
+ *
+ * Whenever the backend returns BULLETPROOF_BACKEND_UNAVAILABLE, for example
+ * because its device is busy, missing or lacks memory for the group, the
+ * group is verified on the CPU instead. A proof is only reported invalid once
+ * the CPU verifier has rejected it as well, so a faulty backend cannot reject
+ * valid meters.
+ *
+ * @param batch The batch.
+ * @param backend The backend, or NULL for bulletproof_backend_cpu. It must
+ *                outlive the batch.
+ */
+void bulletproof_batch_set_backend(bulletproof_batch_t *batch, const bulletproof_backend_t *backend);
+
+/**
+ * Removes every item from a batch so that it can be reused.
+ *
+ * @param batch The batch to clear.
+ */
+void bulletproof_batch_clear(bulletproof_batch_t *batch);
+
+/**
+ * Adds one range proof to a batch.
+ *
+ * The proof and commitment buffers are not copied: they must stay valid and
+ * unchanged until the batch is verified or cleared.
+ *
+ * @param batch The batch to add the proof to.
+ * @param proof The serialized range proof.
+ * @param plen The length of the proof in bytes.
+ * @param commit The n_commits Pedersen commitments the proof covers.
+ * @param n_commits The number of commitments.
+ * @param nbits The number of bits proven per commitment.
+ * @param value_gen The value generator of the commitments.
+ *
+ * @return The index of the item within the batch.
+ *
+ * @note This function aborts the program if memory allocation fails.
+ */
+size_t bulletproof_batch_add(bulletproof_batch_t *batch, const unsigned char *proof, size_t plen, const secp256k1_pedersen_commitment *commit, size_t n_commits, size_t nbits, const secp256k1_generator *value_gen);
+
+/**
+ * Verifies every range proof of a batch.
+ *
+ * Items are grouped by shape (n_commits, nbits and proof length), because
+ * secp256k1_bulletproof_rangeproof_verify_multi checks proofs of one shape
+ * at a time. Each group is verified with a single verify_multi call, that is
+ * a single multi-exponentiation, as far as the scratch space allows, on the
+ * backend of the batch. If a group fails, it is bisected until the invalid
+ * proofs are isolated, so a few bad meters cost only a logarithmic number of
+ * extra verifications.
+ *
+ * @param batch The batch to verify.
+ * @param valid An array of batch->n_items flags that receives 1 for every
+ *              valid proof and 0 for every invalid one.
+ *
+ * @return The number of invalid proofs; 0 if the whole batch is valid.
+ */
+size_t bulletproof_batch_verify(bulletproof_batch_t *batch, unsigned char *valid);
+
+#endif // BULLETPROOF_BATCH_H
@@ -0,0 +1,335 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bulletproof_gens.h"
+
+typedef struct {
+    unsigned char seed[32];
+    secp256k1_generator gen;
+    int used;
+} bulletproof_gens_slot_t;
+
+// Process-wide cache, guarded by gens_lock
+static pthread_rwlock_t gens_lock = PTHREAD_RWLOCK_INITIALIZER;
+static bulletproof_gens_slot_t *gens_slots = NULL;
+static size_t gens_count = 0;
+
+// Read-only mapping of a generator file, also guarded by gens_lock
+static unsigned char *gens_map = NULL;
+static size_t gens_map_len = 0;
+static size_t gens_map_count = 0;
+
+static void bulletproof_gens_put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static uint32_t bulletproof_gens_get_u32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * Returns the cache slot holding seed, or the empty slot where it belongs.
+ * The table is never more than three quarters full, so probing ends.
+ */
+static bulletproof_gens_slot_t *bulletproof_gens_slot(const unsigned char seed[32]) {
+    size_t h = ((size_t)seed[0] << 24 | (size_t)seed[1] << 16 | (size_t)seed[2] << 8 | seed[3]) % BULLETPROOF_GENS_CACHE_SLOTS;
+
+    while (gens_slots[h].used && memcmp(gens_slots[h].seed, seed, 32) != 0) {
+        h = (h + 1) % BULLETPROOF_GENS_CACHE_SLOTS;
+    }
+    return &gens_slots[h];
+}
+
+/**
+ * Binary-searches the mapped file for seed.
+ *
+ * @return The serialized generator of seed, or NULL if it is not mapped.
+ */
+static const unsigned char *bulletproof_gens_map_find(const unsigned char seed[32]) {
+    size_t lo = 0, hi = gens_map_count, mid;
+    const unsigned char *record;
+    int c;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        record = gens_map + BULLETPROOF_GENS_HEADER + mid * BULLETPROOF_GENS_RECORD;
+        c = memcmp(seed, record, 32);
+        if (c == 0) {
+            return record + 32;
+        }
+        if (c < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Derives the value generator of a seed through a process-wide cache.
+ *
+ * The result equals that of secp256k1_generator_generate for the same seed.
+ * It is looked up first in the in-memory cache, then in the file mapped by
+ * bulletproof_value_gen_load, and only generated on a miss of both; every
+ * result is remembered while the cache has room. The function may be called
+ * from several threads at once.
+ *
+ * @param ctx A secp256k1 context, only read.
+ * @param gen The generator to set.
+ * @param seed The 32-byte seed the generator is derived from.
+ *
+ * @return 1 on success, 0 if the generator cannot be derived.
+ */
+int bulletproof_value_gen(const secp256k1_context *ctx, secp256k1_generator *gen, const unsigned char seed[32]) {
+    bulletproof_gens_slot_t *slot;
+    const unsigned char *mapped;
+    int ok = 0;
+
+    pthread_rwlock_rdlock(&gens_lock);
+    if (gens_slots != NULL) {
+        slot = bulletproof_gens_slot(seed);
+        if (slot->used) {
+            *gen = slot->gen;
+            pthread_rwlock_unlock(&gens_lock);
+            return 1;
+        }
+    }
+    if (gens_map != NULL) {
+        mapped = bulletproof_gens_map_find(seed);
+        ok = mapped != NULL && secp256k1_generator_parse(ctx, gen, mapped) == 1;
+    }
+    pthread_rwlock_unlock(&gens_lock);
+
+    if (!ok && secp256k1_generator_generate(ctx, gen, seed) != 1) {
+        return 0;
+    }
+
+    // Remember the generator; a concurrent miss may have inserted it already
+    pthread_rwlock_wrlock(&gens_lock);
+    if (gens_slots == NULL) {
+        gens_slots = (bulletproof_gens_slot_t *)calloc(BULLETPROOF_GENS_CACHE_SLOTS, sizeof(*gens_slots));
+    }
+    if (gens_slots != NULL && gens_count < BULLETPROOF_GENS_CACHE_SLOTS / 4 * 3) {
+        slot = bulletproof_gens_slot(seed);
+        if (!slot->used) {
+            memcpy(slot->seed, seed, 32);
+            slot->gen = *gen;
+            slot->used = 1;
+            gens_count++;
+        }
+    }
+    pthread_rwlock_unlock(&gens_lock);
+
+    return 1;
+}
+
+/**
+ * Syncs the directory holding path, so that a rename into it survives a
+ * power loss.
+ *
+ * @return 1 on success, 0 on failure.
+ */
+static int bulletproof_gens_sync_dir(const char *path) {
+    const char *slash = strrchr(path, '/');
+    size_t dlen;
+    char *dir;
+    int fd, ok;
+
+    if (slash == NULL) {
+        path = ".";
+        dlen = 1;
+    } else {
+        dlen = slash == path ? 1 : (size_t)(slash - path);
+    }
+    dir = (char *)malloc(dlen + 1);
+    if (dir == NULL) {
+        return 0;
+    }
+    memcpy(dir, path, dlen);
+    dir[dlen] = '\0';
+
+    fd = open(dir, O_RDONLY | O_DIRECTORY);
+    ok = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0) {
+        ok = close(fd) == 0 && ok;
+    }
+    free(dir);
+    return ok;
+}
+
+static int bulletproof_gens_record_cmp(const void *a, const void *b) {
+    return memcmp(a, b, 32);
+}
+
+/**
+ * Writes every cached and mapped value generator to a file.
+ *
+ * The file holds a 16-byte header (magic, big-endian version and record
+ * count) followed by 65-byte records, a seed and the serialized generator,
+ * sorted by seed. It is written to path.tmp, synced and renamed over path,
+ * and the directory is synced so that the rename survives a power loss.
+ *
+ * @param ctx A secp256k1 context, only read.
+ * @param path The file to write.
+ *
+ * @return 1 on success, 0 on failure.
+ */
+int bulletproof_value_gen_save(const secp256k1_context *ctx, const char *path) {
+    unsigned char header[BULLETPROOF_GENS_HEADER];
+    unsigned char *records, *p;
+    size_t i, n = 0, kept, len;
+    char *tmp;
+    FILE *fp;
+    int ok = 1;
+
+    pthread_rwlock_rdlock(&gens_lock);
+    records = (unsigned char *)malloc((gens_count + gens_map_count + 1) * BULLETPROOF_GENS_RECORD);
+    if (records == NULL) {
+        pthread_rwlock_unlock(&gens_lock);
+        return 0;
+    }
+    for (i = 0; gens_slots != NULL && i < BULLETPROOF_GENS_CACHE_SLOTS && ok; i++) {
+        if (gens_slots[i].used) {
+            p = records + n++ * BULLETPROOF_GENS_RECORD;
+            memcpy(p, gens_slots[i].seed, 32);
+            ok = secp256k1_generator_serialize(ctx, p + 32, &gens_slots[i].gen) == 1;
+        }
+    }
+    if (gens_map_count != 0) {
+        memcpy(records + n * BULLETPROOF_GENS_RECORD, gens_map + BULLETPROOF_GENS_HEADER, gens_map_count * BULLETPROOF_GENS_RECORD);
+        n += gens_map_count;
+    }
+    pthread_rwlock_unlock(&gens_lock);
+
+    // Sort by seed and drop the generators that are both cached and mapped
+    qsort(records, n, BULLETPROOF_GENS_RECORD, bulletproof_gens_record_cmp);
+    for (i = 0, kept = 0; i < n; i++) {
+        if (kept == 0 || memcmp(records + i * BULLETPROOF_GENS_RECORD, records + (kept - 1) * BULLETPROOF_GENS_RECORD, 32) != 0) {
+            memmove(records + kept++ * BULLETPROOF_GENS_RECORD, records + i * BULLETPROOF_GENS_RECORD, BULLETPROOF_GENS_RECORD);
+        }
+    }
+    ok = ok && kept <= UINT32_MAX;
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, BULLETPROOF_GENS_MAGIC, 8);
+    bulletproof_gens_put_u32(header + 8, BULLETPROOF_GENS_VERSION);
+    bulletproof_gens_put_u32(header + 12, (uint32_t)kept);
+
+    len = strlen(path);
+    tmp = (char *)malloc(len + sizeof(".tmp"));
+    if (!ok || tmp == NULL) {
+        free(records);
+        free(tmp);
+        return 0;
+    }
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".tmp", sizeof(".tmp"));
+
+    fp = fopen(tmp, "wb");
+    if (fp == NULL) {
+        free(records);
+        free(tmp);
+        return 0;
+    }
+    ok = fwrite(header, sizeof(header), 1, fp) == 1;
+    ok = ok && fwrite(records, BULLETPROOF_GENS_RECORD, kept, fp) == kept;
+    ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = (fclose(fp) == 0) && ok;
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok) {
+        unlink(tmp);
+    }
+    ok = ok && bulletproof_gens_sync_dir(path);
+    free(records);
+    free(tmp);
+
+    return ok;
+}
+
+/**
+ * Maps a file written by bulletproof_value_gen_save read-only.
+ *
+ * Lookups binary-search the mapping in place, so pods sharing the file share
+ * its pages and start without generating the generators it holds. Records
+ * are trusted like the binary: a generator with a known discrete logarithm
+ * would break the binding of the commitments, so the file must be deployed
+ * read-only. A previous mapping is released.
+ *
+ * @param path The file to map.
+ *
+ * @return 1 on success, 0 if the file is missing or malformed.
+ */
+int bulletproof_value_gen_load(const char *path) {
+    struct stat st;
+    unsigned char *map;
+    size_t len, count, i;
+    int fd;
+    int valid;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < BULLETPROOF_GENS_HEADER) {
+        close(fd);
+        return 0;
+    }
+    len = (size_t)st.st_size;
+    map = (unsigned char *)mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // The mapping stays valid after the descriptor is closed
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+
+    count = bulletproof_gens_get_u32(map + 12);
+    valid = memcmp(map, BULLETPROOF_GENS_MAGIC, 8) == 0
+        && bulletproof_gens_get_u32(map + 8) == BULLETPROOF_GENS_VERSION
+        && len == BULLETPROOF_GENS_HEADER + count * BULLETPROOF_GENS_RECORD;
+    // Binary search needs strictly increasing seeds
+    for (i = 1; valid && i < count; i++) {
+        valid = memcmp(map + BULLETPROOF_GENS_HEADER + (i - 1) * BULLETPROOF_GENS_RECORD, map + BULLETPROOF_GENS_HEADER + i * BULLETPROOF_GENS_RECORD, 32) < 0;
+    }
+    if (!valid) {
+        munmap(map, len);
+        return 0;
+    }
+
+    pthread_rwlock_wrlock(&gens_lock);
+    if (gens_map != NULL) {
+        munmap(gens_map, gens_map_len);
+    }
+    gens_map = map;
+    gens_map_len = len;
+    gens_map_count = count;
+    pthread_rwlock_unlock(&gens_lock);
+
+    return 1;
+}
+
+/**
+ * Empties the value generator cache and releases the file mapping.
+ */
+void bulletproof_value_gen_clear(void) {
+    pthread_rwlock_wrlock(&gens_lock);
+    free(gens_slots);
+    gens_slots = NULL;
+    gens_count = 0;
+    if (gens_map != NULL) {
+        munmap(gens_map, gens_map_len);
+    }
+    gens_map = NULL;
+    gens_map_len = 0;
+    gens_map_count = 0;
+    pthread_rwlock_unlock(&gens_lock);
+}
@@ -0,0 +1,69 @@
+#ifndef BULLETPROOF_GENS_H
+#define BULLETPROOF_GENS_H
+
+#include <stddef.h>
+
+#include "secp256k1_generator.h"
+
+// Slots of the process-wide value generator cache
+#define BULLETPROOF_GENS_CACHE_SLOTS 1024
+
+// Generator file: magic, version, header size and size of a (seed, generator) record
+#define BULLETPROOF_GENS_MAGIC "BPGENS\0\0"
+#define BULLETPROOF_GENS_VERSION 1
+#define BULLETPROOF_GENS_HEADER 16
+#define BULLETPROOF_GENS_RECORD (32 + 33)
+
+/**
+ * Derives the value generator of a seed through a process-wide cache.
+ *
+ * The result equals that of secp256k1_generator_generate for the same seed.
+ * It is looked up first in the in-memory cache, then in the file mapped by
+ * bulletproof_value_gen_load, and only generated on a miss of both; every
+ * result is remembered while the cache has room. The function may be called
+ * from several threads at once.
+ *
+ * @param ctx A secp256k1 context, only read.
+ * @param gen The generator to set.
+ * @param seed The 32-byte seed the generator is derived from.
+ *
+ * @return 1 on success, 0 if the generator cannot be derived.
+ */
+int bulletproof_value_gen(const secp256k1_context *ctx, secp256k1_generator *gen, const unsigned char seed[32]);
+
+/**
+ * Writes every cached and mapped value generator to a file.
+ *
+ * The file holds a 16-byte header (magic, big-endian version and record
+ * count) followed by 65-byte records, a seed and the serialized generator,
+ * sorted by seed. It is written to path.tmp, synced and renamed over path,
+ * and the directory is synced so that the rename survives a power loss.
+ *
+ * @param ctx A secp256k1 context, only read.
+ * @param path The file to write.
+ *
+ * @return 1 on success, 0 on failure.
+ */
+int bulletproof_value_gen_save(const secp256k1_context *ctx, const char *path);
+
+/**
+ * Maps a file written by bulletproof_value_gen_save read-only.
+ *
+ * Lookups binary-search the mapping in place, so pods sharing the file share
+ * its pages and start without generating the generators it holds. Records
+ * are trusted like the binary: a generator with a known discrete logarithm
+ * would break the binding of the commitments, so the file must be deployed
+ * read-only. A previous mapping is released.
+ *
+ * @param path The file to map.
+ *
+ * @return 1 on success, 0 if the file is missing or malformed.
+ */
+int bulletproof_value_gen_load(const char *path);
+
+/**
+ * Empties the value generator cache and releases the file mapping.
+ */
+void bulletproof_value_gen_clear(void);
+
+#endif // BULLETPROOF_GENS_H
@@ -0,0 +1,210 @@
+#include <string.h>
+
+#include "bulletproof_prover.h"
+#include "metrics.h"
+
+// Steps of a resumable proof, in order
+enum {
+    BULLETPROOF_PROVER_STAGE_NONE = 0,
+    BULLETPROOF_PROVER_STAGE_CONTEXT,
+    BULLETPROOF_PROVER_STAGE_GENERATORS,
+    BULLETPROOF_PROVER_STAGE_SCRATCH,
+    BULLETPROOF_PROVER_STAGE_COMMIT,
+    BULLETPROOF_PROVER_STAGE_PROVE,
+    BULLETPROOF_PROVER_STAGE_DONE
+};
+
+/**
+ * Prepares a resumable range proof without doing any expensive work.
+ *
+ * The proof covers n_commits values at nbits bits each and is made in
+ * bounded steps by bulletproof_prover_step, which never aborts.
+ *
+ * @param prover The prover to initialize.
+ * @param context A context with at least 2 * n_commits * nbits generators, or
+ *                NULL to create a minimal context in the first steps.
+ * @param value_gen The value generator H the verifier expects.
+ * @param value The n_commits values to prove.
+ * @param blinds n_commits * 32 bytes of blinding factors, or NULL to draw
+ *               them with generate_secure_random_bytes.
+ * @param nonce 32 random bytes for the proof, or NULL to draw them likewise.
+ *              Devices with their own entropy source pass blinds and nonce.
+ * @param n_commits The number of values, at most BULLETPROOF_PROVER_MAX_COMMITS.
+ * @param nbits The number of bits proven per value, at most 64.
+ * @param budget The largest scratch space in bytes the prover may allocate.
+ *
+ * @return BULLETPROOF_PROVER_PENDING on success, BULLETPROOF_PROVER_ERR_ARGS
+ *         or BULLETPROOF_PROVER_ERR_BUDGET otherwise.
+ */
+bulletproof_prover_status_t bulletproof_prover_init(bulletproof_prover_t *prover, const bulletproof_context_t *context, const secp256k1_generator *value_gen, const uint64_t *value, const unsigned char *blinds, const unsigned char *nonce, size_t n_commits, size_t nbits, size_t budget) {
+    size_t i;
+
+    memset(prover, 0, sizeof(*prover));
+    prover->status = BULLETPROOF_PROVER_ERR_ARGS;
+    if (value_gen == NULL || value == NULL || n_commits == 0 || n_commits > BULLETPROOF_PROVER_MAX_COMMITS || nbits == 0 || nbits > 64) {
+        return prover->status;
+    }
+    // secp256k1-zkp uses a G_i and an H_i generator per proven bit
+    if (context != NULL && context->n_gens < 2 * n_commits * nbits) {
+        return prover->status;
+    }
+    for (i = 0; i < n_commits; i++) {
+        if (nbits < 64 && value[i] >> nbits != 0) {
+            return prover->status;
+        }
+    }
+    prover->scratch_size = bulletproof_scratch_size(n_commits, nbits, 1);
+    if (prover->scratch_size > budget) {
+        prover->status = BULLETPROOF_PROVER_ERR_BUDGET;
+        return prover->status;
+    }
+
+    prover->context = context;
+    prover->value_gen = *value_gen;
+    prover->blind_gen = secp256k1_generator_const_g;
+    prover->n_commits = n_commits;
+    prover->nbits = nbits;
+    memcpy(prover->value, value, n_commits * sizeof(*value));
+    if (blinds != NULL) {
+        memcpy(prover->blind, blinds, n_commits * 32);
+    } else {
+        generate_secure_random_bytes(&prover->blind[0][0], n_commits * 32);
+    }
+    for (i = 0; i < n_commits; i++) {
+        prover->blind_ptr[i] = prover->blind[i];
+    }
+    if (nonce != NULL) {
+        memcpy(prover->nonce, nonce, 32);
+    } else {
+        generate_secure_random_bytes(prover->nonce, 32);
+    }
+    prover->plen = MAX_PROOF_SIZE;
+
+    prover->stage = BULLETPROOF_PROVER_STAGE_CONTEXT;
+    prover->status = BULLETPROOF_PROVER_PENDING;
+    return prover->status;
+}
+
+/**
+ * Performs the next step of a resumable range proof.
+ *
+ * The steps create the secp256k1 context, the generators and the scratch
+ * space as needed, compute one commitment each and finally prove. Each step
+ * is a single secp256k1-zkp call, so the caller can return to its own loop
+ * between steps; the proving step is the longest and cannot be split further.
+ *
+ * @param prover A prover prepared with bulletproof_prover_init.
+ *
+ * @return BULLETPROOF_PROVER_PENDING while steps remain,
+ *         BULLETPROOF_PROVER_OK once the proof is complete, or a negative
+ *         error code, which every later step returns again.
+ */
+bulletproof_prover_status_t bulletproof_prover_step(bulletproof_prover_t *prover) {
+    if (prover->stage == BULLETPROOF_PROVER_STAGE_NONE) {
+        return BULLETPROOF_PROVER_ERR_STATE;
+    }
+    if (prover->status != BULLETPROOF_PROVER_PENDING) {
+        return prover->status;
+    }
+
+    switch (prover->stage) {
+    case BULLETPROOF_PROVER_STAGE_CONTEXT:
+        if (prover->context != NULL) {
+            prover->ctx = prover->context->ctx;
+            prover->generators = prover->context->generators;
+            prover->stage = BULLETPROOF_PROVER_STAGE_SCRATCH;
+            break;
+        }
+        prover->owned_ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+        if (prover->owned_ctx == NULL) {
+            prover->status = BULLETPROOF_PROVER_ERR_MEMORY;
+            break;
+        }
+        prover->ctx = prover->owned_ctx;
+        prover->stage = BULLETPROOF_PROVER_STAGE_GENERATORS;
+        break;
+
+    case BULLETPROOF_PROVER_STAGE_GENERATORS:
+        // Only the generators this proof needs, not BULLETPROOF_N_GENERATORS
+        prover->owned_generators = secp256k1_bulletproof_generators_create(prover->ctx, &prover->blind_gen, 2 * prover->n_commits * prover->nbits);
+        if (prover->owned_generators == NULL) {
+            prover->status = BULLETPROOF_PROVER_ERR_MEMORY;
+            break;
+        }
+        prover->generators = prover->owned_generators;
+        prover->stage = BULLETPROOF_PROVER_STAGE_SCRATCH;
+        break;
+
+    case BULLETPROOF_PROVER_STAGE_SCRATCH:
+        prover->scratch = secp256k1_scratch_space_create(prover->ctx, prover->scratch_size);
+        if (prover->scratch == NULL) {
+            prover->status = BULLETPROOF_PROVER_ERR_MEMORY;
+            break;
+        }
+        prover->stage = BULLETPROOF_PROVER_STAGE_COMMIT;
+        break;
+
+    case BULLETPROOF_PROVER_STAGE_COMMIT:
+        if (secp256k1_pedersen_commit(prover->ctx, &prover->commit[prover->next], prover->blind[prover->next], prover->value[prover->next], &prover->value_gen, &prover->blind_gen) != 1) {
+            prover->status = BULLETPROOF_PROVER_ERR_CRYPTO;
+            break;
+        }
+        if (++prover->next == prover->n_commits) {
+            prover->stage = BULLETPROOF_PROVER_STAGE_PROVE;
+        }
+        break;
+
+    case BULLETPROOF_PROVER_STAGE_PROVE: {
+        int ok;
+        METRICS_BEGIN(start);
+
+        ok = secp256k1_bulletproof_rangeproof_prove(prover->ctx, prover->scratch, prover->generators, prover->proof, &prover->plen, prover->value, NULL, prover->blind_ptr, prover->n_commits, &prover->value_gen, prover->nbits, prover->nonce, NULL, 0) == 1;
+        METRICS_END(METRICS_OP_PROVE, start, ok);
+        if (!ok) {
+            prover->status = BULLETPROOF_PROVER_ERR_CRYPTO;
+            break;
+        }
+        // The nonce must never serve a second proof
+        memset(prover->nonce, 0, sizeof(prover->nonce));
+        prover->stage = BULLETPROOF_PROVER_STAGE_DONE;
+        prover->status = BULLETPROOF_PROVER_OK;
+        break;
+    }
+
+    default:
+        prover->status = BULLETPROOF_PROVER_ERR_STATE;
+        break;
+    }
+
+    return prover->status;
+}
+
+/**
+ * Erases the secrets of a prover and releases what its steps allocated.
+ *
+ * The commitments and proof are kept, so they can still be sent. Blinding
+ * factors drawn by the prover must be read from prover->blind first if they
+ * are needed later, for example by zkpe_prove.
+ *
+ * @param prover The prover to clear.
+ */
+void bulletproof_prover_clear(bulletproof_prover_t *prover) {
+    if (prover->scratch != NULL) {
+        secp256k1_scratch_space_destroy(prover->scratch);
+    }
+    if (prover->owned_generators != NULL) {
+        secp256k1_bulletproof_generators_destroy(prover->ctx, prover->owned_generators);
+    }
+    if (prover->owned_ctx != NULL) {
+        secp256k1_context_destroy(prover->owned_ctx);
+    }
+    prover->scratch = NULL;
+    prover->owned_generators = NULL;
+    prover->owned_ctx = NULL;
+    prover->generators = NULL;
+    prover->ctx = NULL;
+    memset(prover->value, 0, sizeof(prover->value));
+    memset(prover->blind, 0, sizeof(prover->blind));
+    memset(prover->nonce, 0, sizeof(prover->nonce));
+    prover->stage = BULLETPROOF_PROVER_STAGE_NONE;
+}
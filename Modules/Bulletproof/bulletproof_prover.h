@@ -0,0 +1,103 @@
+#ifndef BULLETPROOF_PROVER_H
+#define BULLETPROOF_PROVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "bulletproof.h"
+
+// Largest number of commitments one resumable proof covers
+#define BULLETPROOF_PROVER_MAX_COMMITS 8
+
+typedef enum {
+    BULLETPROOF_PROVER_OK = 0,           // The proof is complete
+    BULLETPROOF_PROVER_PENDING = 1,      // More steps are needed
+    BULLETPROOF_PROVER_ERR_ARGS = -1,    // Invalid shape, value or context
+    BULLETPROOF_PROVER_ERR_BUDGET = -2,  // The scratch space exceeds the memory budget
+    BULLETPROOF_PROVER_ERR_MEMORY = -3,  // An allocation failed
+    BULLETPROOF_PROVER_ERR_CRYPTO = -4,  // secp256k1-zkp rejected a commitment or the proof
+    BULLETPROOF_PROVER_ERR_STATE = -5    // The prover is not initialized
+} bulletproof_prover_status_t;
+
+/*
+ * A range proof produced in steps. Every buffer is part of the structure, so
+ * a prover can live in static memory; the scratch space, and the secp256k1
+ * context and generators when no shared context is given, are the only
+ * allocations, all made by the first steps.
+ */
+typedef struct {
+    int stage;
+    bulletproof_prover_status_t status;  // Sticky once an error occurred
+    const bulletproof_context_t *context;
+    secp256k1_context *owned_ctx;
+    secp256k1_bulletproof_generators *owned_generators;
+    secp256k1_context *ctx;
+    secp256k1_bulletproof_generators *generators;
+    secp256k1_scratch_space *scratch;
+    size_t scratch_size;
+    secp256k1_generator value_gen;
+    secp256k1_generator blind_gen;
+    size_t n_commits;
+    size_t nbits;
+    size_t next;                         // Next commitment to compute
+    uint64_t value[BULLETPROOF_PROVER_MAX_COMMITS];
+    unsigned char blind[BULLETPROOF_PROVER_MAX_COMMITS][32];
+    const unsigned char *blind_ptr[BULLETPROOF_PROVER_MAX_COMMITS];
+    secp256k1_pedersen_commitment commit[BULLETPROOF_PROVER_MAX_COMMITS];
+    unsigned char nonce[32];
+    unsigned char proof[MAX_PROOF_SIZE];
+    size_t plen;
+} bulletproof_prover_t;
+
+/**
+ * Prepares a resumable range proof without doing any expensive work.
+ *
+ * The proof covers n_commits values at nbits bits each and is made in
+ * bounded steps by bulletproof_prover_step, which never aborts.
+ *
+ * @param prover The prover to initialize.
+ * @param context A context with at least 2 * n_commits * nbits generators, or
+ *                NULL to create a minimal context in the first steps.
+ * @param value_gen The value generator H the verifier expects.
+ * @param value The n_commits values to prove.
+ * @param blinds n_commits * 32 bytes of blinding factors, or NULL to draw
+ *               them with generate_secure_random_bytes.
+ * @param nonce 32 random bytes for the proof, or NULL to draw them likewise.
+ *              Devices with their own entropy source pass blinds and nonce.
+ * @param n_commits The number of values, at most BULLETPROOF_PROVER_MAX_COMMITS.
+ * @param nbits The number of bits proven per value, at most 64.
+ * @param budget The largest scratch space in bytes the prover may allocate.
+ *
+ * @return BULLETPROOF_PROVER_PENDING on success, BULLETPROOF_PROVER_ERR_ARGS
+ *         or BULLETPROOF_PROVER_ERR_BUDGET otherwise.
+ */
+bulletproof_prover_status_t bulletproof_prover_init(bulletproof_prover_t *prover, const bulletproof_context_t *context, const secp256k1_generator *value_gen, const uint64_t *value, const unsigned char *blinds, const unsigned char *nonce, size_t n_commits, size_t nbits, size_t budget);
+
+/**
+ * Performs the next step of a resumable range proof.
+ *
+ * The steps create the secp256k1 context, the generators and the scratch
+ * space as needed, compute one commitment each and finally prove. Each step
+ * is a single secp256k1-zkp call, so the caller can return to its own loop
+ * between steps; the proving step is the longest and cannot be split further.
+ *
+ * @param prover A prover prepared with bulletproof_prover_init.
+ *
+ * @return BULLETPROOF_PROVER_PENDING while steps remain,
+ *         BULLETPROOF_PROVER_OK once the proof is complete, or a negative
+ *         error code, which every later step returns again.
+ */
+bulletproof_prover_status_t bulletproof_prover_step(bulletproof_prover_t *prover);
+
+/**
+ * Erases the secrets of a prover and releases what its steps allocated.
+ *
+ * The commitments and proof are kept, so they can still be sent. Blinding
+ * factors drawn by the prover must be read from prover->blind first if they
+ * are needed later, for example by zkpe_prove.
+ *
+ * @param prover The prover to clear.
+ */
+void bulletproof_prover_clear(bulletproof_prover_t *prover);
+
+#endif // BULLETPROOF_PROVER_H
@@ -0,0 +1,137 @@
+#include <stdlib.h>
+
+#include "bulletproof_scratch.h"
+
+/**
+ * Computes the scratch space size needed to prove or verify a batch.
+ *
+ * Proving and verification spend their scratch space on the multi-scalar
+ * multiplication over the bulletproof generators, which involves about
+ * 2 * n_commits * nbits points per proof plus a logarithmic number of
+ * inner-product points. This function sizes the space from those counts
+ * instead of reserving a fixed 1 GiB.
+ *
+ * @param n_commits The number of commitments per proof.
+ * @param nbits The number of bits proven per commitment.
+ * @param n_proofs The number of proofs proven or verified together.
+ *
+ * @return The scratch space size in bytes, capped at BULLETPROOF_SCRATCH_MAX.
+ */
+size_t bulletproof_scratch_size(size_t n_commits, size_t nbits, size_t n_proofs) {
+    size_t n_points = 2 * n_commits * nbits;
+    size_t depth = 0;
+    size_t per_proof;
+
+    // Rounds of the inner-product argument, each contributing two points
+    while (((size_t)1 << depth) < n_points) {
+        depth++;
+    }
+    // Generators, inner-product points, commitments and the fixed proof points
+    per_proof = n_points + 2 * depth + n_commits + 8;
+
+    if (n_proofs != 0 && per_proof > (BULLETPROOF_SCRATCH_MAX - BULLETPROOF_SCRATCH_BASE) / BULLETPROOF_SCRATCH_PER_POINT / n_proofs) {
+        return BULLETPROOF_SCRATCH_MAX;
+    }
+    return BULLETPROOF_SCRATCH_BASE + n_proofs * per_proof * BULLETPROOF_SCRATCH_PER_POINT;
+}
+
+/**
+ * Creates a thread-safe pool of equally sized scratch spaces.
+ *
+ * Concurrent proving or verification workers acquire a scratch space from
+ * the pool for the duration of a job and release it afterwards, so buffers
+ * are reused instead of allocated per job. Spaces are created lazily, up to
+ * max_spaces in total; an acquire beyond that blocks until one is released.
+ *
+ * @param ctx The secp256k1 context the scratch spaces are created with.
+ * @param size The size of each scratch space in bytes, typically obtained
+ *             from bulletproof_scratch_size for the largest expected job.
+ * @param max_spaces The maximum number of spaces, usually one per worker.
+ *
+ * @return A pointer to the new pool.
+ *
+ * @note This function aborts the program if memory allocation fails.
+ */
+bulletproof_scratch_pool_t *bulletproof_scratch_pool_create(const secp256k1_context *ctx, size_t size, size_t max_spaces) {
+    bulletproof_scratch_pool_t *pool = (bulletproof_scratch_pool_t *)malloc(sizeof(*pool));
+    if (pool == NULL || max_spaces == 0) {abort();}
+
+    pool->spaces = (secp256k1_scratch_space **)malloc(max_spaces * sizeof(*pool->spaces));
+    if (pool->spaces == NULL) {abort();}
+    if (pthread_mutex_init(&pool->lock, NULL) != 0) {abort();}
+    if (pthread_cond_init(&pool->available, NULL) != 0) {abort();}
+
+    pool->ctx = ctx;
+    pool->n_free = 0;
+    pool->n_created = 0;
+    pool->max_spaces = max_spaces;
+    pool->size = size;
+
+    return pool;
+}
+
+/**
+ * Destroys a scratch pool and every scratch space it holds.
+ *
+ * @param pool The pool to destroy. All acquired spaces must have been released.
+ */
+void bulletproof_scratch_pool_destroy(bulletproof_scratch_pool_t *pool) {
+    size_t i;
+
+    if (pool == NULL) {
+        return;
+    }
+    for (i = 0; i < pool->n_free; i++) {
+        secp256k1_scratch_space_destroy(pool->spaces[i]);
+    }
+    pthread_cond_destroy(&pool->available);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->spaces);
+    free(pool);
+}
+
+/**
+ * Takes a scratch space from the pool, creating or waiting for one if needed.
+ *
+ * @param pool The pool to take the scratch space from.
+ *
+ * @return A scratch space of pool->size bytes for exclusive use by the caller.
+ *
+ * @note This function aborts the program if scratch space creation fails.
+ */
+secp256k1_scratch_space *bulletproof_scratch_pool_acquire(bulletproof_scratch_pool_t *pool) {
+    secp256k1_scratch_space *scratch = NULL;
+    int create = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->n_free == 0 && pool->n_created == pool->max_spaces) {
+        pthread_cond_wait(&pool->available, &pool->lock);
+    }
+    if (pool->n_free > 0) {
+        scratch = pool->spaces[--pool->n_free];
+    } else {
+        // Reserve the slot now, create the space outside the lock
+        pool->n_created++;
+        create = 1;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (create) {
+        scratch = secp256k1_scratch_space_create(pool->ctx, pool->size);
+        if (scratch == NULL) {abort();}
+    }
+    return scratch;
+}
+
+/**
+ * Returns a scratch space to the pool and wakes one waiting worker.
+ *
+ * @param pool The pool the scratch space was acquired from.
+ * @param scratch The scratch space to return.
+ */
+void bulletproof_scratch_pool_release(bulletproof_scratch_pool_t *pool, secp256k1_scratch_space *scratch) {
+    pthread_mutex_lock(&pool->lock);
+    pool->spaces[pool->n_free++] = scratch;
+    pthread_cond_signal(&pool->available);
+    pthread_mutex_unlock(&pool->lock);
+}
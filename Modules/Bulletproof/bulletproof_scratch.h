@@ -0,0 +1,86 @@
+#ifndef BULLETPROOF_SCRATCH_H
+#define BULLETPROOF_SCRATCH_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "secp256k1.h"
+
+#define BULLETPROOF_SCRATCH_BASE (256 * 1024)
+#define BULLETPROOF_SCRATCH_PER_POINT 256
+#define BULLETPROOF_SCRATCH_MAX ((size_t)1024 * 1024 * 1024)
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+    const secp256k1_context *ctx;
+    secp256k1_scratch_space **spaces;
+    size_t n_free;
+    size_t n_created;
+    size_t max_spaces;
+    size_t size;
+} bulletproof_scratch_pool_t;
+
+/**
+ * Computes the scratch space size needed to prove or verify a batch.
+ *
+ * Proving and verification spend their scratch space on the multi-scalar
+ * multiplication over the bulletproof generators, which involves about
+ * 2 * n_commits * nbits points per proof plus a logarithmic number of
+ * inner-product points. This function sizes the space from those counts
+ * instead of reserving a fixed 1 GiB.
+ *
+ * @param n_commits The number of commitments per proof.
+ * @param nbits The number of bits proven per commitment.
+ * @param n_proofs The number of proofs proven or verified together.
+ *
+ * @return The scratch space size in bytes, capped at BULLETPROOF_SCRATCH_MAX.
+ */
+size_t bulletproof_scratch_size(size_t n_commits, size_t nbits, size_t n_proofs);
+
+/**
+ * Creates a thread-safe pool of equally sized scratch spaces.
+ *
+ * Concurrent proving or verification workers acquire a scratch space from
+ * the pool for the duration of a job and release it afterwards, so buffers
+ * are reused instead of allocated per job. Spaces are created lazily, up to
+ * max_spaces in total; an acquire beyond that blocks until one is released.
+ *
+ * @param ctx The secp256k1 context the scratch spaces are created with.
+ * @param size The size of each scratch space in bytes, typically obtained
+ *             from bulletproof_scratch_size for the largest expected job.
+ * @param max_spaces The maximum number of spaces, usually one per worker.
+ *
+ * @return A pointer to the new pool.
+ *
+ * @note This function aborts the program if memory allocation fails.
+ */
+bulletproof_scratch_pool_t *bulletproof_scratch_pool_create(const secp256k1_context *ctx, size_t size, size_t max_spaces);
+
+/**
+ * Destroys a scratch pool and every scratch space it holds.
+ *
+ * @param pool The pool to destroy. All acquired spaces must have been released.
+ */
+void bulletproof_scratch_pool_destroy(bulletproof_scratch_pool_t *pool);
+
+/**
+ * Takes a scratch space from the pool, creating or waiting for one if needed.
+ *
+ * @param pool The pool to take the scratch space from.
+ *
+ * @return A scratch space of pool->size bytes for exclusive use by the caller.
+ *
+ * @note This function aborts the program if scratch space creation fails.
+ */
+secp256k1_scratch_space *bulletproof_scratch_pool_acquire(bulletproof_scratch_pool_t *pool);
+
+/**
+ * Returns a scratch space to the pool and wakes one waiting worker.
+ *
+ * @param pool The pool the scratch space was acquired from.
+ * @param scratch The scratch space to return.
+ */
+void bulletproof_scratch_pool_release(bulletproof_scratch_pool_t *pool, secp256k1_scratch_space *scratch);
+
+#endif // BULLETPROOF_SCRATCH_H
@@ -1,4 +1,70 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include "elgamal.h"
+#include "elgamal_dlog.h"
+#include "csprng.h"
+#include "metrics.h"
+
+/**
+ * Draws a uniformly random integer k from the range [1, n-1].
+ *
+ * The integer is read from the calling thread's buffered CSPRNG rather than
+ * from RELIC's generator. Sixty-four bits more than the length of n are drawn
+ * and reduced modulo n, which leaves a bias below 2^-64. Like bn_rand_mod, it
+ * raises a RELIC error inside RLC_TRY blocks on failure.
+ */
+void elgamal_rand_mod(bn_t k, const bn_t n) {
+    uint8_t buf[ELGAMAL_RAND_BYTES];
+    size_t len = ((size_t)bn_bits(n) + 64 + 7) / 8;
+
+    if (len > sizeof(buf)) {
+        RLC_THROW(ERR_NO_BUFFER);
+        return;
+    }
+    do {
+        csprng_bytes(buf, len);
+        bn_read_bin(k, buf, len);
+        bn_mod(k, k, n);
+    } while (bn_is_zero(k));
+    memset(buf, 0, sizeof(buf));
+}
+
+/**
+ * Variable-base scalar multiplication R = k*Q.
+ *
+ * When RELIC is built with EP_ENDOM and the curve has an efficient
+ * endomorphism psi(x, y) = (beta*x, y), as secp256k1 does, k is split with
+ * the GLV method into two half-length scalars k0 + k1*lambda = k mod n, and
+ * R = k0*Q + k1*psi(Q) is computed with interleaved width-w NAFs, halving the
+ * number of point doublings. On other curves, or without EP_ENDOM, this is
+ * RELIC's configured ec_mul.
+ *
+ * The running time depends on k, so this is only for public scalars such
+ * as the Lagrange coefficients of elgamal_threshold_combine. Private keys,
+ * key shares and encryption nonces, which reveal the plaintext through
+ * m*P = M2 - k*B, go through elgamal_mul_secret.
+ */
+void elgamal_mul(ec_t R, const ec_t Q, const bn_t k) {
+#if defined(EP_ENDOM)
+    if (ep_curve_is_endom()) {
+        ep_mul_lwnaf(R, Q, k);
+        return;
+    }
+#endif
+    ec_mul(R, Q, k);
+}
+
+/**
+ * Variable-base scalar multiplication R = k*Q for a secret k.
+ *
+ * Uses RELIC's regular-recoding multiplication, whose sequence of
+ * operations does not depend on k and which also takes the GLV split on
+ * curves with an endomorphism when RELIC is built with EP_ENDOM.
+ */
+void elgamal_mul_secret(ec_t R, const ec_t Q, const bn_t k) {
+    ep_mul_lwreg(R, Q, k);
+}
 
 /**
  * The ElGamal key generation process (Elliptic Curve Version):
@@ -27,7 +93,7 @@ int elgamal_keygen(bn_t s, ec_t B) {
         ec_curve_get_gen(P); // Get the generator of the group G1 and store it in g
         ec_curve_get_ord(n); // Get the order of the group G1 and store it in n
 
-        bn_rand_mod(s, n);  // Generate a random private key in the range [1, n-1]
+        elgamal_rand_mod(s, n);  // Generate a random private key in the range [1, n-1]
         ec_mul(B, P, s);  // Compute the public key as g*pri_key
     } 
     
@@ -64,10 +130,13 @@ int elgamal_keygen(bn_t s, ec_t B) {
 int elgamal_encrypt(ec_t B, bn_t m, ec_t M1, ec_t M2) {
     int result = RLC_OK; // Variable to hold the result
     bn_t k;              // Secret random integer k
+    bn_t n;              // Order of the group G1
     ec_t P, h, M;        // Temporary variables. P is the base point of the curve.
+    METRICS_BEGIN(start);
 
     // Initialize variables as null
     bn_null(k);
+    bn_null(n);
     ec_null(P);
     ec_null(h);
     ec_null(M);
@@ -75,12 +144,14 @@ int elgamal_encrypt(ec_t B, bn_t m, ec_t M1, ec_t M2) {
     RLC_TRY {
         // Initialize and allocate memory for variables
         bn_new(k);
+        bn_new(n);
         ec_new(P)
         ec_new(h)
         ec_new(M)
 
-        // Generate a random integer k from the range of the order of G_1
-        bn_rand(k, RLC_POS, RLC_BN_BITS);
+        // Generate a random integer k in the range [1, n-1]
+        ec_curve_get_ord(n);
+        elgamal_rand_mod(k, n);
 
         // Get the base point of the group G1 and store it in P
         ec_curve_get_gen(P);
@@ -89,8 +160,8 @@ int elgamal_encrypt(ec_t B, bn_t m, ec_t M1, ec_t M2) {
         ec_mul(M, P, m);
         // Compute M1 = k*P
         ec_mul(M1, P, k);
-        // Compute h = B*k
-        ec_mul(h, B, k);
+        // Compute h = B*k; k is as secret as m
+        elgamal_mul_secret(h, B, k);
         // Compute M2 = M + h
         ec_add(M2, M, h);
     }
@@ -102,15 +173,466 @@ int elgamal_encrypt(ec_t B, bn_t m, ec_t M1, ec_t M2) {
     RLC_FINALLY {
         // Free the memory allocated for the variables
         bn_free(k);
+        bn_free(n);
+        ec_free(P);
+        ec_free(h);
+        ec_free(M);
+    }
+
+    METRICS_END(METRICS_OP_ENCRYPT, start, result == RLC_OK);
+    return result;
+}
+
+
+
+/**
+ * The ElGamal encryption process with caller-supplied randomness.
+ *
+ * Identical to elgamal_encrypt, except that the random integer k is chosen
+ * by the caller, who needs it as the witness of a proof of equivalence:
+ *
+ * 1. Compute M1 = k*P (fixed-base multiplication by the generator).
+ * 2. Compute M2 = m*P + k*B (one simultaneous multiplication).
+ *
+ * k must be drawn uniformly from [1, n-1] and never reused.
+ */
+int elgamal_encrypt_k(ec_t B, bn_t m, bn_t k, ec_t M1, ec_t M2) {
+    int result = RLC_OK; // Variable to hold the result
+
+    RLC_TRY {
+        // Compute M1 = k*P
+        ec_mul_gen(M1, k);
+        // Compute M2 = m*P + k*B
+        ec_mul_sim_gen(M2, m, B, k);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    return result;
+}
+
+/**
+ * Allocates the two points of a ciphertext and sets both to infinity, which
+ * is the encryption of zero with k = 0 and the identity for aggregation.
+ */
+int elgamal_ciphertext_init(elgamal_ciphertext_t *ct) {
+    int result = RLC_OK;
+
+    ec_null(ct->M1);
+    ec_null(ct->M2);
+
+    RLC_TRY {
+        ec_new(ct->M1);
+        ec_new(ct->M2);
+        ec_set_infty(ct->M1);
+        ec_set_infty(ct->M2);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    return result;
+}
+
+/**
+ * Releases the two points of a ciphertext.
+ */
+void elgamal_ciphertext_free(elgamal_ciphertext_t *ct) {
+    ec_free(ct->M1);
+    ec_free(ct->M2);
+}
+
+/**
+ * Serializes a ciphertext as the compressed encodings of M1 and M2, one
+ * after the other, ELGAMAL_CIPHERTEXT_BYTES bytes in total.
+ *
+ * The point at infinity has no compressed encoding: RELIC writes it as a
+ * single zero byte without raising an error, which elgamal_ciphertext_read
+ * and the wire parser reject. Ciphertexts with either point at infinity are
+ * therefore refused with RLC_ERR.
+ */
+int elgamal_ciphertext_write(uint8_t out[ELGAMAL_CIPHERTEXT_BYTES], const elgamal_ciphertext_t *ct) {
+    int result = RLC_OK;
+
+    if (ec_is_infty(ct->M1) || ec_is_infty(ct->M2)) {
+        return RLC_ERR;
+    }
+
+    RLC_TRY {
+        ec_write_bin(out, ELGAMAL_POINT_BYTES, ct->M1, 1);
+        ec_write_bin(out + ELGAMAL_POINT_BYTES, ELGAMAL_POINT_BYTES, ct->M2, 1);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    return result;
+}
+
+/**
+ * Deserializes a ciphertext written by elgamal_ciphertext_write into an
+ * initialized ciphertext. Encodings of points off the curve are rejected.
+ */
+int elgamal_ciphertext_read(elgamal_ciphertext_t *ct, const uint8_t in[ELGAMAL_CIPHERTEXT_BYTES]) {
+    int result = RLC_OK;
+
+    RLC_TRY {
+        ec_read_bin(ct->M1, in, ELGAMAL_POINT_BYTES);
+        ec_read_bin(ct->M2, in + ELGAMAL_POINT_BYTES, ELGAMAL_POINT_BYTES);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    return result;
+}
+
+/**
+ * Initializes a reusable encryption context for the public key B.
+ *
+ * Steps:
+ * 1. Precompute the fixed-base table for the base point P of G_1.
+ * 2. Precompute the fixed-base table for the public key B.
+ * 3. Cache the order of G_1 for sampling k.
+ *
+ * The context is meant to be built once per public key and shared by every
+ * encryption under that key; see elgamal_encrypt_ctx.
+ */
+int elgamal_ctx_init(elgamal_ctx_t *ctx, ec_t B) {
+    int result = RLC_OK;
+    ec_t P;  // Base point of the group G1
+    int i;
+
+    // Initialize variables as null
+    ec_null(P);
+    bn_null(ctx->n);
+    for (i = 0; i < RLC_EC_TABLE; i++) {
+        ec_null(ctx->table_P[i]);
+        ec_null(ctx->table_B[i]);
+    }
+
+    RLC_TRY {
+        // Allocate memory for variables
+        ec_new(P);
+        bn_new(ctx->n);
+        for (i = 0; i < RLC_EC_TABLE; i++) {
+            ec_new(ctx->table_P[i]);
+            ec_new(ctx->table_B[i]);
+        }
+
+        // Get the base point and the order of the group G1
+        ec_curve_get_gen(P);
+        ec_curve_get_ord(ctx->n);
+
+        // Precompute the fixed-base tables for P and B
+        ec_mul_pre(ctx->table_P, P);
+        ec_mul_pre(ctx->table_B, B);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
         ec_free(P);
+    }
+
+    if (result != RLC_OK) {
+        elgamal_ctx_free(ctx);
+    }
+    return result;
+}
+
+/**
+ * Releases the tables held by an encryption context.
+ */
+void elgamal_ctx_free(elgamal_ctx_t *ctx) {
+    int i;
+
+    for (i = 0; i < RLC_EC_TABLE; i++) {
+        ec_free(ctx->table_P[i]);
+        ec_free(ctx->table_B[i]);
+    }
+    bn_free(ctx->n);
+}
+
+/**
+ * The ElGamal encryption process using a precomputed encryption context.
+ *
+ * Identical to elgamal_encrypt, except that the three scalar multiplications
+ * m*P, k*P and k*B are fixed-base multiplications over the tables in ctx:
+ *
+ * 1. Choose a random integer, k, from the range of the order of G_1.
+ * 2. Compute M = mP and M1 = kP from the table for P.
+ * 3. Compute h = kB from the table for B.
+ * 4. Compute M2 = M + h (point addition on the curve).
+ *
+ * The ciphertext is then the tuple (M1, M2).
+ */
+int elgamal_encrypt_ctx(elgamal_ctx_t *ctx, bn_t m, ec_t M1, ec_t M2) {
+    int result = RLC_OK; // Variable to hold the result
+    bn_t k;              // Secret random integer k
+    ec_t h, M;           // Temporary variables
+    METRICS_BEGIN(start);
+
+    // Initialize variables as null
+    bn_null(k);
+    ec_null(h);
+    ec_null(M);
+
+    RLC_TRY {
+        // Initialize and allocate memory for variables
+        bn_new(k);
+        ec_new(h);
+        ec_new(M);
+
+        // Generate a random integer k in the range [1, n-1]
+        elgamal_rand_mod(k, ctx->n);
+
+        // Compute M = m*P
+        ec_mul_fix(M, (const ec_t *)ctx->table_P, m);
+        // Compute M1 = k*P
+        ec_mul_fix(M1, (const ec_t *)ctx->table_P, k);
+        // Compute h = B*k
+        ec_mul_fix(h, (const ec_t *)ctx->table_B, k);
+        // Compute M2 = M + h
+        ec_add(M2, M, h);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for the variables
+        bn_free(k);
         ec_free(h);
         ec_free(M);
     }
 
+    METRICS_END(METRICS_OP_ENCRYPT, start, result == RLC_OK);
     return result;
 }
 
+/**
+ * Normalizes the finite points among P[0..n-1] with one shared inversion.
+ *
+ * RELIC's simultaneous inversion cannot handle the zero z-coordinate of the
+ * point at infinity, so those points are left out, in their own encoding.
+ */
+static void elgamal_norm_sim(ec_t *P, ec_t *T, size_t n) {
+    size_t i, m = 0;
+
+    for (i = 0; i < n; i++) {
+        if (!ec_is_infty(P[i])) {
+            ec_copy(T[m++], P[i]);
+        }
+    }
+    ep_norm_sim(T, (const ep_t *)T, (int)m);
+    for (i = 0, m = 0; i < n; i++) {
+        if (!ec_is_infty(P[i])) {
+            ec_copy(P[i], T[m++]);
+        }
+    }
+}
+
+/**
+ * Re-randomizes ciphertexts in place using a precomputed encryption context.
+ *
+ * Adding an encryption of zero, (r*P, r*B), to a ciphertext (M1, M2) of m
+ * under B gives a fresh-looking ciphertext of the same m that cannot be
+ * linked to the original without the private key:
+ *
+ * Steps, for chunks of up to ELGAMAL_RERANDOMIZE_CHUNK ciphertexts:
+ * 1. Choose a random integer, r, from the range of the order of G_1.
+ * 2. Compute M1 = M1 + rP and M2 = M2 + rB, with the fixed-base tables of
+ *    ctx for P and B and the sums left in projective coordinates.
+ * 3. Normalize every M1 and M2 of the chunk with a single inversion.
+ *
+ * Compared with re-encryption this saves the multiplication m*P and, since
+ * m never appears, needs neither the plaintext nor the private key.
+ */
+int elgamal_rerandomize_ctx(elgamal_ctx_t *ctx, elgamal_ciphertext_t *cts, size_t n) {
+    int result = RLC_OK;
+    ec_t *P, *T;   // Chunk of components being normalized, and scratch for the normalization
+    ec_t R;        // r*P or r*B
+    bn_t r;        // Secret random integer r
+    size_t i, j, done, chunk;
+
+    if (n == 0) {
+        return RLC_OK;
+    }
+    chunk = n < ELGAMAL_RERANDOMIZE_CHUNK ? n : ELGAMAL_RERANDOMIZE_CHUNK;
+    P = (ec_t *)malloc(2 * chunk * sizeof(*P));
+    T = (ec_t *)malloc(2 * chunk * sizeof(*T));
+    if (P == NULL || T == NULL) {
+        free(P);
+        free(T);
+        return RLC_ERR;
+    }
+
+    // Initialize variables as null
+    bn_null(r);
+    ec_null(R);
+    for (i = 0; i < 2 * chunk; i++) {
+        ec_null(P[i]);
+        ec_null(T[i]);
+    }
+
+    RLC_TRY {
+        // Initialize and allocate memory for variables
+        bn_new(r);
+        ec_new(R);
+        for (i = 0; i < 2 * chunk; i++) {
+            ec_new(P[i]);
+            ec_new(T[i]);
+        }
+
+        for (done = 0; done < n; done += chunk) {
+            size_t m = n - done < chunk ? n - done : chunk;
+
+            for (j = 0; j < m; j++) {
+                elgamal_ciphertext_t *ct = &cts[done + j];
+
+                elgamal_rand_mod(r, ctx->n);
+                // Compute M1 + r*P
+                ec_mul_fix(R, (const ec_t *)ctx->table_P, r);
+                ec_add(P[2 * j], ct->M1, R);
+                // Compute M2 + r*B
+                ec_mul_fix(R, (const ec_t *)ctx->table_B, r);
+                ec_add(P[2 * j + 1], ct->M2, R);
+            }
+
+            elgamal_norm_sim(P, T, 2 * m);
+            for (j = 0; j < m; j++) {
+                ec_copy(cts[done + j].M1, P[2 * j]);
+                ec_copy(cts[done + j].M2, P[2 * j + 1]);
+            }
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for the variables
+        bn_free(r);
+        ec_free(R);
+        for (i = 0; i < 2 * chunk; i++) {
+            ec_free(P[i]);
+            ec_free(T[i]);
+        }
+        free(P);
+        free(T);
+    }
+
+    return result;
+}
+
+/**
+ * Batch ElGamal encryption using a precomputed encryption context.
+ *
+ * Given:
+ * - m: an array of n plaintexts
+ * - cts: an array of n initialized ciphertexts, overwritten with the results
+ *
+ * Steps, for chunks of up to ELGAMAL_ENCRYPT_BATCH_CHUNK plaintexts:
+ * 1. Choose a random integer, k, from the range of the order of G_1.
+ * 2. Compute M1 = kP, M = mP and h = kB with the fixed-base tables of ctx.
+ * 3. Compute M2 = M + h, left in projective coordinates.
+ * 4. Normalize every M2 of the chunk with a single inversion.
+ *
+ * Each ciphertext is distributed exactly as one from elgamal_encrypt_ctx, but
+ * comes back normalized, with one inversion shared by the chunk, so that
+ * serializing the batch costs no further inversion.
+ */
+int elgamal_encrypt_batch(elgamal_ctx_t *ctx, bn_t *m, elgamal_ciphertext_t *cts, size_t n) {
+    int result = RLC_OK;
+    ec_t *P, *T;   // Chunk of M2 components being normalized, and scratch for the normalization
+    ec_t M, h;     // m*P and k*B
+    bn_t k;        // Secret random integer k
+    size_t i, j, done, chunk;
+    METRICS_BEGIN(start);
+
+    if (n == 0) {
+        return RLC_OK;
+    }
+    chunk = n < ELGAMAL_ENCRYPT_BATCH_CHUNK ? n : ELGAMAL_ENCRYPT_BATCH_CHUNK;
+    P = (ec_t *)malloc(chunk * sizeof(*P));
+    T = (ec_t *)malloc(chunk * sizeof(*T));
+    if (P == NULL || T == NULL) {
+        free(P);
+        free(T);
+        return RLC_ERR;
+    }
+
+    // Initialize variables as null
+    bn_null(k);
+    ec_null(M);
+    ec_null(h);
+    for (i = 0; i < chunk; i++) {
+        ec_null(P[i]);
+        ec_null(T[i]);
+    }
+
+    RLC_TRY {
+        // Initialize and allocate memory for variables
+        bn_new(k);
+        ec_new(M);
+        ec_new(h);
+        for (i = 0; i < chunk; i++) {
+            ec_new(P[i]);
+            ec_new(T[i]);
+        }
+
+        for (done = 0; done < n; done += chunk) {
+            size_t c = n - done < chunk ? n - done : chunk;
+
+            for (j = 0; j < c; j++) {
+                elgamal_rand_mod(k, ctx->n);
+                // Compute M1 = k*P
+                ec_mul_fix(cts[done + j].M1, (const ec_t *)ctx->table_P, k);
+                // Compute M = m*P and h = k*B
+                ec_mul_fix(M, (const ec_t *)ctx->table_P, m[done + j]);
+                ec_mul_fix(h, (const ec_t *)ctx->table_B, k);
+                // Compute M2 = M + h
+                ec_add(P[j], M, h);
+            }
+
+            elgamal_norm_sim(P, T, c);
+            for (j = 0; j < c; j++) {
+                ec_copy(cts[done + j].M2, P[j]);
+            }
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Erase k and free the memory allocated for the variables
+        bn_zero(k);
+        bn_free(k);
+        ec_free(M);
+        ec_free(h);
+        for (i = 0; i < chunk; i++) {
+            ec_free(P[i]);
+            ec_free(T[i]);
+        }
+        free(P);
+        free(T);
+    }
 
+    METRICS_END(METRICS_OP_ENCRYPT, start, result == RLC_OK);
+    return result;
+}
 
 /**
  * The ElGamal decryption process (Elliptic Curve Version):
@@ -124,48 +646,37 @@ int elgamal_encrypt(ec_t B, bn_t m, ec_t M1, ec_t M2) {
  * Steps:
  * 1. Compute \( h = M1 \times s \) (scalar multiplication using the private key).
  * 2. Compute \( M = M2 - h \) (point subtraction on the curve).
- * 3. Solve the elliptic curve discrete log problem to recover \( m \) from \( M \) using a brute force search if the set of possible \( m \) values is small.
+ * 3. Solve the elliptic curve discrete log problem to recover \( m \) from \( M \) using a baby-step giant-step search over the bounded plaintext range.
  *
- * The message \( m \) is then recovered.
+ * The message \( m \) is then recovered. The baby-step table is built once per curve
+ * (see elgamal_dlog_setup) and shared by every call; RLC_ERR is returned if \( m \)
+ * lies outside the range covered by the table.
  */
 int elgamal_decrypt(bn_t s, g1_t M1, g1_t M2, bn_t* m) {
     int result = RLC_OK;
     ec_t h, M;  // Temporary variables
-    ec_t P;     // Base point of the group G1
-    bn_t ord;   // Order of the group G1
+    const elgamal_dlog_t *table;  // Shared baby-step table
+    METRICS_BEGIN(start);
 
     // Initialize variables as null
     ec_null(h);
     ec_null(M);
-    ec_null(P);
-    bn_null(ord);
 
     RLC_TRY {
         // Allocate memory for variables
         ec_new(h);
         ec_new(M);
-        ec_new(P);
-        bn_new(ord);
 
-        // Get the base point of the group G1 and store it in P
-        ec_curve_get_gen(P);
-        // Get the order of the group G1 and store it in ord
-        ec_curve_get_ord(ord);
-
-        // Compute h = M1*s
-        ec_mul(h, M1, s);
+        // Compute h = M1*s in constant time
+        elgamal_mul_secret(h, M1, s);
         // Compute M = M2 - h
         ec_sub(M, M2, h);
 
         // Solve the elliptic curve discrete log problem to recover m from M
-        // This can be done using a brute force search if the set of possible m values is small
-        for (bn_zero(*m); bn_cmp(*m, ord) != RLC_EQ; bn_add_dig(*m, *m, 1)) {
-            // Compute h = P*m
-            ec_mul(h, P, *m);
-            // If h equals M, break the loop
-            if (ec_cmp(h, M) == RLC_EQ) {
-                break;
-            }
+        // using the baby-step giant-step table for the current curve
+        table = elgamal_dlog_shared();
+        if (table == NULL || elgamal_dlog_solve(table, M, *m) != RLC_OK) {
+            result = RLC_ERR;
         }
     }
 
@@ -177,7 +688,149 @@ int elgamal_decrypt(bn_t s, g1_t M1, g1_t M2, bn_t* m) {
         // Free the memory allocated for variables
         ec_free(h);
         ec_free(M);
-        ec_free(P);
-        bn_free(ord);
     }
-}
\ No newline at end of file
+
+    METRICS_END(METRICS_OP_DECRYPT, start, result == RLC_OK);
+    return result;
+}
+
+/**
+ * Allocates the temporaries of a workspace for elgamal_encrypt_ws and
+ * elgamal_decrypt_ws.
+ *
+ * The workspace captures the process-wide discrete-log table installed for
+ * the current curve and computes its giant-step stride, so decryption never
+ * builds or maps a table. Install the table first with elgamal_dlog_setup or
+ * elgamal_dlog_setup_file; without one, the workspace still serves
+ * elgamal_encrypt_ws but elgamal_decrypt_ws fails. A table installed later
+ * is only picked up by workspaces initialized after it.
+ */
+int elgamal_ws_init(elgamal_ws_t *ws) {
+    int result = RLC_OK;
+
+    // Initialize variables as null
+    bn_null(ws->k);
+    ec_null(ws->h);
+    ec_null(ws->M);
+    ec_null(ws->Q);
+    ec_null(ws->R);
+    ec_null(ws->G);
+    bn_null(ws->t);
+    ws->table = elgamal_dlog_current();
+
+    RLC_TRY {
+        // Allocate memory for variables
+        bn_new(ws->k);
+        ec_new(ws->h);
+        ec_new(ws->M);
+        ec_new(ws->Q);
+        ec_new(ws->R);
+        ec_new(ws->G);
+        bn_new(ws->t);
+
+        if (ws->table != NULL) {
+            elgamal_dlog_stride(ws->table, ws->G, ws->t);
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    if (result != RLC_OK) {
+        elgamal_ws_free(ws);
+    }
+    return result;
+}
+
+/**
+ * Erases and releases the temporaries of a workspace.
+ */
+void elgamal_ws_free(elgamal_ws_t *ws) {
+    bn_zero(ws->k);
+    bn_free(ws->k);
+    ec_free(ws->h);
+    ec_free(ws->M);
+    ec_free(ws->Q);
+    ec_free(ws->R);
+    ec_free(ws->G);
+    bn_free(ws->t);
+    ws->table = NULL;
+}
+
+/**
+ * The ElGamal encryption process with a precomputed encryption context and a
+ * caller-provided workspace.
+ *
+ * Identical to elgamal_encrypt_ctx, except that k, h and M live in ws, so the
+ * call does no allocation and, since ctx caches the tables for P and B and
+ * the order of G_1, reads no curve parameter.
+ */
+int elgamal_encrypt_ws(elgamal_ctx_t *ctx, elgamal_ws_t *ws, bn_t m, ec_t M1, ec_t M2) {
+    int result = RLC_OK;
+    METRICS_BEGIN(start);
+
+    RLC_TRY {
+        // Generate a random integer k in the range [1, n-1]
+        elgamal_rand_mod(ws->k, ctx->n);
+
+        // Compute M = m*P
+        ec_mul_fix(ws->M, (const ec_t *)ctx->table_P, m);
+        // Compute M1 = k*P
+        ec_mul_fix(M1, (const ec_t *)ctx->table_P, ws->k);
+        // Compute h = B*k
+        ec_mul_fix(ws->h, (const ec_t *)ctx->table_B, ws->k);
+        // Compute M2 = M + h
+        ec_add(M2, ws->M, ws->h);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    // Erase k, which would reveal m to anyone holding the ciphertext
+    bn_zero(ws->k);
+
+    METRICS_END(METRICS_OP_ENCRYPT, start, result == RLC_OK);
+    return result;
+}
+
+/**
+ * The ElGamal decryption process with a caller-provided workspace.
+ *
+ * Identical to elgamal_decrypt, except that:
+ * - h, M and the temporaries of the discrete log search live in ws, so the
+ *   call does no allocation;
+ * - the table is the one ws captured at elgamal_ws_init, with its giant-step
+ *   stride T*P computed there instead of once per decryption. RLC_ERR is
+ *   returned if no table was installed then, or if it belongs to another
+ *   curve than the current one. The table is never built here.
+ *
+ * Like elgamal_decrypt, h = M1 * s is computed with elgamal_mul_secret. The
+ * discrete log search still takes time proportional to m, which is
+ * inherent to baby-step giant-step and reveals nothing about s.
+ */
+int elgamal_decrypt_ws(elgamal_ws_t *ws, bn_t s, ec_t M1, ec_t M2, bn_t m) {
+    int result = RLC_OK;
+    METRICS_BEGIN(start);
+
+    if (ws->table == NULL || ws->table->curve != ep_param_get()) {
+        return RLC_ERR;
+    }
+
+    RLC_TRY {
+        // Compute h = M1*s in constant time
+        elgamal_mul_secret(ws->h, M1, s);
+        // Compute M = M2 - h
+        ec_sub(ws->M, M2, ws->h);
+
+        result = elgamal_dlog_solve_ws(ws->table, ws->M, m, ws->G, ws->Q, ws->R, ws->t);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    METRICS_END(METRICS_OP_DECRYPT, start, result == RLC_OK);
+    return result;
+}
@@ -1,10 +1,82 @@
 #ifndef ELGAMAL_H
 #define ELGAMAL_H
 
+#include <stdint.h>
+#include <stddef.h>
+
 #include <relic.h>
 
+#include "elgamal_dlog.h"
+
+// Sizes of a compressed point and of a serialized ciphertext
+#define ELGAMAL_POINT_BYTES (RLC_FP_BYTES + 1)
+#define ELGAMAL_CIPHERTEXT_BYTES (2 * ELGAMAL_POINT_BYTES)
+
+// Ciphertexts re-randomized together, sharing one normalization
+#define ELGAMAL_RERANDOMIZE_CHUNK 256
+
+// Ciphertexts encrypted together by elgamal_encrypt_batch, sharing one normalization
+#define ELGAMAL_ENCRYPT_BATCH_CHUNK 256
+
+// Bytes drawn per random scalar: the group order plus 64 bits of slack
+#define ELGAMAL_RAND_BYTES (RLC_FP_BYTES + 9)
+
+/*
+ * An ElGamal ciphertext (M1, M2) = (k*P, m*P + k*B).
+ */
+typedef struct {
+    ec_t M1;
+    ec_t M2;
+} elgamal_ciphertext_t;
+
+/*
+ * Reusable encryption context for one public key B. It holds the fixed-base
+ * precomputation tables for the base point P and for B, so that encryption
+ * needs table lookups and point additions only.
+ */
+typedef struct {
+    ec_t table_P[RLC_EC_TABLE];  // Fixed-base table for the base point P
+    ec_t table_B[RLC_EC_TABLE];  // Fixed-base table for the public key B
+    bn_t n;                      // Order of the group G1
+} elgamal_ctx_t;
+
+/*
+ * Caller-owned temporaries of elgamal_encrypt_ws and elgamal_decrypt_ws.
+ * A workspace is allocated once and reused, so those calls do no heap
+ * allocation; it must not be used by two threads at once.
+ */
+typedef struct {
+    bn_t k;                       // Random integer k of encryption
+    ec_t h;                       // k*B, or s*M1
+    ec_t M;                       // m*P, or M2 - s*M1
+    ec_t Q, R;                    // Giant step and candidate of the discrete log search
+    ec_t G;                       // Giant-step stride of table
+    bn_t t;                       // Exponent of the candidate
+    const elgamal_dlog_t *table;  // Process-wide table captured at init, or NULL
+} elgamal_ws_t;
+
 int elgamal_encrypt(ec_t B, bn_t m, ec_t M1, ec_t M2);
+int elgamal_encrypt_k(ec_t B, bn_t m, bn_t k, ec_t M1, ec_t M2);
 int elgamal_decrypt(bn_t s, g1_t M1, g1_t M2, bn_t* m);
 int elgamal_keygen(bn_t s, ec_t B);
+void elgamal_rand_mod(bn_t k, const bn_t n);
+void elgamal_mul(ec_t R, const ec_t Q, const bn_t k);
+void elgamal_mul_secret(ec_t R, const ec_t Q, const bn_t k);
+
+int elgamal_ciphertext_init(elgamal_ciphertext_t *ct);
+void elgamal_ciphertext_free(elgamal_ciphertext_t *ct);
+int elgamal_ciphertext_write(uint8_t out[ELGAMAL_CIPHERTEXT_BYTES], const elgamal_ciphertext_t *ct);
+int elgamal_ciphertext_read(elgamal_ciphertext_t *ct, const uint8_t in[ELGAMAL_CIPHERTEXT_BYTES]);
+
+int elgamal_ctx_init(elgamal_ctx_t *ctx, ec_t B);
+void elgamal_ctx_free(elgamal_ctx_t *ctx);
+int elgamal_encrypt_ctx(elgamal_ctx_t *ctx, bn_t m, ec_t M1, ec_t M2);
+int elgamal_rerandomize_ctx(elgamal_ctx_t *ctx, elgamal_ciphertext_t *cts, size_t n);
+int elgamal_encrypt_batch(elgamal_ctx_t *ctx, bn_t *m, elgamal_ciphertext_t *cts, size_t n);
+
+int elgamal_ws_init(elgamal_ws_t *ws);
+void elgamal_ws_free(elgamal_ws_t *ws);
+int elgamal_encrypt_ws(elgamal_ctx_t *ctx, elgamal_ws_t *ws, bn_t m, ec_t M1, ec_t M2);
+int elgamal_decrypt_ws(elgamal_ws_t *ws, bn_t s, ec_t M1, ec_t M2, bn_t m);
 
 #endif // ELGAMAL_H
\ No newline at end of file
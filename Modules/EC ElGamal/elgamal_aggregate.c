@@ -0,0 +1,493 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "elgamal_aggregate.h"
+
+typedef struct {
+    const elgamal_ciphertext_t *cts;  // Slice of the input array
+    size_t n;                         // Number of ciphertexts in the slice
+    elgamal_ciphertext_t *partial;    // Partial sum of the slice
+    int curve;                        // RELIC curve identifier of the caller
+    int result;                       // RLC_OK on success
+} elgamal_aggregate_job_t;
+
+/**
+ * Normalizes the two projective sums of a ciphertext with a single batched
+ * inversion. The batch must not contain the point at infinity, whose z has no
+ * inverse, so that case falls back to normalizing each point on its own.
+ */
+static void elgamal_aggregate_norm(ec_t S[2]) {
+    if (ec_is_infty(S[0]) || ec_is_infty(S[1])) {
+        ec_norm(S[0], S[0]);
+        ec_norm(S[1], S[1]);
+    } else {
+        ep_norm_sim(S, (const ep_t *)S, 2);
+    }
+}
+
+/**
+ * Homomorphic aggregation of ElGamal ciphertexts (Elliptic Curve Version).
+ *
+ * Given:
+ * - cts: an array of n ciphertexts (M1_i, M2_i) under the same public key B
+ *
+ * Steps:
+ * 1. Accumulate S1 = sum of M1_i and S2 = sum of M2_i in projective coordinates.
+ * 2. Normalize S1 and S2 together, sharing a single field inversion.
+ *
+ * Since (M1_i, M2_i) = (k_i*P, m_i*P + k_i*B), the result (S1, S2) is an
+ * encryption of the sum of m_i under the randomness sum of k_i, and decrypts
+ * with elgamal_decrypt as usual. The point additions never normalize: with
+ * normalized inputs RELIC uses mixed additions into the projective sums.
+ */
+int elgamal_aggregate(elgamal_ciphertext_t *sum, const elgamal_ciphertext_t *cts, size_t n) {
+    int result = RLC_OK;
+    ec_t S[2];   // Projective accumulators for M1 and M2
+    size_t i;
+
+    // Initialize variables as null
+    ec_null(S[0]);
+    ec_null(S[1]);
+
+    RLC_TRY {
+        // Allocate memory for variables
+        ec_new(S[0]);
+        ec_new(S[1]);
+
+        ec_set_infty(S[0]);
+        ec_set_infty(S[1]);
+
+        // Compute S1 = sum of M1_i and S2 = sum of M2_i
+        for (i = 0; i < n; i++) {
+            ec_add(S[0], S[0], cts[i].M1);
+            ec_add(S[1], S[1], cts[i].M2);
+        }
+
+        // Normalize both sums with one batched inversion
+        elgamal_aggregate_norm(S);
+
+        ec_copy(sum->M1, S[0]);
+        ec_copy(sum->M2, S[1]);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for variables
+        ec_free(S[0]);
+        ec_free(S[1]);
+    }
+
+    return result;
+}
+
+/**
+ * Sums one slice of ciphertexts on a worker thread.
+ *
+ * RELIC built with MULTI = PTHREAD keeps its state (error state, curve
+ * parameters and precomputed tables) per thread, and a new thread starts
+ * without any. In that case the worker initializes its own core with the
+ * caller's curve and releases it before exiting.
+ */
+static void *elgamal_aggregate_worker(void *arg) {
+    elgamal_aggregate_job_t *job = (elgamal_aggregate_job_t *)arg;
+    int own_core = 0;
+
+    if (core_get() == NULL) {
+        if (core_init() != RLC_OK) {
+            job->result = RLC_ERR;
+            return NULL;
+        }
+        ep_param_set(job->curve);
+        own_core = 1;
+    }
+
+    job->result = elgamal_aggregate(job->partial, job->cts, job->n);
+
+    if (own_core) {
+        core_clean();
+    }
+    return NULL;
+}
+
+/**
+ * Parallel homomorphic aggregation of ElGamal ciphertexts.
+ *
+ * Given:
+ * - cts: an array of n ciphertexts under the same public key B
+ * - n_threads: the number of worker threads, or 0 for one per online core
+ *
+ * Steps:
+ * 1. Split cts into contiguous slices of at least ELGAMAL_AGGREGATE_MIN_CHUNK.
+ * 2. Sum each slice on its own thread with elgamal_aggregate.
+ * 3. Combine the partial sums pairwise in a binary tree.
+ * 4. Normalize the final sums together with a single batched inversion.
+ *
+ * The result equals that of elgamal_aggregate. RELIC must be built with
+ * MULTI = PTHREAD (or OPENMP) for concurrent use; each worker thread sets up
+ * its own RELIC core for the caller's curve. If a thread cannot be created,
+ * its slice is summed on the calling thread instead.
+ */
+int elgamal_aggregate_parallel(elgamal_ciphertext_t *sum, const elgamal_ciphertext_t *cts, size_t n, size_t n_threads) {
+    int result = RLC_OK;
+    elgamal_aggregate_job_t *jobs = NULL;
+    elgamal_ciphertext_t *partials = NULL;
+    pthread_t *threads = NULL;
+    char *started = NULL;
+    size_t i, stride, begin, per_thread;
+    int prepared;
+    long cores;
+
+    if (n_threads == 0) {
+        cores = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = (cores > 0) ? (size_t)cores : 1;
+    }
+    if (n_threads > n / ELGAMAL_AGGREGATE_MIN_CHUNK) {
+        n_threads = n / ELGAMAL_AGGREGATE_MIN_CHUNK;
+    }
+    if (n_threads <= 1) {
+        return elgamal_aggregate(sum, cts, n);
+    }
+
+    jobs = (elgamal_aggregate_job_t *)malloc(n_threads * sizeof(*jobs));
+    partials = (elgamal_ciphertext_t *)malloc(n_threads * sizeof(*partials));
+    threads = (pthread_t *)malloc(n_threads * sizeof(*threads));
+    started = (char *)calloc(n_threads, sizeof(*started));
+    if (jobs == NULL || partials == NULL || threads == NULL || started == NULL) {
+        free(jobs);
+        free(partials);
+        free(threads);
+        free(started);
+        return RLC_ERR;
+    }
+
+    // Partial sums are allocated by the caller's RELIC core and handed to the workers
+    for (i = 0; i < n_threads; i++) {
+        if (elgamal_ciphertext_init(&partials[i]) != RLC_OK) {
+            result = RLC_ERR;
+        }
+    }
+
+    // Split the input into n_threads contiguous slices of near-equal size
+    prepared = (result == RLC_OK);
+    per_thread = n / n_threads;
+    for (i = 0, begin = 0; i < n_threads && prepared; i++) {
+        jobs[i].cts = cts + begin;
+        jobs[i].n = (i < n % n_threads) ? per_thread + 1 : per_thread;
+        jobs[i].partial = &partials[i];
+        jobs[i].curve = ep_param_get();
+        jobs[i].result = RLC_ERR;
+        begin += jobs[i].n;
+
+        started[i] = pthread_create(&threads[i], NULL, elgamal_aggregate_worker, &jobs[i]) == 0;
+    }
+
+    // Every started thread is joined, even after a failure
+    for (i = 0; i < n_threads; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else if (prepared) {
+            jobs[i].result = elgamal_aggregate(jobs[i].partial, jobs[i].cts, jobs[i].n);
+        }
+        if (prepared && jobs[i].result != RLC_OK) {
+            result = RLC_ERR;
+        }
+    }
+
+    RLC_TRY {
+        if (result == RLC_OK) {
+            // Combine the partial sums in a binary tree
+            for (stride = 1; stride < n_threads; stride *= 2) {
+                for (i = 0; i + stride < n_threads; i += 2 * stride) {
+                    ec_add(partials[i].M1, partials[i].M1, partials[i + stride].M1);
+                    ec_add(partials[i].M2, partials[i].M2, partials[i + stride].M2);
+                }
+            }
+            // Normalize the final sums, reusing the single-threaded batched path
+            result = elgamal_aggregate(sum, partials, 1);
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        for (i = 0; i < n_threads; i++) {
+            elgamal_ciphertext_free(&partials[i]);
+        }
+        free(jobs);
+        free(partials);
+        free(threads);
+        free(started);
+    }
+
+    return result;
+}
+
+/**
+ * Extracts the c-bit digit of k starting at bit offset.
+ */
+static size_t elgamal_msm_digit(const bn_t k, int offset, int c) {
+    size_t d = 0;
+    int j;
+
+    for (j = c - 1; j >= 0; j--) {
+        d = (d << 1) | (size_t)bn_get_bit(k, offset + j);
+    }
+    return d;
+}
+
+/**
+ * Chooses the Pippenger window width for n points and bits-bit scalars:
+ * about log2(n) - 2 bits, never wider than the scalars.
+ */
+static int elgamal_msm_window(size_t n, int bits) {
+    int c;
+
+    for (c = 0; ((size_t)1 << (c + 1)) <= n; c++);
+    c -= 2;
+    if (c > ELGAMAL_MSM_MAX_WINDOW) {
+        c = ELGAMAL_MSM_MAX_WINDOW;
+    }
+    if (c > bits) {
+        c = bits;
+    }
+    if (c < 1) {
+        c = 1;
+    }
+    return c;
+}
+
+/**
+ * Tariff-weighted homomorphic aggregation of ElGamal ciphertexts.
+ *
+ * Given:
+ * - cts: an array of n ciphertexts (M1_i, M2_i) under the same public key B
+ * - t: an array of n non-negative public weights (tariffs) t_i
+ *
+ * Computes (S1, S2) = (sum of t_i*M1_i, sum of t_i*M2_i), an encryption of the
+ * sum of t_i*m_i, with a Pippenger bucket multi-scalar multiplication shared by
+ * the M1 and M2 vectors:
+ *
+ * 1. Choose a window width c of roughly log2(n) - 2 bits.
+ * 2. For each c-bit window of the tariffs, from the most significant down:
+ *    a. Shift the running sums left by c bits (c point doublings).
+ *    b. Add every M1_i and M2_i into the bucket indexed by the digit of t_i.
+ *    c. Add sum of d * bucket[d] to the running sums using suffix sums.
+ * 3. Normalize S1 and S2 together with a single batched inversion.
+ *
+ * This costs about (n + 2^(c+1)) point additions per window, instead of a full
+ * scalar multiplication per reading. Returns RLC_ERR on a negative tariff.
+ */
+int elgamal_aggregate_weighted(elgamal_ciphertext_t *sum, const elgamal_ciphertext_t *cts, const bn_t *t, size_t n) {
+    int result = RLC_OK;
+    ec_t S[2];               // Running sums for M1 and M2
+    ec_t R[2];               // Suffix sums of the buckets
+    ec_t W[2];               // Window sums
+    ec_t *buckets = NULL;    // 2^c buckets for M1 followed by 2^c buckets for M2
+    size_t i, d, n_buckets = 0;
+    int c, j, w, bits = 0;
+
+    for (i = 0; i < n; i++) {
+        if (bn_sign(t[i]) == RLC_NEG) {
+            return RLC_ERR;
+        }
+        if (bn_bits(t[i]) > bits) {
+            bits = bn_bits(t[i]);
+        }
+    }
+
+    c = elgamal_msm_window(n, bits);
+    n_buckets = (size_t)1 << c;
+
+    buckets = (ec_t *)malloc(2 * n_buckets * sizeof(*buckets));
+    if (buckets == NULL) {
+        return RLC_ERR;
+    }
+
+    // Initialize variables as null
+    for (j = 0; j < 2; j++) {
+        ec_null(S[j]);
+        ec_null(R[j]);
+        ec_null(W[j]);
+    }
+    for (d = 0; d < 2 * n_buckets; d++) {
+        ec_null(buckets[d]);
+    }
+
+    RLC_TRY {
+        // Allocate memory for variables
+        for (j = 0; j < 2; j++) {
+            ec_new(S[j]);
+            ec_new(R[j]);
+            ec_new(W[j]);
+            ec_set_infty(S[j]);
+        }
+        for (d = 0; d < 2 * n_buckets; d++) {
+            ec_new(buckets[d]);
+        }
+
+        for (w = ((bits + c - 1) / c) - 1; w >= 0; w--) {
+            // Shift the running sums by one window
+            for (j = 0; j < c; j++) {
+                ec_dbl(S[0], S[0]);
+                ec_dbl(S[1], S[1]);
+            }
+
+            // Sort the points into buckets by digit; digit 0 contributes nothing
+            for (d = 1; d < n_buckets; d++) {
+                ec_set_infty(buckets[d]);
+                ec_set_infty(buckets[n_buckets + d]);
+            }
+            for (i = 0; i < n; i++) {
+                d = elgamal_msm_digit(t[i], w * c, c);
+                if (d != 0) {
+                    ec_add(buckets[d], buckets[d], cts[i].M1);
+                    ec_add(buckets[n_buckets + d], buckets[n_buckets + d], cts[i].M2);
+                }
+            }
+
+            // Compute W = sum of d * bucket[d] as a sum of suffix sums
+            for (j = 0; j < 2; j++) {
+                ec_set_infty(R[j]);
+                ec_set_infty(W[j]);
+            }
+            for (d = n_buckets - 1; d >= 1; d--) {
+                ec_add(R[0], R[0], buckets[d]);
+                ec_add(R[1], R[1], buckets[n_buckets + d]);
+                ec_add(W[0], W[0], R[0]);
+                ec_add(W[1], W[1], R[1]);
+            }
+
+            ec_add(S[0], S[0], W[0]);
+            ec_add(S[1], S[1], W[1]);
+        }
+
+        // Normalize both sums with one batched inversion
+        elgamal_aggregate_norm(S);
+
+        ec_copy(sum->M1, S[0]);
+        ec_copy(sum->M2, S[1]);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for variables
+        for (j = 0; j < 2; j++) {
+            ec_free(S[j]);
+            ec_free(R[j]);
+            ec_free(W[j]);
+        }
+        for (d = 0; d < 2 * n_buckets; d++) {
+            ec_free(buckets[d]);
+        }
+        free(buckets);
+    }
+
+    return result;
+}
+
+/**
+ * Multi-scalar multiplication R = sum of k_i*P_i over arbitrary points.
+ *
+ * Uses the same Pippenger bucket method as elgamal_aggregate_weighted, for a
+ * single vector of points. The scalars must be non-negative; reduce them
+ * modulo the group order first. The result is normalized.
+ */
+int elgamal_msm(ec_t R, const ec_t *P, const bn_t *k, size_t n) {
+    int result = RLC_OK;
+    ec_t S, T, W;            // Running sum, suffix sum and window sum
+    ec_t *buckets = NULL;
+    size_t i, d, n_buckets = 0;
+    int c, j, w, bits = 0;
+
+    for (i = 0; i < n; i++) {
+        if (bn_sign(k[i]) == RLC_NEG) {
+            return RLC_ERR;
+        }
+        if (bn_bits(k[i]) > bits) {
+            bits = bn_bits(k[i]);
+        }
+    }
+
+    c = elgamal_msm_window(n, bits);
+    n_buckets = (size_t)1 << c;
+
+    buckets = (ec_t *)malloc(n_buckets * sizeof(*buckets));
+    if (buckets == NULL) {
+        return RLC_ERR;
+    }
+
+    // Initialize variables as null
+    ec_null(S);
+    ec_null(T);
+    ec_null(W);
+    for (d = 0; d < n_buckets; d++) {
+        ec_null(buckets[d]);
+    }
+
+    RLC_TRY {
+        // Allocate memory for variables
+        ec_new(S);
+        ec_new(T);
+        ec_new(W);
+        for (d = 0; d < n_buckets; d++) {
+            ec_new(buckets[d]);
+        }
+
+        ec_set_infty(S);
+        for (w = ((bits + c - 1) / c) - 1; w >= 0; w--) {
+            // Shift the running sum by one window
+            for (j = 0; j < c; j++) {
+                ec_dbl(S, S);
+            }
+
+            // Sort the points into buckets by digit; digit 0 contributes nothing
+            for (d = 1; d < n_buckets; d++) {
+                ec_set_infty(buckets[d]);
+            }
+            for (i = 0; i < n; i++) {
+                d = elgamal_msm_digit(k[i], w * c, c);
+                if (d != 0) {
+                    ec_add(buckets[d], buckets[d], P[i]);
+                }
+            }
+
+            // Compute W = sum of d * bucket[d] as a sum of suffix sums
+            ec_set_infty(T);
+            ec_set_infty(W);
+            for (d = n_buckets - 1; d >= 1; d--) {
+                ec_add(T, T, buckets[d]);
+                ec_add(W, W, T);
+            }
+
+            ec_add(S, S, W);
+        }
+
+        ec_norm(R, S);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for variables
+        ec_free(S);
+        ec_free(T);
+        ec_free(W);
+        for (d = 0; d < n_buckets; d++) {
+            ec_free(buckets[d]);
+        }
+        free(buckets);
+    }
+
+    return result;
+}
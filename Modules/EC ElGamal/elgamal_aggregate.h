@@ -0,0 +1,19 @@
+#ifndef ELGAMAL_AGGREGATE_H
+#define ELGAMAL_AGGREGATE_H
+
+#include <stddef.h>
+
+#include "elgamal.h"
+
+// Smallest slice of ciphertexts worth handing to a separate thread
+#define ELGAMAL_AGGREGATE_MIN_CHUNK 4096
+
+// Widest bucket window of the tariff-weighted multi-scalar multiplication
+#define ELGAMAL_MSM_MAX_WINDOW 14
+
+int elgamal_aggregate(elgamal_ciphertext_t *sum, const elgamal_ciphertext_t *cts, size_t n);
+int elgamal_aggregate_parallel(elgamal_ciphertext_t *sum, const elgamal_ciphertext_t *cts, size_t n, size_t n_threads);
+int elgamal_aggregate_weighted(elgamal_ciphertext_t *sum, const elgamal_ciphertext_t *cts, const bn_t *t, size_t n);
+int elgamal_msm(ec_t R, const ec_t *P, const bn_t *k, size_t n);
+
+#endif // ELGAMAL_AGGREGATE_H
@@ -0,0 +1,643 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "elgamal_dlog.h"
+#include "metrics.h"
+
+// A table installed as the process-wide table
+typedef struct elgamal_dlog_node {
+    elgamal_dlog_t table;
+    struct elgamal_dlog_node *next;  // Previously installed table
+} elgamal_dlog_node_t;
+
+// Process-wide table used by elgamal_decrypt. Readers load shared_table
+// without locking; tables are built and published under shared_lock.
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic(elgamal_dlog_t *) shared_table = NULL;
+
+// Every table ever installed. Concurrent decryptions may still read a replaced
+// table, so none is released before the process exits.
+static elgamal_dlog_node_t *shared_nodes = NULL;
+
+/**
+ * Sets a multiple precision integer from an unsigned 64-bit value.
+ *
+ * The value is loaded in two 32-bit halves so that the conversion is correct
+ * regardless of the digit size RELIC was configured with.
+ */
+static void elgamal_dlog_set_u64(bn_t a, uint64_t v) {
+    bn_set_dig(a, (dig_t)(v >> 32));
+    bn_lsh(a, a, 32);
+    bn_add_dig(a, a, (dig_t)(v & 0xFFFFFFFF));
+}
+
+/**
+ * Computes the smallest integer t such that t * t >= v.
+ */
+static uint64_t elgamal_dlog_isqrt_ceil(uint64_t v) {
+    uint64_t t = 0;
+    uint64_t rem = v;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > rem) {
+        bit >>= 2;
+    }
+    // Integer square root by the digit-by-digit method; rem ends as v - t*t
+    for (; bit != 0; bit >>= 2) {
+        if (rem >= t + bit) {
+            rem -= t + bit;
+            t = (t >> 1) + bit;
+        } else {
+            t >>= 1;
+        }
+    }
+    return (rem != 0) ? t + 1 : t;
+}
+
+/**
+ * Derives the 32-bit lookup key of a normalized, non-infinity point from the
+ * leading bytes of its compressed x-coordinate.
+ *
+ * The key depends on x only, so the key of -R equals the key of R. Callers
+ * must therefore verify every candidate that a key lookup produces.
+ */
+static uint32_t elgamal_dlog_key(const ec_t R) {
+    uint8_t bin[RLC_FP_BYTES + 1];
+
+    ec_write_bin(bin, sizeof(bin), R, 1);
+    return ((uint32_t)bin[1] << 24) | ((uint32_t)bin[2] << 16) | ((uint32_t)bin[3] << 8) | (uint32_t)bin[4];
+}
+
+/**
+ * Inserts the baby-step exponent j under the given key using linear probing.
+ */
+static void elgamal_dlog_insert(elgamal_dlog_t *table, uint32_t key, uint32_t j) {
+    uint64_t slot = key & table->mask;
+
+    while (table->slots[slot].value != 0) {
+        slot = (slot + 1) & table->mask;
+    }
+    table->slots[slot].key = key;
+    table->slots[slot].value = j;
+}
+
+/**
+ * Builds a baby-step giant-step table for the base point P of the current curve.
+ *
+ * Given:
+ * - max: the exclusive upper bound on plaintexts that must be recoverable
+ * - n_baby: the number of baby steps T, or 0 to use ceil(sqrt(max))
+ *
+ * Steps:
+ * 1. Compute the baby steps j*P for j in [1, T) by repeated point addition.
+ * 2. Normalize the baby steps in chunks with a single shared inversion each.
+ * 3. Store each exponent j under the truncated x-coordinate of j*P.
+ *
+ * A larger T trades memory for fewer giant steps per decryption: solving then
+ * takes at most ceil(max / T) point subtractions and table lookups.
+ */
+int elgamal_dlog_init(elgamal_dlog_t *table, uint64_t max, uint64_t n_baby) {
+    int result = RLC_OK;
+    uint64_t j, n_slots;
+    size_t i, count;
+    ec_t P, R;          // Base point and running baby step
+    ec_t *chunk = NULL; // Baby steps awaiting normalization
+
+    table->slots = NULL;
+    table->map = NULL;
+    table->map_len = 0;
+    if (max == 0) {
+        return RLC_ERR;
+    }
+    if (n_baby == 0) {
+        n_baby = elgamal_dlog_isqrt_ceil(max);
+    }
+    if (n_baby > max) {
+        n_baby = max;
+    }
+    // Exponents are stored in 32 bits
+    if (n_baby > UINT32_MAX) {
+        return RLC_ERR;
+    }
+
+    // Keep the load factor at or below one half
+    for (n_slots = 1; n_slots < 2 * n_baby; n_slots <<= 1);
+
+    table->slots = (elgamal_dlog_entry_t *)calloc(n_slots, sizeof(*table->slots));
+    chunk = (ec_t *)malloc(ELGAMAL_DLOG_CHUNK * sizeof(*chunk));
+    if (table->slots == NULL || chunk == NULL) {
+        free(table->slots);
+        free(chunk);
+        table->slots = NULL;
+        return RLC_ERR;
+    }
+    table->mask = n_slots - 1;
+    table->n_baby = n_baby;
+    table->n_giant = (max + n_baby - 1) / n_baby;
+    table->max = max;
+    table->curve = ep_param_get();
+
+    // Initialize variables as null
+    ec_null(P);
+    ec_null(R);
+    for (i = 0; i < ELGAMAL_DLOG_CHUNK; i++) {
+        ec_null(chunk[i]);
+    }
+
+    RLC_TRY {
+        // Allocate memory for variables
+        ec_new(P);
+        ec_new(R);
+        for (i = 0; i < ELGAMAL_DLOG_CHUNK; i++) {
+            ec_new(chunk[i]);
+        }
+
+        // Get the base point of the group G1 and store it in P
+        ec_curve_get_gen(P);
+        ec_copy(R, P);
+
+        for (j = 1; j < n_baby; j += count) {
+            // Compute the next chunk of baby steps in projective coordinates
+            for (count = 0; count < ELGAMAL_DLOG_CHUNK && j + count < n_baby; count++) {
+                ec_copy(chunk[count], R);
+                ec_add(R, R, P);
+            }
+            // secp256k1 is a prime curve, so batch normalization goes through the ep layer
+            ep_norm_sim(chunk, (const ep_t *)chunk, (int)count);
+            for (i = 0; i < count; i++) {
+                elgamal_dlog_insert(table, elgamal_dlog_key(chunk[i]), (uint32_t)(j + i));
+            }
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for variables
+        ec_free(P);
+        ec_free(R);
+        for (i = 0; i < ELGAMAL_DLOG_CHUNK; i++) {
+            ec_free(chunk[i]);
+        }
+        free(chunk);
+    }
+
+    if (result != RLC_OK) {
+        elgamal_dlog_free(table);
+    }
+    return result;
+}
+
+/**
+ * Releases the memory held by a baby-step giant-step table, or unmaps the
+ * file backing it if it was loaded with elgamal_dlog_load.
+ */
+void elgamal_dlog_free(elgamal_dlog_t *table) {
+    if (table->map != NULL) {
+        munmap(table->map, table->map_len);
+    } else {
+        free(table->slots);
+    }
+    table->slots = NULL;
+    table->map = NULL;
+    table->map_len = 0;
+    table->mask = 0;
+    table->n_baby = 0;
+    table->n_giant = 0;
+    table->max = 0;
+}
+
+/**
+ * Computes the giant-step stride G = T*P of a table, normalized, using t as a
+ * temporary. Raises a RELIC error on failure.
+ */
+void elgamal_dlog_stride(const elgamal_dlog_t *table, ec_t G, bn_t t) {
+    elgamal_dlog_set_u64(t, table->n_baby);
+    ec_mul_gen(G, t);
+    ec_norm(G, G);
+}
+
+/**
+ * Solves the bounded elliptic curve discrete log problem M = m*P.
+ *
+ * Given:
+ * - table: a baby-step table built for the current curve
+ * - M: the point whose discrete logarithm is sought
+ *
+ * Steps:
+ * 1. Compute the giant-step stride G = T*P.
+ * 2. For i = 0, 1, ...: look up Q = M - i*G in the baby-step table.
+ * 3. On a key match with exponent j, accept m = i*T + j if m*P equals M.
+ *
+ * Returns RLC_OK and sets m if a solution exists in [0, max), RLC_ERR otherwise.
+ */
+int elgamal_dlog_solve(const elgamal_dlog_t *table, const ec_t M, bn_t m) {
+    int result = RLC_ERR;
+    ec_t Q, G, R;   // Current giant step, giant-step stride, candidate check
+    bn_t t;
+
+    if (table == NULL || table->slots == NULL || table->curve != ep_param_get()) {
+        return RLC_ERR;
+    }
+
+    // Initialize variables as null
+    ec_null(Q);
+    ec_null(G);
+    ec_null(R);
+    bn_null(t);
+
+    RLC_TRY {
+        // Allocate memory for variables
+        ec_new(Q);
+        ec_new(G);
+        ec_new(R);
+        bn_new(t);
+
+        // Compute G = T*P
+        elgamal_dlog_stride(table, G, t);
+
+        result = elgamal_dlog_solve_ws(table, M, m, G, Q, R, t);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for variables
+        ec_free(Q);
+        ec_free(G);
+        ec_free(R);
+        bn_free(t);
+    }
+
+    return result;
+}
+
+/**
+ * Allocation-free counterpart of elgamal_dlog_solve.
+ *
+ * The stride G must have been computed for table with elgamal_dlog_stride;
+ * Q, R and t are caller-provided temporaries, so the search allocates
+ * nothing and skips the scalar multiplication of step 1.
+ */
+int elgamal_dlog_solve_ws(const elgamal_dlog_t *table, const ec_t M, bn_t m, const ec_t G, ec_t Q, ec_t R, bn_t t) {
+    int result = RLC_ERR;
+    int done = 0;
+    uint64_t i = 0, slot, candidate;
+    uint32_t key;
+
+    if (table == NULL || table->slots == NULL || table->curve != ep_param_get()) {
+        return RLC_ERR;
+    }
+
+    RLC_TRY {
+        ec_norm(Q, M);
+
+        for (i = 0; i < table->n_giant && !done; i++) {
+            if (ec_is_infty(Q)) {
+                // M = (i*T)*P exactly
+                candidate = i * table->n_baby;
+                if (candidate < table->max) {
+                    elgamal_dlog_set_u64(m, candidate);
+                    result = RLC_OK;
+                }
+                break;
+            }
+
+            key = elgamal_dlog_key(Q);
+            for (slot = key & table->mask; table->slots[slot].value != 0; slot = (slot + 1) & table->mask) {
+                if (table->slots[slot].key != key) {
+                    continue;
+                }
+                candidate = i * table->n_baby + table->slots[slot].value;
+                if (candidate >= table->max) {
+                    continue;
+                }
+                // Truncated keys collide and ignore the sign of y, so verify the match
+                elgamal_dlog_set_u64(t, candidate);
+                ec_mul_gen(R, t);
+                if (ec_cmp(R, M) == RLC_EQ) {
+                    bn_copy(m, t);
+                    result = RLC_OK;
+                    done = 1;
+                    break;
+                }
+            }
+
+            // Compute Q = Q - G
+            ec_sub(Q, Q, G);
+            ec_norm(Q, Q);
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    METRICS_DLOG_STEPS(i);
+    return result;
+}
+
+/**
+ * Writes the compressed encoding of the base point P of the current curve.
+ */
+static int elgamal_dlog_base(uint8_t base[RLC_FP_BYTES + 1]) {
+    int result = RLC_OK;
+    ec_t P;
+
+    ec_null(P);
+
+    RLC_TRY {
+        ec_new(P);
+        ec_curve_get_gen(P);
+        ec_write_bin(base, RLC_FP_BYTES + 1, P, 1);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        ec_free(P);
+    }
+    return result;
+}
+
+/**
+ * Saves a baby-step giant-step table to a file.
+ *
+ * The file holds a fixed-size header followed by the slot array exactly as it
+ * is laid out in memory: 8 bytes per slot, a 32-bit truncated point hash and
+ * a 32-bit exponent. The table is written to a temporary file that is renamed
+ * over the destination, so concurrent readers never observe a partial table.
+ */
+int elgamal_dlog_save(const elgamal_dlog_t *table, const char *path) {
+    elgamal_dlog_header_t header;
+    unsigned char block[ELGAMAL_DLOG_HEADER_SIZE];
+    uint64_t n_slots;
+    size_t len;
+    char *tmp;
+    FILE *fp;
+    int ok;
+
+    if (table == NULL || table->slots == NULL) {
+        return RLC_ERR;
+    }
+    n_slots = table->mask + 1;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ELGAMAL_DLOG_MAGIC, sizeof(header.magic));
+    header.version = ELGAMAL_DLOG_VERSION;
+    header.byte_order = 0x01020304;
+    header.n_slots = n_slots;
+    header.n_baby = table->n_baby;
+    header.max = table->max;
+    if (elgamal_dlog_base(header.base) != RLC_OK) {
+        return RLC_ERR;
+    }
+    memset(block, 0, sizeof(block));
+    memcpy(block, &header, sizeof(header));
+
+    len = strlen(path);
+    tmp = (char *)malloc(len + sizeof(".tmp"));
+    if (tmp == NULL) {
+        return RLC_ERR;
+    }
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".tmp", sizeof(".tmp"));
+
+    fp = fopen(tmp, "wb");
+    if (fp == NULL) {
+        free(tmp);
+        return RLC_ERR;
+    }
+    ok = fwrite(block, sizeof(block), 1, fp) == 1;
+    ok = ok && fwrite(table->slots, sizeof(*table->slots), n_slots, fp) == n_slots;
+    ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = (fclose(fp) == 0) && ok;
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok) {
+        unlink(tmp);
+    }
+    free(tmp);
+
+    return ok ? RLC_OK : RLC_ERR;
+}
+
+/**
+ * Loads a baby-step giant-step table by mapping a file read-only.
+ *
+ * The slot array is used directly from the mapping, so loading costs no
+ * point arithmetic and several decryption processes on one host share a
+ * single page-cached copy. The header is validated against the current curve
+ * and the file size before the table is accepted.
+ *
+ * The mapping is read-only: a loaded table must only be passed to
+ * elgamal_dlog_solve, elgamal_dlog_save and elgamal_dlog_free.
+ */
+int elgamal_dlog_load(elgamal_dlog_t *table, const char *path) {
+    const elgamal_dlog_header_t *header;
+    uint8_t base[RLC_FP_BYTES + 1];
+    struct stat st;
+    void *map;
+    size_t len;
+    int fd;
+    int valid;
+
+    table->slots = NULL;
+    table->map = NULL;
+    table->map_len = 0;
+
+    if (elgamal_dlog_base(base) != RLC_OK) {
+        return RLC_ERR;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return RLC_ERR;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < ELGAMAL_DLOG_HEADER_SIZE) {
+        close(fd);
+        return RLC_ERR;
+    }
+    len = (size_t)st.st_size;
+    map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // The mapping stays valid after the descriptor is closed
+    if (map == MAP_FAILED) {
+        return RLC_ERR;
+    }
+
+    header = (const elgamal_dlog_header_t *)map;
+    valid = memcmp(header->magic, ELGAMAL_DLOG_MAGIC, sizeof(header->magic)) == 0
+        && header->version == ELGAMAL_DLOG_VERSION
+        && header->byte_order == 0x01020304
+        && memcmp(header->base, base, sizeof(base)) == 0
+        && header->n_slots != 0
+        && (header->n_slots & (header->n_slots - 1)) == 0
+        && header->n_slots <= (SIZE_MAX - ELGAMAL_DLOG_HEADER_SIZE) / sizeof(elgamal_dlog_entry_t)
+        && len == ELGAMAL_DLOG_HEADER_SIZE + header->n_slots * sizeof(elgamal_dlog_entry_t)
+        && header->n_baby != 0 && header->n_baby <= UINT32_MAX
+        && header->n_slots >= 2 * header->n_baby  // Guarantees empty slots, so probing ends
+        && header->max != 0 && header->n_baby <= header->max;
+    if (!valid) {
+        munmap(map, len);
+        return RLC_ERR;
+    }
+
+    // Lookups probe the table at random
+    madvise(map, len, MADV_RANDOM);
+
+    table->slots = (elgamal_dlog_entry_t *)((unsigned char *)map + ELGAMAL_DLOG_HEADER_SIZE);
+    table->mask = header->n_slots - 1;
+    table->n_baby = header->n_baby;
+    table->n_giant = (header->max + header->n_baby - 1) / header->n_baby;
+    table->max = header->max;
+    table->curve = ep_param_get();
+    table->map = map;
+    table->map_len = len;
+
+    return RLC_OK;
+}
+
+/**
+ * Publishes a table as the process-wide table. Must be called with shared_lock
+ * held. The previous table is kept for the readers still using it.
+ */
+static int elgamal_dlog_install_locked(const elgamal_dlog_t *table) {
+    elgamal_dlog_node_t *node = (elgamal_dlog_node_t *)malloc(sizeof(*node));
+
+    if (node == NULL) {
+        return RLC_ERR;
+    }
+    node->table = *table;
+    node->next = shared_nodes;
+    shared_nodes = node;
+    atomic_store_explicit(&shared_table, &node->table, memory_order_release);
+    return RLC_OK;
+}
+
+/**
+ * Publishes a freshly built or loaded table as the process-wide table, or
+ * releases it if the table cannot be recorded.
+ */
+static int elgamal_dlog_install(elgamal_dlog_t *table) {
+    int result;
+
+    pthread_mutex_lock(&shared_lock);
+    result = elgamal_dlog_install_locked(table);
+    pthread_mutex_unlock(&shared_lock);
+    if (result != RLC_OK) {
+        elgamal_dlog_free(table);
+    }
+    return result;
+}
+
+/**
+ * Replaces the process-wide table used by elgamal_decrypt.
+ *
+ * Call this once at startup to choose the plaintext bound and the memory/time
+ * trade-off of the table. Concurrent decryptions keep using the table they
+ * already hold, which therefore stays allocated until the process exits.
+ */
+int elgamal_dlog_setup(uint64_t max, uint64_t n_baby) {
+    elgamal_dlog_t table;
+
+    if (elgamal_dlog_init(&table, max, n_baby) != RLC_OK) {
+        return RLC_ERR;
+    }
+    return elgamal_dlog_install(&table);
+}
+
+/**
+ * Installs the process-wide table from a file, creating the file if needed.
+ *
+ * If the file holds a valid table for the current curve covering at least
+ * max, it is mapped and used as is. Otherwise a table is built, saved to the
+ * file and then mapped from it, so that later workers and restarts start
+ * without any point arithmetic. If the file cannot be written, the freshly
+ * built in-memory table is used instead.
+ */
+int elgamal_dlog_setup_file(const char *path, uint64_t max, uint64_t n_baby) {
+    elgamal_dlog_t table;
+
+    if (elgamal_dlog_load(&table, path) == RLC_OK) {
+        if (table.max >= max) {
+            return elgamal_dlog_install(&table);
+        }
+        elgamal_dlog_free(&table);
+    }
+
+    if (elgamal_dlog_init(&table, max, n_baby) != RLC_OK) {
+        return RLC_ERR;
+    }
+    if (elgamal_dlog_save(&table, path) == RLC_OK) {
+        elgamal_dlog_t mapped;
+
+        if (elgamal_dlog_load(&mapped, path) == RLC_OK) {
+            elgamal_dlog_free(&table);
+            table = mapped;
+        }
+    }
+    return elgamal_dlog_install(&table);
+}
+
+/**
+ * Returns the process-wide table if it was built for the current RELIC curve,
+ * or NULL otherwise. Never builds a table.
+ */
+const elgamal_dlog_t *elgamal_dlog_current(void) {
+    const elgamal_dlog_t *table = atomic_load_explicit(&shared_table, memory_order_acquire);
+
+    if (table == NULL || table->curve != ep_param_get()) {
+        return NULL;
+    }
+    return table;
+}
+
+/**
+ * Returns the process-wide table, building it on first use.
+ *
+ * The table is built once per curve: if the current RELIC curve differs from
+ * the one the table was built for, a previously installed table of that curve
+ * is reinstated, or a new one is built with the same bound. Without a prior
+ * elgamal_dlog_setup call the bound is ELGAMAL_DLOG_DEFAULT_MAX. Concurrent
+ * first callers wait for a single build.
+ */
+const elgamal_dlog_t *elgamal_dlog_shared(void) {
+    const elgamal_dlog_t *table = elgamal_dlog_current();
+    elgamal_dlog_t *last;
+    elgamal_dlog_node_t *node;
+    elgamal_dlog_t built;
+    int curve;
+
+    if (table != NULL) {
+        return table;
+    }
+
+    pthread_mutex_lock(&shared_lock);
+    curve = ep_param_get();
+    last = atomic_load_explicit(&shared_table, memory_order_relaxed);
+    if (last == NULL || last->curve != curve) {
+        for (node = shared_nodes; node != NULL && node->table.curve != curve; node = node->next);
+        if (node != NULL) {
+            atomic_store_explicit(&shared_table, &node->table, memory_order_release);
+        } else if (elgamal_dlog_init(&built, last != NULL ? last->max : ELGAMAL_DLOG_DEFAULT_MAX, last != NULL ? last->n_baby : 0) == RLC_OK) {
+            if (elgamal_dlog_install_locked(&built) != RLC_OK) {
+                elgamal_dlog_free(&built);
+            }
+        }
+    }
+    pthread_mutex_unlock(&shared_lock);
+
+    return elgamal_dlog_current();
+}
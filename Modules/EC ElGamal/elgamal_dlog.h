@@ -0,0 +1,65 @@
+#ifndef ELGAMAL_DLOG_H
+#define ELGAMAL_DLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <relic.h>
+
+// Default exclusive upper bound on decryptable plaintexts (2^32 Wh)
+#define ELGAMAL_DLOG_DEFAULT_MAX ((uint64_t)1 << 32)
+
+// Number of baby-step points normalized together while building a table
+#define ELGAMAL_DLOG_CHUNK 1024
+
+// On-disk table format: magic, version and fixed header size
+#define ELGAMAL_DLOG_MAGIC "EGDLOG\0\0"
+#define ELGAMAL_DLOG_VERSION 1
+#define ELGAMAL_DLOG_HEADER_SIZE 128
+
+typedef struct {
+    uint32_t key;    // Truncated x-coordinate of j*P
+    uint32_t value;  // Baby-step exponent j; 0 marks an empty slot
+} elgamal_dlog_entry_t;
+
+typedef struct {
+    elgamal_dlog_entry_t *slots;  // Open-addressing hash table of baby steps
+    uint64_t mask;                // Number of slots minus one
+    uint64_t n_baby;              // Baby steps T, i.e. the giant-step stride
+    uint64_t n_giant;             // Giant steps needed to cover [0, max)
+    uint64_t max;                 // Exclusive upper bound on plaintexts
+    int curve;                    // RELIC curve identifier the table belongs to
+    void *map;                    // Read-only file mapping backing slots, or NULL
+    size_t map_len;               // Length of the file mapping in bytes
+} elgamal_dlog_t;
+
+/*
+ * Layout of the on-disk table header. The slot array follows at offset
+ * ELGAMAL_DLOG_HEADER_SIZE in host byte order, so a loaded file is used in
+ * place without copying.
+ */
+typedef struct {
+    char magic[8];                  // ELGAMAL_DLOG_MAGIC
+    uint32_t version;               // ELGAMAL_DLOG_VERSION
+    uint32_t byte_order;            // 0x01020304 as written by the host
+    uint64_t n_slots;               // Number of slots following the header
+    uint64_t n_baby;                // Baby steps T
+    uint64_t max;                   // Exclusive upper bound on plaintexts
+    uint8_t base[RLC_FP_BYTES + 1]; // Compressed base point the table was built for
+} elgamal_dlog_header_t;
+
+int elgamal_dlog_init(elgamal_dlog_t *table, uint64_t max, uint64_t n_baby);
+void elgamal_dlog_free(elgamal_dlog_t *table);
+int elgamal_dlog_solve(const elgamal_dlog_t *table, const ec_t M, bn_t m);
+void elgamal_dlog_stride(const elgamal_dlog_t *table, ec_t G, bn_t t);
+int elgamal_dlog_solve_ws(const elgamal_dlog_t *table, const ec_t M, bn_t m, const ec_t G, ec_t Q, ec_t R, bn_t t);
+
+int elgamal_dlog_save(const elgamal_dlog_t *table, const char *path);
+int elgamal_dlog_load(elgamal_dlog_t *table, const char *path);
+
+int elgamal_dlog_setup(uint64_t max, uint64_t n_baby);
+int elgamal_dlog_setup_file(const char *path, uint64_t max, uint64_t n_baby);
+const elgamal_dlog_t *elgamal_dlog_current(void);
+const elgamal_dlog_t *elgamal_dlog_shared(void);
+
+#endif // ELGAMAL_DLOG_H
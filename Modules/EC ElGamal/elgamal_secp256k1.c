@@ -0,0 +1,383 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "elgamal_secp256k1.h"
+
+// n - 2 for the order n of secp256k1, the exponent of the Fermat inversion
+static const unsigned char elgamal_secp256k1_order_m2[ELGAMAL_SECP256K1_SCALAR_BYTES] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+    0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B,
+    0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x3F
+};
+
+// The zero scalar; blinding with it turns secp256k1_pedersen_commit into m*H
+static const unsigned char elgamal_secp256k1_zero[ELGAMAL_SECP256K1_SCALAR_BYTES] = {0};
+
+/**
+ * Computes the smallest integer t such that t * t >= v.
+ */
+static uint64_t elgamal_secp256k1_isqrt_ceil(uint64_t v) {
+    uint64_t t = 0;
+    uint64_t rem = v;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > rem) {
+        bit >>= 2;
+    }
+    // Integer square root by the digit-by-digit method; rem ends as v - t*t
+    for (; bit != 0; bit >>= 2) {
+        if (rem >= t + bit) {
+            rem -= t + bit;
+            t = (t >> 1) + bit;
+        } else {
+            t >>= 1;
+        }
+    }
+    return (rem != 0) ? t + 1 : t;
+}
+
+/**
+ * Reinterprets a commitment as a generator, so that it can serve as the
+ * blinding generator of secp256k1_pedersen_commit.
+ *
+ * Both are serialized as a tag byte and the x-coordinate, with the low bit
+ * of the tag flagging a non-residue y. Commitments use tags 0x08/0x09 and
+ * generators 0x0a/0x0b, so the conversion only adds 2 to the tag.
+ */
+static int elgamal_secp256k1_as_generator(const secp256k1_context *ctx, secp256k1_generator *gen, const secp256k1_pedersen_commitment *commit) {
+    unsigned char bin[ELGAMAL_SECP256K1_POINT_BYTES];
+
+    if (secp256k1_pedersen_commitment_serialize(ctx, bin, commit) != 1) {
+        return 0;
+    }
+    bin[0] += 2;
+    return secp256k1_generator_parse(ctx, gen, bin);
+}
+
+/**
+ * Compares two commitments by their serialization.
+ */
+static int elgamal_secp256k1_equal(const secp256k1_context *ctx, const secp256k1_pedersen_commitment *a, const secp256k1_pedersen_commitment *b) {
+    unsigned char bin_a[ELGAMAL_SECP256K1_POINT_BYTES];
+    unsigned char bin_b[ELGAMAL_SECP256K1_POINT_BYTES];
+
+    return secp256k1_pedersen_commitment_serialize(ctx, bin_a, a) == 1
+        && secp256k1_pedersen_commitment_serialize(ctx, bin_b, b) == 1
+        && memcmp(bin_a, bin_b, sizeof(bin_a)) == 0;
+}
+
+/**
+ * Derives the 32-bit lookup key of a serialized commitment from the leading
+ * bytes of its x-coordinate, as elgamal_dlog does for RELIC points.
+ */
+static uint32_t elgamal_secp256k1_key(const unsigned char bin[ELGAMAL_SECP256K1_POINT_BYTES]) {
+    return ((uint32_t)bin[1] << 24) | ((uint32_t)bin[2] << 16) | ((uint32_t)bin[3] << 8) | (uint32_t)bin[4];
+}
+
+/**
+ * The key generation process.
+ *
+ * Given:
+ * - d: 32 uniformly random bytes forming a valid secret key
+ *
+ * Steps:
+ * 1. Compute the public key B = d*G.
+ * 2. Compute d^-1 = d^(n-2) mod n, needed at every decryption.
+ *
+ * The context must be created with SECP256K1_CONTEXT_SIGN.
+ * Returns 1 on success, 0 if d is not a valid secret key.
+ */
+int elgamal_secp256k1_keygen(const secp256k1_context *ctx, elgamal_secp256k1_key_t *key, const unsigned char d[ELGAMAL_SECP256K1_SCALAR_BYTES]) {
+    secp256k1_pedersen_commitment B;
+    unsigned char t[ELGAMAL_SECP256K1_SCALAR_BYTES];
+    int i, ok;
+
+    if (secp256k1_ec_seckey_verify(ctx, d) != 1) {
+        return 0;
+    }
+    memcpy(key->d, d, ELGAMAL_SECP256K1_SCALAR_BYTES);
+
+    // Compute B = d*G + 0*G
+    ok = secp256k1_pedersen_commit(ctx, &B, d, 0, &secp256k1_generator_const_g, &secp256k1_generator_const_g) == 1
+        && elgamal_secp256k1_as_generator(ctx, &key->B, &B) == 1;
+
+    // Compute d^-1 by left-to-right square-and-multiply over the bits of n - 2
+    memset(key->d_inv, 0, ELGAMAL_SECP256K1_SCALAR_BYTES);
+    key->d_inv[ELGAMAL_SECP256K1_SCALAR_BYTES - 1] = 1;
+    for (i = 0; i < 8 * ELGAMAL_SECP256K1_SCALAR_BYTES && ok; i++) {
+        memcpy(t, key->d_inv, sizeof(t));
+        ok = secp256k1_ec_privkey_tweak_mul(ctx, key->d_inv, t) == 1;
+        if (ok && (elgamal_secp256k1_order_m2[i / 8] >> (7 - i % 8)) & 1) {
+            ok = secp256k1_ec_privkey_tweak_mul(ctx, key->d_inv, d) == 1;
+        }
+    }
+    memset(t, 0, sizeof(t));
+
+    if (!ok) {
+        memset(key, 0, sizeof(*key));
+    }
+    return ok;
+}
+
+/**
+ * The encryption process.
+ *
+ * Given:
+ * - B: the public key
+ * - H: the value generator, the same one the bulletproofs are made for
+ * - m: the plaintext
+ * - r: 32 uniformly random bytes forming a valid scalar
+ *
+ * Steps:
+ * 1. Compute X = r*B.
+ * 2. Compute Y = m*H + r*G.
+ *
+ * Y is the Pedersen commitment to m with blinding factor r, so the meter
+ * passes r to the range prover as the blind of that reading and a verifier
+ * checks the range proof against Y without any conversion.
+ */
+int elgamal_secp256k1_encrypt(const secp256k1_context *ctx, elgamal_secp256k1_ciphertext_t *ct, const secp256k1_generator *B, const secp256k1_generator *H, uint64_t m, const unsigned char r[ELGAMAL_SECP256K1_SCALAR_BYTES]) {
+    return secp256k1_pedersen_commit(ctx, &ct->X, r, 0, H, B) == 1
+        && secp256k1_pedersen_commit(ctx, &ct->Y, r, m, H, &secp256k1_generator_const_g) == 1;
+}
+
+/**
+ * The decryption process.
+ *
+ * Given:
+ * - table: a baby-step table built for the value generator H
+ * - key: the key pair (d, B)
+ * - ct: the ciphertext (X, Y) = (r*B, m*H + r*G)
+ *
+ * Steps:
+ * 1. Compute S = d^-1 * X = r*G.
+ * 2. Compute M = Y - S = m*H.
+ * 3. Solve the discrete log of M to the base H.
+ *
+ * Returns 1 and sets m on success, 0 if m is not in [0, max).
+ */
+int elgamal_secp256k1_decrypt(const secp256k1_context *ctx, const elgamal_secp256k1_dlog_t *table, const elgamal_secp256k1_key_t *key, const elgamal_secp256k1_ciphertext_t *ct, uint64_t *m) {
+    secp256k1_generator X;
+    secp256k1_pedersen_commitment S, M;
+    const secp256k1_pedersen_commitment *pos[1];
+    const secp256k1_pedersen_commitment *neg[1];
+
+    if (elgamal_secp256k1_as_generator(ctx, &X, &ct->X) != 1
+        || secp256k1_pedersen_commit(ctx, &S, key->d_inv, 0, &table->H, &X) != 1) {
+        return 0;
+    }
+    // M is the point at infinity, which a commitment cannot hold
+    if (elgamal_secp256k1_equal(ctx, &S, &ct->Y)) {
+        *m = 0;
+        return 1;
+    }
+
+    pos[0] = &ct->Y;
+    neg[0] = &S;
+    if (secp256k1_pedersen_commit_sum(ctx, &M, pos, 1, neg, 1) != 1) {
+        return 0;
+    }
+    return elgamal_secp256k1_dlog_solve(ctx, table, &M, m);
+}
+
+/**
+ * Aggregates n ciphertexts into one, component by component.
+ *
+ * The sum of the Y components is the Pedersen commitment to the total under
+ * the sum of the blinding factors, so it matches the aggregate commitment
+ * obtained with secp256k1_pedersen_commit_sum on the readings' commitments.
+ */
+int elgamal_secp256k1_aggregate(const secp256k1_context *ctx, elgamal_secp256k1_ciphertext_t *sum, const elgamal_secp256k1_ciphertext_t *cts, size_t n) {
+    const secp256k1_pedersen_commitment **ptrs;
+    size_t i;
+    int ok;
+
+    if (n == 0) {
+        return 0;
+    }
+    ptrs = (const secp256k1_pedersen_commitment **)malloc(2 * n * sizeof(*ptrs));
+    if (ptrs == NULL) {
+        return 0;
+    }
+    for (i = 0; i < n; i++) {
+        ptrs[i] = &cts[i].X;
+        ptrs[n + i] = &cts[i].Y;
+    }
+    ok = secp256k1_pedersen_commit_sum(ctx, &sum->X, ptrs, n, NULL, 0) == 1
+        && secp256k1_pedersen_commit_sum(ctx, &sum->Y, ptrs + n, n, NULL, 0) == 1;
+    free(ptrs);
+
+    return ok;
+}
+
+/**
+ * Builds a baby-step giant-step table for the value generator H.
+ *
+ * Given:
+ * - H: the value generator
+ * - max: the exclusive upper bound on plaintexts that must be recoverable
+ * - n_baby: the number of baby steps T, or 0 to use ceil(sqrt(max))
+ *
+ * Steps:
+ * 1. Compute the baby steps j*H for j in [1, T) by repeated addition of H.
+ * 2. Store each exponent j under the truncated x-coordinate of j*H.
+ * 3. Compute the giant-step stride T*H.
+ */
+int elgamal_secp256k1_dlog_init(const secp256k1_context *ctx, elgamal_secp256k1_dlog_t *table, const secp256k1_generator *H, uint64_t max, uint64_t n_baby) {
+    secp256k1_pedersen_commitment P, R, next;
+    const secp256k1_pedersen_commitment *pos[2];
+    unsigned char bin[ELGAMAL_SECP256K1_POINT_BYTES];
+    uint64_t j, slot, n_slots;
+    uint32_t key;
+
+    table->slots = NULL;
+    if (max == 0) {
+        return 0;
+    }
+    if (n_baby == 0) {
+        n_baby = elgamal_secp256k1_isqrt_ceil(max);
+    }
+    if (n_baby > max) {
+        n_baby = max;
+    }
+    // Exponents are stored in 32 bits
+    if (n_baby > UINT32_MAX) {
+        return 0;
+    }
+
+    // Keep the load factor at or below one half
+    for (n_slots = 1; n_slots < 2 * n_baby; n_slots <<= 1);
+
+    table->slots = (elgamal_secp256k1_entry_t *)calloc(n_slots, sizeof(*table->slots));
+    if (table->slots == NULL) {
+        return 0;
+    }
+    table->mask = n_slots - 1;
+    table->n_baby = n_baby;
+    table->n_giant = (max + n_baby - 1) / n_baby;
+    table->max = max;
+    table->H = *H;
+
+    // Compute P = 1*H and the stride T*H
+    if (secp256k1_pedersen_commit(ctx, &P, elgamal_secp256k1_zero, 1, H, &secp256k1_generator_const_g) != 1
+        || secp256k1_pedersen_commit(ctx, &table->stride, elgamal_secp256k1_zero, n_baby, H, &secp256k1_generator_const_g) != 1
+        || secp256k1_pedersen_commitment_serialize(ctx, table->stride_bin, &table->stride) != 1) {
+        elgamal_secp256k1_dlog_free(table);
+        return 0;
+    }
+
+    R = P;
+    pos[0] = &R;
+    pos[1] = &P;
+    for (j = 1; j < n_baby; j++) {
+        if (secp256k1_pedersen_commitment_serialize(ctx, bin, &R) != 1) {
+            elgamal_secp256k1_dlog_free(table);
+            return 0;
+        }
+        key = elgamal_secp256k1_key(bin);
+        for (slot = key & table->mask; table->slots[slot].value != 0; slot = (slot + 1) & table->mask);
+        table->slots[slot].key = key;
+        table->slots[slot].value = (uint32_t)j;
+
+        // Compute R = R + H; j*H never reaches infinity since T is below the order
+        if (j + 1 < n_baby) {
+            if (secp256k1_pedersen_commit_sum(ctx, &next, pos, 2, NULL, 0) != 1) {
+                elgamal_secp256k1_dlog_free(table);
+                return 0;
+            }
+            R = next;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Releases the memory held by a baby-step giant-step table.
+ */
+void elgamal_secp256k1_dlog_free(elgamal_secp256k1_dlog_t *table) {
+    free(table->slots);
+    table->slots = NULL;
+    table->mask = 0;
+    table->n_baby = 0;
+    table->n_giant = 0;
+    table->max = 0;
+}
+
+/**
+ * Solves the bounded discrete log problem M = m*H for a non-infinity M.
+ *
+ * Given:
+ * - table: a baby-step table built for H
+ * - M: the commitment whose discrete logarithm is sought
+ *
+ * Steps:
+ * 1. For i = 0, 1, ...: look up Q = M - i*T*H in the baby-step table.
+ * 2. On a key match with exponent j, accept m = i*T + j if m*H equals M.
+ * 3. If Q equals T*H, accept m = (i+1)*T.
+ *
+ * The public API of secp256k1-zkp only adds points through commitments, so
+ * every giant step costs one secp256k1_pedersen_commit_sum. Q is serialized
+ * once per step, and the lookup key and both comparisons then work on that
+ * serialization against the ones of M and T*H computed up front.
+ *
+ * Returns 1 and sets m if a solution exists in [1, max), 0 otherwise.
+ */
+int elgamal_secp256k1_dlog_solve(const secp256k1_context *ctx, const elgamal_secp256k1_dlog_t *table, const secp256k1_pedersen_commitment *M, uint64_t *m) {
+    secp256k1_pedersen_commitment Q, R, next;
+    const secp256k1_pedersen_commitment *pos[1];
+    const secp256k1_pedersen_commitment *neg[1];
+    unsigned char m_bin[ELGAMAL_SECP256K1_POINT_BYTES];
+    unsigned char q_bin[ELGAMAL_SECP256K1_POINT_BYTES];
+    unsigned char r_bin[ELGAMAL_SECP256K1_POINT_BYTES];
+    uint64_t i, slot, candidate;
+    uint32_t key;
+
+    if (table == NULL || table->slots == NULL || secp256k1_pedersen_commitment_serialize(ctx, m_bin, M) != 1) {
+        return 0;
+    }
+
+    Q = *M;
+    memcpy(q_bin, m_bin, sizeof(q_bin));
+    pos[0] = &Q;
+    neg[0] = &table->stride;
+    for (i = 0; i < table->n_giant; i++) {
+        key = elgamal_secp256k1_key(q_bin);
+        for (slot = key & table->mask; table->slots[slot].value != 0; slot = (slot + 1) & table->mask) {
+            if (table->slots[slot].key != key) {
+                continue;
+            }
+            candidate = i * table->n_baby + table->slots[slot].value;
+            if (candidate >= table->max) {
+                continue;
+            }
+            // Truncated keys collide and ignore the sign of y, so verify the match
+            if (secp256k1_pedersen_commit(ctx, &R, elgamal_secp256k1_zero, candidate, &table->H, &secp256k1_generator_const_g) == 1
+                && secp256k1_pedersen_commitment_serialize(ctx, r_bin, &R) == 1
+                && memcmp(r_bin, m_bin, sizeof(r_bin)) == 0) {
+                *m = candidate;
+                return 1;
+            }
+        }
+
+        // Q - T*H would be the point at infinity
+        if (memcmp(q_bin, table->stride_bin, sizeof(q_bin)) == 0) {
+            candidate = (i + 1) * table->n_baby;
+            if (candidate < table->max) {
+                *m = candidate;
+                return 1;
+            }
+            return 0;
+        }
+
+        // Compute Q = Q - T*H
+        if (secp256k1_pedersen_commit_sum(ctx, &next, pos, 1, neg, 1) != 1
+            || secp256k1_pedersen_commitment_serialize(ctx, q_bin, &next) != 1) {
+            return 0;
+        }
+        Q = next;
+    }
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#ifndef ELGAMAL_SECP256K1_H
+#define ELGAMAL_SECP256K1_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "secp256k1.h"
+#include "secp256k1_generator.h"
+#include "secp256k1_commitment.h"
+
+// Serialized size of commitments, generators and scalars
+#define ELGAMAL_SECP256K1_POINT_BYTES 33
+#define ELGAMAL_SECP256K1_SCALAR_BYTES 32
+
+/*
+ * A twisted ElGamal ciphertext (X, Y) = (r*B, m*H + r*G) built directly on
+ * the secp256k1-zkp group. Y is a Pedersen commitment to m with value
+ * generator H and blinding factor r, so it can be handed to the bulletproof
+ * prover and verifier as is.
+ *
+ * This variant is standalone: the ingest pipeline and the wire format carry
+ * RELIC ciphertexts linked to their commitment by a ZKPe proof, and do not
+ * use it.
+ */
+typedef struct {
+    secp256k1_pedersen_commitment X;  // Decryption handle r*B
+    secp256k1_pedersen_commitment Y;  // Pedersen commitment m*H + r*G
+} elgamal_secp256k1_ciphertext_t;
+
+/*
+ * A key pair. The public key B = d*G is kept as a generator so that it can
+ * be used as the blinding generator of secp256k1_pedersen_commit.
+ */
+typedef struct {
+    unsigned char d[ELGAMAL_SECP256K1_SCALAR_BYTES];      // Secret key d
+    unsigned char d_inv[ELGAMAL_SECP256K1_SCALAR_BYTES];  // d^-1 mod n
+    secp256k1_generator B;                                // Public key d*G
+} elgamal_secp256k1_key_t;
+
+typedef struct {
+    uint32_t key;    // Truncated x-coordinate of j*H
+    uint32_t value;  // Baby-step exponent j; 0 marks an empty slot
+} elgamal_secp256k1_entry_t;
+
+/*
+ * Baby-step giant-step table for the value generator H. Keys are derived
+ * from the serialized x-coordinate exactly as in elgamal_dlog.
+ */
+typedef struct {
+    elgamal_secp256k1_entry_t *slots;      // Open-addressing hash table of baby steps
+    uint64_t mask;                         // Number of slots minus one
+    uint64_t n_baby;                       // Baby steps T, i.e. the giant-step stride
+    uint64_t n_giant;                      // Giant steps needed to cover [0, max)
+    uint64_t max;                          // Exclusive upper bound on plaintexts
+    secp256k1_generator H;                 // Value generator the table was built for
+    secp256k1_pedersen_commitment stride;  // Giant-step stride T*H
+    unsigned char stride_bin[ELGAMAL_SECP256K1_POINT_BYTES];  // Serialized stride
+} elgamal_secp256k1_dlog_t;
+
+int elgamal_secp256k1_keygen(const secp256k1_context *ctx, elgamal_secp256k1_key_t *key, const unsigned char d[ELGAMAL_SECP256K1_SCALAR_BYTES]);
+int elgamal_secp256k1_encrypt(const secp256k1_context *ctx, elgamal_secp256k1_ciphertext_t *ct, const secp256k1_generator *B, const secp256k1_generator *H, uint64_t m, const unsigned char r[ELGAMAL_SECP256K1_SCALAR_BYTES]);
+int elgamal_secp256k1_decrypt(const secp256k1_context *ctx, const elgamal_secp256k1_dlog_t *table, const elgamal_secp256k1_key_t *key, const elgamal_secp256k1_ciphertext_t *ct, uint64_t *m);
+int elgamal_secp256k1_aggregate(const secp256k1_context *ctx, elgamal_secp256k1_ciphertext_t *sum, const elgamal_secp256k1_ciphertext_t *cts, size_t n);
+
+int elgamal_secp256k1_dlog_init(const secp256k1_context *ctx, elgamal_secp256k1_dlog_t *table, const secp256k1_generator *H, uint64_t max, uint64_t n_baby);
+void elgamal_secp256k1_dlog_free(elgamal_secp256k1_dlog_t *table);
+int elgamal_secp256k1_dlog_solve(const secp256k1_context *ctx, const elgamal_secp256k1_dlog_t *table, const secp256k1_pedersen_commitment *M, uint64_t *m);
+
+#endif // ELGAMAL_SECP256K1_H
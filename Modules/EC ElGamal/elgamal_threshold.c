@@ -0,0 +1,658 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "elgamal_threshold.h"
+#include "elgamal_dlog.h"
+#include "metrics.h"
+
+// Domain separation tag of the Fiat-Shamir challenge of partial decryptions
+#define ELGAMAL_THRESHOLD_DOMAIN "ElGamal/threshold/v1"
+
+static void elgamal_threshold_put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t elgamal_threshold_get_u32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * Serializes a point in compressed form, writing the point at infinity, which
+ * has no compressed encoding, as ELGAMAL_POINT_BYTES zero bytes.
+ */
+static void elgamal_threshold_put_point(uint8_t out[ELGAMAL_POINT_BYTES], const ec_t R) {
+    if (ec_is_infty(R)) {
+        memset(out, 0, ELGAMAL_POINT_BYTES);
+    } else {
+        ec_write_bin(out, ELGAMAL_POINT_BYTES, R, 1);
+    }
+}
+
+/**
+ * Deserializes a point written by elgamal_threshold_put_point. Encodings of
+ * points off the curve raise a RELIC error.
+ */
+static void elgamal_threshold_get_point(ec_t R, const uint8_t in[ELGAMAL_POINT_BYTES]) {
+    if (in[0] == 0) {
+        ec_set_infty(R);
+    } else {
+        ec_read_bin(R, in, ELGAMAL_POINT_BYTES);
+    }
+}
+
+/**
+ * Reads a scalar and checks that it lies in [0, n).
+ */
+static int elgamal_threshold_get_scalar(bn_t k, const uint8_t in[ELGAMAL_SCALAR_BYTES], const bn_t n) {
+    bn_read_bin(k, in, ELGAMAL_SCALAR_BYTES);
+    return bn_cmp(k, n) == RLC_LT ? RLC_OK : RLC_ERR;
+}
+
+/**
+ * Computes the Fiat-Shamir challenge
+ * e = SHA-256(domain, i, V_i, M1, D_i, A1, A2) mod n of a partial decryption.
+ */
+static void elgamal_threshold_challenge(bn_t e, uint32_t index, const ec_t V, const ec_t M1, const ec_t D, const ec_t A1, const ec_t A2, const bn_t n) {
+    uint8_t buf[sizeof(ELGAMAL_THRESHOLD_DOMAIN) - 1 + 4 + 5 * ELGAMAL_POINT_BYTES];
+    uint8_t hash[RLC_MD_LEN];
+    uint8_t *p = buf;
+
+    memcpy(p, ELGAMAL_THRESHOLD_DOMAIN, sizeof(ELGAMAL_THRESHOLD_DOMAIN) - 1);
+    p += sizeof(ELGAMAL_THRESHOLD_DOMAIN) - 1;
+    elgamal_threshold_put_u32(p, index);
+    p += 4;
+    elgamal_threshold_put_point(p, V);
+    p += ELGAMAL_POINT_BYTES;
+    elgamal_threshold_put_point(p, M1);
+    p += ELGAMAL_POINT_BYTES;
+    elgamal_threshold_put_point(p, D);
+    p += ELGAMAL_POINT_BYTES;
+    elgamal_threshold_put_point(p, A1);
+    p += ELGAMAL_POINT_BYTES;
+    elgamal_threshold_put_point(p, A2);
+
+    md_map_sh256(hash, buf, sizeof(buf));
+    bn_read_bin(e, hash, RLC_MD_LEN);
+    bn_mod(e, e, n);
+}
+
+/**
+ * Allocates a key share.
+ */
+int elgamal_share_init(elgamal_share_t *share) {
+    int result = RLC_OK;
+
+    share->index = 0;
+    bn_null(share->s);
+    ec_null(share->V);
+
+    RLC_TRY {
+        bn_new(share->s);
+        ec_new(share->V);
+        bn_zero(share->s);
+        ec_set_infty(share->V);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    return result;
+}
+
+/**
+ * Erases the secret of a key share and releases it.
+ */
+void elgamal_share_free(elgamal_share_t *share) {
+    bn_zero(share->s);
+    bn_free(share->s);
+    ec_free(share->V);
+    share->index = 0;
+}
+
+/**
+ * Serializes a key share as its big-endian index, s_i and the compressed V_i,
+ * ELGAMAL_SHARE_BYTES bytes in total. The output holds secret key material.
+ */
+int elgamal_share_write(uint8_t out[ELGAMAL_SHARE_BYTES], const elgamal_share_t *share) {
+    int result = RLC_OK;
+
+    RLC_TRY {
+        elgamal_threshold_put_u32(out, share->index);
+        bn_write_bin(out + 4, ELGAMAL_SCALAR_BYTES, share->s);
+        ec_write_bin(out + 4 + ELGAMAL_SCALAR_BYTES, ELGAMAL_POINT_BYTES, share->V, 1);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    return result;
+}
+
+/**
+ * Deserializes a key share written by elgamal_share_write into an initialized
+ * share. Shares with index 0, with s_i out of range or whose V_i differs from
+ * s_i*P are rejected.
+ */
+int elgamal_share_read(elgamal_share_t *share, const uint8_t in[ELGAMAL_SHARE_BYTES]) {
+    int result = RLC_OK;
+    bn_t n;
+    ec_t R;
+
+    // Initialize variables as null
+    bn_null(n);
+    ec_null(R);
+
+    RLC_TRY {
+        // Allocate memory for variables
+        bn_new(n);
+        ec_new(R);
+
+        ec_curve_get_ord(n);
+        share->index = elgamal_threshold_get_u32(in);
+        if (share->index == 0 || elgamal_threshold_get_scalar(share->s, in + 4, n) != RLC_OK) {
+            result = RLC_ERR;
+        } else {
+            ec_read_bin(share->V, in + 4 + ELGAMAL_SCALAR_BYTES, ELGAMAL_POINT_BYTES);
+            ec_mul_gen(R, share->s);
+            if (ec_cmp(R, share->V) != RLC_EQ) {
+                result = RLC_ERR;
+            }
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for variables
+        bn_free(n);
+        ec_free(R);
+    }
+
+    return result;
+}
+
+/**
+ * Allocates a partial decryption.
+ */
+int elgamal_partial_init(elgamal_partial_t *partial) {
+    int result = RLC_OK;
+
+    partial->index = 0;
+    ec_null(partial->D);
+    bn_null(partial->e);
+    bn_null(partial->z);
+
+    RLC_TRY {
+        ec_new(partial->D);
+        bn_new(partial->e);
+        bn_new(partial->z);
+        ec_set_infty(partial->D);
+        bn_zero(partial->e);
+        bn_zero(partial->z);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    return result;
+}
+
+/**
+ * Releases a partial decryption.
+ */
+void elgamal_partial_free(elgamal_partial_t *partial) {
+    ec_free(partial->D);
+    bn_free(partial->e);
+    bn_free(partial->z);
+}
+
+/**
+ * Serializes a partial decryption as its big-endian index, D_i, e and z,
+ * ELGAMAL_PARTIAL_BYTES bytes in total, for sending it to the combiner.
+ */
+int elgamal_partial_write(uint8_t out[ELGAMAL_PARTIAL_BYTES], const elgamal_partial_t *partial) {
+    int result = RLC_OK;
+
+    RLC_TRY {
+        elgamal_threshold_put_u32(out, partial->index);
+        elgamal_threshold_put_point(out + 4, partial->D);
+        bn_write_bin(out + 4 + ELGAMAL_POINT_BYTES, ELGAMAL_SCALAR_BYTES, partial->e);
+        bn_write_bin(out + 4 + ELGAMAL_POINT_BYTES + ELGAMAL_SCALAR_BYTES, ELGAMAL_SCALAR_BYTES, partial->z);
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    return result;
+}
+
+/**
+ * Deserializes a partial decryption written by elgamal_partial_write into an
+ * initialized partial decryption. Encodings with index 0, with D_i off the
+ * curve or with e or z out of range are rejected; the proof itself is only
+ * checked by elgamal_partial_verify.
+ */
+int elgamal_partial_read(elgamal_partial_t *partial, const uint8_t in[ELGAMAL_PARTIAL_BYTES]) {
+    int result = RLC_OK;
+    bn_t n;
+
+    // Initialize variables as null
+    bn_null(n);
+
+    RLC_TRY {
+        // Allocate memory for variables
+        bn_new(n);
+
+        ec_curve_get_ord(n);
+        partial->index = elgamal_threshold_get_u32(in);
+        elgamal_threshold_get_point(partial->D, in + 4);
+        if (partial->index == 0
+            || elgamal_threshold_get_scalar(partial->e, in + 4 + ELGAMAL_POINT_BYTES, n) != RLC_OK
+            || elgamal_threshold_get_scalar(partial->z, in + 4 + ELGAMAL_POINT_BYTES + ELGAMAL_SCALAR_BYTES, n) != RLC_OK) {
+            result = RLC_ERR;
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for variables
+        bn_free(n);
+    }
+
+    return result;
+}
+
+/**
+ * Splits an existing private key into shares (Shamir's secret sharing).
+ *
+ * Given:
+ * - s: the private key
+ * - n_shares, t: the number of shares and the number needed to decrypt,
+ *   with 1 <= t <= n_shares
+ *
+ * Steps:
+ * 1. Choose a random polynomial f(x) = s + a_1*x + ... + a_(t-1)*x^(t-1)
+ *    over the integers modulo the order of G_1.
+ * 2. For i = 1, ..., n_shares, compute s_i = f(i) and V_i = s_i*P.
+ *
+ * Any t shares determine f and therefore s, while fewer reveal nothing about
+ * s. The public key B = s*P is unchanged, so ciphertexts encrypted before
+ * the split can be decrypted through the shares. The coefficients are erased
+ * before returning; the caller should erase s and hand share i to node i.
+ */
+int elgamal_threshold_split(elgamal_share_t *shares, size_t n_shares, size_t t, const bn_t s) {
+    int result = RLC_OK;
+    bn_t n, f;
+    bn_t *a = NULL;  // Coefficients of the polynomial
+    size_t i, j;
+
+    if (t == 0 || t > n_shares || n_shares > UINT32_MAX) {
+        return RLC_ERR;
+    }
+    a = (bn_t *)malloc(t * sizeof(*a));
+    if (a == NULL) {
+        return RLC_ERR;
+    }
+
+    // Initialize variables as null
+    bn_null(n);
+    bn_null(f);
+    for (j = 0; j < t; j++) {
+        bn_null(a[j]);
+    }
+
+    RLC_TRY {
+        // Allocate memory for variables
+        bn_new(n);
+        bn_new(f);
+        for (j = 0; j < t; j++) {
+            bn_new(a[j]);
+        }
+
+        ec_curve_get_ord(n);
+
+        // Choose f with f(0) = s and random higher coefficients
+        bn_mod(a[0], s, n);
+        for (j = 1; j < t; j++) {
+            elgamal_rand_mod(a[j], n);
+        }
+
+        // Compute s_i = f(i) with Horner's rule and V_i = s_i*P
+        for (i = 0; i < n_shares; i++) {
+            bn_copy(f, a[t - 1]);
+            for (j = t - 1; j > 0; j--) {
+                bn_mul_dig(f, f, (dig_t)(i + 1));
+                bn_add(f, f, a[j - 1]);
+                bn_mod(f, f, n);
+            }
+            shares[i].index = (uint32_t)(i + 1);
+            bn_copy(shares[i].s, f);
+            ec_mul_gen(shares[i].V, f);
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Erase the coefficients and free the memory allocated for variables
+        bn_zero(f);
+        for (j = 0; j < t; j++) {
+            bn_zero(a[j]);
+            bn_free(a[j]);
+        }
+        free(a);
+        bn_free(f);
+        bn_free(n);
+    }
+
+    return result;
+}
+
+/**
+ * Threshold key generation by a trusted dealer.
+ *
+ * Generates a fresh key pair with elgamal_keygen, splits the private key with
+ * elgamal_threshold_split and erases it, so that only the shares and the
+ * public key B remain. The dealer sees s while it runs, so it should run on an
+ * offline machine.
+ */
+int elgamal_threshold_keygen(elgamal_share_t *shares, size_t n_shares, size_t t, ec_t B) {
+    int result = RLC_OK;
+    bn_t s;
+
+    // Initialize variables as null
+    bn_null(s);
+
+    RLC_TRY {
+        // Allocate memory for variables
+        bn_new(s);
+
+        if (elgamal_keygen(s, B) != RLC_OK || elgamal_threshold_split(shares, n_shares, t, s) != RLC_OK) {
+            result = RLC_ERR;
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Erase the private key and free the memory allocated for it
+        bn_zero(s);
+        bn_free(s);
+    }
+
+    return result;
+}
+
+/**
+ * Partial decryption, run by each node holding a share.
+ *
+ * Given:
+ * - share: the node's share (i, s_i, V_i)
+ * - ct: the ciphertext (M1, M2), typically an aggregate
+ *
+ * Steps:
+ * 1. Compute D_i = s_i*M1.
+ * 2. Choose a random integer w from the range of the order of G_1.
+ * 3. Compute A1 = w*P and A2 = w*M1.
+ * 4. Compute the challenge e from i, V_i, M1, D_i, A1 and A2.
+ * 5. Compute z = w + e*s_i.
+ *
+ * The proof (e, z) shows that D_i was computed with the s_i behind V_i, so a
+ * combiner can reject a faulty or dishonest node before combining. Only M1
+ * is needed, and neither s nor the plaintext is learned by the node.
+ */
+int elgamal_partial_decrypt(elgamal_partial_t *partial, const elgamal_share_t *share, const elgamal_ciphertext_t *ct) {
+    int result = RLC_OK;
+    bn_t n, w;
+    ec_t A1, A2;
+
+    // Initialize variables as null
+    bn_null(n);
+    bn_null(w);
+    ec_null(A1);
+    ec_null(A2);
+
+    RLC_TRY {
+        // Allocate memory for variables
+        bn_new(n);
+        bn_new(w);
+        ec_new(A1);
+        ec_new(A2);
+
+        ec_curve_get_ord(n);
+
+        // Compute D_i = s_i*M1 in constant time
+        elgamal_mul_secret(partial->D, ct->M1, share->s);
+
+        // Compute the commitments A1 = w*P and A2 = w*M1; w reveals s_i
+        // through z, so it is multiplied in constant time as well
+        elgamal_rand_mod(w, n);
+        ec_mul_gen(A1, w);
+        elgamal_mul_secret(A2, ct->M1, w);
+
+        // Compute the challenge e and the response z = w + e*s_i
+        elgamal_threshold_challenge(partial->e, share->index, share->V, ct->M1, partial->D, A1, A2, n);
+        bn_mul(partial->z, partial->e, share->s);
+        bn_add(partial->z, partial->z, w);
+        bn_mod(partial->z, partial->z, n);
+        partial->index = share->index;
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Erase the nonce and free the memory allocated for variables
+        bn_zero(w);
+        bn_free(w);
+        bn_free(n);
+        ec_free(A1);
+        ec_free(A2);
+    }
+
+    return result;
+}
+
+/**
+ * Checks the proof of a partial decryption against the verification key V_i
+ * of the node that produced it.
+ *
+ * Steps:
+ * 1. Compute A1 = z*P - e*V_i and A2 = z*M1 - e*D_i.
+ * 2. Recompute the challenge from i, V_i, M1, D_i, A1 and A2.
+ *
+ * Returns RLC_OK if the challenge matches e, RLC_ERR otherwise.
+ */
+int elgamal_partial_verify(const elgamal_partial_t *partial, const ec_t V, const elgamal_ciphertext_t *ct) {
+    int result = RLC_OK;
+    bn_t n, ne, e;
+    ec_t A1, A2;
+
+    // Initialize variables as null
+    bn_null(n);
+    bn_null(ne);
+    bn_null(e);
+    ec_null(A1);
+    ec_null(A2);
+
+    RLC_TRY {
+        // Allocate memory for variables
+        bn_new(n);
+        bn_new(ne);
+        bn_new(e);
+        ec_new(A1);
+        ec_new(A2);
+
+        ec_curve_get_ord(n);
+
+        // Compute -e mod n
+        if (bn_is_zero(partial->e)) {
+            bn_zero(ne);
+        } else {
+            bn_sub(ne, n, partial->e);
+        }
+
+        // Compute A1 = z*P - e*V_i and A2 = z*M1 - e*D_i
+        ec_mul_sim_gen(A1, partial->z, V, ne);
+        ec_mul_sim(A2, ct->M1, partial->z, partial->D, ne);
+
+        elgamal_threshold_challenge(e, partial->index, V, ct->M1, partial->D, A1, A2, n);
+        if (bn_cmp(e, partial->e) != RLC_EQ) {
+            result = RLC_ERR;
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for variables
+        bn_free(n);
+        bn_free(ne);
+        bn_free(e);
+        ec_free(A1);
+        ec_free(A2);
+    }
+
+    return result;
+}
+
+/**
+ * Combines partial decryptions into the plaintext.
+ *
+ * Given:
+ * - ct: the ciphertext (M1, M2) = (k*P, m*P + k*B)
+ * - partials: n >= t partial decryptions of ct with distinct indices,
+ *   each checked with elgamal_partial_verify
+ *
+ * Steps:
+ * 1. For each partial i, compute the Lagrange coefficient at zero,
+ *    l_i = product over j != i of x_j / (x_j - x_i).
+ * 2. Compute h = sum of l_i*D_i, which equals s*M1.
+ * 3. Compute M = M2 - h.
+ * 4. Recover m from M with the shared baby-step giant-step table, as in
+ *    elgamal_decrypt.
+ *
+ * The combiner holds no secret, so it can run anywhere, and any t of the
+ * nodes suffice. With fewer than t partials, or with a partial that does
+ * not verify, M is unrelated to m and the search fails with RLC_ERR except
+ * with negligible probability.
+ */
+int elgamal_threshold_combine(bn_t m, const elgamal_ciphertext_t *ct, const elgamal_partial_t *partials, size_t n) {
+    int result = RLC_OK;
+    bn_t order, num, den, d, l;
+    ec_t h, T;
+    const elgamal_dlog_t *table;  // Shared baby-step table
+    size_t i, j;
+    METRICS_BEGIN(start);
+
+    if (n == 0) {
+        return RLC_ERR;
+    }
+
+    // Initialize variables as null
+    bn_null(order);
+    bn_null(num);
+    bn_null(den);
+    bn_null(d);
+    bn_null(l);
+    ec_null(h);
+    ec_null(T);
+
+    RLC_TRY {
+        // Allocate memory for variables
+        bn_new(order);
+        bn_new(num);
+        bn_new(den);
+        bn_new(d);
+        bn_new(l);
+        ec_new(h);
+        ec_new(T);
+
+        ec_curve_get_ord(order);
+        ec_set_infty(h);
+
+        for (i = 0; i < n && result == RLC_OK; i++) {
+            // Compute the numerator and denominator of l_i
+            bn_set_dig(num, 1);
+            bn_set_dig(den, 1);
+            for (j = 0; j < n; j++) {
+                if (j == i) {
+                    continue;
+                }
+                if (partials[j].index == partials[i].index) {
+                    result = RLC_ERR;
+                    break;
+                }
+                bn_mul_dig(num, num, partials[j].index);
+                bn_mod(num, num, order);
+                // Compute x_j - x_i mod n without negative integers
+                if (partials[j].index > partials[i].index) {
+                    bn_set_dig(d, partials[j].index - partials[i].index);
+                } else {
+                    bn_set_dig(d, partials[i].index - partials[j].index);
+                    bn_sub(d, order, d);
+                }
+                bn_mul(den, den, d);
+                bn_mod(den, den, order);
+            }
+            if (result != RLC_OK) {
+                break;
+            }
+
+            // Compute l_i = num / den and accumulate h += l_i*D_i
+            bn_mod_inv(l, den, order);
+            bn_mul(l, l, num);
+            bn_mod(l, l, order);
+            elgamal_mul(T, partials[i].D, l);
+            ec_add(h, h, T);
+        }
+
+        if (result == RLC_OK) {
+            // Compute M = M2 - h, reusing T
+            ec_norm(h, h);
+            ec_sub(T, ct->M2, h);
+
+            table = elgamal_dlog_shared();
+            if (table == NULL || elgamal_dlog_solve(table, T, m) != RLC_OK) {
+                result = RLC_ERR;
+            }
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for variables
+        bn_free(order);
+        bn_free(num);
+        bn_free(den);
+        bn_free(d);
+        bn_free(l);
+        ec_free(h);
+        ec_free(T);
+    }
+
+    METRICS_END(METRICS_OP_DECRYPT, start, result == RLC_OK);
+    return result;
+}
@@ -0,0 +1,56 @@
+#ifndef ELGAMAL_THRESHOLD_H
+#define ELGAMAL_THRESHOLD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <relic.h>
+
+#include "elgamal.h"
+
+// Serialized size of a scalar modulo the group order
+#define ELGAMAL_SCALAR_BYTES RLC_FP_BYTES
+
+// Serialized sizes of a key share and of a partial decryption
+#define ELGAMAL_SHARE_BYTES (4 + ELGAMAL_SCALAR_BYTES + ELGAMAL_POINT_BYTES)
+#define ELGAMAL_PARTIAL_BYTES (4 + ELGAMAL_POINT_BYTES + 2 * ELGAMAL_SCALAR_BYTES)
+
+/*
+ * One node's share of the private key s, split t-of-n with Shamir's scheme:
+ * s_i = f(i) for a random polynomial f of degree t - 1 with f(0) = s.
+ */
+typedef struct {
+    uint32_t index;  // Evaluation point i, from 1 to n
+    bn_t s;          // Secret share s_i
+    ec_t V;          // Public verification key V_i = s_i*P
+} elgamal_share_t;
+
+/*
+ * A partial decryption D_i = s_i*M1 of one ciphertext, with a Chaum-Pedersen
+ * proof (e, z) that log_P(V_i) = log_M1(D_i).
+ */
+typedef struct {
+    uint32_t index;  // Index of the share that produced it
+    ec_t D;          // Decryption share s_i*M1
+    bn_t e;          // Challenge of the proof
+    bn_t z;          // Response w + e*s_i of the proof
+} elgamal_partial_t;
+
+int elgamal_share_init(elgamal_share_t *share);
+void elgamal_share_free(elgamal_share_t *share);
+int elgamal_share_write(uint8_t out[ELGAMAL_SHARE_BYTES], const elgamal_share_t *share);
+int elgamal_share_read(elgamal_share_t *share, const uint8_t in[ELGAMAL_SHARE_BYTES]);
+
+int elgamal_partial_init(elgamal_partial_t *partial);
+void elgamal_partial_free(elgamal_partial_t *partial);
+int elgamal_partial_write(uint8_t out[ELGAMAL_PARTIAL_BYTES], const elgamal_partial_t *partial);
+int elgamal_partial_read(elgamal_partial_t *partial, const uint8_t in[ELGAMAL_PARTIAL_BYTES]);
+
+int elgamal_threshold_split(elgamal_share_t *shares, size_t n_shares, size_t t, const bn_t s);
+int elgamal_threshold_keygen(elgamal_share_t *shares, size_t n_shares, size_t t, ec_t B);
+
+int elgamal_partial_decrypt(elgamal_partial_t *partial, const elgamal_share_t *share, const elgamal_ciphertext_t *ct);
+int elgamal_partial_verify(const elgamal_partial_t *partial, const ec_t V, const elgamal_ciphertext_t *ct);
+int elgamal_threshold_combine(bn_t m, const elgamal_ciphertext_t *ct, const elgamal_partial_t *partials, size_t n);
+
+#endif // ELGAMAL_THRESHOLD_H
@@ -0,0 +1,641 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ingest.h"
+
+/**
+ * Prepares RELIC for use on a worker thread.
+ *
+ * Returns 1 if the worker initialized its own core and must clean it up,
+ * 0 if the thread already had one, and -1 on failure.
+ */
+static int ingest_core_enter(int curve) {
+    if (core_get() != NULL) {
+        return 0;
+    }
+    if (core_init() != RLC_OK) {
+        return -1;
+    }
+    ep_param_set(curve);
+    return 1;
+}
+
+static void ingest_core_leave(int own_core) {
+    if (own_core == 1) {
+        core_clean();
+    }
+}
+
+/**
+ * Releases a reading together with the upload it was parsed from.
+ */
+static void ingest_reading_free(ingest_reading_t *reading) {
+    ingest_buffer_t *owner = reading->owner;
+
+    elgamal_ciphertext_free(&reading->ct);
+    free(reading);
+    if (atomic_fetch_sub(&owner->refs, 1) == 1) {
+        free(owner->data);
+        free(owner);
+    }
+}
+
+/**
+ * Drains a queue and drops every reading in it.
+ *
+ * A worker that lost its resources keeps consuming this way, so that the
+ * stages before it never block on a queue that nobody empties.
+ */
+static void ingest_discard(ingest_t *ingest, ingest_queue_t *queue) {
+    ingest_reading_t *reading;
+
+    atomic_store(&ingest->failed, 1);
+    while ((reading = (ingest_reading_t *)ingest_queue_pop(queue)) != NULL) {
+        atomic_fetch_add(&ingest->n_rejected, 1);
+        ingest_reading_free(reading);
+    }
+}
+
+/**
+ * Stage one: deserializes uploads into readings.
+ */
+static void *ingest_parse_worker(void *arg) {
+    ingest_t *ingest = (ingest_t *)arg;
+    ingest_reading_t *reading;
+    int own_core, ok;
+
+    own_core = ingest_core_enter(ingest->curve);
+    if (own_core < 0) {
+        ingest_discard(ingest, ingest->parse_queue);
+        return NULL;
+    }
+
+    while ((reading = (ingest_reading_t *)ingest_queue_pop(ingest->parse_queue)) != NULL) {
+        ok = ingest->config.parse(ingest->config.parse_arg, reading) == 1
+            && secp256k1_pedersen_commitment_parse(ingest->config.context->ctx, &reading->commit, reading->commit_bin) == 1;
+        if (!ok) {
+            atomic_fetch_add(&ingest->n_malformed, 1);
+            ingest_reading_free(reading);
+            continue;
+        }
+        if (!ingest_queue_push(ingest->verify_queue, reading)) {
+            ingest_reading_free(reading);
+        }
+    }
+
+    ingest_core_leave(own_core);
+    return NULL;
+}
+
+/**
+ * Stage two: verifies readings in batches.
+ *
+ * A worker blocks for the first reading of a batch and then takes whatever
+ * else is already queued, up to the batch size. Under load batches fill up
+ * and verification is amortized; when idle, single readings pass through
+ * without waiting for a batch to complete.
+ */
+static void *ingest_verify_worker(void *arg) {
+    ingest_t *ingest = (ingest_t *)arg;
+    const ingest_config_t *config = &ingest->config;
+    ingest_reading_t **readings = NULL;
+    ingest_reading_t *reading;
+    zkpe_statement_t *st = NULL;
+    zkpe_proof_t *proofs = NULL;
+    unsigned char *valid_bp = NULL;
+    unsigned char *valid_zk = NULL;
+    secp256k1_scratch_space *scratch = NULL;
+    bulletproof_batch_t *batch = NULL;
+    size_t scratch_size, n, i;
+    int own_core;
+
+    own_core = ingest_core_enter(ingest->curve);
+    if (own_core < 0) {
+        ingest_discard(ingest, ingest->verify_queue);
+        return NULL;
+    }
+
+    scratch_size = bulletproof_scratch_size(1, config->nbits, config->batch_size);
+    readings = (ingest_reading_t **)malloc(config->batch_size * sizeof(*readings));
+    st = (zkpe_statement_t *)malloc(config->batch_size * sizeof(*st));
+    proofs = (zkpe_proof_t *)malloc(config->batch_size * sizeof(*proofs));
+    valid_bp = (unsigned char *)malloc(config->batch_size);
+    valid_zk = (unsigned char *)malloc(config->batch_size);
+    scratch = secp256k1_scratch_space_create(config->context->ctx, scratch_size);
+    if (readings == NULL || st == NULL || proofs == NULL || valid_bp == NULL || valid_zk == NULL || scratch == NULL) {
+        ingest_discard(ingest, ingest->verify_queue);
+        goto done;
+    }
+    batch = bulletproof_batch_create(config->context, scratch, scratch_size, config->batch_size);
+
+    while ((reading = (ingest_reading_t *)ingest_queue_pop(ingest->verify_queue)) != NULL) {
+        n = 0;
+        readings[n++] = reading;
+        while (n < config->batch_size && (reading = (ingest_reading_t *)ingest_queue_try_pop(ingest->verify_queue)) != NULL) {
+            readings[n++] = reading;
+        }
+
+        bulletproof_batch_clear(batch);
+        for (i = 0; i < n; i++) {
+            bulletproof_batch_add(batch, readings[i]->proof, readings[i]->plen, &readings[i]->commit, 1, config->nbits, &config->value_gen);
+            st[i].B = (const ec_t *)&ingest->B;
+            st[i].ct = &readings[i]->ct;
+            st[i].H = ingest->H;
+            st[i].C = readings[i]->commit_bin;
+            st[i].customer = readings[i]->customer;
+            st[i].seq = readings[i]->seq;
+            proofs[i] = readings[i]->zkpe;
+        }
+        bulletproof_batch_verify(batch, valid_bp);
+        zkpe_verify_batch(st, proofs, n, valid_zk);
+
+        for (i = 0; i < n; i++) {
+            if (valid_bp[i] && valid_zk[i]) {
+                if (!ingest_queue_push(ingest->aggregate_queue, readings[i])) {
+                    ingest_reading_free(readings[i]);
+                }
+                continue;
+            }
+            atomic_fetch_add(&ingest->n_rejected, 1);
+            if (config->reject != NULL) {
+                config->reject(config->reject_arg, readings[i]);
+            }
+            ingest_reading_free(readings[i]);
+        }
+    }
+
+done:
+    if (batch != NULL) {
+        bulletproof_batch_destroy(batch);
+    }
+    if (scratch != NULL) {
+        secp256k1_scratch_space_destroy(scratch);
+    }
+    free(readings);
+    free(st);
+    free(proofs);
+    free(valid_bp);
+    free(valid_zk);
+    ingest_core_leave(own_core);
+    return NULL;
+}
+
+/**
+ * Writes the checkpoint images handed over by the folding worker.
+ *
+ * Only the newest image matters: one taken while an older one is still
+ * waiting replaces it. Images left when the writer is stopped are written
+ * before it exits.
+ */
+static void *ingest_checkpoint_worker(void *arg) {
+    ingest_t *ingest = (ingest_t *)arg;
+    uint8_t *image;
+    size_t len;
+
+    pthread_mutex_lock(&ingest->writer_lock);
+    for (;;) {
+        while (ingest->writer_image == NULL && !ingest->writer_stop) {
+            pthread_cond_wait(&ingest->writer_cond, &ingest->writer_lock);
+        }
+        if (ingest->writer_image == NULL) {
+            break;
+        }
+        image = ingest->writer_image;
+        len = ingest->writer_len;
+        ingest->writer_image = NULL;
+        pthread_mutex_unlock(&ingest->writer_lock);
+
+        pthread_mutex_lock(&ingest->commit_lock);
+        if (ingest_ledger_commit(ingest->config.checkpoint_path, image, len) == RLC_OK) {
+            atomic_fetch_add(&ingest->n_checkpoints, 1);
+        } else {
+            atomic_fetch_add(&ingest->n_checkpoint_failures, 1);
+        }
+        pthread_mutex_unlock(&ingest->commit_lock);
+        free(image);
+
+        pthread_mutex_lock(&ingest->writer_lock);
+    }
+    pthread_mutex_unlock(&ingest->writer_lock);
+    return NULL;
+}
+
+/**
+ * Takes a checkpoint image and hands it to the writer thread, without
+ * waiting for the disk.
+ */
+static void ingest_checkpoint_async(ingest_t *ingest) {
+    uint8_t *image;
+    size_t len;
+
+    if (ingest_ledger_snapshot(&ingest->ledger, &image, &len) != RLC_OK) {
+        atomic_fetch_add(&ingest->n_checkpoint_failures, 1);
+        return;
+    }
+    pthread_mutex_lock(&ingest->writer_lock);
+    // A newer image supersedes one the writer has not started on
+    free(ingest->writer_image);
+    ingest->writer_image = image;
+    ingest->writer_len = len;
+    pthread_cond_signal(&ingest->writer_cond);
+    pthread_mutex_unlock(&ingest->writer_lock);
+}
+
+/**
+ * Stage three: folds accepted readings into per-customer running sums,
+ * rejecting the ones the ledger has already folded.
+ *
+ * Every checkpoint_interval readings the worker also takes a checkpoint
+ * image of the sums for the writer thread.
+ */
+static void *ingest_aggregate_worker(void *arg) {
+    ingest_t *ingest = (ingest_t *)arg;
+    ingest_reading_t *reading;
+    int own_core, result;
+
+    own_core = ingest_core_enter(ingest->curve);
+    if (own_core < 0) {
+        ingest_discard(ingest, ingest->aggregate_queue);
+        return NULL;
+    }
+
+    while ((reading = (ingest_reading_t *)ingest_queue_pop(ingest->aggregate_queue)) != NULL) {
+        result = ingest_ledger_add(&ingest->ledger, reading->customer, reading->seq, &reading->ct);
+        if (result == RLC_OK) {
+            atomic_fetch_add(&ingest->n_accepted, 1);
+            if (ingest->config.checkpoint_path != NULL && ingest->config.checkpoint_interval != 0
+                && ++ingest->since_checkpoint >= ingest->config.checkpoint_interval) {
+                ingest_checkpoint_async(ingest);
+                ingest->since_checkpoint = 0;
+            }
+        } else if (result == INGEST_LEDGER_REPLAY) {
+            atomic_fetch_add(&ingest->n_replayed, 1);
+            atomic_fetch_add(&ingest->n_rejected, 1);
+            if (ingest->config.reject != NULL) {
+                ingest->config.reject(ingest->config.reject_arg, reading);
+            }
+        } else {
+            atomic_store(&ingest->failed, 1);
+            atomic_fetch_add(&ingest->n_rejected, 1);
+        }
+        ingest_reading_free(reading);
+    }
+
+    ingest_core_leave(own_core);
+    return NULL;
+}
+
+/**
+ * Initializes the locks of the checkpoint writer; returns 1 on success.
+ */
+static int ingest_writer_init(ingest_t *ingest) {
+    if (pthread_mutex_init(&ingest->writer_lock, NULL) != 0) {
+        return 0;
+    }
+    if (pthread_cond_init(&ingest->writer_cond, NULL) != 0) {
+        pthread_mutex_destroy(&ingest->writer_lock);
+        return 0;
+    }
+    if (pthread_mutex_init(&ingest->commit_lock, NULL) != 0) {
+        pthread_cond_destroy(&ingest->writer_cond);
+        pthread_mutex_destroy(&ingest->writer_lock);
+        return 0;
+    }
+    return 1;
+}
+
+ingest_t *ingest_create(const ingest_config_t *config, ec_t B) {
+    ingest_t *ingest;
+    size_t i;
+    int ok;
+
+    if (config->context == NULL || config->nbits == 0) {
+        return NULL;
+    }
+    ingest = (ingest_t *)calloc(1, sizeof(*ingest));
+    if (ingest == NULL) {
+        return NULL;
+    }
+
+    ingest->config = *config;
+    if (ingest->config.n_parsers == 0) {
+        ingest->config.n_parsers = INGEST_DEFAULT_PARSERS;
+    }
+    if (ingest->config.n_verifiers == 0) {
+        ingest->config.n_verifiers = INGEST_DEFAULT_VERIFIERS;
+    }
+    if (ingest->config.queue_capacity == 0) {
+        ingest->config.queue_capacity = INGEST_DEFAULT_QUEUE;
+    }
+    if (ingest->config.batch_size == 0) {
+        ingest->config.batch_size = INGEST_DEFAULT_BATCH;
+    }
+    if (ingest->config.parse == NULL) {
+        ingest->config.parse = ingest_parse_bundle;
+    }
+    ingest->curve = ep_param_get();
+    atomic_init(&ingest->n_submitted, 0);
+    atomic_init(&ingest->n_malformed, 0);
+    atomic_init(&ingest->n_rejected, 0);
+    atomic_init(&ingest->n_replayed, 0);
+    atomic_init(&ingest->n_accepted, 0);
+    atomic_init(&ingest->n_checkpoints, 0);
+    atomic_init(&ingest->n_checkpoint_failures, 0);
+    atomic_init(&ingest->failed, 0);
+
+    ec_null(ingest->B);
+    ok = 1;
+    RLC_TRY {
+        ec_new(ingest->B);
+        ec_copy(ingest->B, B);
+    }
+    RLC_CATCH_ANY {
+        ok = 0;
+    }
+    RLC_FINALLY {
+    }
+
+    ok = ok && secp256k1_generator_serialize(config->context->ctx, ingest->H, &config->value_gen) == 1;
+    ingest->parse_queue = ingest_queue_create(ingest->config.queue_capacity);
+    ingest->verify_queue = ingest_queue_create(ingest->config.queue_capacity);
+    ingest->aggregate_queue = ingest_queue_create(ingest->config.queue_capacity);
+    ingest->parsers = (pthread_t *)malloc(ingest->config.n_parsers * sizeof(*ingest->parsers));
+    ingest->verifiers = (pthread_t *)malloc(ingest->config.n_verifiers * sizeof(*ingest->verifiers));
+    ingest->ledger_ready = ingest_ledger_init(&ingest->ledger) == RLC_OK;
+    ingest->writer_ready = ingest_writer_init(ingest);
+    ok = ok && ingest->parse_queue != NULL && ingest->verify_queue != NULL && ingest->aggregate_queue != NULL
+        && ingest->parsers != NULL && ingest->verifiers != NULL && ingest->ledger_ready && ingest->writer_ready;
+
+    // Resume from the last checkpoint; a checkpoint that exists but does not load is an error
+    if (ok && config->checkpoint_path != NULL && access(config->checkpoint_path, F_OK) == 0) {
+        ok = ingest_ledger_load(&ingest->ledger, config->checkpoint_path) == RLC_OK;
+    }
+
+    // Start the stages back to front, so every stage has a consumer when it starts producing
+    if (ok && config->checkpoint_path != NULL && config->checkpoint_interval != 0) {
+        ok = pthread_create(&ingest->writer, NULL, ingest_checkpoint_worker, ingest) == 0;
+        ingest->writer_started = ok;
+    }
+    if (ok) {
+        ok = pthread_create(&ingest->aggregator, NULL, ingest_aggregate_worker, ingest) == 0;
+        ingest->aggregator_started = ok;
+    }
+    for (i = 0; ok && i < ingest->config.n_verifiers; i++) {
+        ok = pthread_create(&ingest->verifiers[i], NULL, ingest_verify_worker, ingest) == 0;
+        ingest->n_verifiers_started += ok;
+    }
+    for (i = 0; ok && i < ingest->config.n_parsers; i++) {
+        ok = pthread_create(&ingest->parsers[i], NULL, ingest_parse_worker, ingest) == 0;
+        ingest->n_parsers_started += ok;
+    }
+
+    if (!ok) {
+        ingest_destroy(ingest);
+        return NULL;
+    }
+    return ingest;
+}
+
+/**
+ * Allocates a reading for the bundle at buf, which lies within owner.
+ */
+static ingest_reading_t *ingest_reading_new(ingest_buffer_t *owner, const uint8_t *buf, size_t len) {
+    ingest_reading_t *reading;
+
+    reading = (ingest_reading_t *)calloc(1, sizeof(*reading));
+    if (reading == NULL) {
+        return NULL;
+    }
+    if (elgamal_ciphertext_init(&reading->ct) != RLC_OK) {
+        free(reading);
+        return NULL;
+    }
+    reading->owner = owner;
+    reading->buf = buf;
+    reading->len = len;
+    return reading;
+}
+
+/**
+ * Frees readings that were never queued, leaving their buffer to the caller.
+ */
+static void ingest_readings_discard(ingest_reading_t **readings, size_t n) {
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        if (readings[i] != NULL) {
+            elgamal_ciphertext_free(&readings[i]->ct);
+            free(readings[i]);
+        }
+    }
+}
+
+int ingest_submit(ingest_t *ingest, uint8_t *buf, size_t len) {
+    ingest_buffer_t *owner;
+    ingest_reading_t *reading;
+
+    if (ingest->finished) {
+        return 0;
+    }
+    owner = (ingest_buffer_t *)malloc(sizeof(*owner));
+    if (owner == NULL) {
+        return 0;
+    }
+    owner->data = buf;
+    atomic_init(&owner->refs, 1);
+    reading = ingest_reading_new(owner, buf, len);
+    if (reading == NULL || !ingest_queue_push(ingest->parse_queue, reading)) {
+        ingest_readings_discard(&reading, 1);
+        free(owner);
+        return 0;
+    }
+    atomic_fetch_add(&ingest->n_submitted, 1);
+    return 1;
+}
+
+size_t ingest_submit_batch(ingest_t *ingest, uint8_t *buf, size_t len) {
+    wire_batch_reader_t reader;
+    wire_bundle_t bundle;
+    ingest_buffer_t *owner;
+    ingest_reading_t **readings;
+    size_t offset, i, n;
+
+    if (ingest->finished || !wire_batch_open(&reader, buf, len)) {
+        return 0;
+    }
+    // Validate the whole batch before any bundle enters the pipeline
+    while (wire_batch_next(&reader, &bundle));
+    if (reader.index != reader.count || reader.offset != reader.len || reader.count == 0) {
+        return 0;
+    }
+    n = reader.count;
+
+    owner = (ingest_buffer_t *)malloc(sizeof(*owner));
+    readings = (ingest_reading_t **)calloc(n, sizeof(*readings));
+    if (owner == NULL || readings == NULL) {
+        free(owner);
+        free(readings);
+        return 0;
+    }
+    owner->data = buf;
+    atomic_init(&owner->refs, n);
+
+    wire_batch_open(&reader, buf, len);
+    for (i = 0; i < n; i++) {
+        offset = reader.offset;
+        wire_batch_next(&reader, &bundle);
+        readings[i] = ingest_reading_new(owner, buf + offset, reader.offset - offset);
+        if (readings[i] == NULL) {
+            ingest_readings_discard(readings, i);
+            free(readings);
+            free(owner);
+            return 0;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (!ingest_queue_push(ingest->parse_queue, readings[i])) {
+            break;
+        }
+    }
+    if (i == 0) {
+        ingest_readings_discard(readings, n);
+        free(owner);
+    } else {
+        // The queued readings own the buffer now; drop the references of the rest
+        for (n = i; i < reader.count; i++) {
+            ingest_reading_free(readings[i]);
+        }
+    }
+    free(readings);
+
+    atomic_fetch_add(&ingest->n_submitted, n);
+    return n;
+}
+
+void ingest_finish(ingest_t *ingest) {
+    size_t i;
+
+    if (ingest->finished) {
+        return;
+    }
+    ingest->finished = 1;
+
+    // Close each queue once every producer feeding it has stopped, then wait for its consumers
+    if (ingest->parse_queue != NULL) {
+        ingest_queue_close(ingest->parse_queue);
+    }
+    for (i = 0; i < ingest->n_parsers_started; i++) {
+        pthread_join(ingest->parsers[i], NULL);
+    }
+    if (ingest->verify_queue != NULL) {
+        ingest_queue_close(ingest->verify_queue);
+    }
+    for (i = 0; i < ingest->n_verifiers_started; i++) {
+        pthread_join(ingest->verifiers[i], NULL);
+    }
+    if (ingest->aggregate_queue != NULL) {
+        ingest_queue_close(ingest->aggregate_queue);
+    }
+    if (ingest->aggregator_started) {
+        pthread_join(ingest->aggregator, NULL);
+    }
+    // The writer flushes the image it still holds before it stops
+    if (ingest->writer_started) {
+        pthread_mutex_lock(&ingest->writer_lock);
+        ingest->writer_stop = 1;
+        pthread_cond_signal(&ingest->writer_cond);
+        pthread_mutex_unlock(&ingest->writer_lock);
+        pthread_join(ingest->writer, NULL);
+    }
+
+    if (ingest->ledger_ready && ingest->config.checkpoint_path != NULL && ingest->aggregator_started) {
+        ingest_checkpoint(ingest, NULL);
+    }
+}
+
+/**
+ * Frees the readings left in a queue whose consumers never started.
+ */
+static void ingest_queue_drain(ingest_queue_t *queue) {
+    ingest_reading_t *reading;
+
+    if (queue == NULL) {
+        return;
+    }
+    while ((reading = (ingest_reading_t *)ingest_queue_try_pop(queue)) != NULL) {
+        ingest_reading_free(reading);
+    }
+    ingest_queue_destroy(queue);
+}
+
+void ingest_destroy(ingest_t *ingest) {
+    if (ingest == NULL) {
+        return;
+    }
+    ingest_finish(ingest);
+
+    ingest_queue_drain(ingest->parse_queue);
+    ingest_queue_drain(ingest->verify_queue);
+    ingest_queue_drain(ingest->aggregate_queue);
+    if (ingest->ledger_ready) {
+        ingest_ledger_free(&ingest->ledger);
+    }
+    if (ingest->writer_ready) {
+        free(ingest->writer_image);
+        pthread_mutex_destroy(&ingest->commit_lock);
+        pthread_cond_destroy(&ingest->writer_cond);
+        pthread_mutex_destroy(&ingest->writer_lock);
+    }
+    ec_free(ingest->B);
+    free(ingest->parsers);
+    free(ingest->verifiers);
+    free(ingest);
+}
+
+int ingest_customer_sum(ingest_t *ingest, uint64_t customer, elgamal_ciphertext_t *sum, uint64_t *n_readings) {
+    if (!ingest->ledger_ready) {
+        return RLC_ERR;
+    }
+    return ingest_ledger_get(&ingest->ledger, customer, sum, n_readings);
+}
+
+int ingest_checkpoint(ingest_t *ingest, const char *path) {
+    int result;
+
+    if (path == NULL) {
+        path = ingest->config.checkpoint_path;
+    }
+    if (!ingest->ledger_ready || !ingest->writer_ready || path == NULL) {
+        return RLC_ERR;
+    }
+    // The writer thread writes through the same temporary file
+    pthread_mutex_lock(&ingest->commit_lock);
+    result = ingest_ledger_save(&ingest->ledger, path);
+    pthread_mutex_unlock(&ingest->commit_lock);
+    if (result == RLC_OK) {
+        atomic_fetch_add(&ingest->n_checkpoints, 1);
+    } else {
+        atomic_fetch_add(&ingest->n_checkpoint_failures, 1);
+    }
+    return result;
+}
+
+int ingest_parse_bundle(void *arg, ingest_reading_t *reading) {
+    wire_bundle_t bundle;
+
+    (void)arg;
+    if (wire_bundle_parse(&bundle, reading->buf, reading->len) != reading->len
+        || elgamal_ciphertext_read(&reading->ct, bundle.ct) != RLC_OK) {
+        return 0;
+    }
+    reading->customer = bundle.customer;
+    reading->seq = bundle.seq;
+    memcpy(reading->commit_bin, bundle.commit, ZKPE_POINT_BYTES);
+    reading->zkpe = *bundle.zkpe;
+    reading->proof = bundle.proof;
+    reading->plen = bundle.plen;
+
+    return 1;
+}
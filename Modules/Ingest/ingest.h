@@ -0,0 +1,224 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include <relic.h>
+
+#include "elgamal.h"
+#include "zkpe.h"
+#include "bulletproof_batch.h"
+#include "ingest_queue.h"
+#include "wire.h"
+#include "ingest_ledger.h"
+
+// Defaults for the fields of ingest_config_t left at zero
+#define INGEST_DEFAULT_QUEUE 4096
+#define INGEST_DEFAULT_BATCH 256
+#define INGEST_DEFAULT_PARSERS 1
+#define INGEST_DEFAULT_VERIFIERS 4
+
+/*
+ * An upload buffer shared by the readings parsed from it. It is freed when
+ * the last of them has been processed.
+ */
+typedef struct {
+    uint8_t *data;
+    atomic_size_t refs;
+} ingest_buffer_t;
+
+/*
+ * One meter reading as it moves through the pipeline. The range proof is
+ * not copied out of the upload: proof points into buf.
+ */
+typedef struct {
+    ingest_buffer_t *owner;                  // Upload buffer holding buf
+    const uint8_t *buf;                      // Bundle the reading is parsed from
+    size_t len;                              // Length of the bundle in bytes
+    uint64_t customer;                       // Customer the reading is billed to
+    uint64_t seq;                            // Meter's sequence number of the reading
+    elgamal_ciphertext_t ct;                 // Encrypted reading (M1, M2)
+    uint8_t commit_bin[ZKPE_POINT_BYTES];    // Serialized Pedersen commitment
+    secp256k1_pedersen_commitment commit;    // Parsed Pedersen commitment
+    zkpe_proof_t zkpe;                       // Equivalence of ct and commit
+    const uint8_t *proof;                    // Range proof of commit
+    size_t plen;                             // Length of the range proof in bytes
+} ingest_reading_t;
+
+/*
+ * Deserializes an upload into a reading; returns 1 on success, 0 if the
+ * upload is malformed. reading->buf and reading->len are set on entry; the
+ * parser fills every other field but commit, which the pipeline parses
+ * from commit_bin.
+ */
+typedef int (*ingest_parse_fn)(void *arg, ingest_reading_t *reading);
+
+// Called from a verification or aggregation worker for every rejected reading
+typedef void (*ingest_reject_fn)(void *arg, const ingest_reading_t *reading);
+
+typedef struct {
+    const bulletproof_context_t *context;  // Context the range proofs were made with
+    secp256k1_generator value_gen;         // Value generator H of the commitments, see bulletproof_value_gen_default
+    size_t nbits;                          // Bits proven per reading
+    size_t n_parsers;                      // Deserialization workers
+    size_t n_verifiers;                    // Verification workers
+    size_t queue_capacity;                 // Capacity of each inter-stage queue
+    size_t batch_size;                     // Readings verified together
+    ingest_parse_fn parse;                 // Upload parser, ingest_parse_bundle if NULL
+    void *parse_arg;
+    ingest_reject_fn reject;               // Optional rejection callback
+    void *reject_arg;
+    const char *checkpoint_path;           // Ledger checkpoint, resumed from if it exists; not copied
+    uint64_t checkpoint_interval;          // Readings folded between checkpoints, 0 for only at finish
+} ingest_config_t;
+
+typedef struct {
+    ingest_config_t config;
+    ec_t B;                                // Public key the readings are encrypted under
+    uint8_t H[ZKPE_POINT_BYTES];           // Serialized value generator
+    int curve;                             // RELIC curve of the creating thread
+    ingest_queue_t *parse_queue;           // Uploads awaiting deserialization
+    ingest_queue_t *verify_queue;          // Readings awaiting verification
+    ingest_queue_t *aggregate_queue;       // Accepted readings awaiting aggregation
+    pthread_t *parsers;
+    pthread_t *verifiers;
+    pthread_t aggregator;
+    size_t n_parsers_started;
+    size_t n_verifiers_started;
+    int aggregator_started;
+    ingest_ledger_t ledger;                // Per-customer running sums
+    int ledger_ready;
+    uint64_t since_checkpoint;             // Readings folded since the last periodic checkpoint
+    pthread_t writer;                      // Writes the periodic checkpoints to disk
+    int writer_started;
+    int writer_ready;                      // writer_lock and writer_cond are initialized
+    int writer_stop;
+    pthread_mutex_t writer_lock;
+    pthread_cond_t writer_cond;
+    uint8_t *writer_image;                 // Newest checkpoint image not yet written, or NULL
+    size_t writer_len;
+    pthread_mutex_t commit_lock;           // Serializes writes to the checkpoint files
+    atomic_uint_fast64_t n_submitted;
+    atomic_uint_fast64_t n_malformed;
+    atomic_uint_fast64_t n_rejected;
+    atomic_uint_fast64_t n_replayed;       // Rejected readings that were already folded
+    atomic_uint_fast64_t n_accepted;
+    atomic_uint_fast64_t n_checkpoints;
+    atomic_uint_fast64_t n_checkpoint_failures;
+    atomic_int failed;                     // Set if a worker lost its resources
+    int finished;
+} ingest_t;
+
+/**
+ * Creates and starts an ingest pipeline.
+ *
+ * An upload passes three stages connected by bounded lock-free queues:
+ * 1. Deserialization into a reading.
+ * 2. Batched verification of the range proofs with bulletproof_batch_verify
+ *    and of the ZKPe proofs with zkpe_verify_batch.
+ * 3. Folding of the accepted ciphertexts into per-customer running sums.
+ *    A reading whose customer and sequence number were already folded is
+ *    rejected as a replay (see ingest_ledger_add). Both are bound into the
+ *    ZKPe proof, which only keeps a captured bundle from being resubmitted
+ *    under another header: nothing here authenticates the meter, and anyone
+ *    holding B can make a valid bundle for any customer and sequence
+ *    number, including one far ahead that pushes the customer's genuine
+ *    readings out of the replay window. Uploads must therefore be
+ *    authenticated as coming from the customer's meter before they are
+ *    submitted.
+ *    If config->checkpoint_path is set, the sums are resumed from that
+ *    checkpoint and saved to it every checkpoint_interval readings and when
+ *    the pipeline finishes. Periodic checkpoints are taken in memory by the
+ *    folding worker and written to disk by a separate thread, so folding
+ *    never waits for the disk. A checkpoint records which sequence numbers
+ *    of each customer it covers, so after a crash the uploads since any
+ *    point before the last checkpoint can be resubmitted: readings already
+ *    in it are rejected as replays instead of being counted twice.
+ * A full queue blocks the stage feeding it, so a slow stage throttles the
+ * ones before it down to ingest_submit rather than letting buffers grow.
+ *
+ * @param config The pipeline configuration. Zero sizes select the defaults.
+ * @param B The public key the readings are encrypted under.
+ *
+ * @return A pointer to the running pipeline, or NULL on failure.
+ */
+ingest_t *ingest_create(const ingest_config_t *config, ec_t B);
+
+/**
+ * Submits an upload, waiting while the pipeline is saturated.
+ *
+ * @param ingest The pipeline.
+ * @param buf The upload, allocated with malloc. The pipeline takes
+ *            ownership and frees it once the reading has been processed.
+ * @param len The length of the upload in bytes.
+ *
+ * @return 1 if the upload was accepted for processing, 0 otherwise, in which
+ *         case the caller keeps ownership of buf.
+ */
+int ingest_submit(ingest_t *ingest, uint8_t *buf, size_t len);
+
+/**
+ * Submits a wire batch of bundles, waiting while the pipeline is saturated.
+ *
+ * The batch is validated structurally first and rejected as a whole if it
+ * is malformed. Its bundles then enter the pipeline in place: they all share
+ * buf, which is freed once the last of them has been processed.
+ *
+ * @param ingest The pipeline.
+ * @param buf The batch, allocated with malloc. The pipeline takes ownership
+ *            unless 0 is returned.
+ * @param len The length of the batch in bytes.
+ *
+ * @return The number of bundles queued.
+ */
+size_t ingest_submit_batch(ingest_t *ingest, uint8_t *buf, size_t len);
+
+/**
+ * Drains the pipeline and stops its workers. The per-customer sums can be
+ * read once this returns.
+ *
+ * @param ingest The pipeline.
+ */
+void ingest_finish(ingest_t *ingest);
+
+/**
+ * Destroys a pipeline, finishing it first if needed.
+ *
+ * @param ingest The pipeline to destroy.
+ */
+void ingest_destroy(ingest_t *ingest);
+
+/**
+ * Reads the running sum of one customer. This may be called at any time,
+ * including while readings are being folded.
+ *
+ * @param ingest The pipeline.
+ * @param customer The customer.
+ * @param sum Receives the normalized sum of the accepted ciphertexts.
+ * @param n_readings Receives the number of accepted readings, or NULL.
+ *
+ * @return RLC_OK on success, RLC_ERR if no reading of the customer was accepted.
+ */
+int ingest_customer_sum(ingest_t *ingest, uint64_t customer, elgamal_ciphertext_t *sum, uint64_t *n_readings);
+
+/**
+ * Writes a checkpoint of the per-customer sums now; see ingest_ledger_save.
+ * Unlike the periodic checkpoints, this runs on the calling thread and
+ * returns once the checkpoint is on disk.
+ *
+ * @param ingest The pipeline.
+ * @param path The checkpoint file, or NULL for config->checkpoint_path.
+ *
+ * @return RLC_OK on success, RLC_ERR otherwise.
+ */
+int ingest_checkpoint(ingest_t *ingest, const char *path);
+
+/**
+ * Parses a reading from a wire bundle; see wire_bundle_parse.
+ */
+int ingest_parse_bundle(void *arg, ingest_reading_t *reading);
+
+#endif // INGEST_H
@@ -0,0 +1,645 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "ingest_ledger.h"
+
+static void ingest_ledger_put_u64(uint8_t *p, uint64_t v) {
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+static uint64_t ingest_ledger_get_u64(const uint8_t *p) {
+    uint64_t v = 0;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/**
+ * Mixes a customer number into a well-distributed table index.
+ */
+static uint64_t ingest_ledger_hash(uint64_t customer) {
+    customer ^= customer >> 33;
+    customer *= 0xFF51AFD7ED558CCDULL;
+    customer ^= customer >> 33;
+    return customer;
+}
+
+/**
+ * Finds the account slot of a customer, or the empty slot it belongs in.
+ */
+static ingest_account_t *ingest_ledger_slot(ingest_account_t *accounts, uint64_t mask, uint64_t customer) {
+    uint64_t slot;
+
+    for (slot = ingest_ledger_hash(customer) & mask; accounts[slot].n_readings != 0; slot = (slot + 1) & mask) {
+        if (accounts[slot].customer == customer) {
+            break;
+        }
+    }
+    return &accounts[slot];
+}
+
+/**
+ * Doubles the account table, moving every account to its new slot.
+ */
+static int ingest_ledger_grow(ingest_ledger_t *ledger) {
+    uint64_t mask = 2 * ledger->mask + 1;
+    ingest_account_t *accounts;
+    uint64_t i;
+
+    accounts = (ingest_account_t *)calloc(mask + 1, sizeof(*accounts));
+    if (accounts == NULL) {
+        return RLC_ERR;
+    }
+    for (i = 0; i <= ledger->mask; i++) {
+        if (ledger->accounts[i].n_readings != 0) {
+            *ingest_ledger_slot(accounts, mask, ledger->accounts[i].customer) = ledger->accounts[i];
+        }
+    }
+    free(ledger->accounts);
+    ledger->accounts = accounts;
+    ledger->mask = mask;
+    return RLC_OK;
+}
+
+/**
+ * Returns the account of a customer, creating it with a zero sum if needed.
+ * Called with the lock held.
+ */
+static ingest_account_t *ingest_ledger_account(ingest_ledger_t *ledger, uint64_t customer) {
+    ingest_account_t *account;
+
+    // Keep the load factor at or below one half
+    if (2 * (ledger->n_accounts + 1) > ledger->mask + 1 && ingest_ledger_grow(ledger) != RLC_OK) {
+        return NULL;
+    }
+    account = ingest_ledger_slot(ledger->accounts, ledger->mask, customer);
+    if (account->n_readings == 0) {
+        if (elgamal_ciphertext_init(&account->sum) != RLC_OK) {
+            return NULL;
+        }
+        account->customer = customer;
+    }
+    return account;
+}
+
+int ingest_ledger_init(ingest_ledger_t *ledger) {
+    ledger->accounts = (ingest_account_t *)calloc(INGEST_ACCOUNTS_INIT, sizeof(*ledger->accounts));
+    if (ledger->accounts == NULL) {
+        return RLC_ERR;
+    }
+    if (pthread_mutex_init(&ledger->lock, NULL) != 0) {
+        free(ledger->accounts);
+        ledger->accounts = NULL;
+        return RLC_ERR;
+    }
+    ledger->mask = INGEST_ACCOUNTS_INIT - 1;
+    ledger->n_accounts = 0;
+    ledger->n_readings = 0;
+    return RLC_OK;
+}
+
+/**
+ * Frees every account and empties the table without shrinking it.
+ */
+static void ingest_ledger_clear(ingest_ledger_t *ledger) {
+    uint64_t i;
+
+    for (i = 0; i <= ledger->mask; i++) {
+        if (ledger->accounts[i].n_readings != 0) {
+            elgamal_ciphertext_free(&ledger->accounts[i].sum);
+        }
+    }
+    memset(ledger->accounts, 0, (ledger->mask + 1) * sizeof(*ledger->accounts));
+    ledger->n_accounts = 0;
+    ledger->n_readings = 0;
+}
+
+void ingest_ledger_free(ingest_ledger_t *ledger) {
+    if (ledger->accounts == NULL) {
+        return;
+    }
+    ingest_ledger_clear(ledger);
+    pthread_mutex_destroy(&ledger->lock);
+    free(ledger->accounts);
+    ledger->accounts = NULL;
+}
+
+/**
+ * Checks whether an account already folded the reading with sequence number
+ * seq, or can no longer tell because seq fell out of the window.
+ */
+static int ingest_ledger_seen(const ingest_account_t *account, uint64_t seq) {
+    uint64_t bit = seq % INGEST_LEDGER_WINDOW;
+
+    if (account->n_readings == 0 || seq > account->seq) {
+        return 0;
+    }
+    if (account->seq - seq >= INGEST_LEDGER_WINDOW) {
+        return 1;
+    }
+    return (account->seen[bit / 64] >> (bit % 64)) & 1;
+}
+
+/**
+ * Records that an account folded the reading with sequence number seq,
+ * sliding the window forward if seq is the newest one.
+ */
+static void ingest_ledger_mark(ingest_account_t *account, uint64_t seq) {
+    uint64_t bit, s;
+
+    if (account->n_readings == 0 || (seq > account->seq && seq - account->seq >= INGEST_LEDGER_WINDOW)) {
+        memset(account->seen, 0, sizeof(account->seen));
+        account->seq = seq;
+    } else if (seq > account->seq) {
+        // Forget the numbers the window slides past
+        for (s = account->seq + 1; s <= seq; s++) {
+            bit = s % INGEST_LEDGER_WINDOW;
+            account->seen[bit / 64] &= ~((uint64_t)1 << (bit % 64));
+        }
+        account->seq = seq;
+    }
+    bit = seq % INGEST_LEDGER_WINDOW;
+    account->seen[bit / 64] |= (uint64_t)1 << (bit % 64);
+}
+
+int ingest_ledger_add(ingest_ledger_t *ledger, uint64_t customer, uint64_t seq, const elgamal_ciphertext_t *ct) {
+    int result = RLC_OK;
+    ingest_account_t *account;
+
+    pthread_mutex_lock(&ledger->lock);
+    account = ingest_ledger_account(ledger, customer);
+    if (account == NULL) {
+        pthread_mutex_unlock(&ledger->lock);
+        return RLC_ERR;
+    }
+    if (ingest_ledger_seen(account, seq)) {
+        pthread_mutex_unlock(&ledger->lock);
+        return INGEST_LEDGER_REPLAY;
+    }
+
+    RLC_TRY {
+        if (account->n_readings == 0) {
+            ec_copy(account->sum.M1, ct->M1);
+            ec_copy(account->sum.M2, ct->M2);
+            ledger->n_accounts++;
+        } else {
+            ec_add(account->sum.M1, account->sum.M1, ct->M1);
+            ec_add(account->sum.M2, account->sum.M2, ct->M2);
+        }
+        ingest_ledger_mark(account, seq);
+        account->n_readings++;
+        ledger->n_readings++;
+    }
+
+    RLC_CATCH_ANY {
+        if (account->n_readings == 0) {
+            elgamal_ciphertext_free(&account->sum);
+        }
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+    }
+
+    pthread_mutex_unlock(&ledger->lock);
+    return result;
+}
+
+int ingest_ledger_get(ingest_ledger_t *ledger, uint64_t customer, elgamal_ciphertext_t *sum, uint64_t *n_readings) {
+    const ingest_account_t *account;
+    int result = RLC_OK;
+
+    pthread_mutex_lock(&ledger->lock);
+    account = ingest_ledger_slot(ledger->accounts, ledger->mask, customer);
+    if (account->n_readings == 0) {
+        pthread_mutex_unlock(&ledger->lock);
+        return RLC_ERR;
+    }
+
+    RLC_TRY {
+        ec_norm(sum->M1, account->sum.M1);
+        ec_norm(sum->M2, account->sum.M2);
+        if (n_readings != NULL) {
+            *n_readings = account->n_readings;
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+    }
+
+    pthread_mutex_unlock(&ledger->lock);
+    return result;
+}
+
+/*
+ * A chunk of accounts with their sums normalized, as produced by
+ * ingest_ledger_chunks.
+ */
+typedef struct {
+    const ingest_account_t *account[INGEST_LEDGER_CHUNK];
+    elgamal_ciphertext_t sum[INGEST_LEDGER_CHUNK];
+    size_t n;
+} ingest_ledger_chunk_t;
+
+typedef void (*ingest_ledger_chunk_fn)(void *arg, const ingest_ledger_chunk_t *chunk);
+
+/**
+ * Normalizes a full or final chunk in place.
+ *
+ * The points at infinity are left out of the simultaneous inversion, which
+ * cannot handle them; the others are normalized with a single inversion.
+ */
+static void ingest_ledger_normalize(ingest_ledger_chunk_t *chunk, ec_t *P) {
+    size_t i, n = 0;
+
+    for (i = 0; i < chunk->n; i++) {
+        if (!ec_is_infty(chunk->sum[i].M1)) {
+            ec_copy(P[n++], chunk->sum[i].M1);
+        }
+        if (!ec_is_infty(chunk->sum[i].M2)) {
+            ec_copy(P[n++], chunk->sum[i].M2);
+        }
+    }
+    ep_norm_sim(P, (const ep_t *)P, (int)n);
+    for (i = 0, n = 0; i < chunk->n; i++) {
+        if (!ec_is_infty(chunk->sum[i].M1)) {
+            ec_copy(chunk->sum[i].M1, P[n++]);
+        }
+        if (!ec_is_infty(chunk->sum[i].M2)) {
+            ec_copy(chunk->sum[i].M2, P[n++]);
+        }
+    }
+}
+
+/**
+ * Hands every account to fn, a chunk of normalized sums at a time. Called
+ * with the lock held.
+ */
+static int ingest_ledger_chunks(ingest_ledger_t *ledger, ingest_ledger_chunk_fn fn, void *arg) {
+    int result = RLC_OK;
+    ingest_ledger_chunk_t *chunk;
+    ec_t *P;
+    uint64_t slot;
+    size_t i;
+
+    chunk = (ingest_ledger_chunk_t *)malloc(sizeof(*chunk));
+    P = (ec_t *)malloc(2 * INGEST_LEDGER_CHUNK * sizeof(*P));
+    if (chunk == NULL || P == NULL) {
+        free(chunk);
+        free(P);
+        return RLC_ERR;
+    }
+
+    // Initialize variables as null
+    for (i = 0; i < INGEST_LEDGER_CHUNK; i++) {
+        ec_null(chunk->sum[i].M1);
+        ec_null(chunk->sum[i].M2);
+        ec_null(P[2 * i]);
+        ec_null(P[2 * i + 1]);
+    }
+
+    RLC_TRY {
+        // Allocate memory for variables
+        for (i = 0; i < INGEST_LEDGER_CHUNK; i++) {
+            ec_new(chunk->sum[i].M1);
+            ec_new(chunk->sum[i].M2);
+            ec_new(P[2 * i]);
+            ec_new(P[2 * i + 1]);
+        }
+
+        chunk->n = 0;
+        for (slot = 0; slot <= ledger->mask; slot++) {
+            const ingest_account_t *account = &ledger->accounts[slot];
+
+            if (account->n_readings == 0) {
+                continue;
+            }
+            chunk->account[chunk->n] = account;
+            ec_copy(chunk->sum[chunk->n].M1, account->sum.M1);
+            ec_copy(chunk->sum[chunk->n].M2, account->sum.M2);
+            if (++chunk->n == INGEST_LEDGER_CHUNK) {
+                ingest_ledger_normalize(chunk, P);
+                fn(arg, chunk);
+                chunk->n = 0;
+            }
+        }
+        if (chunk->n > 0) {
+            ingest_ledger_normalize(chunk, P);
+            fn(arg, chunk);
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        for (i = 0; i < INGEST_LEDGER_CHUNK; i++) {
+            ec_free(chunk->sum[i].M1);
+            ec_free(chunk->sum[i].M2);
+            ec_free(P[2 * i]);
+            ec_free(P[2 * i + 1]);
+        }
+    }
+
+    free(chunk);
+    free(P);
+    return result;
+}
+
+typedef struct {
+    ingest_ledger_fn fn;
+    void *arg;
+} ingest_ledger_visit_t;
+
+static void ingest_ledger_visit(void *arg, const ingest_ledger_chunk_t *chunk) {
+    ingest_ledger_visit_t *visit = (ingest_ledger_visit_t *)arg;
+    size_t i;
+
+    for (i = 0; i < chunk->n; i++) {
+        visit->fn(visit->arg, chunk->account[i]->customer, chunk->account[i]->n_readings, &chunk->sum[i]);
+    }
+}
+
+int ingest_ledger_foreach(ingest_ledger_t *ledger, ingest_ledger_fn fn, void *arg) {
+    ingest_ledger_visit_t visit = { fn, arg };
+    int result;
+
+    pthread_mutex_lock(&ledger->lock);
+    result = ingest_ledger_chunks(ledger, ingest_ledger_visit, &visit);
+    pthread_mutex_unlock(&ledger->lock);
+    return result;
+}
+
+/**
+ * Writes a normalized point, or 33 zero bytes for the point at infinity.
+ */
+static void ingest_ledger_write_point(uint8_t out[ELGAMAL_POINT_BYTES], const ec_t P) {
+    if (ec_is_infty(P)) {
+        memset(out, 0, ELGAMAL_POINT_BYTES);
+    } else {
+        ec_write_bin(out, ELGAMAL_POINT_BYTES, P, 1);
+    }
+}
+
+static void ingest_ledger_read_point(ec_t P, const uint8_t in[ELGAMAL_POINT_BYTES]) {
+    static const uint8_t zero[ELGAMAL_POINT_BYTES];
+
+    if (memcmp(in, zero, ELGAMAL_POINT_BYTES) == 0) {
+        ec_set_infty(P);
+    } else {
+        ec_read_bin(P, in, ELGAMAL_POINT_BYTES);
+    }
+}
+
+static void ingest_ledger_serialize(void *arg, const ingest_ledger_chunk_t *chunk) {
+    uint8_t **p = (uint8_t **)arg;
+
+    uint8_t *q;
+    size_t i, j;
+
+    for (i = 0; i < chunk->n; i++) {
+        q = *p;
+        ingest_ledger_put_u64(q, chunk->account[i]->customer);
+        ingest_ledger_put_u64(q + 8, chunk->account[i]->n_readings);
+        ingest_ledger_put_u64(q + 16, chunk->account[i]->seq);
+        q += 24;
+        for (j = 0; j < INGEST_LEDGER_WINDOW / 64; j++, q += 8) {
+            ingest_ledger_put_u64(q, chunk->account[i]->seen[j]);
+        }
+        ingest_ledger_write_point(q, chunk->sum[i].M1);
+        ingest_ledger_write_point(q + ELGAMAL_POINT_BYTES, chunk->sum[i].M2);
+        *p += INGEST_LEDGER_RECORD;
+    }
+}
+
+/**
+ * Syncs the directory holding path, so that a rename into it survives a
+ * power loss.
+ */
+static int ingest_ledger_sync_dir(const char *path) {
+    const char *slash = strrchr(path, '/');
+    size_t dlen;
+    char *dir;
+    int fd, ok;
+
+    if (slash == NULL) {
+        path = ".";
+        dlen = 1;
+    } else {
+        dlen = slash == path ? 1 : (size_t)(slash - path);
+    }
+    dir = (char *)malloc(dlen + 1);
+    if (dir == NULL) {
+        return 0;
+    }
+    memcpy(dir, path, dlen);
+    dir[dlen] = '\0';
+
+    fd = open(dir, O_RDONLY | O_DIRECTORY);
+    ok = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0) {
+        ok = close(fd) == 0 && ok;
+    }
+    free(dir);
+    return ok;
+}
+
+int ingest_ledger_commit(const char *path, const uint8_t *image, size_t len) {
+    size_t plen = strlen(path);
+    char *tmp;
+    FILE *file;
+    int ok;
+
+    tmp = (char *)malloc(plen + sizeof(".tmp"));
+    if (tmp == NULL) {
+        return RLC_ERR;
+    }
+    memcpy(tmp, path, plen);
+    memcpy(tmp + plen, ".tmp", sizeof(".tmp"));
+
+    file = fopen(tmp, "wb");
+    ok = file != NULL;
+    if (ok) {
+        ok = fwrite(image, 1, len, file) == len && fflush(file) == 0 && fsync(fileno(file)) == 0;
+        ok = fclose(file) == 0 && ok;
+    }
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok) {
+        remove(tmp);
+    }
+    ok = ok && ingest_ledger_sync_dir(path);
+
+    free(tmp);
+    return ok ? RLC_OK : RLC_ERR;
+}
+
+int ingest_ledger_snapshot(ingest_ledger_t *ledger, uint8_t **out, size_t *out_len) {
+    uint8_t *image, *p;
+    size_t len;
+    int result;
+
+    pthread_mutex_lock(&ledger->lock);
+    len = INGEST_LEDGER_HEADER + ledger->n_accounts * INGEST_LEDGER_RECORD + INGEST_LEDGER_DIGEST;
+    image = (uint8_t *)malloc(len);
+    if (image == NULL) {
+        pthread_mutex_unlock(&ledger->lock);
+        return RLC_ERR;
+    }
+    memcpy(image, INGEST_LEDGER_MAGIC, 8);
+    image[8] = 0;
+    image[9] = 0;
+    image[10] = 0;
+    image[11] = INGEST_LEDGER_VERSION;
+    memset(image + 12, 0, 4);
+    ingest_ledger_put_u64(image + 16, ledger->n_accounts);
+    ingest_ledger_put_u64(image + 24, ledger->n_readings);
+    p = image + INGEST_LEDGER_HEADER;
+    result = ingest_ledger_chunks(ledger, ingest_ledger_serialize, &p);
+    pthread_mutex_unlock(&ledger->lock);
+
+    if (result != RLC_OK) {
+        free(image);
+        return result;
+    }
+    md_map_sh256(image + len - INGEST_LEDGER_DIGEST, image, len - INGEST_LEDGER_DIGEST);
+    *out = image;
+    *out_len = len;
+    return RLC_OK;
+}
+
+int ingest_ledger_save(ingest_ledger_t *ledger, const char *path) {
+    uint8_t *image;
+    size_t len;
+    int result;
+
+    result = ingest_ledger_snapshot(ledger, &image, &len);
+    if (result == RLC_OK) {
+        result = ingest_ledger_commit(path, image, len);
+        free(image);
+    }
+    return result;
+}
+
+/**
+ * Reads a whole file into memory; returns NULL if it cannot be read.
+ */
+static uint8_t *ingest_ledger_read_file(const char *path, size_t *len) {
+    uint8_t *image = NULL;
+    FILE *file;
+    long size;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        image = (uint8_t *)malloc(size > 0 ? (size_t)size : 1);
+        if (image != NULL && fread(image, 1, (size_t)size, file) != (size_t)size) {
+            free(image);
+            image = NULL;
+        }
+        *len = (size_t)size;
+    }
+    fclose(file);
+    return image;
+}
+
+int ingest_ledger_load(ingest_ledger_t *ledger, const char *path) {
+    int result = RLC_OK;
+    uint8_t digest[INGEST_LEDGER_DIGEST];
+    uint64_t n_accounts, n_readings, total = 0, i = 0;
+    ingest_account_t *account = NULL;
+    const uint8_t *p, *q;
+    uint8_t *image;
+    size_t len, j;
+
+    image = ingest_ledger_read_file(path, &len);
+    if (image == NULL) {
+        return RLC_ERR;
+    }
+    if (len < INGEST_LEDGER_HEADER + INGEST_LEDGER_DIGEST || memcmp(image, INGEST_LEDGER_MAGIC, 8) != 0
+        || image[8] != 0 || image[9] != 0 || image[10] != 0 || image[11] != INGEST_LEDGER_VERSION) {
+        free(image);
+        return RLC_ERR;
+    }
+    n_accounts = ingest_ledger_get_u64(image + 16);
+    n_readings = ingest_ledger_get_u64(image + 24);
+    md_map_sh256(digest, image, len - INGEST_LEDGER_DIGEST);
+    if (n_accounts > (len - INGEST_LEDGER_HEADER - INGEST_LEDGER_DIGEST) / INGEST_LEDGER_RECORD
+        || len != INGEST_LEDGER_HEADER + n_accounts * INGEST_LEDGER_RECORD + INGEST_LEDGER_DIGEST
+        || memcmp(digest, image + len - INGEST_LEDGER_DIGEST, INGEST_LEDGER_DIGEST) != 0) {
+        free(image);
+        return RLC_ERR;
+    }
+
+    pthread_mutex_lock(&ledger->lock);
+    if (ledger->n_accounts != 0) {
+        pthread_mutex_unlock(&ledger->lock);
+        free(image);
+        return RLC_ERR;
+    }
+
+    RLC_TRY {
+        for (i = 0, p = image + INGEST_LEDGER_HEADER; i < n_accounts; i++, p += INGEST_LEDGER_RECORD) {
+            uint64_t customer = ingest_ledger_get_u64(p);
+            uint64_t count = ingest_ledger_get_u64(p + 8);
+
+            account = ingest_ledger_account(ledger, customer);
+            // Every account holds at least one reading and appears once
+            if (account == NULL || count == 0 || account->n_readings != 0) {
+                result = RLC_ERR;
+                break;
+            }
+            account->seq = ingest_ledger_get_u64(p + 16);
+            for (j = 0, q = p + 24; j < INGEST_LEDGER_WINDOW / 64; j++, q += 8) {
+                account->seen[j] = ingest_ledger_get_u64(q);
+            }
+            ingest_ledger_read_point(account->sum.M1, q);
+            ingest_ledger_read_point(account->sum.M2, q + ELGAMAL_POINT_BYTES);
+            account->n_readings = count;
+            ledger->n_accounts++;
+            total += count;
+        }
+    }
+
+    RLC_CATCH_ANY {
+        // Raised for points that are not on the curve
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+    }
+
+    if (result == RLC_OK && total != n_readings) {
+        result = RLC_ERR;
+    }
+    if (result == RLC_OK) {
+        ledger->n_readings = n_readings;
+    } else {
+        // An account created for a bad record holds an initialized sum but no readings
+        if (account != NULL && account->n_readings == 0 && i < n_accounts) {
+            elgamal_ciphertext_free(&account->sum);
+        }
+        ingest_ledger_clear(ledger);
+    }
+    pthread_mutex_unlock(&ledger->lock);
+
+    free(image);
+    return result;
+}
@@ -0,0 +1,166 @@
+#ifndef INGEST_LEDGER_H
+#define INGEST_LEDGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include <relic.h>
+
+#include "elgamal.h"
+
+// Initial number of account slots
+#define INGEST_ACCOUNTS_INIT 1024
+
+// Accounts normalized together, with one inversion, while checkpointing
+#define INGEST_LEDGER_CHUNK 512
+
+// Sequence numbers behind the newest folded one that are still tracked per
+// account, a multiple of 64
+#define INGEST_LEDGER_WINDOW 256
+
+// Returned by ingest_ledger_add for a reading that was already folded
+#define INGEST_LEDGER_REPLAY 2
+
+/*
+ * Checkpoint layout, all integers big-endian:
+ *   0   magic          8 bytes, INGEST_LEDGER_MAGIC
+ *   8   version        4 bytes
+ *   12  reserved       4 bytes, zero
+ *   16  n_accounts     8 bytes
+ *   24  n_readings     8 bytes, readings folded into all accounts
+ *   32  accounts       n_accounts records of INGEST_LEDGER_RECORD bytes:
+ *                      customer (8), n_readings (8), seq (8), the window of
+ *                      folded sequence numbers (INGEST_LEDGER_WINDOW / 8, as
+ *                      big-endian 64-bit words), M1 and M2 (2 x 33)
+ *   ... digest         32 bytes, SHA-256 of everything before it
+ * A point at infinity is written as 33 zero bytes.
+ */
+#define INGEST_LEDGER_MAGIC "SMLEDGER"
+#define INGEST_LEDGER_VERSION 2
+#define INGEST_LEDGER_HEADER 32
+#define INGEST_LEDGER_RECORD (24 + INGEST_LEDGER_WINDOW / 8 + ELGAMAL_CIPHERTEXT_BYTES)
+#define INGEST_LEDGER_DIGEST 32
+
+typedef struct {
+    uint64_t customer;
+    uint64_t n_readings;                   // 0 marks an unused account
+    elgamal_ciphertext_t sum;              // Running sum in projective coordinates
+    uint64_t seq;                          // Newest sequence number folded
+    uint64_t seen[INGEST_LEDGER_WINDOW / 64];  // Folded sequence numbers, bit seq % INGEST_LEDGER_WINDOW
+} ingest_account_t;
+
+/*
+ * Running encrypted balances keyed by customer. The lock makes the ledger
+ * safe to read and checkpoint while a writer keeps folding readings into it.
+ */
+typedef struct {
+    ingest_account_t *accounts;            // Open-addressing table
+    uint64_t mask;                         // Number of slots minus one
+    uint64_t n_accounts;
+    uint64_t n_readings;                   // Readings folded into all accounts
+    pthread_mutex_t lock;
+} ingest_ledger_t;
+
+// Called by ingest_ledger_foreach with a normalized sum
+typedef void (*ingest_ledger_fn)(void *arg, uint64_t customer, uint64_t n_readings, const elgamal_ciphertext_t *sum);
+
+/**
+ * Initializes an empty ledger.
+ *
+ * @return RLC_OK on success, RLC_ERR if memory allocation fails.
+ */
+int ingest_ledger_init(ingest_ledger_t *ledger);
+
+/**
+ * Frees a ledger and every running sum in it.
+ */
+void ingest_ledger_free(ingest_ledger_t *ledger);
+
+/**
+ * Folds a ciphertext into the running sum of its customer.
+ *
+ * Sums stay in projective coordinates, as in elgamal_aggregate, so folding
+ * a reading costs two point additions and no inversion.
+ *
+ * Every account remembers which of the INGEST_LEDGER_WINDOW sequence numbers
+ * up to the newest one it folded, so that a resubmitted or replayed reading
+ * is not counted twice. Readings may arrive out of order within the window;
+ * older ones are rejected as replays, since they can no longer be told apart
+ * from them. Any sequence number newer than the window slides it forward,
+ * so seq must come from an authenticated upload.
+ *
+ * @return RLC_OK on success, INGEST_LEDGER_REPLAY if the customer's reading
+ *         with this sequence number was already folded or is older than the
+ *         window, RLC_ERR if memory allocation fails.
+ */
+int ingest_ledger_add(ingest_ledger_t *ledger, uint64_t customer, uint64_t seq, const elgamal_ciphertext_t *ct);
+
+/**
+ * Reads the running sum of one customer.
+ *
+ * @param sum Receives the normalized sum.
+ * @param n_readings Receives the number of readings folded into it, or NULL.
+ *
+ * @return RLC_OK on success, RLC_ERR if the customer has no account.
+ */
+int ingest_ledger_get(ingest_ledger_t *ledger, uint64_t customer, elgamal_ciphertext_t *sum, uint64_t *n_readings);
+
+/**
+ * Calls fn for every account, for example to bill a cycle at its close.
+ *
+ * The accounts are visited in table order with their sums normalized a
+ * chunk at a time. fn runs with the ledger locked and must not call back
+ * into it.
+ *
+ * @return RLC_OK on success, RLC_ERR on a RELIC error.
+ */
+int ingest_ledger_foreach(ingest_ledger_t *ledger, ingest_ledger_fn fn, void *arg);
+
+/**
+ * Takes a checkpoint image of the ledger.
+ *
+ * The sums are normalized and compressed under the lock into a memory image
+ * in the checkpoint layout, digest included. Folding only waits for this
+ * step; the image is written out separately with ingest_ledger_commit.
+ *
+ * @param image Receives the image, allocated with malloc.
+ * @param len Receives the length of the image in bytes.
+ *
+ * @return RLC_OK on success, RLC_ERR otherwise.
+ */
+int ingest_ledger_snapshot(ingest_ledger_t *ledger, uint8_t **image, size_t *len);
+
+/**
+ * Writes a checkpoint image to path.tmp, syncs it to disk, renames it over
+ * path and syncs the directory, so that path always holds a complete
+ * checkpoint, the new one once this returns RLC_OK. The ledger is not
+ * involved, so this may run on any thread while folding goes on.
+ *
+ * @return RLC_OK on success, RLC_ERR otherwise.
+ */
+int ingest_ledger_commit(const char *path, const uint8_t *image, size_t len);
+
+/**
+ * Writes a checkpoint of the ledger: ingest_ledger_snapshot followed by
+ * ingest_ledger_commit.
+ *
+ * @return RLC_OK on success, RLC_ERR otherwise.
+ */
+int ingest_ledger_save(ingest_ledger_t *ledger, const char *path);
+
+/**
+ * Restores an empty ledger from a checkpoint written by ingest_ledger_save.
+ *
+ * The header, length and digest are checked before anything is restored,
+ * and every point when it is decoded. A checkpoint that fails any check
+ * leaves the ledger empty. The windows of folded sequence numbers are
+ * restored with the sums, so readings already in the checkpoint are
+ * rejected as replays when they are submitted again.
+ *
+ * @return RLC_OK on success, RLC_ERR if the file is missing, truncated or
+ *         corrupt, or the ledger is not empty.
+ */
+int ingest_ledger_load(ingest_ledger_t *ledger, const char *path);
+
+#endif // INGEST_LEDGER_H
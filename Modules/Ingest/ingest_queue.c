@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <sched.h>
+#include <time.h>
+
+#include "ingest_queue.h"
+
+ingest_queue_t *ingest_queue_create(size_t capacity) {
+    ingest_queue_t *queue;
+    size_t size, i;
+
+    // Two cells at least, so that a full and an empty cell never share a sequence number
+    for (size = 2; size < capacity; size <<= 1);
+
+    queue = (ingest_queue_t *)aligned_alloc(INGEST_CACHE_LINE, sizeof(*queue));
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->cells = (ingest_cell_t *)malloc(size * sizeof(*queue->cells));
+    if (queue->cells == NULL) {
+        free(queue);
+        return NULL;
+    }
+    for (i = 0; i < size; i++) {
+        atomic_init(&queue->cells[i].seq, i);
+        queue->cells[i].item = NULL;
+    }
+    queue->mask = size - 1;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->closed, 0);
+
+    return queue;
+}
+
+void ingest_queue_destroy(ingest_queue_t *queue) {
+    if (queue == NULL) {
+        return;
+    }
+    free(queue->cells);
+    free(queue);
+}
+
+int ingest_queue_try_push(ingest_queue_t *queue, void *item) {
+    ingest_cell_t *cell;
+    size_t pos, seq;
+    intptr_t diff;
+
+    pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            // The cell is free for this position; claim it
+            if (atomic_compare_exchange_weak_explicit(&queue->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The cell still holds the item from one lap ago
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        }
+    }
+    cell->item = item;
+    // Publish the item to the consumer of this position
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+
+    return 1;
+}
+
+void *ingest_queue_try_pop(ingest_queue_t *queue) {
+    ingest_cell_t *cell;
+    size_t pos, seq;
+    intptr_t diff;
+    void *item;
+
+    pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            // The cell is full for this position; claim it
+            if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // No producer has filled this position yet
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
+    }
+    item = cell->item;
+    // Hand the cell back to the producer of the next lap
+    atomic_store_explicit(&cell->seq, pos + queue->mask + 1, memory_order_release);
+
+    return item;
+}
+
+/**
+ * Backs off after a failed attempt: spins with yields first, then sleeps.
+ */
+static void ingest_queue_backoff(unsigned *attempts) {
+    struct timespec ts;
+
+    if (*attempts < INGEST_QUEUE_SPINS) {
+        (*attempts)++;
+        sched_yield();
+        return;
+    }
+    ts.tv_sec = 0;
+    ts.tv_nsec = INGEST_QUEUE_SLEEP_NS;
+    nanosleep(&ts, NULL);
+}
+
+int ingest_queue_push(ingest_queue_t *queue, void *item) {
+    unsigned attempts = 0;
+
+    while (!atomic_load_explicit(&queue->closed, memory_order_acquire)) {
+        if (ingest_queue_try_push(queue, item)) {
+            return 1;
+        }
+        ingest_queue_backoff(&attempts);
+    }
+    return 0;
+}
+
+void *ingest_queue_pop(ingest_queue_t *queue) {
+    unsigned attempts = 0;
+    void *item;
+
+    for (;;) {
+        if ((item = ingest_queue_try_pop(queue)) != NULL) {
+            return item;
+        }
+        if (atomic_load_explicit(&queue->closed, memory_order_acquire)) {
+            // Items pushed before the close are visible now; drain them first
+            return ingest_queue_try_pop(queue);
+        }
+        ingest_queue_backoff(&attempts);
+    }
+}
+
+void ingest_queue_close(ingest_queue_t *queue) {
+    atomic_store_explicit(&queue->closed, 1, memory_order_release);
+}
@@ -0,0 +1,92 @@
+#ifndef INGEST_QUEUE_H
+#define INGEST_QUEUE_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Cache line size used to keep the producer and consumer indices apart
+#define INGEST_CACHE_LINE 64
+
+// Failed attempts before a blocking push or pop starts sleeping
+#define INGEST_QUEUE_SPINS 64
+
+// Sleep between attempts of a blocking push or pop, in nanoseconds
+#define INGEST_QUEUE_SLEEP_NS 50000
+
+typedef struct {
+    atomic_size_t seq;  // Position this cell is ready for
+    void *item;
+} ingest_cell_t;
+
+/*
+ * A bounded lock-free multi-producer multi-consumer queue of pointers.
+ *
+ * Each cell carries a sequence number telling producers and consumers
+ * whether it is free or full for their position, so push and pop complete
+ * with a single compare-and-swap on the shared index and never take a lock.
+ */
+typedef struct {
+    ingest_cell_t *cells;
+    size_t mask;
+    _Alignas(INGEST_CACHE_LINE) atomic_size_t head;  // Next position to push
+    _Alignas(INGEST_CACHE_LINE) atomic_size_t tail;  // Next position to pop
+    _Alignas(INGEST_CACHE_LINE) atomic_int closed;
+} ingest_queue_t;
+
+/**
+ * Creates a bounded queue.
+ *
+ * @param capacity The maximum number of queued items, rounded up to a power of two.
+ *
+ * @return A pointer to the new queue, or NULL if memory allocation fails.
+ */
+ingest_queue_t *ingest_queue_create(size_t capacity);
+
+/**
+ * Destroys a queue. Items still queued are not freed.
+ *
+ * @param queue The queue to destroy.
+ */
+void ingest_queue_destroy(ingest_queue_t *queue);
+
+/**
+ * Appends an item without blocking.
+ *
+ * @return 1 if the item was queued, 0 if the queue is full.
+ */
+int ingest_queue_try_push(ingest_queue_t *queue, void *item);
+
+/**
+ * Removes the oldest item without blocking.
+ *
+ * @return The item, or NULL if the queue is empty.
+ */
+void *ingest_queue_try_pop(ingest_queue_t *queue);
+
+/**
+ * Appends an item, waiting while the queue is full.
+ *
+ * This is the backpressure point of the pipeline: a stage that outruns the
+ * next one stalls here instead of buffering without bound.
+ *
+ * @return 1 if the item was queued, 0 if the queue was closed.
+ */
+int ingest_queue_push(ingest_queue_t *queue, void *item);
+
+/**
+ * Removes the oldest item, waiting while the queue is empty.
+ *
+ * @return The item, or NULL once the queue is closed and drained.
+ */
+void *ingest_queue_pop(ingest_queue_t *queue);
+
+/**
+ * Closes a queue. Pushes fail from then on, and pops return NULL once the
+ * remaining items are drained. Close a queue only after all of its
+ * producers have returned from their last push.
+ *
+ * @param queue The queue to close.
+ */
+void ingest_queue_close(ingest_queue_t *queue);
+
+#endif // INGEST_QUEUE_H
@@ -0,0 +1,276 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "metrics.h"
+
+/*
+ * Counters of one operation, on their own cache lines so that threads timing
+ * different operations do not contend.
+ */
+typedef struct {
+    _Alignas(64) atomic_uint_fast64_t count;
+    atomic_uint_fast64_t failures;
+    atomic_uint_fast64_t sum_ns;
+    atomic_uint_fast64_t buckets[METRICS_BUCKETS];
+} metrics_op_stats_t;
+
+static metrics_op_stats_t metrics_ops[METRICS_N_OPS];
+static _Alignas(64) atomic_uint_fast64_t metrics_dlog_total;
+static atomic_uint_fast64_t metrics_gauges[METRICS_N_GAUGES];
+
+static const char *const metrics_op_names[METRICS_N_OPS] = {
+    "encrypt", "decrypt", "commit", "prove", "verify"
+};
+
+static const char *const metrics_gauge_names[METRICS_N_GAUGES] = {
+    "smb_scratch_bytes_max", "smb_arena_bytes_max", "smb_dlog_giant_steps_max"
+};
+
+static const char *const metrics_gauge_help[METRICS_N_GAUGES] = {
+    "Largest bulletproof scratch space in use, in bytes.",
+    "Largest bulletproof arena footprint, in bytes.",
+    "Most giant steps taken by a single discrete logarithm."
+};
+
+struct metrics_reporter {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+    unsigned interval_ms;
+    metrics_report_fn fn;
+    void *arg;
+};
+
+uint64_t metrics_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Returns the smallest i such that ns <= METRICS_BUCKET_BASE_NS * 2^i.
+ */
+static size_t metrics_bucket(uint64_t ns) {
+    uint64_t q;
+    size_t i;
+
+    if (ns <= METRICS_BUCKET_BASE_NS) {
+        return 0;
+    }
+    q = (ns - 1) / METRICS_BUCKET_BASE_NS;
+    i = 64 - (size_t)__builtin_clzll(q);
+    return i < METRICS_BUCKETS - 1 ? i : METRICS_BUCKETS - 1;
+}
+
+void metrics_record(metrics_op_t op, uint64_t ns, int ok) {
+    metrics_op_stats_t *s = &metrics_ops[op];
+
+    atomic_fetch_add_explicit(&s->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->sum_ns, ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->buckets[metrics_bucket(ns)], 1, memory_order_relaxed);
+    if (!ok) {
+        atomic_fetch_add_explicit(&s->failures, 1, memory_order_relaxed);
+    }
+}
+
+void metrics_dlog_steps(uint64_t steps) {
+    atomic_fetch_add_explicit(&metrics_dlog_total, steps, memory_order_relaxed);
+    metrics_high_water(METRICS_GAUGE_DLOG_STEPS, steps);
+}
+
+void metrics_high_water(metrics_gauge_t gauge, uint64_t v) {
+    uint_fast64_t cur = atomic_load_explicit(&metrics_gauges[gauge], memory_order_relaxed);
+
+    while (v > cur && !atomic_compare_exchange_weak_explicit(&metrics_gauges[gauge], &cur, v, memory_order_relaxed, memory_order_relaxed));
+}
+
+void metrics_snapshot(metrics_snapshot_t *snapshot) {
+    size_t op, i;
+
+    snapshot->timestamp_ns = metrics_now();
+    for (op = 0; op < METRICS_N_OPS; op++) {
+        metrics_op_stats_t *s = &metrics_ops[op];
+        snapshot->ops[op].count = atomic_load_explicit(&s->count, memory_order_relaxed);
+        snapshot->ops[op].failures = atomic_load_explicit(&s->failures, memory_order_relaxed);
+        snapshot->ops[op].sum_ns = atomic_load_explicit(&s->sum_ns, memory_order_relaxed);
+        for (i = 0; i < METRICS_BUCKETS; i++) {
+            snapshot->ops[op].buckets[i] = atomic_load_explicit(&s->buckets[i], memory_order_relaxed);
+        }
+    }
+    snapshot->dlog_steps = atomic_load_explicit(&metrics_dlog_total, memory_order_relaxed);
+    for (i = 0; i < METRICS_N_GAUGES; i++) {
+        snapshot->gauges[i] = atomic_load_explicit(&metrics_gauges[i], memory_order_relaxed);
+    }
+}
+
+void metrics_reset(void) {
+    size_t op, i;
+
+    for (op = 0; op < METRICS_N_OPS; op++) {
+        metrics_op_stats_t *s = &metrics_ops[op];
+        atomic_store_explicit(&s->count, 0, memory_order_relaxed);
+        atomic_store_explicit(&s->failures, 0, memory_order_relaxed);
+        atomic_store_explicit(&s->sum_ns, 0, memory_order_relaxed);
+        for (i = 0; i < METRICS_BUCKETS; i++) {
+            atomic_store_explicit(&s->buckets[i], 0, memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&metrics_dlog_total, 0, memory_order_relaxed);
+    for (i = 0; i < METRICS_N_GAUGES; i++) {
+        atomic_store_explicit(&metrics_gauges[i], 0, memory_order_relaxed);
+    }
+}
+
+/*
+ * Output cursor of metrics_format_prometheus; len keeps counting past cap so
+ * that the caller learns the size it needs.
+ */
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+} metrics_writer_t;
+
+static void metrics_printf(metrics_writer_t *w, const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(w->len < w->cap ? w->buf + w->len : NULL, w->len < w->cap ? w->cap - w->len : 0, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        w->len += (size_t)n;
+    }
+}
+
+size_t metrics_format_prometheus(const metrics_snapshot_t *snapshot, char *buf, size_t cap) {
+    metrics_writer_t w = { buf, cap, 0 };
+    size_t op, i;
+
+    if (cap > 0) {
+        buf[0] = '\0';
+    }
+
+    metrics_printf(&w, "# HELP smb_op_duration_seconds Latency of cryptographic operations.\n"
+                       "# TYPE smb_op_duration_seconds histogram\n");
+    for (op = 0; op < METRICS_N_OPS; op++) {
+        const metrics_op_snapshot_t *s = &snapshot->ops[op];
+        uint64_t cumulative = 0;
+
+        for (i = 0; i < METRICS_BUCKETS - 1; i++) {
+            cumulative += s->buckets[i];
+            metrics_printf(&w, "smb_op_duration_seconds_bucket{op=\"%s\",le=\"%.9g\"} %llu\n", metrics_op_names[op],
+                           (double)((uint64_t)METRICS_BUCKET_BASE_NS << i) / 1e9, (unsigned long long)cumulative);
+        }
+        cumulative += s->buckets[METRICS_BUCKETS - 1];
+        metrics_printf(&w, "smb_op_duration_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n", metrics_op_names[op], (unsigned long long)cumulative);
+        metrics_printf(&w, "smb_op_duration_seconds_sum{op=\"%s\"} %.9f\n", metrics_op_names[op], (double)s->sum_ns / 1e9);
+        metrics_printf(&w, "smb_op_duration_seconds_count{op=\"%s\"} %llu\n", metrics_op_names[op], (unsigned long long)s->count);
+    }
+
+    metrics_printf(&w, "# HELP smb_op_failures_total Operations that returned an error.\n"
+                       "# TYPE smb_op_failures_total counter\n");
+    for (op = 0; op < METRICS_N_OPS; op++) {
+        metrics_printf(&w, "smb_op_failures_total{op=\"%s\"} %llu\n", metrics_op_names[op], (unsigned long long)snapshot->ops[op].failures);
+    }
+
+    metrics_printf(&w, "# HELP smb_dlog_giant_steps_total Giant steps taken by all discrete logarithms.\n"
+                       "# TYPE smb_dlog_giant_steps_total counter\n"
+                       "smb_dlog_giant_steps_total %llu\n", (unsigned long long)snapshot->dlog_steps);
+
+    for (i = 0; i < METRICS_N_GAUGES; i++) {
+        metrics_printf(&w, "# HELP %s %s\n# TYPE %s gauge\n%s %llu\n", metrics_gauge_names[i], metrics_gauge_help[i],
+                       metrics_gauge_names[i], metrics_gauge_names[i], (unsigned long long)snapshot->gauges[i]);
+    }
+
+    return w.len;
+}
+
+static void *metrics_reporter_main(void *arg) {
+    metrics_reporter_t *reporter = (metrics_reporter_t *)arg;
+    metrics_snapshot_t snapshot;
+    struct timespec deadline;
+    int stop;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    do {
+        deadline.tv_sec += reporter->interval_ms / 1000;
+        deadline.tv_nsec += (long)(reporter->interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        pthread_mutex_lock(&reporter->lock);
+        while (!reporter->stop && pthread_cond_timedwait(&reporter->cond, &reporter->lock, &deadline) != ETIMEDOUT);
+        stop = reporter->stop;
+        pthread_mutex_unlock(&reporter->lock);
+
+        metrics_snapshot(&snapshot);
+        reporter->fn(&snapshot, reporter->arg);
+    } while (!stop);
+
+    return NULL;
+}
+
+metrics_reporter_t *metrics_reporter_start(unsigned interval_ms, metrics_report_fn fn, void *arg) {
+    metrics_reporter_t *reporter;
+    pthread_condattr_t attr;
+    int ok;
+
+    if (interval_ms == 0 || fn == NULL) {
+        return NULL;
+    }
+    reporter = (metrics_reporter_t *)calloc(1, sizeof(*reporter));
+    if (reporter == NULL) {
+        return NULL;
+    }
+    reporter->interval_ms = interval_ms;
+    reporter->fn = fn;
+    reporter->arg = arg;
+
+    // Deadlines are taken from CLOCK_MONOTONIC so clock changes do not skew the period
+    ok = pthread_condattr_init(&attr) == 0;
+    if (ok) {
+        ok = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) == 0 && pthread_cond_init(&reporter->cond, &attr) == 0;
+        pthread_condattr_destroy(&attr);
+    }
+    if (!ok) {
+        free(reporter);
+        return NULL;
+    }
+    if (pthread_mutex_init(&reporter->lock, NULL) != 0) {
+        pthread_cond_destroy(&reporter->cond);
+        free(reporter);
+        return NULL;
+    }
+    if (pthread_create(&reporter->thread, NULL, metrics_reporter_main, reporter) != 0) {
+        pthread_mutex_destroy(&reporter->lock);
+        pthread_cond_destroy(&reporter->cond);
+        free(reporter);
+        return NULL;
+    }
+
+    return reporter;
+}
+
+void metrics_reporter_stop(metrics_reporter_t *reporter) {
+    if (reporter == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&reporter->lock);
+    reporter->stop = 1;
+    pthread_cond_signal(&reporter->cond);
+    pthread_mutex_unlock(&reporter->lock);
+    pthread_join(reporter->thread, NULL);
+
+    pthread_mutex_destroy(&reporter->lock);
+    pthread_cond_destroy(&reporter->cond);
+    free(reporter);
+}
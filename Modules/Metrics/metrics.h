@@ -0,0 +1,126 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Latency histogram buckets: upper bounds of 1us * 2^i, the last one unbounded
+#define METRICS_BUCKETS 24
+#define METRICS_BUCKET_BASE_NS 1000
+
+// Timed operations
+typedef enum {
+    METRICS_OP_ENCRYPT,
+    METRICS_OP_DECRYPT,
+    METRICS_OP_COMMIT,
+    METRICS_OP_PROVE,
+    METRICS_OP_VERIFY,
+    METRICS_N_OPS
+} metrics_op_t;
+
+// High-water marks
+typedef enum {
+    METRICS_GAUGE_SCRATCH_BYTES,   // Largest bulletproof scratch space in use
+    METRICS_GAUGE_ARENA_BYTES,     // Largest bulletproof arena footprint
+    METRICS_GAUGE_DLOG_STEPS,      // Most giant steps taken by one discrete log
+    METRICS_N_GAUGES
+} metrics_gauge_t;
+
+/*
+ * A consistent-enough copy of the counters: every field is read atomically,
+ * but fields recorded concurrently with the snapshot may be one event apart.
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t failures;
+    uint64_t sum_ns;
+    uint64_t buckets[METRICS_BUCKETS];   // Not cumulative
+} metrics_op_snapshot_t;
+
+typedef struct {
+    uint64_t timestamp_ns;               // CLOCK_MONOTONIC time of the snapshot
+    metrics_op_snapshot_t ops[METRICS_N_OPS];
+    uint64_t dlog_steps;                 // Giant steps taken by all discrete logs
+    uint64_t gauges[METRICS_N_GAUGES];
+} metrics_snapshot_t;
+
+typedef void (*metrics_report_fn)(const metrics_snapshot_t *snapshot, void *arg);
+
+typedef struct metrics_reporter metrics_reporter_t;
+
+/*
+ * The hooks compile to nothing unless SMB_METRICS is defined, so the hot
+ * paths of both modules are unchanged in builds without instrumentation.
+ */
+#ifdef SMB_METRICS
+#define METRICS_BEGIN(t) uint64_t t = metrics_now()
+#define METRICS_END(op, t, ok) metrics_record((op), metrics_now() - (t), (ok))
+#define METRICS_DLOG_STEPS(n) metrics_dlog_steps(n)
+#define METRICS_HIGH_WATER(gauge, v) metrics_high_water((gauge), (v))
+#else
+#define METRICS_BEGIN(t) ((void)0)
+#define METRICS_END(op, t, ok) ((void)0)
+#define METRICS_DLOG_STEPS(n) ((void)0)
+#define METRICS_HIGH_WATER(gauge, v) ((void)0)
+#endif
+
+/**
+ * Returns the CLOCK_MONOTONIC time in nanoseconds.
+ */
+uint64_t metrics_now(void);
+
+/**
+ * Records one operation.
+ *
+ * @param op The operation.
+ * @param ns Its latency in nanoseconds.
+ * @param ok Nonzero if it succeeded.
+ */
+void metrics_record(metrics_op_t op, uint64_t ns, int ok);
+
+/**
+ * Adds the giant steps of one discrete logarithm.
+ */
+void metrics_dlog_steps(uint64_t steps);
+
+/**
+ * Raises a high-water mark to v if v exceeds it.
+ */
+void metrics_high_water(metrics_gauge_t gauge, uint64_t v);
+
+/**
+ * Copies every counter into snapshot.
+ */
+void metrics_snapshot(metrics_snapshot_t *snapshot);
+
+/**
+ * Zeroes every counter, for example between benchmark runs.
+ */
+void metrics_reset(void);
+
+/**
+ * Formats a snapshot in the Prometheus text exposition format.
+ *
+ * @param snapshot The snapshot to format.
+ * @param buf The output buffer; the text is NUL-terminated if cap > 0.
+ * @param cap The size of buf.
+ *
+ * @return The length of the full text, excluding the NUL. As with snprintf,
+ *         the text was truncated if this is not below cap.
+ */
+size_t metrics_format_prometheus(const metrics_snapshot_t *snapshot, char *buf, size_t cap);
+
+/**
+ * Starts a thread that hands a snapshot to fn every interval_ms milliseconds.
+ *
+ * @return The reporter, or NULL on failure.
+ */
+metrics_reporter_t *metrics_reporter_start(unsigned interval_ms, metrics_report_fn fn, void *arg);
+
+/**
+ * Stops a reporter, after a final report, and frees it.
+ */
+void metrics_reporter_stop(metrics_reporter_t *reporter);
+
+#endif // METRICS_H
@@ -0,0 +1,215 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/random.h>
+#endif
+
+#include "csprng.h"
+
+#define CSPRNG_KEY_SIZE 32
+#define CSPRNG_BLOCK_SIZE 64
+#define CSPRNG_BLOCKS ((CSPRNG_KEY_SIZE + CSPRNG_BUFFER_SIZE + CSPRNG_BLOCK_SIZE - 1) / CSPRNG_BLOCK_SIZE)
+
+_Static_assert(CSPRNG_BUFFER_SIZE % CSPRNG_BLOCK_SIZE == 0, "the buffer must hold whole blocks");
+
+typedef struct {
+    uint32_t key[8];
+    uint8_t buf[CSPRNG_BUFFER_SIZE];
+    size_t pos;             // Next unserved byte of buf
+    uint64_t served;        // Bytes served since the last seed
+    unsigned generation;    // Fork generation the state was seeded in
+    int seeded;
+} csprng_state_t;
+
+static _Thread_local csprng_state_t csprng_state;
+
+// Incremented in the child of every fork, which then must not reuse the parent's stream
+static atomic_uint csprng_generation;
+static pthread_once_t csprng_once = PTHREAD_ONCE_INIT;
+
+static void csprng_atfork_child(void) {
+    atomic_fetch_add(&csprng_generation, 1);
+}
+
+static void csprng_register(void) {
+    if (pthread_atfork(NULL, NULL, csprng_atfork_child) != 0) {
+        abort();
+    }
+}
+
+/**
+ * Overwrites memory in a way the compiler cannot elide.
+ */
+static void csprng_zero(void *p, size_t len) {
+    volatile uint8_t *v = p;
+
+    while (len-- > 0) {
+        *v++ = 0;
+    }
+}
+
+#define CSPRNG_ROTL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define CSPRNG_QUARTER(a, b, c, d)                        \
+    do {                                                  \
+        a += b; d ^= a; d = CSPRNG_ROTL(d, 16);           \
+        c += d; b ^= c; b = CSPRNG_ROTL(b, 12);           \
+        a += b; d ^= a; d = CSPRNG_ROTL(d, 8);            \
+        c += d; b ^= c; b = CSPRNG_ROTL(b, 7);            \
+    } while (0)
+
+/**
+ * Computes one ChaCha20 block (RFC 8439) with a zero nonce.
+ */
+static void csprng_block(const uint32_t key[8], uint32_t counter, uint8_t out[CSPRNG_BLOCK_SIZE]) {
+    uint32_t in[16] = {
+        0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+        key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+        counter, 0, 0, 0
+    };
+    uint32_t x[16];
+    size_t i;
+
+    memcpy(x, in, sizeof(x));
+    for (i = 0; i < 10; i++) {
+        CSPRNG_QUARTER(x[0], x[4], x[8], x[12]);
+        CSPRNG_QUARTER(x[1], x[5], x[9], x[13]);
+        CSPRNG_QUARTER(x[2], x[6], x[10], x[14]);
+        CSPRNG_QUARTER(x[3], x[7], x[11], x[15]);
+        CSPRNG_QUARTER(x[0], x[5], x[10], x[15]);
+        CSPRNG_QUARTER(x[1], x[6], x[11], x[12]);
+        CSPRNG_QUARTER(x[2], x[7], x[8], x[13]);
+        CSPRNG_QUARTER(x[3], x[4], x[9], x[14]);
+    }
+    for (i = 0; i < 16; i++) {
+        uint32_t v = x[i] + in[i];
+        out[4 * i] = (uint8_t)v;
+        out[4 * i + 1] = (uint8_t)(v >> 8);
+        out[4 * i + 2] = (uint8_t)(v >> 16);
+        out[4 * i + 3] = (uint8_t)(v >> 24);
+    }
+    csprng_zero(x, sizeof(x));
+    csprng_zero(in, sizeof(in));
+}
+
+/**
+ * Reads len bytes of kernel randomness, returning 1 on success.
+ */
+static int csprng_os_bytes(uint8_t *out, size_t len) {
+    size_t done = 0;
+    int fd;
+
+#if defined(__linux__)
+    while (done < len) {
+        ssize_t n = getrandom(out + done, len - done, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        done += (size_t)n;
+    }
+    if (done == len) {
+        return 1;
+    }
+    done = 0;
+#endif
+    fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    while (done < len) {
+        ssize_t n = read(fd, out + done, len - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+
+    return done == len;
+}
+
+/**
+ * Generates a fresh buffer of keystream and replaces the key (fast key erasure).
+ */
+static void csprng_refill(csprng_state_t *st) {
+    uint8_t blocks[CSPRNG_BLOCKS * CSPRNG_BLOCK_SIZE];
+    size_t i;
+
+    for (i = 0; i < CSPRNG_BLOCKS; i++) {
+        csprng_block(st->key, (uint32_t)i, blocks + i * CSPRNG_BLOCK_SIZE);
+    }
+    for (i = 0; i < 8; i++) {
+        st->key[i] = (uint32_t)blocks[4 * i] | ((uint32_t)blocks[4 * i + 1] << 8)
+                   | ((uint32_t)blocks[4 * i + 2] << 16) | ((uint32_t)blocks[4 * i + 3] << 24);
+    }
+    memcpy(st->buf, blocks + CSPRNG_KEY_SIZE, CSPRNG_BUFFER_SIZE);
+    st->pos = 0;
+    csprng_zero(blocks, sizeof(blocks));
+}
+
+static void csprng_seed(csprng_state_t *st) {
+    uint8_t seed[CSPRNG_KEY_SIZE];
+    size_t i;
+
+    if (!csprng_os_bytes(seed, sizeof(seed))) {
+        abort();
+    }
+    for (i = 0; i < 8; i++) {
+        st->key[i] = (uint32_t)seed[4 * i] | ((uint32_t)seed[4 * i + 1] << 8)
+                   | ((uint32_t)seed[4 * i + 2] << 16) | ((uint32_t)seed[4 * i + 3] << 24);
+    }
+    csprng_zero(seed, sizeof(seed));
+    csprng_zero(st->buf, sizeof(st->buf));
+    st->pos = CSPRNG_BUFFER_SIZE;
+    st->served = 0;
+    st->generation = atomic_load(&csprng_generation);
+    st->seeded = 1;
+}
+
+void csprng_bytes(void *out, size_t len) {
+    csprng_state_t *st = &csprng_state;
+    uint8_t *p = out;
+
+    pthread_once(&csprng_once, csprng_register);
+    if (!st->seeded || st->served >= CSPRNG_RESEED_INTERVAL || st->generation != atomic_load(&csprng_generation)) {
+        csprng_seed(st);
+    }
+
+    while (len > 0) {
+        size_t n;
+
+        if (st->pos == CSPRNG_BUFFER_SIZE) {
+            csprng_refill(st);
+        }
+        n = CSPRNG_BUFFER_SIZE - st->pos;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(p, st->buf + st->pos, n);
+        csprng_zero(st->buf + st->pos, n);
+        st->pos += n;
+        st->served += n;
+        p += n;
+        len -= n;
+    }
+}
+
+void csprng_reseed(void) {
+    pthread_once(&csprng_once, csprng_register);
+    csprng_seed(&csprng_state);
+}
+
+void csprng_wipe(void) {
+    csprng_zero(&csprng_state, sizeof(csprng_state));
+}
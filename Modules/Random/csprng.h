@@ -0,0 +1,43 @@
+#ifndef CSPRNG_H
+#define CSPRNG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Keystream bytes each thread buffers between refills
+#define CSPRNG_BUFFER_SIZE 1024
+
+// Bytes a thread serves from one kernel seed before it reseeds
+#define CSPRNG_RESEED_INTERVAL ((uint64_t)1 << 24)
+
+/**
+ * Fills a buffer with cryptographically secure random bytes.
+ *
+ * Every thread runs its own ChaCha20 generator, seeded with 32 bytes from
+ * getrandom (or /dev/urandom where getrandom is unavailable) on first use,
+ * after CSPRNG_RESEED_INTERVAL bytes and in the child after a fork. Each
+ * refill generates CSPRNG_BUFFER_SIZE bytes of keystream plus a fresh key
+ * that replaces the old one, so a later compromise of the state does not
+ * reveal bytes already served; served bytes are wiped from the buffer.
+ * Requests are thus served by copying from the buffer, with no system call
+ * except when reseeding.
+ *
+ * @param out The buffer to fill.
+ * @param len The number of bytes to generate.
+ *
+ * @note This function aborts the program if the kernel cannot provide a
+ *       seed, like generate_secure_random_bytes did.
+ */
+void csprng_bytes(void *out, size_t len);
+
+/**
+ * Forces the calling thread's generator to reseed from the kernel.
+ */
+void csprng_reseed(void);
+
+/**
+ * Erases the calling thread's generator state. The next request reseeds.
+ */
+void csprng_wipe(void);
+
+#endif // CSPRNG_H
@@ -0,0 +1,514 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "scheduler.h"
+
+struct scheduler_future {
+    scheduler_t *scheduler;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    atomic_int done;
+};
+
+// Worker the calling thread belongs to, or NULL outside the workers
+static _Thread_local scheduler_worker_t *scheduler_self = NULL;
+
+static int scheduler_deque_init(scheduler_deque_t *deque) {
+    deque->jobs = (scheduler_job_t *)malloc(SCHEDULER_DEQUE_INIT * sizeof(*deque->jobs));
+    if (deque->jobs == NULL) {
+        return 0;
+    }
+    deque->top = 0;
+    deque->count = 0;
+    deque->capacity = SCHEDULER_DEQUE_INIT;
+    pthread_mutex_init(&deque->lock, NULL);
+    return 1;
+}
+
+static void scheduler_deque_free(scheduler_deque_t *deque) {
+    pthread_mutex_destroy(&deque->lock);
+    free(deque->jobs);
+}
+
+/**
+ * Pushes a job at the bottom of a deque, doubling it when it is full.
+ */
+static int scheduler_deque_push(scheduler_deque_t *deque, const scheduler_job_t *job) {
+    scheduler_job_t *jobs;
+    size_t i;
+
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count == deque->capacity) {
+        jobs = (scheduler_job_t *)malloc(2 * deque->capacity * sizeof(*jobs));
+        if (jobs == NULL) {
+            pthread_mutex_unlock(&deque->lock);
+            return 0;
+        }
+        for (i = 0; i < deque->count; i++) {
+            jobs[i] = deque->jobs[(deque->top + i) % deque->capacity];
+        }
+        free(deque->jobs);
+        deque->jobs = jobs;
+        deque->top = 0;
+        deque->capacity *= 2;
+    }
+    deque->jobs[(deque->top + deque->count) % deque->capacity] = *job;
+    deque->count++;
+    pthread_mutex_unlock(&deque->lock);
+
+    return 1;
+}
+
+/**
+ * Takes the newest job from the bottom of a deque; used by its owner.
+ */
+static int scheduler_deque_pop(scheduler_deque_t *deque, scheduler_job_t *job) {
+    int ok = 0;
+
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count != 0) {
+        deque->count--;
+        *job = deque->jobs[(deque->top + deque->count) % deque->capacity];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+
+    return ok;
+}
+
+/**
+ * Takes the oldest job from the top of a deque; used by thieves.
+ */
+static int scheduler_deque_steal(scheduler_deque_t *deque, scheduler_job_t *job) {
+    int ok = 0;
+
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count != 0) {
+        *job = deque->jobs[deque->top];
+        deque->top = (deque->top + 1) % deque->capacity;
+        deque->count--;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+
+    return ok;
+}
+
+/**
+ * Finds a job for a worker: its own newest job first, otherwise the oldest
+ * job of another worker, starting from a random victim.
+ */
+static int scheduler_take(scheduler_worker_t *worker, scheduler_job_t *job) {
+    scheduler_t *scheduler = worker->scheduler;
+    size_t i, victim;
+
+    if (atomic_load(&scheduler->pending) == 0) {
+        return 0;
+    }
+    if (!scheduler_deque_pop(&worker->deque, job)) {
+        // xorshift32
+        worker->rng ^= worker->rng << 13;
+        worker->rng ^= worker->rng >> 17;
+        worker->rng ^= worker->rng << 5;
+        victim = worker->rng % scheduler->n_started;
+        for (i = 0; i < scheduler->n_started; i++) {
+            if (scheduler_deque_steal(&scheduler->workers[(victim + i) % scheduler->n_started].deque, job)) {
+                break;
+            }
+        }
+        if (i == scheduler->n_started) {
+            return 0;
+        }
+    }
+    atomic_fetch_sub(&scheduler->pending, 1);
+    return 1;
+}
+
+/**
+ * Runs a job and completes its future.
+ */
+static void scheduler_run(scheduler_worker_t *worker, const scheduler_job_t *job) {
+    scheduler_future_t *future = job->future;
+
+    job->fn(worker, job->arg);
+
+    pthread_mutex_lock(&future->lock);
+    atomic_store(&future->done, 1);
+    pthread_cond_broadcast(&future->cond);
+    pthread_mutex_unlock(&future->lock);
+}
+
+static void *scheduler_worker_main(void *arg) {
+    scheduler_worker_t *worker = (scheduler_worker_t *)arg;
+    scheduler_t *scheduler = worker->scheduler;
+    scheduler_job_t job;
+    int done;
+
+    scheduler_self = worker;
+    worker->relic_ok = core_init() == RLC_OK;
+    if (worker->relic_ok) {
+        ep_param_set(scheduler->curve);
+    }
+
+    for (;;) {
+        if (scheduler_take(worker, &job)) {
+            scheduler_run(worker, &job);
+            continue;
+        }
+        pthread_mutex_lock(&scheduler->idle_lock);
+        while (atomic_load(&scheduler->pending) == 0 && !scheduler->stop) {
+            pthread_cond_wait(&scheduler->work, &scheduler->idle_lock);
+        }
+        // Queued jobs still run after a stop request
+        done = scheduler->stop && atomic_load(&scheduler->pending) == 0;
+        pthread_mutex_unlock(&scheduler->idle_lock);
+        if (done) {
+            break;
+        }
+    }
+
+    if (worker->relic_ok) {
+        core_clean();
+    }
+    return NULL;
+}
+
+scheduler_t *scheduler_create(const bulletproof_context_t *context, size_t n_workers, size_t scratch_size) {
+    scheduler_t *scheduler;
+    scheduler_worker_t *worker;
+    unsigned char seed[32];
+    long n_cores;
+    size_t i;
+    int ok = 1;
+
+    if (n_workers == 0) {
+        n_cores = sysconf(_SC_NPROCESSORS_ONLN);
+        n_workers = (n_cores > 0) ? (size_t)n_cores : 1;
+    }
+    if (scratch_size == 0) {
+        scratch_size = bulletproof_scratch_size(1, 64, 1);
+    }
+
+    scheduler = (scheduler_t *)calloc(1, sizeof(*scheduler));
+    if (scheduler == NULL) {
+        return NULL;
+    }
+    scheduler->workers = (scheduler_worker_t *)calloc(n_workers, sizeof(*scheduler->workers));
+    if (scheduler->workers == NULL) {
+        free(scheduler);
+        return NULL;
+    }
+    scheduler->context = context;
+    scheduler->n_workers = n_workers;
+    scheduler->curve = ep_param_get();
+    pthread_mutex_init(&scheduler->idle_lock, NULL);
+    pthread_cond_init(&scheduler->work, NULL);
+    atomic_init(&scheduler->pending, 0);
+    atomic_init(&scheduler->next, 0);
+
+    for (i = 0; i < n_workers && ok; i++) {
+        worker = &scheduler->workers[i];
+        worker->scheduler = scheduler;
+        worker->id = i;
+        worker->rng = 2463534242u + 2654435761u * (unsigned)i;
+        worker->scratch_size = scratch_size;
+        if (!scheduler_deque_init(&worker->deque)) {
+            ok = 0;
+            break;
+        }
+        worker->ctx = secp256k1_context_clone(context->ctx);
+        if (worker->ctx == NULL) {
+            scheduler_deque_free(&worker->deque);
+            ok = 0;
+            break;
+        }
+        // Blind each clone separately against side channels
+        generate_secure_random_bytes(seed, sizeof(seed));
+        worker->scratch = secp256k1_scratch_space_create(worker->ctx, scratch_size);
+        ok = secp256k1_context_randomize(worker->ctx, seed) == 1 && worker->scratch != NULL
+            && pthread_create(&worker->thread, NULL, scheduler_worker_main, worker) == 0;
+        if (!ok) {
+            if (worker->scratch != NULL) {
+                secp256k1_scratch_space_destroy(worker->scratch);
+            }
+            secp256k1_context_destroy(worker->ctx);
+            scheduler_deque_free(&worker->deque);
+            break;
+        }
+        scheduler->n_started++;
+    }
+    memset(seed, 0, sizeof(seed));
+
+    if (!ok) {
+        scheduler_destroy(scheduler);
+        return NULL;
+    }
+    return scheduler;
+}
+
+void scheduler_destroy(scheduler_t *scheduler) {
+    scheduler_worker_t *worker;
+    size_t i;
+
+    if (scheduler == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&scheduler->idle_lock);
+    scheduler->stop = 1;
+    pthread_cond_broadcast(&scheduler->work);
+    pthread_mutex_unlock(&scheduler->idle_lock);
+
+    for (i = 0; i < scheduler->n_started; i++) {
+        pthread_join(scheduler->workers[i].thread, NULL);
+    }
+    for (i = 0; i < scheduler->n_started; i++) {
+        worker = &scheduler->workers[i];
+        secp256k1_scratch_space_destroy(worker->scratch);
+        secp256k1_context_destroy(worker->ctx);
+        scheduler_deque_free(&worker->deque);
+    }
+
+    pthread_cond_destroy(&scheduler->work);
+    pthread_mutex_destroy(&scheduler->idle_lock);
+    free(scheduler->workers);
+    free(scheduler);
+}
+
+scheduler_future_t *scheduler_submit(scheduler_t *scheduler, scheduler_fn fn, void *arg) {
+    scheduler_future_t *future;
+    scheduler_worker_t *target;
+    scheduler_job_t job;
+
+    future = (scheduler_future_t *)malloc(sizeof(*future));
+    if (future == NULL) {
+        return NULL;
+    }
+    future->scheduler = scheduler;
+    pthread_mutex_init(&future->lock, NULL);
+    pthread_cond_init(&future->cond, NULL);
+    atomic_init(&future->done, 0);
+
+    job.fn = fn;
+    job.arg = arg;
+    job.future = future;
+
+    if (scheduler_self != NULL && scheduler_self->scheduler == scheduler) {
+        target = scheduler_self;
+    } else {
+        target = &scheduler->workers[atomic_fetch_add(&scheduler->next, 1) % scheduler->n_started];
+    }
+    // Counted before the push: a thief may take and uncount the job as soon as
+    // it is in the deque, which would otherwise wrap pending below zero
+    atomic_fetch_add(&scheduler->pending, 1);
+    if (!scheduler_deque_push(&target->deque, &job)) {
+        atomic_fetch_sub(&scheduler->pending, 1);
+        pthread_cond_destroy(&future->cond);
+        pthread_mutex_destroy(&future->lock);
+        free(future);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&scheduler->idle_lock);
+    pthread_cond_signal(&scheduler->work);
+    pthread_mutex_unlock(&scheduler->idle_lock);
+
+    return future;
+}
+
+void scheduler_wait(scheduler_future_t *future) {
+    scheduler_worker_t *worker = scheduler_self;
+    scheduler_job_t job;
+
+    if (worker != NULL && worker->scheduler == future->scheduler) {
+        // Help instead of blocking, so nested jobs cannot starve the pool
+        while (!atomic_load(&future->done)) {
+            if (scheduler_take(worker, &job)) {
+                scheduler_run(worker, &job);
+            } else {
+                sched_yield();
+            }
+        }
+        // Let the completing worker release the lock before the future is freed
+        pthread_mutex_lock(&future->lock);
+        pthread_mutex_unlock(&future->lock);
+    } else {
+        pthread_mutex_lock(&future->lock);
+        while (!atomic_load(&future->done)) {
+            pthread_cond_wait(&future->cond, &future->lock);
+        }
+        pthread_mutex_unlock(&future->lock);
+    }
+
+    pthread_cond_destroy(&future->cond);
+    pthread_mutex_destroy(&future->lock);
+    free(future);
+}
+
+void scheduler_wait_all(scheduler_future_t **futures, size_t n) {
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        if (futures[i] != NULL) {
+            scheduler_wait(futures[i]);
+        }
+    }
+}
+
+/**
+ * Submits n jobs whose arguments are consecutive elements of size bytes
+ * and waits for all of them.
+ *
+ * Returns 1 if every job was submitted, 0 otherwise; the jobs that were
+ * submitted have completed in either case.
+ */
+static int scheduler_run_all(scheduler_t *scheduler, scheduler_fn fn, void *args, size_t size, size_t n) {
+    scheduler_future_t **futures;
+    size_t i;
+    int ok = 1;
+
+    futures = (scheduler_future_t **)malloc(n * sizeof(*futures));
+    if (futures == NULL) {
+        return 0;
+    }
+    for (i = 0; i < n; i++) {
+        futures[i] = scheduler_submit(scheduler, fn, (unsigned char *)args + i * size);
+        ok = ok && futures[i] != NULL;
+    }
+    scheduler_wait_all(futures, n);
+    free(futures);
+
+    return ok;
+}
+
+typedef struct {
+    bulletproof_rangeproof_t *data;
+    size_t first;  // First proof of the job
+    size_t count;  // Number of proofs of the job
+    size_t plen;
+    int ok;
+} scheduler_rangeproof_job_t;
+
+static void scheduler_prove_job(scheduler_worker_t *worker, void *arg) {
+    scheduler_rangeproof_job_t *job = (scheduler_rangeproof_job_t *)arg;
+    bulletproof_rangeproof_t *data = job->data;
+
+    job->plen = MAX_PROOF_SIZE;
+    job->ok = secp256k1_bulletproof_rangeproof_prove(worker->ctx, worker->scratch, data->generators, data->proof[job->first], &job->plen, data->value, NULL, data->blind, data->n_commits, data->value_gen, data->nbits, data->nonce, NULL, 0) == 1;
+}
+
+void scheduler_rangeproof_prove(scheduler_t *scheduler, bulletproof_rangeproof_t *data) {
+    scheduler_rangeproof_job_t *jobs;
+    size_t i;
+
+    // Every worker's scratch space must hold one proof of this shape, or the
+    // prover fails on whichever worker runs the job
+    if (bulletproof_scratch_size(data->n_commits, data->nbits, 1) > scheduler->workers[0].scratch_size) {abort();}
+
+    jobs = (scheduler_rangeproof_job_t *)malloc(data->n_proofs * sizeof(*jobs));
+    if (jobs == NULL) {abort();}
+    for (i = 0; i < data->n_proofs; i++) {
+        jobs[i].data = data;
+        jobs[i].first = i;
+        jobs[i].count = 1;
+        jobs[i].ok = 0;
+    }
+    if (!scheduler_run_all(scheduler, scheduler_prove_job, jobs, sizeof(*jobs), data->n_proofs)) {abort();}
+    for (i = 0; i < data->n_proofs; i++) {
+        if (!jobs[i].ok) {abort();}
+        // All proofs of one structure have the same shape and hence the same length
+        data->plen = jobs[i].plen;
+    }
+    free(jobs);
+}
+
+static void scheduler_verify_job(scheduler_worker_t *worker, void *arg) {
+    scheduler_rangeproof_job_t *job = (scheduler_rangeproof_job_t *)arg;
+    bulletproof_rangeproof_t *data = job->data;
+
+    job->ok = secp256k1_bulletproof_rangeproof_verify_multi(worker->ctx, worker->scratch, data->generators, (const unsigned char **)data->proof + job->first, job->count, data->plen, NULL, (const secp256k1_pedersen_commitment **)data->commit + job->first, data->n_commits, data->nbits, data->value_gen + job->first, NULL, 0) == 1;
+}
+
+void scheduler_rangeproof_verify(scheduler_t *scheduler, bulletproof_rangeproof_t *data) {
+    scheduler_rangeproof_job_t *jobs;
+    size_t chunk, n_jobs, i;
+
+    // Spread the proofs over the workers, at most as many per job as a scratch space holds
+    chunk = (data->n_proofs + scheduler->n_started - 1) / scheduler->n_started;
+    while (chunk > 1 && bulletproof_scratch_size(data->n_commits, data->nbits, chunk) > scheduler->workers[0].scratch_size) {
+        chunk /= 2;
+    }
+    if (chunk == 0) {
+        return;
+    }
+    if (bulletproof_scratch_size(data->n_commits, data->nbits, chunk) > scheduler->workers[0].scratch_size) {abort();}
+    n_jobs = (data->n_proofs + chunk - 1) / chunk;
+
+    jobs = (scheduler_rangeproof_job_t *)malloc(n_jobs * sizeof(*jobs));
+    if (jobs == NULL) {abort();}
+    for (i = 0; i < n_jobs; i++) {
+        jobs[i].data = data;
+        jobs[i].first = i * chunk;
+        jobs[i].count = (data->n_proofs - jobs[i].first < chunk) ? data->n_proofs - jobs[i].first : chunk;
+        jobs[i].ok = 0;
+    }
+    if (!scheduler_run_all(scheduler, scheduler_verify_job, jobs, sizeof(*jobs), n_jobs)) {abort();}
+    for (i = 0; i < n_jobs; i++) {
+        if (!jobs[i].ok) {abort();}
+    }
+    free(jobs);
+}
+
+typedef struct {
+    elgamal_ctx_t *ctx;
+    bn_t *m;
+    elgamal_ciphertext_t *cts;
+    size_t n;
+    int result;
+} scheduler_encrypt_job_t;
+
+static void scheduler_encrypt_job(scheduler_worker_t *worker, void *arg) {
+    scheduler_encrypt_job_t *job = (scheduler_encrypt_job_t *)arg;
+
+    job->result = worker->relic_ok ? elgamal_encrypt_batch(job->ctx, job->m, job->cts, job->n) : RLC_ERR;
+}
+
+int scheduler_encrypt(scheduler_t *scheduler, elgamal_ctx_t *ctx, bn_t *m, elgamal_ciphertext_t *cts, size_t n) {
+    scheduler_encrypt_job_t *jobs;
+    size_t chunk, n_jobs, first, i;
+    int result = RLC_OK;
+
+    if (n == 0) {
+        return RLC_OK;
+    }
+    // A few jobs per worker, so that stealing evens out uneven progress
+    n_jobs = scheduler->n_started * SCHEDULER_JOBS_PER_WORKER;
+    chunk = (n + n_jobs - 1) / n_jobs;
+    n_jobs = (n + chunk - 1) / chunk;
+
+    jobs = (scheduler_encrypt_job_t *)malloc(n_jobs * sizeof(*jobs));
+    if (jobs == NULL) {
+        return RLC_ERR;
+    }
+    for (i = 0; i < n_jobs; i++) {
+        first = i * chunk;
+        jobs[i].ctx = ctx;
+        jobs[i].m = m + first;
+        jobs[i].cts = cts + first;
+        jobs[i].n = (n - first < chunk) ? n - first : chunk;
+        jobs[i].result = RLC_ERR;
+    }
+    if (!scheduler_run_all(scheduler, scheduler_encrypt_job, jobs, sizeof(*jobs), n_jobs)) {
+        result = RLC_ERR;
+    }
+    for (i = 0; i < n_jobs; i++) {
+        if (jobs[i].result != RLC_OK) {
+            result = RLC_ERR;
+        }
+    }
+    free(jobs);
+
+    return result;
+}
@@ -0,0 +1,172 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include <relic.h>
+
+#include "elgamal.h"
+#include "bulletproof.h"
+
+// Initial capacity of each worker's job deque; deques grow as needed
+#define SCHEDULER_DEQUE_INIT 256
+
+// Upper bound on jobs a helper submits per worker when splitting a workload
+#define SCHEDULER_JOBS_PER_WORKER 4
+
+typedef struct scheduler scheduler_t;
+typedef struct scheduler_worker scheduler_worker_t;
+typedef struct scheduler_future scheduler_future_t;
+
+// A job; it runs on a worker and may use the worker's context and scratch space
+typedef void (*scheduler_fn)(scheduler_worker_t *worker, void *arg);
+
+typedef struct {
+    scheduler_fn fn;
+    void *arg;
+    scheduler_future_t *future;
+} scheduler_job_t;
+
+/*
+ * A double-ended job queue. Its owner pushes and pops at the bottom, so it
+ * runs the jobs it spawned most recently, while idle workers steal from the
+ * top, taking the oldest and typically largest pieces of work.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    scheduler_job_t *jobs;
+    size_t top;       // Index of the oldest job
+    size_t count;
+    size_t capacity;
+} scheduler_deque_t;
+
+struct scheduler_worker {
+    scheduler_t *scheduler;
+    size_t id;
+    pthread_t thread;
+    secp256k1_context *ctx;           // Private clone of the shared context
+    secp256k1_scratch_space *scratch; // Private scratch space
+    size_t scratch_size;
+    int relic_ok;                     // Whether RELIC is initialized on this worker
+    unsigned rng;                     // State of the victim selection
+    scheduler_deque_t deque;
+};
+
+struct scheduler {
+    const bulletproof_context_t *context;  // Shared, read-only bulletproof generators
+    scheduler_worker_t *workers;
+    size_t n_workers;
+    size_t n_started;
+    int curve;                        // RELIC curve set up on every worker
+    pthread_mutex_t idle_lock;        // Guards the sleep of idle workers and stop
+    pthread_cond_t work;
+    atomic_size_t pending;            // Jobs queued in all deques
+    int stop;
+    atomic_size_t next;               // Round-robin target of external submissions
+};
+
+/**
+ * Creates a work-stealing scheduler and starts its workers.
+ *
+ * Every worker owns a clone of the secp256k1 context, randomized on its own,
+ * a scratch space, and a RELIC core set up for the caller's curve, so jobs
+ * never share mutable state. Only the bulletproof generators are shared.
+ *
+ * @param context The shared bulletproof context.
+ * @param n_workers The number of workers, or 0 for one per online core.
+ * @param scratch_size The size of each worker's scratch space in bytes, or 0
+ *                     for bulletproof_scratch_size(1, 64, 1). It must be at
+ *                     least bulletproof_scratch_size(n_commits, nbits, 1) for
+ *                     the largest shape passed to scheduler_rangeproof_prove
+ *                     or scheduler_rangeproof_verify, so the default only
+ *                     covers proofs of a single 64-bit commitment.
+ *
+ * @return A pointer to the running scheduler, or NULL on failure.
+ */
+scheduler_t *scheduler_create(const bulletproof_context_t *context, size_t n_workers, size_t scratch_size);
+
+/**
+ * Runs every queued job, then stops the workers and destroys the scheduler.
+ *
+ * @param scheduler The scheduler to destroy.
+ */
+void scheduler_destroy(scheduler_t *scheduler);
+
+/**
+ * Submits a job.
+ *
+ * A job submitted from a worker goes onto that worker's own deque; a job
+ * submitted from any other thread is dealt to the workers round-robin.
+ *
+ * @param scheduler The scheduler.
+ * @param fn The job function.
+ * @param arg The argument passed to fn.
+ *
+ * @return A future completed when the job has run, or NULL if memory
+ *         allocation fails. Every future must be passed to scheduler_wait.
+ */
+scheduler_future_t *scheduler_submit(scheduler_t *scheduler, scheduler_fn fn, void *arg);
+
+/**
+ * Waits for a job to complete and releases its future.
+ *
+ * Called from a worker, for example by a job that spawned sub-jobs, the
+ * worker keeps running queued jobs while it waits instead of blocking.
+ *
+ * @param future The future returned by scheduler_submit.
+ */
+void scheduler_wait(scheduler_future_t *future);
+
+/**
+ * Waits for several jobs; see scheduler_wait.
+ */
+void scheduler_wait_all(scheduler_future_t **futures, size_t n);
+
+/**
+ * Parallel counterpart of bulletproof_rangeproof_prove.
+ *
+ * The proofs of data are made concurrently, one job per proof, each with
+ * the context and scratch space of the worker it runs on.
+ *
+ * @param scheduler A scheduler created for data->context.
+ * @param data A structure prepared with bulletproof_rangeproof_setup and
+ *             bulletproof_rangeproof_pedersen_commit.
+ *
+ * @note This function aborts the program if proof generation fails, like
+ *       bulletproof_rangeproof_prove, and before submitting any job if the
+ *       workers' scratch spaces are smaller than
+ *       bulletproof_scratch_size(data->n_commits, data->nbits, 1).
+ */
+void scheduler_rangeproof_prove(scheduler_t *scheduler, bulletproof_rangeproof_t *data);
+
+/**
+ * Parallel counterpart of bulletproof_rangeproof_verify.
+ *
+ * The proofs of data are split into chunks that each fit a worker's scratch
+ * space and are verified with one verify_multi call per chunk.
+ *
+ * @param scheduler A scheduler created for data->context.
+ * @param data A structure holding the proofs and commitments to verify.
+ *
+ * @note This function aborts the program if any proof is invalid, like
+ *       bulletproof_rangeproof_verify, and before submitting any job if the
+ *       workers' scratch spaces cannot hold a single proof of data's shape.
+ */
+void scheduler_rangeproof_verify(scheduler_t *scheduler, bulletproof_rangeproof_t *data);
+
+/**
+ * Encrypts n plaintexts in parallel with a shared encryption context.
+ *
+ * @param scheduler The scheduler.
+ * @param ctx The encryption context of the public key; only read by workers.
+ * @param m The n plaintexts.
+ * @param cts The n ciphertexts, initialized with elgamal_ciphertext_init.
+ * @param n The number of plaintexts.
+ *
+ * @return RLC_OK if every encryption succeeded, RLC_ERR otherwise.
+ */
+int scheduler_encrypt(scheduler_t *scheduler, elgamal_ctx_t *ctx, bn_t *m, elgamal_ciphertext_t *cts, size_t n);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,239 @@
+#include <string.h>
+
+#include "wire.h"
+
+// The bundle layout relies on these sizes
+_Static_assert(ELGAMAL_CIPHERTEXT_BYTES == WIRE_CIPHERTEXT_BYTES, "RELIC must be configured for 256-bit points");
+_Static_assert(sizeof(zkpe_proof_t) == WIRE_ZKPE_BYTES, "zkpe_proof_t must be packed");
+_Static_assert(_Alignof(zkpe_proof_t) == 1, "zkpe_proof_t must be byte-aligned");
+_Static_assert(MAX_PROOF_SIZE <= UINT16_MAX, "proof lengths must fit 16 bits");
+
+static void wire_put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void wire_put_u32(uint8_t *p, uint32_t v) {
+    wire_put_u16(p, (uint16_t)(v >> 16));
+    wire_put_u16(p + 2, (uint16_t)v);
+}
+
+static void wire_put_u64(uint8_t *p, uint64_t v) {
+    wire_put_u32(p, (uint32_t)(v >> 32));
+    wire_put_u32(p + 4, (uint32_t)v);
+}
+
+static uint16_t wire_get_u16(const uint8_t *p) {
+    return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+static uint32_t wire_get_u32(const uint8_t *p) {
+    return ((uint32_t)wire_get_u16(p) << 16) | wire_get_u16(p + 2);
+}
+
+static uint64_t wire_get_u64(const uint8_t *p) {
+    return ((uint64_t)wire_get_u32(p) << 32) | wire_get_u32(p + 4);
+}
+
+/**
+ * Checks the tag byte of a compressed RELIC point (0x02 or 0x03).
+ */
+static int wire_is_point(const uint8_t *p) {
+    return (p[0] & 0xFE) == 0x02;
+}
+
+/**
+ * Returns the serialized size of a bundle carrying a range proof of plen bytes.
+ */
+size_t wire_bundle_size(size_t plen) {
+    return WIRE_BUNDLE_FIXED + plen;
+}
+
+/**
+ * Serializes a bundle.
+ *
+ * Given:
+ * - customer, seq: the customer the reading is billed to and the meter's
+ *   sequence number of the reading, both bound into the ZKPe proof
+ * - ct, commit, zkpe: the encrypted reading, its Pedersen commitment and
+ *   the proof that both hide the same value
+ * - proof, plen: the range proof of the commitment
+ *
+ * Returns the number of bytes written, or 0 if cap is too small or a field
+ * cannot be serialized.
+ */
+size_t wire_bundle_write(const secp256k1_context *ctx, uint8_t *out, size_t cap, uint64_t customer, uint64_t seq, const elgamal_ciphertext_t *ct, const secp256k1_pedersen_commitment *commit, const zkpe_proof_t *zkpe, const uint8_t *proof, size_t plen) {
+    size_t size = wire_bundle_size(plen);
+    uint8_t *p = out;
+
+    if (plen == 0 || plen > MAX_PROOF_SIZE || cap < size) {
+        return 0;
+    }
+
+    p[0] = WIRE_VERSION;
+    p[1] = WIRE_KIND_BUNDLE;
+    wire_put_u16(p + 2, (uint16_t)plen);
+    wire_put_u64(p + 4, customer);
+    wire_put_u64(p + 12, seq);
+    p += WIRE_BUNDLE_HEADER;
+
+    if (elgamal_ciphertext_write(p, ct) != RLC_OK) {
+        return 0;
+    }
+    p += WIRE_CIPHERTEXT_BYTES;
+    if (secp256k1_pedersen_commitment_serialize(ctx, p, commit) != 1) {
+        return 0;
+    }
+    p += WIRE_POINT_BYTES;
+    memcpy(p, zkpe, WIRE_ZKPE_BYTES);
+    p += WIRE_ZKPE_BYTES;
+    memcpy(p, proof, plen);
+
+    return size;
+}
+
+/**
+ * Parses a bundle in place.
+ *
+ * The parser checks the version and kind, the proof length against both
+ * MAX_PROOF_SIZE and the buffer, and the tag byte of every point, and then
+ * points the fields of bundle into buf without copying anything. Whether the
+ * points lie on the curve is checked when they are decoded, by
+ * elgamal_ciphertext_read, secp256k1_pedersen_commitment_parse and the ZKPe
+ * verifier.
+ *
+ * Returns the size of the bundle in bytes, or 0 if it is malformed.
+ */
+size_t wire_bundle_parse(wire_bundle_t *bundle, const uint8_t *buf, size_t len) {
+    const zkpe_proof_t *zkpe;
+    size_t plen;
+
+    if (len < WIRE_BUNDLE_FIXED || buf[0] != WIRE_VERSION || buf[1] != WIRE_KIND_BUNDLE) {
+        return 0;
+    }
+    plen = wire_get_u16(buf + 2);
+    if (plen == 0 || plen > MAX_PROOF_SIZE || len < wire_bundle_size(plen)) {
+        return 0;
+    }
+
+    bundle->customer = wire_get_u64(buf + 4);
+    bundle->seq = wire_get_u64(buf + 12);
+    bundle->ct = buf + WIRE_BUNDLE_HEADER;
+    bundle->commit = bundle->ct + WIRE_CIPHERTEXT_BYTES;
+    zkpe = (const zkpe_proof_t *)(bundle->commit + WIRE_POINT_BYTES);
+    bundle->zkpe = zkpe;
+    bundle->proof = (const uint8_t *)zkpe + WIRE_ZKPE_BYTES;
+    bundle->plen = plen;
+
+    if (!wire_is_point(bundle->ct) || !wire_is_point(bundle->ct + WIRE_POINT_BYTES)
+        || (bundle->commit[0] & 0xFE) != ZKPE_TAG_COMMITMENT
+        || !wire_is_point(zkpe->T1) || !wire_is_point(zkpe->T2) || !wire_is_point(zkpe->T3)) {
+        return 0;
+    }
+
+    return wire_bundle_size(plen);
+}
+
+/**
+ * Starts a batch in buf, reserving room for its header.
+ */
+void wire_batch_writer_init(wire_batch_writer_t *writer, uint8_t *buf, size_t cap) {
+    writer->buf = buf;
+    writer->cap = cap;
+    writer->len = WIRE_BATCH_HEADER;
+    writer->count = 0;
+}
+
+/**
+ * Appends a bundle to a batch; see wire_bundle_write.
+ *
+ * Returns 1 on success, 0 if the buffer is full, in which case the batch is
+ * left unchanged and can still be finished.
+ */
+int wire_batch_writer_add(wire_batch_writer_t *writer, const secp256k1_context *ctx, uint64_t customer, uint64_t seq, const elgamal_ciphertext_t *ct, const secp256k1_pedersen_commitment *commit, const zkpe_proof_t *zkpe, const uint8_t *proof, size_t plen) {
+    size_t size;
+
+    if (writer->cap < writer->len || writer->count == UINT32_MAX || writer->len - WIRE_BATCH_HEADER + wire_bundle_size(plen) > UINT32_MAX) {
+        return 0;
+    }
+    size = wire_bundle_write(ctx, writer->buf + writer->len, writer->cap - writer->len, customer, seq, ct, commit, zkpe, proof, plen);
+    if (size == 0) {
+        return 0;
+    }
+    writer->len += size;
+    writer->count++;
+
+    return 1;
+}
+
+/**
+ * Writes the header of a batch.
+ *
+ * Returns the total length of the batch in bytes, or 0 if the buffer cannot
+ * even hold the header.
+ */
+size_t wire_batch_writer_finish(wire_batch_writer_t *writer) {
+    uint8_t *p = writer->buf;
+
+    if (writer->cap < WIRE_BATCH_HEADER) {
+        return 0;
+    }
+    memcpy(p, WIRE_BATCH_MAGIC, 4);
+    p[4] = WIRE_VERSION;
+    p[5] = WIRE_KIND_BATCH;
+    wire_put_u16(p + 6, 0);
+    wire_put_u32(p + 8, writer->count);
+    wire_put_u32(p + 12, (uint32_t)(writer->len - WIRE_BATCH_HEADER));
+
+    return writer->len;
+}
+
+/**
+ * Opens a batch for reading after validating its header.
+ *
+ * Returns 1 if the header is valid and the payload fits the buffer, 0 otherwise.
+ */
+int wire_batch_open(wire_batch_reader_t *reader, const uint8_t *buf, size_t len) {
+    uint32_t payload;
+
+    if (len < WIRE_BATCH_HEADER || memcmp(buf, WIRE_BATCH_MAGIC, 4) != 0
+        || buf[4] != WIRE_VERSION || buf[5] != WIRE_KIND_BATCH || wire_get_u16(buf + 6) != 0) {
+        return 0;
+    }
+    payload = wire_get_u32(buf + 12);
+    if (len - WIRE_BATCH_HEADER < payload) {
+        return 0;
+    }
+
+    reader->buf = buf;
+    reader->len = WIRE_BATCH_HEADER + (size_t)payload;
+    reader->offset = WIRE_BATCH_HEADER;
+    reader->count = wire_get_u32(buf + 8);
+    reader->index = 0;
+
+    return 1;
+}
+
+/**
+ * Parses the next bundle of a batch in place; see wire_bundle_parse.
+ *
+ * Returns 1 and fills bundle while bundles remain, 0 at the end of the batch
+ * or on a malformed bundle. A batch was read completely and correctly if
+ * reader->index equals reader->count and reader->offset equals reader->len
+ * once this returns 0.
+ */
+int wire_batch_next(wire_batch_reader_t *reader, wire_bundle_t *bundle) {
+    size_t size;
+
+    if (reader->index == reader->count) {
+        return 0;
+    }
+    size = wire_bundle_parse(bundle, reader->buf + reader->offset, reader->len - reader->offset);
+    if (size == 0) {
+        return 0;
+    }
+    reader->offset += size;
+    reader->index++;
+
+    return 1;
+}
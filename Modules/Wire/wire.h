@@ -0,0 +1,94 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "elgamal.h"
+#include "zkpe.h"
+#include "bulletproof.h"
+
+// Format version written into every bundle and batch
+#define WIRE_VERSION 2
+
+// Record kinds
+#define WIRE_KIND_BUNDLE 0x01
+#define WIRE_KIND_BATCH 0x02
+
+// Serialized sizes of the bundle fields
+#define WIRE_POINT_BYTES 33
+#define WIRE_CIPHERTEXT_BYTES (2 * WIRE_POINT_BYTES)
+#define WIRE_ZKPE_BYTES (3 * WIRE_POINT_BYTES + 3 * ZKPE_SCALAR_BYTES)
+
+/*
+ * Bundle layout, all integers big-endian:
+ *   0   version        1 byte
+ *   1   kind           1 byte, WIRE_KIND_BUNDLE
+ *   2   plen           2 bytes, length of the range proof
+ *   4   customer       8 bytes
+ *   12  seq            8 bytes, the meter's sequence number of the reading
+ *   20  M1, M2         2 x 33 bytes, compressed points
+ *   86  commitment     33 bytes, secp256k1-zkp serialization
+ *   119 ZKPe proof     195 bytes, the zkpe_proof_t fields in order
+ *   314 range proof    plen bytes
+ * The header is not authenticated: customer and seq are bound into the ZKPe
+ * challenge, so a bundle whose header was altered fails the ZKPe check, but
+ * a new bundle can be made for any header. The transport must authenticate
+ * the meter.
+ */
+#define WIRE_BUNDLE_HEADER 20
+#define WIRE_BUNDLE_FIXED (WIRE_BUNDLE_HEADER + WIRE_CIPHERTEXT_BYTES + WIRE_POINT_BYTES + WIRE_ZKPE_BYTES)
+
+/*
+ * Batch layout: a 16-byte header followed by count bundles back to back.
+ *   0   magic          4 bytes, WIRE_BATCH_MAGIC
+ *   4   version        1 byte
+ *   5   kind           1 byte, WIRE_KIND_BATCH
+ *   6   reserved       2 bytes, zero
+ *   8   count          4 bytes, number of bundles
+ *   12  payload        4 bytes, total length of the bundles
+ */
+#define WIRE_BATCH_MAGIC "SMWB"
+#define WIRE_BATCH_HEADER 16
+
+/*
+ * A bundle parsed in place. Every pointer refers into the buffer the bundle
+ * was parsed from, which must outlive the view.
+ */
+typedef struct {
+    uint64_t customer;
+    uint64_t seq;
+    const uint8_t *ct;          // WIRE_CIPHERTEXT_BYTES, for elgamal_ciphertext_read
+    const uint8_t *commit;      // WIRE_POINT_BYTES, for secp256k1_pedersen_commitment_parse
+    const zkpe_proof_t *zkpe;   // zkpe_proof_t is a byte array, so no alignment is needed
+    const uint8_t *proof;
+    size_t plen;
+} wire_bundle_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    uint32_t count;
+} wire_batch_writer_t;
+
+typedef struct {
+    const uint8_t *buf;
+    size_t len;
+    size_t offset;    // Offset of the next bundle
+    uint32_t count;   // Bundles announced by the header
+    uint32_t index;   // Bundles returned so far
+} wire_batch_reader_t;
+
+size_t wire_bundle_size(size_t plen);
+size_t wire_bundle_write(const secp256k1_context *ctx, uint8_t *out, size_t cap, uint64_t customer, uint64_t seq, const elgamal_ciphertext_t *ct, const secp256k1_pedersen_commitment *commit, const zkpe_proof_t *zkpe, const uint8_t *proof, size_t plen);
+size_t wire_bundle_parse(wire_bundle_t *bundle, const uint8_t *buf, size_t len);
+
+void wire_batch_writer_init(wire_batch_writer_t *writer, uint8_t *buf, size_t cap);
+int wire_batch_writer_add(wire_batch_writer_t *writer, const secp256k1_context *ctx, uint64_t customer, uint64_t seq, const elgamal_ciphertext_t *ct, const secp256k1_pedersen_commitment *commit, const zkpe_proof_t *zkpe, const uint8_t *proof, size_t plen);
+size_t wire_batch_writer_finish(wire_batch_writer_t *writer);
+
+int wire_batch_open(wire_batch_reader_t *reader, const uint8_t *buf, size_t len);
+int wire_batch_next(wire_batch_reader_t *reader, wire_bundle_t *bundle);
+
+#endif // WIRE_H
@@ -0,0 +1,272 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pedersen_batch.h"
+#include "metrics.h"
+
+/**
+ * Decodes a secp256k1-zkp generator into a RELIC point; see zkpe_read_secp256k1.
+ */
+static int pedersen_batch_read_generator(ec_t R, const secp256k1_context *ctx, const secp256k1_generator *gen) {
+    uint8_t bin[ZKPE_POINT_BYTES];
+
+    if (secp256k1_generator_serialize(ctx, bin, gen) != 1) {
+        return RLC_ERR;
+    }
+    return zkpe_read_secp256k1(R, bin, ZKPE_TAG_GENERATOR);
+}
+
+/**
+ * Initializes the fixed-base tables for a pair of Pedersen generators.
+ *
+ * Steps:
+ * 1. Decode value_gen and blind_gen into RELIC points V and G.
+ * 2. Precompute the fixed-base tables for V and G.
+ * 3. Cache the group order for checking blinding factors.
+ *
+ * RELIC must be configured for secp256k1. The tables are meant to be built
+ * once per pair of generators, typically the bulletproof value_gen and
+ * blind_gen, and shared by every batch; see pedersen_batch_commit.
+ */
+int pedersen_batch_init(pedersen_batch_t *batch, const secp256k1_context *ctx, const secp256k1_generator *value_gen, const secp256k1_generator *blind_gen) {
+    int result = RLC_OK;
+    ec_t V, G;
+    int i;
+
+    // Initialize variables as null
+    ec_null(V);
+    ec_null(G);
+    bn_null(batch->n);
+    for (i = 0; i < RLC_EC_TABLE; i++) {
+        ec_null(batch->table_V[i]);
+        ec_null(batch->table_G[i]);
+    }
+
+    RLC_TRY {
+        // Allocate memory for variables
+        ec_new(V);
+        ec_new(G);
+        bn_new(batch->n);
+        for (i = 0; i < RLC_EC_TABLE; i++) {
+            ec_new(batch->table_V[i]);
+            ec_new(batch->table_G[i]);
+        }
+
+        if (pedersen_batch_read_generator(V, ctx, value_gen) != RLC_OK
+            || pedersen_batch_read_generator(G, ctx, blind_gen) != RLC_OK) {
+            result = RLC_ERR;
+        } else {
+            ec_curve_get_ord(batch->n);
+            ec_mul_pre(batch->table_V, V);
+            ec_mul_pre(batch->table_G, G);
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        ec_free(V);
+        ec_free(G);
+    }
+
+    if (result != RLC_OK) {
+        pedersen_batch_free(batch);
+    }
+    return result;
+}
+
+/**
+ * Frees the tables of a batch committer.
+ */
+void pedersen_batch_free(pedersen_batch_t *batch) {
+    int i;
+
+    for (i = 0; i < RLC_EC_TABLE; i++) {
+        ec_free(batch->table_V[i]);
+        ec_free(batch->table_G[i]);
+    }
+    bn_free(batch->n);
+}
+
+/**
+ * Commits to up to PEDERSEN_BATCH_CHUNK values; see pedersen_batch_commit.
+ */
+static int pedersen_batch_chunk(const pedersen_batch_t *batch, const secp256k1_context *ctx, secp256k1_pedersen_commitment *commits, const uint8_t *blinds, const uint64_t *values, size_t n, ec_t *R) {
+    int result = RLC_OK;
+    uint8_t bin[ZKPE_POINT_BYTES];
+    uint8_t v[8];
+    ec_t T;
+    bn_t k;
+    fp_t y;
+    size_t i;
+    int j;
+
+    // Initialize variables as null
+    ec_null(T);
+    bn_null(k);
+    fp_null(y);
+
+    RLC_TRY {
+        // Allocate memory for variables
+        ec_new(T);
+        bn_new(k);
+        fp_new(y);
+
+        // Compute R_i = v_i*V + r_i*G, leaving R_i in projective coordinates
+        for (i = 0; i < n && result == RLC_OK; i++) {
+            bn_read_bin(k, blinds + i * ZKPE_SCALAR_BYTES, ZKPE_SCALAR_BYTES);
+            if (bn_cmp(k, batch->n) != RLC_LT) {
+                // secp256k1_pedersen_commit rejects overflowing blinding factors too
+                result = RLC_ERR;
+                break;
+            }
+            ec_mul_fix(R[i], (const ec_t *)batch->table_G, k);
+            for (j = 0; j < 8; j++) {
+                v[j] = (uint8_t)(values[i] >> (56 - 8 * j));
+            }
+            bn_read_bin(k, v, sizeof(v));
+            ec_mul_fix(T, (const ec_t *)batch->table_V, k);
+            ec_add(R[i], R[i], T);
+            // The simultaneous inversion below cannot handle a zero z-coordinate
+            if (ec_is_infty(R[i])) {
+                result = RLC_ERR;
+            }
+        }
+
+        if (result == RLC_OK) {
+            // Convert every R_i to affine coordinates with a single inversion
+            ep_norm_sim(R, (const ep_t *)R, (int)n);
+
+            for (i = 0; i < n; i++) {
+                // Tag the x-coordinate with whether y is a quadratic residue
+                bin[0] = fp_srt(y, R[i]->y) ? ZKPE_TAG_COMMITMENT : ZKPE_TAG_COMMITMENT | 1;
+                fp_write_bin(bin + 1, RLC_FP_BYTES, R[i]->x);
+                if (secp256k1_pedersen_commitment_parse(ctx, &commits[i], bin) != 1) {
+                    result = RLC_ERR;
+                    break;
+                }
+            }
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        ec_free(T);
+        bn_free(k);
+        fp_free(y);
+    }
+
+    return result;
+}
+
+/**
+ * Computes n Pedersen commitments under the generators of batch.
+ *
+ * Given:
+ * - blinds: n 32-byte blinding factors r_i, back to back
+ * - values: the n values v_i
+ *
+ * Steps, for chunks of up to PEDERSEN_BATCH_CHUNK commitments:
+ * 1. Compute R_i = v_i*V + r_i*G with two fixed-base multiplications over the
+ *    precomputed tables, in place of the two generic multiplications of
+ *    secp256k1_pedersen_commit.
+ * 2. Normalize the whole chunk at once (one field inversion per chunk).
+ * 3. Encode each R_i the way secp256k1-zkp does, as the x-coordinate tagged
+ *    with the quadratic residuosity of y, and parse it into commits[i].
+ *
+ * The commitments are identical to those of secp256k1_pedersen_commit for the
+ * same inputs. RELIC's fixed-base multiplication is not constant-time, so
+ * this is meant for aggregators re-committing large batches, not for meters
+ * exposed to timing measurements.
+ *
+ * Returns RLC_OK on success, RLC_ERR if a blinding factor is not below the
+ * group order, a commitment is the point at infinity, or memory runs out.
+ */
+int pedersen_batch_commit(const pedersen_batch_t *batch, const secp256k1_context *ctx, secp256k1_pedersen_commitment *commits, const uint8_t *blinds, const uint64_t *values, size_t n) {
+    int result = RLC_OK;
+    size_t chunk = n < PEDERSEN_BATCH_CHUNK ? n : PEDERSEN_BATCH_CHUNK;
+    size_t i, done;
+    ec_t *R;
+    METRICS_BEGIN(start);
+
+    if (n == 0) {
+        return RLC_OK;
+    }
+    R = (ec_t *)malloc(chunk * sizeof(*R));
+    if (R == NULL) {
+        return RLC_ERR;
+    }
+    for (i = 0; i < chunk; i++) {
+        ec_null(R[i]);
+    }
+
+    RLC_TRY {
+        for (i = 0; i < chunk; i++) {
+            ec_new(R[i]);
+        }
+        for (done = 0; done < n && result == RLC_OK; done += chunk) {
+            size_t m = n - done < chunk ? n - done : chunk;
+            result = pedersen_batch_chunk(batch, ctx, commits + done, blinds + done * ZKPE_SCALAR_BYTES, values + done, m, R);
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        for (i = 0; i < chunk; i++) {
+            ec_free(R[i]);
+        }
+        free(R);
+    }
+
+    METRICS_END(METRICS_OP_COMMIT, start, result == RLC_OK);
+    return result;
+}
+
+/**
+ * Batch counterpart of bulletproof_rangeproof_pedersen_commit.
+ *
+ * The blinding factors are derived exactly as there, and the commitments of
+ * the first proof are computed with pedersen_batch_commit and copied to the
+ * other proofs. batch must have been initialized for data->value_gen[0] and
+ * data->blind_gen.
+ *
+ * Returns RLC_OK on success, RLC_ERR otherwise.
+ */
+int pedersen_batch_rangeproof_commit(const pedersen_batch_t *batch, bulletproof_rangeproof_t *data) {
+    unsigned char blind[32];
+    uint64_t *values;
+    size_t i;
+    int result;
+
+    values = (uint64_t *)malloc(data->n_commits * sizeof(*values));
+    if (values == NULL) {
+        return RLC_ERR;
+    }
+
+    generate_secure_random_bytes(blind, sizeof(blind));
+    for (i = 0; i < data->n_commits; i++) {
+        blind[0] = i;
+        blind[1] = i >> 8;
+        memcpy(data->blinds + i * 32, blind, 32);
+        values[i] = data->value[i];
+    }
+    memset(blind, 0, sizeof(blind));
+
+    result = pedersen_batch_commit(batch, data->ctx, data->commit[0], data->blinds, values, data->n_commits);
+    free(values);
+
+    if (result == RLC_OK) {
+        for (i = 1; i < data->n_proofs; i++) {
+            memcpy(data->commit[i], data->commit[0], data->n_commits * sizeof(*data->commit[0]));
+        }
+    }
+    return result;
+}
@@ -0,0 +1,31 @@
+#ifndef PEDERSEN_BATCH_H
+#define PEDERSEN_BATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <relic.h>
+
+#include "zkpe.h"
+#include "bulletproof.h"
+
+// Largest number of commitments normalized together with one inversion
+#define PEDERSEN_BATCH_CHUNK 256
+
+/*
+ * Fixed-base tables for committing to many values under the same pair of
+ * generators, C = v*V + r*G, where V is the value generator and G the
+ * blinding generator of secp256k1_pedersen_commit.
+ */
+typedef struct {
+    ec_t table_V[RLC_EC_TABLE];  // Fixed-base table for the value generator
+    ec_t table_G[RLC_EC_TABLE];  // Fixed-base table for the blinding generator
+    bn_t n;                      // Order of the group
+} pedersen_batch_t;
+
+int pedersen_batch_init(pedersen_batch_t *batch, const secp256k1_context *ctx, const secp256k1_generator *value_gen, const secp256k1_generator *blind_gen);
+void pedersen_batch_free(pedersen_batch_t *batch);
+int pedersen_batch_commit(const pedersen_batch_t *batch, const secp256k1_context *ctx, secp256k1_pedersen_commitment *commits, const uint8_t *blinds, const uint64_t *values, size_t n);
+int pedersen_batch_rangeproof_commit(const pedersen_batch_t *batch, bulletproof_rangeproof_t *data);
+
+#endif // PEDERSEN_BATCH_H
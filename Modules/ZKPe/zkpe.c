@@ -0,0 +1,474 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "zkpe.h"
+#include "elgamal_aggregate.h"
+#include "csprng.h"
+
+// Domain separation tag of the Fiat-Shamir challenge
+#define ZKPE_DOMAIN "ZKPe/secp256k1/v2"
+
+// Bit length of the random weights of batch verification
+#define ZKPE_WEIGHT_BITS 128
+
+// Largest number of proofs combined into one multi-scalar multiplication
+#define ZKPE_BATCH_CHUNK 4096
+
+// Points per proof in the batch equation: B, H, T1, M1, T2, M2, T3, C
+#define ZKPE_POINTS_PER_PROOF 8
+
+/**
+ * Decodes a point serialized by secp256k1-zkp into a RELIC point.
+ *
+ * secp256k1-zkp serializes Pedersen commitments and generators as a tag byte
+ * followed by the 32-byte x-coordinate. Unlike SEC1 compression, the low bit
+ * of the tag does not give the parity of y but whether y is a quadratic
+ * residue (bit clear) or not (bit set).
+ *
+ * Steps:
+ * 1. Compute t = x^3 + a*x + b.
+ * 2. Compute y = sqrt(t). On secp256k1 p = 3 mod 4, and RELIC computes the
+ *    root as t^((p+1)/4), which is itself a quadratic residue.
+ * 3. Negate y if the tag marks a non-residue.
+ *
+ * Returns RLC_OK on success, RLC_ERR if RELIC is not configured for secp256k1,
+ * the tag is wrong or x is not on the curve.
+ */
+int zkpe_read_secp256k1(ec_t R, const uint8_t in[ZKPE_POINT_BYTES], uint8_t tag) {
+    int result = RLC_OK;
+    fp_t t, a, b;
+
+    // Serialized secp256k1-zkp objects only decode on the same curve
+    if (ep_param_get() != SECG_K256 || (in[0] & 0xFE) != tag) {
+        return RLC_ERR;
+    }
+
+    // Initialize variables as null
+    fp_null(t);
+    fp_null(a);
+    fp_null(b);
+
+    RLC_TRY {
+        // Allocate memory for variables
+        fp_new(t);
+        fp_new(a);
+        fp_new(b);
+
+        fp_read_bin(R->x, in + 1, RLC_FP_BYTES);
+
+        // Compute t = x^3 + a*x + b
+        ep_curve_get_a(a);
+        ep_curve_get_b(b);
+        fp_sqr(t, R->x);
+        fp_add(t, t, a);
+        fp_mul(t, t, R->x);
+        fp_add(t, t, b);
+
+        if (!fp_srt(R->y, t)) {
+            result = RLC_ERR;
+        } else {
+            if (in[0] & 1) {
+                fp_neg(R->y, R->y);
+            }
+            fp_set_dig(R->z, 1);
+            R->coord = BASIC;
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for variables
+        fp_free(t);
+        fp_free(a);
+        fp_free(b);
+    }
+
+    return result;
+}
+
+/**
+ * Computes c = a * b mod n.
+ */
+static void zkpe_mul_mod(bn_t c, const bn_t a, const bn_t b, const bn_t n) {
+    bn_mul(c, a, b);
+    bn_mod(c, c, n);
+}
+
+/**
+ * Computes c = -a mod n for 0 <= a < n.
+ */
+static void zkpe_neg_mod(bn_t c, const bn_t a, const bn_t n) {
+    if (bn_is_zero(a)) {
+        bn_zero(c);
+    } else {
+        bn_sub(c, n, a);
+    }
+}
+
+/**
+ * Writes a 64-bit integer in big-endian order.
+ */
+static void zkpe_put_u64(uint8_t *p, uint64_t v) {
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+/**
+ * Computes the Fiat-Shamir challenge
+ * e = SHA-256(domain, customer, seq, B, H, M1, M2, C, T1, T2, T3) mod n.
+ */
+static void zkpe_challenge(bn_t e, const zkpe_statement_t *st, const zkpe_proof_t *proof, const bn_t n) {
+    uint8_t buf[sizeof(ZKPE_DOMAIN) - 1 + 16 + 8 * ZKPE_POINT_BYTES];
+    uint8_t hash[RLC_MD_LEN];
+    uint8_t *p = buf;
+
+    memcpy(p, ZKPE_DOMAIN, sizeof(ZKPE_DOMAIN) - 1);
+    p += sizeof(ZKPE_DOMAIN) - 1;
+    zkpe_put_u64(p, st->customer);
+    p += 8;
+    zkpe_put_u64(p, st->seq);
+    p += 8;
+    ec_write_bin(p, ZKPE_POINT_BYTES, *st->B, 1);
+    p += ZKPE_POINT_BYTES;
+    memcpy(p, st->H, ZKPE_POINT_BYTES);
+    p += ZKPE_POINT_BYTES;
+    ec_write_bin(p, ZKPE_POINT_BYTES, st->ct->M1, 1);
+    p += ZKPE_POINT_BYTES;
+    ec_write_bin(p, ZKPE_POINT_BYTES, st->ct->M2, 1);
+    p += ZKPE_POINT_BYTES;
+    memcpy(p, st->C, ZKPE_POINT_BYTES);
+    p += ZKPE_POINT_BYTES;
+    memcpy(p, proof->T1, ZKPE_POINT_BYTES);
+    p += ZKPE_POINT_BYTES;
+    memcpy(p, proof->T2, ZKPE_POINT_BYTES);
+    p += ZKPE_POINT_BYTES;
+    memcpy(p, proof->T3, ZKPE_POINT_BYTES);
+
+    md_map_sh256(hash, buf, sizeof(buf));
+    bn_read_bin(e, hash, RLC_MD_LEN);
+    bn_mod(e, e, n);
+}
+
+/**
+ * Computes and serializes the response z = a + e*w mod n.
+ */
+static void zkpe_response(uint8_t out[ZKPE_SCALAR_BYTES], bn_t z, const bn_t a, const bn_t e, const bn_t w, const bn_t n) {
+    bn_mul(z, e, w);
+    bn_add(z, z, a);
+    bn_mod(z, z, n);
+    bn_write_bin(out, ZKPE_SCALAR_BYTES, z);
+}
+
+/**
+ * The ZKPe proving process, run by the meter for each reading.
+ *
+ * Given:
+ * - st: the ciphertext (M1, M2) = (k*P, m*P + k*B), the public key B, the
+ *   value generator H, the commitment C = m*H + r*G, and the customer and
+ *   sequence number the reading is uploaded under
+ * - m, k, blind: the witness; blind is the 32-byte blinding factor r of C
+ *
+ * Steps (a Sigma protocol made non-interactive with Fiat-Shamir):
+ * 1. Choose random integers a, b and c from the range of the order of G_1.
+ * 2. Compute T1 = b*P, T2 = a*P + b*B and T3 = a*H + c*G.
+ * 3. Compute the challenge e from the statement and T1, T2, T3.
+ * 4. Compute z_m = a + e*m, z_k = b + e*k and z_r = c + e*r.
+ *
+ * The proof (T1, T2, T3, z_m, z_k, z_r) shows that M2 and C hide the same m
+ * without revealing m, k or r. On secp256k1 the ElGamal base point P and the
+ * commitment blinding generator G are the same point.
+ */
+int zkpe_prove(zkpe_proof_t *proof, const zkpe_statement_t *st, const bn_t m, const bn_t k, const uint8_t blind[ZKPE_SCALAR_BYTES]) {
+    int result = RLC_OK;
+    bn_t n, r, a, b, c, e, z;
+    ec_t H, T;
+
+    // Initialize variables as null
+    bn_null(n);
+    bn_null(r);
+    bn_null(a);
+    bn_null(b);
+    bn_null(c);
+    bn_null(e);
+    bn_null(z);
+    ec_null(H);
+    ec_null(T);
+
+    RLC_TRY {
+        // Allocate memory for variables
+        bn_new(n);
+        bn_new(r);
+        bn_new(a);
+        bn_new(b);
+        bn_new(c);
+        bn_new(e);
+        bn_new(z);
+        ec_new(H);
+        ec_new(T);
+
+        ec_curve_get_ord(n);
+        if (zkpe_read_secp256k1(H, st->H, ZKPE_TAG_GENERATOR) != RLC_OK) {
+            result = RLC_ERR;
+        } else {
+            bn_read_bin(r, blind, ZKPE_SCALAR_BYTES);
+            bn_mod(r, r, n);
+
+            // Generate the random integers a, b, c in the range [1, n-1]
+            elgamal_rand_mod(a, n);
+            elgamal_rand_mod(b, n);
+            elgamal_rand_mod(c, n);
+
+            // Compute T1 = b*P
+            ec_mul_gen(T, b);
+            ec_write_bin(proof->T1, ZKPE_POINT_BYTES, T, 1);
+            // Compute T2 = a*P + b*B
+            ec_mul_sim_gen(T, a, *st->B, b);
+            ec_write_bin(proof->T2, ZKPE_POINT_BYTES, T, 1);
+            // Compute T3 = c*G + a*H
+            ec_mul_sim_gen(T, c, H, a);
+            ec_write_bin(proof->T3, ZKPE_POINT_BYTES, T, 1);
+
+            zkpe_challenge(e, st, proof, n);
+
+            zkpe_response(proof->z_m, z, a, e, m, n);
+            zkpe_response(proof->z_k, z, b, e, k, n);
+            zkpe_response(proof->z_r, z, c, e, r, n);
+        }
+    }
+
+    RLC_CATCH_ANY {
+        result = RLC_ERR;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for variables
+        bn_free(n);
+        bn_free(r);
+        bn_free(a);
+        bn_free(b);
+        bn_free(c);
+        bn_free(e);
+        bn_free(z);
+        ec_free(H);
+        ec_free(T);
+    }
+
+    return result;
+}
+
+/**
+ * Checks n proofs at once with one randomized linear combination.
+ *
+ * Each proof i must satisfy the three equations
+ *   z_k*P         = T1 + e*M1
+ *   z_m*P + z_k*B = T2 + e*M2
+ *   z_m*H + z_r*G = T3 + e*C
+ * Weighting the equations of proof i with random 128-bit rho1, rho2, rho3
+ * and summing everything gives a single multi-scalar multiplication over
+ * 8n + 1 points that is the point at infinity exactly when, except with
+ * probability about 2^-128, every equation holds. The terms in P and G are
+ * merged since P = G.
+ */
+static int zkpe_check(const zkpe_statement_t *st, const zkpe_proof_t *proof, size_t n_proofs) {
+    int valid = 1;
+    size_t n_points = ZKPE_POINTS_PER_PROOF * n_proofs + 1;
+    size_t i, j;
+    ec_t *P = NULL;
+    bn_t *k = NULL;
+    ec_t R;
+    bn_t n, e, t, g, z_m, z_k, z_r, rho[3];
+    uint8_t weights[3 * ZKPE_WEIGHT_BITS / 8];
+
+    P = (ec_t *)malloc(n_points * sizeof(*P));
+    k = (bn_t *)malloc(n_points * sizeof(*k));
+    if (P == NULL || k == NULL) {
+        free(P);
+        free(k);
+        return RLC_ERR;
+    }
+
+    // Initialize variables as null
+    for (i = 0; i < n_points; i++) {
+        ec_null(P[i]);
+        bn_null(k[i]);
+    }
+    ec_null(R);
+    bn_null(n);
+    bn_null(e);
+    bn_null(t);
+    bn_null(g);
+    bn_null(z_m);
+    bn_null(z_k);
+    bn_null(z_r);
+    for (j = 0; j < 3; j++) {
+        bn_null(rho[j]);
+    }
+
+    RLC_TRY {
+        // Allocate memory for variables
+        for (i = 0; i < n_points; i++) {
+            ec_new(P[i]);
+            bn_new(k[i]);
+        }
+        ec_new(R);
+        bn_new(n);
+        bn_new(e);
+        bn_new(t);
+        bn_new(g);
+        bn_new(z_m);
+        bn_new(z_k);
+        bn_new(z_r);
+        for (j = 0; j < 3; j++) {
+            bn_new(rho[j]);
+        }
+
+        ec_curve_get_ord(n);
+        bn_zero(g);
+
+        for (i = 0; i < n_proofs && valid; i++) {
+            ec_t *Pi = &P[ZKPE_POINTS_PER_PROOF * i];
+            bn_t *ki = &k[ZKPE_POINTS_PER_PROOF * i];
+
+            // Points of proof i: B, H, T1, M1, T2, M2, T3, C
+            ec_copy(Pi[0], *st[i].B);
+            ec_read_bin(Pi[2], proof[i].T1, ZKPE_POINT_BYTES);
+            ec_copy(Pi[3], st[i].ct->M1);
+            ec_read_bin(Pi[4], proof[i].T2, ZKPE_POINT_BYTES);
+            ec_copy(Pi[5], st[i].ct->M2);
+            ec_read_bin(Pi[6], proof[i].T3, ZKPE_POINT_BYTES);
+            if (zkpe_read_secp256k1(Pi[1], st[i].H, ZKPE_TAG_GENERATOR) != RLC_OK
+                || zkpe_read_secp256k1(Pi[7], st[i].C, ZKPE_TAG_COMMITMENT) != RLC_OK) {
+                valid = 0;
+                break;
+            }
+
+            // Responses must be canonical
+            bn_read_bin(z_m, proof[i].z_m, ZKPE_SCALAR_BYTES);
+            bn_read_bin(z_k, proof[i].z_k, ZKPE_SCALAR_BYTES);
+            bn_read_bin(z_r, proof[i].z_r, ZKPE_SCALAR_BYTES);
+            if (bn_cmp(z_m, n) != RLC_LT || bn_cmp(z_k, n) != RLC_LT || bn_cmp(z_r, n) != RLC_LT) {
+                valid = 0;
+                break;
+            }
+
+            zkpe_challenge(e, &st[i], &proof[i], n);
+            csprng_bytes(weights, sizeof(weights));
+            for (j = 0; j < 3; j++) {
+                bn_read_bin(rho[j], weights + j * (ZKPE_WEIGHT_BITS / 8), ZKPE_WEIGHT_BITS / 8);
+            }
+
+            // Coefficients of B and H
+            zkpe_mul_mod(ki[0], rho[1], z_k, n);
+            zkpe_mul_mod(ki[1], rho[2], z_m, n);
+            // Coefficients -rho_j of T_j and -rho_j*e of M1, M2 and C
+            for (j = 0; j < 3; j++) {
+                zkpe_neg_mod(ki[2 + 2 * j], rho[j], n);
+                zkpe_mul_mod(t, rho[j], e, n);
+                zkpe_neg_mod(ki[3 + 2 * j], t, n);
+            }
+            // Accumulate the coefficient rho1*z_k + rho2*z_m + rho3*z_r of P = G
+            zkpe_mul_mod(t, rho[0], z_k, n);
+            bn_add(g, g, t);
+            zkpe_mul_mod(t, rho[1], z_m, n);
+            bn_add(g, g, t);
+            zkpe_mul_mod(t, rho[2], z_r, n);
+            bn_add(g, g, t);
+            bn_mod(g, g, n);
+        }
+
+        if (valid) {
+            ec_curve_get_gen(P[n_points - 1]);
+            bn_copy(k[n_points - 1], g);
+            valid = elgamal_msm(R, (const ec_t *)P, (const bn_t *)k, n_points) == RLC_OK && ec_is_infty(R);
+        }
+    }
+
+    RLC_CATCH_ANY {
+        // Thrown for instance on a T_j that is not a valid point encoding
+        valid = 0;
+    }
+
+    RLC_FINALLY {
+        // Free the memory allocated for variables
+        for (i = 0; i < n_points; i++) {
+            ec_free(P[i]);
+            bn_free(k[i]);
+        }
+        ec_free(R);
+        bn_free(n);
+        bn_free(e);
+        bn_free(t);
+        bn_free(g);
+        bn_free(z_m);
+        bn_free(z_k);
+        bn_free(z_r);
+        for (j = 0; j < 3; j++) {
+            bn_free(rho[j]);
+        }
+        free(P);
+        free(k);
+    }
+
+    return valid ? RLC_OK : RLC_ERR;
+}
+
+/**
+ * The ZKPe verification process for a single reading.
+ *
+ * Returns RLC_OK if the proof is valid for the statement, RLC_ERR otherwise.
+ */
+int zkpe_verify(const zkpe_statement_t *st, const zkpe_proof_t *proof) {
+    return zkpe_check(st, proof, 1);
+}
+
+/**
+ * Verifies n proofs, bisecting on failure to isolate the invalid ones.
+ */
+static size_t zkpe_verify_range(const zkpe_statement_t *st, const zkpe_proof_t *proof, size_t n, unsigned char *valid) {
+    size_t i;
+
+    if (zkpe_check(st, proof, n) == RLC_OK) {
+        for (i = 0; i < n; i++) {
+            valid[i] = 1;
+        }
+        return 0;
+    }
+    if (n == 1) {
+        valid[0] = 0;
+        return 1;
+    }
+    return zkpe_verify_range(st, proof, n / 2, valid) + zkpe_verify_range(st + n / 2, proof + n / 2, n - n / 2, valid + n / 2);
+}
+
+/**
+ * The ZKPe batch verification process, run at ingest for many readings.
+ *
+ * Given:
+ * - st, proof: n statements, possibly from different meters, and their proofs
+ *
+ * Steps:
+ * 1. Split the batch into chunks of at most ZKPE_BATCH_CHUNK proofs.
+ * 2. Check each chunk with a single randomized linear combination, that is
+ *    one multi-scalar multiplication over 8 points per proof.
+ * 3. Bisect a failing chunk until the invalid proofs are isolated.
+ *
+ * Sets valid[i] to 1 for every valid proof and to 0 for every invalid one,
+ * and returns the number of invalid proofs.
+ */
+size_t zkpe_verify_batch(const zkpe_statement_t *st, const zkpe_proof_t *proof, size_t n, unsigned char *valid) {
+    size_t n_invalid = 0;
+    size_t i, chunk;
+
+    for (i = 0; i < n; i += chunk) {
+        chunk = (n - i < ZKPE_BATCH_CHUNK) ? n - i : ZKPE_BATCH_CHUNK;
+        n_invalid += zkpe_verify_range(st + i, proof + i, chunk, valid + i);
+    }
+    return n_invalid;
+}
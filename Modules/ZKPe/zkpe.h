@@ -0,0 +1,57 @@
+#ifndef ZKPE_H
+#define ZKPE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <relic.h>
+
+#include "elgamal.h"
+
+// Serialized sizes of points and scalars on secp256k1
+#define ZKPE_POINT_BYTES 33
+#define ZKPE_SCALAR_BYTES 32
+
+// Prefix bytes of serialized secp256k1-zkp objects (the low bit flags y)
+#define ZKPE_TAG_COMMITMENT 0x08
+#define ZKPE_TAG_GENERATOR 0x0a
+
+/*
+ * A serialized Zero-Knowledge Proof of Equivalence between an ElGamal
+ * ciphertext (M1, M2) = (k*P, m*P + k*B) and a Pedersen commitment
+ * C = m*H + r*G to the same m.
+ */
+typedef struct {
+    uint8_t T1[ZKPE_POINT_BYTES];   // b*P
+    uint8_t T2[ZKPE_POINT_BYTES];   // a*P + b*B
+    uint8_t T3[ZKPE_POINT_BYTES];   // a*H + c*G
+    uint8_t z_m[ZKPE_SCALAR_BYTES]; // a + e*m
+    uint8_t z_k[ZKPE_SCALAR_BYTES]; // b + e*k
+    uint8_t z_r[ZKPE_SCALAR_BYTES]; // c + e*r
+} zkpe_proof_t;
+
+/*
+ * The public statement of one proof. H and C are the 33-byte serializations
+ * produced by secp256k1_generator_serialize for the bulletproof value_gen and
+ * by secp256k1_pedersen_commitment_serialize for the reading's commitment.
+ * The customer and the meter's sequence number of the reading are bound into
+ * the challenge, so a proof cannot be moved to another customer or sequence
+ * number. This does not authenticate them: a prover may choose both freely
+ * for a ciphertext of its own.
+ */
+typedef struct {
+    const ec_t *B;                   // Public key of the ciphertext
+    const elgamal_ciphertext_t *ct;  // Ciphertext (M1, M2)
+    const uint8_t *H;                // Serialized value generator
+    const uint8_t *C;                // Serialized Pedersen commitment
+    uint64_t customer;               // Customer the reading is billed to
+    uint64_t seq;                    // Sequence number of the reading
+} zkpe_statement_t;
+
+int zkpe_read_secp256k1(ec_t R, const uint8_t in[ZKPE_POINT_BYTES], uint8_t tag);
+
+int zkpe_prove(zkpe_proof_t *proof, const zkpe_statement_t *st, const bn_t m, const bn_t k, const uint8_t blind[ZKPE_SCALAR_BYTES]);
+int zkpe_verify(const zkpe_statement_t *st, const zkpe_proof_t *proof);
+size_t zkpe_verify_batch(const zkpe_statement_t *st, const zkpe_proof_t *proof, size_t n, unsigned char *valid);
+
+#endif // ZKPE_H
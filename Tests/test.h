@@ -0,0 +1,37 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+/*
+ * Minimal checks shared by the test drivers. Every driver is one
+ * translation unit, defines its cases as static functions and returns
+ * test_result() from main, so ctest reports a failure by exit status.
+ */
+
+static int test_failures = 0;
+
+// Records a failed check and carries on, so one run reports every failure
+#define TEST_CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+// Runs one case and names it in the output
+#define TEST_RUN(fn) do { \
+        int before = test_failures; \
+        fn(); \
+        printf("%s %s\n", test_failures == before ? "ok  " : "FAIL", #fn); \
+    } while (0)
+
+static int test_result(void) {
+    if (test_failures != 0) {
+        fprintf(stderr, "%d check(s) failed\n", test_failures);
+        return 1;
+    }
+    return 0;
+}
+
+#endif // TEST_H
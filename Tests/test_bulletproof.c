@@ -0,0 +1,171 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "bulletproof.h"
+#include "bulletproof_aggregate.h"
+#include "bulletproof_batch.h"
+#include "test.h"
+
+// Generators of the test context: 2 * 8 commitments of 8 bits, no more
+#define TEST_N_GENS 128
+#define TEST_NBITS 8
+#define TEST_READINGS 5
+
+static bulletproof_context_t *test_context;
+static secp256k1_generator test_value_gen;
+
+static void test_covers(void) {
+    // 2 * n_commits * nbits up to n_gens is covered
+    TEST_CHECK(bulletproof_context_covers(test_context, 1, 1) == 1);
+    TEST_CHECK(bulletproof_context_covers(test_context, 8, 8) == 1);
+    TEST_CHECK(bulletproof_context_covers(test_context, 1, 64) == 1);
+    TEST_CHECK(bulletproof_context_covers(test_context, 64, 1) == 1);
+
+    // n_commits * nbits in (n_gens / 2, n_gens] is not
+    TEST_CHECK(bulletproof_context_covers(test_context, 9, 8) == 0);
+    TEST_CHECK(bulletproof_context_covers(test_context, 16, 8) == 0);
+    TEST_CHECK(bulletproof_context_covers(test_context, 2, 64) == 0);
+    TEST_CHECK(bulletproof_context_covers(test_context, 65, 1) == 0);
+    TEST_CHECK(bulletproof_context_covers(test_context, 128, 1) == 0);
+
+    // Degenerate and overflowing shapes
+    TEST_CHECK(bulletproof_context_covers(test_context, 0, 8) == 0);
+    TEST_CHECK(bulletproof_context_covers(test_context, 1, 0) == 0);
+    TEST_CHECK(bulletproof_context_covers(test_context, 1, 65) == 0);
+    TEST_CHECK(bulletproof_context_covers(test_context, SIZE_MAX, 8) == 0);
+    TEST_CHECK(bulletproof_context_covers(test_context, SIZE_MAX / 16 + 1, 8) == 0);
+    TEST_CHECK(bulletproof_context_covers(test_context, 1, SIZE_MAX) == 0);
+}
+
+static void test_value_gen_default(void) {
+    unsigned char a[33], b[33];
+    secp256k1_generator gen;
+
+    TEST_CHECK(bulletproof_value_gen_default(test_context, &gen) == 1);
+    TEST_CHECK(secp256k1_generator_serialize(test_context->ctx, a, &gen) == 1);
+    TEST_CHECK(secp256k1_generator_serialize(test_context->ctx, b, &test_value_gen) == 1);
+    TEST_CHECK(memcmp(a, b, sizeof(a)) == 0);
+
+    // The cache returns what secp256k1-zkp derives from the seed
+    TEST_CHECK(secp256k1_generator_generate(test_context->ctx, &gen, (const unsigned char *)BULLETPROOF_VALUE_GEN_SEED) == 1);
+    TEST_CHECK(secp256k1_generator_serialize(test_context->ctx, b, &gen) == 1);
+    TEST_CHECK(memcmp(a, b, sizeof(a)) == 0);
+}
+
+/**
+ * Proves TEST_READINGS readings of TEST_NBITS bits with one aggregated proof.
+ *
+ * @return The proof length, or 0 on failure.
+ */
+static size_t test_prove(secp256k1_scratch_space *scratch, unsigned char *proof, secp256k1_pedersen_commitment *commit) {
+    bulletproof_aggregate_t *agg;
+    size_t plen = MAX_PROOF_SIZE;
+    size_t i;
+    int ok = 1;
+
+    agg = bulletproof_aggregate_create(test_context, scratch, &test_value_gen, TEST_NBITS, TEST_READINGS);
+    for (i = 0; i < TEST_READINGS; i++) {
+        ok = ok && bulletproof_aggregate_add(agg, 17 * i + 3, NULL, &commit[i]) == 1;
+    }
+    // Out of range and past the capacity
+    TEST_CHECK(bulletproof_aggregate_add(agg, 1 << TEST_NBITS, NULL, &commit[TEST_READINGS]) == 0);
+    TEST_CHECK(bulletproof_aggregate_add(agg, 0, NULL, &commit[TEST_READINGS]) == 0);
+    ok = ok && bulletproof_aggregate_prove(agg, proof, &plen) == 1;
+    bulletproof_aggregate_destroy(agg);
+
+    return ok ? plen : 0;
+}
+
+static void test_aggregate_verify(void) {
+    secp256k1_scratch_space *scratch = secp256k1_scratch_space_create(test_context->ctx, bulletproof_scratch_size(8, TEST_NBITS, 1));
+    secp256k1_pedersen_commitment commit[16], swapped[16];
+    unsigned char proof[MAX_PROOF_SIZE], bad[MAX_PROOF_SIZE];
+    size_t plen;
+
+    TEST_CHECK(scratch != NULL);
+    plen = test_prove(scratch, proof, commit);
+    TEST_CHECK(plen != 0);
+
+    TEST_CHECK(bulletproof_aggregate_verify(test_context, scratch, proof, plen, commit, TEST_READINGS, TEST_NBITS, &test_value_gen) == 1);
+
+    // Tampered proofs and commitments
+    memcpy(bad, proof, plen);
+    bad[plen / 2] ^= 0x01;
+    TEST_CHECK(bulletproof_aggregate_verify(test_context, scratch, bad, plen, commit, TEST_READINGS, TEST_NBITS, &test_value_gen) == 0);
+    TEST_CHECK(bulletproof_aggregate_verify(test_context, scratch, proof, plen - 1, commit, TEST_READINGS, TEST_NBITS, &test_value_gen) == 0);
+    memcpy(swapped, commit, sizeof(commit));
+    swapped[0] = commit[1];
+    swapped[1] = commit[0];
+    TEST_CHECK(bulletproof_aggregate_verify(test_context, scratch, proof, plen, swapped, TEST_READINGS, TEST_NBITS, &test_value_gen) == 0);
+    TEST_CHECK(bulletproof_aggregate_verify(test_context, scratch, proof, plen, commit, TEST_READINGS - 1, TEST_NBITS, &test_value_gen) == 0);
+    TEST_CHECK(bulletproof_aggregate_verify(test_context, scratch, proof, plen, commit, TEST_READINGS, TEST_NBITS - 1, &test_value_gen) == 0);
+
+    // Shapes the generators cannot cover are rejected without aborting:
+    // 9 readings pad to 16, and 5 readings of 12 bits fit unpadded (60) but
+    // not padded (96)
+    TEST_CHECK(bulletproof_aggregate_verify(test_context, scratch, proof, plen, commit, 9, TEST_NBITS, &test_value_gen) == 0);
+    TEST_CHECK(bulletproof_aggregate_verify(test_context, scratch, proof, plen, commit, TEST_READINGS, 12, &test_value_gen) == 0);
+    TEST_CHECK(bulletproof_aggregate_verify(test_context, scratch, proof, plen, commit, 0, TEST_NBITS, &test_value_gen) == 0);
+    TEST_CHECK(bulletproof_aggregate_verify(test_context, scratch, proof, plen, commit, TEST_READINGS, 0, &test_value_gen) == 0);
+    TEST_CHECK(bulletproof_aggregate_verify(test_context, scratch, proof, plen, commit, TEST_READINGS, 65, &test_value_gen) == 0);
+    TEST_CHECK(bulletproof_aggregate_verify(test_context, scratch, proof, plen, commit, SIZE_MAX, TEST_NBITS, &test_value_gen) == 0);
+
+    secp256k1_scratch_space_destroy(scratch);
+}
+
+static void test_batch_verify(void) {
+    size_t scratch_size = bulletproof_scratch_size(8, TEST_NBITS, 2);
+    secp256k1_scratch_space *scratch = secp256k1_scratch_space_create(test_context->ctx, scratch_size);
+    secp256k1_pedersen_commitment commit[16];
+    unsigned char proof[MAX_PROOF_SIZE], bad[MAX_PROOF_SIZE];
+    unsigned char valid[6];
+    bulletproof_batch_t *batch;
+    size_t plen;
+
+    TEST_CHECK(scratch != NULL);
+    plen = test_prove(scratch, proof, commit);
+    TEST_CHECK(plen != 0);
+    // The batch verifier takes the padded commitments
+    TEST_CHECK(bulletproof_aggregate_pad(test_context, commit, TEST_READINGS, &test_value_gen) == 1);
+    memcpy(bad, proof, plen);
+    bad[plen / 2] ^= 0x01;
+
+    batch = bulletproof_batch_create(test_context, scratch, scratch_size, 2);
+    bulletproof_batch_add(batch, proof, plen, commit, 8, TEST_NBITS, &test_value_gen);
+    bulletproof_batch_add(batch, bad, plen, commit, 8, TEST_NBITS, &test_value_gen);
+    bulletproof_batch_add(batch, proof, plen, commit, 8, TEST_NBITS, &test_value_gen);
+    // Uncovered shapes: 9 * 8 and 6 * 12 lie in (n_gens / 2, n_gens]
+    bulletproof_batch_add(batch, proof, plen, commit, 9, TEST_NBITS, &test_value_gen);
+    bulletproof_batch_add(batch, proof, plen, commit, 6, 12, &test_value_gen);
+    bulletproof_batch_add(batch, proof, plen, commit, 1, 65, &test_value_gen);
+    TEST_CHECK(batch->n_items == 6);
+
+    memset(valid, 0xFF, sizeof(valid));
+    TEST_CHECK(bulletproof_batch_verify(batch, valid) == 4);
+    TEST_CHECK(valid[0] == 1 && valid[1] == 0 && valid[2] == 1);
+    TEST_CHECK(valid[3] == 0 && valid[4] == 0 && valid[5] == 0);
+
+    // A cleared batch verifies the valid proof alone
+    bulletproof_batch_clear(batch);
+    bulletproof_batch_add(batch, proof, plen, commit, 8, TEST_NBITS, &test_value_gen);
+    TEST_CHECK(bulletproof_batch_verify(batch, valid) == 0);
+    TEST_CHECK(valid[0] == 1);
+
+    bulletproof_batch_destroy(batch);
+    secp256k1_scratch_space_destroy(scratch);
+}
+
+int main(void) {
+    test_context = bulletproof_context_create(TEST_N_GENS);
+    if (bulletproof_value_gen_default(test_context, &test_value_gen) != 1) {
+        return 1;
+    }
+
+    TEST_RUN(test_covers);
+    TEST_RUN(test_value_gen_default);
+    TEST_RUN(test_aggregate_verify);
+    TEST_RUN(test_batch_verify);
+
+    bulletproof_context_destroy(test_context);
+    return test_result();
+}
@@ -0,0 +1,303 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <relic.h>
+
+#include "ingest_ledger.h"
+#include "test.h"
+
+#define TEST_PATH "test_ledger.ckpt"
+
+static bn_t test_s;
+static ec_t test_B;
+
+/**
+ * Encrypts a small reading under the test key.
+ */
+static void test_encrypt(elgamal_ciphertext_t *ct, dig_t value) {
+    bn_t m;
+
+    bn_null(m);
+    bn_new(m);
+    bn_set_dig(m, value);
+    TEST_CHECK(elgamal_ciphertext_init(ct) == RLC_OK);
+    TEST_CHECK(elgamal_encrypt(test_B, m, ct->M1, ct->M2) == RLC_OK);
+    bn_free(m);
+}
+
+/**
+ * Checks that the running sum of a customer equals the given ciphertext.
+ */
+static void test_check_sum(ingest_ledger_t *ledger, uint64_t customer, const elgamal_ciphertext_t *expected, uint64_t n_readings) {
+    elgamal_ciphertext_t sum;
+    uint64_t n = 0;
+
+    TEST_CHECK(elgamal_ciphertext_init(&sum) == RLC_OK);
+    TEST_CHECK(ingest_ledger_get(ledger, customer, &sum, &n) == RLC_OK);
+    TEST_CHECK(n == n_readings);
+    TEST_CHECK(ec_cmp(sum.M1, expected->M1) == RLC_EQ);
+    TEST_CHECK(ec_cmp(sum.M2, expected->M2) == RLC_EQ);
+    elgamal_ciphertext_free(&sum);
+}
+
+static uint8_t *test_read(const char *path, size_t *len) {
+    uint8_t *image;
+    FILE *file = fopen(path, "rb");
+    long size;
+
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    image = (uint8_t *)malloc((size_t)size);
+    if (image != NULL && fread(image, 1, (size_t)size, file) != (size_t)size) {
+        free(image);
+        image = NULL;
+    }
+    fclose(file);
+    *len = (size_t)size;
+    return image;
+}
+
+static void test_write(const char *path, const uint8_t *image, size_t len) {
+    FILE *file = fopen(path, "wb");
+
+    TEST_CHECK(file != NULL);
+    if (file != NULL) {
+        TEST_CHECK(fwrite(image, 1, len, file) == len);
+        fclose(file);
+    }
+}
+
+/**
+ * Checks that a checkpoint image is rejected and leaves the ledger empty.
+ */
+static void test_check_rejected(const uint8_t *image, size_t len) {
+    ingest_ledger_t ledger;
+
+    test_write(TEST_PATH ".bad", image, len);
+    TEST_CHECK(ingest_ledger_init(&ledger) == RLC_OK);
+    TEST_CHECK(ingest_ledger_load(&ledger, TEST_PATH ".bad") == RLC_ERR);
+    TEST_CHECK(ledger.n_accounts == 0 && ledger.n_readings == 0);
+    ingest_ledger_free(&ledger);
+    remove(TEST_PATH ".bad");
+}
+
+static void test_ledger_fold(void) {
+    ingest_ledger_t ledger;
+    elgamal_ciphertext_t ct[3], expected;
+
+    test_encrypt(&ct[0], 3);
+    test_encrypt(&ct[1], 4);
+    test_encrypt(&ct[2], 5);
+    TEST_CHECK(elgamal_ciphertext_init(&expected) == RLC_OK);
+    ec_add(expected.M1, ct[0].M1, ct[1].M1);
+    ec_add(expected.M2, ct[0].M2, ct[1].M2);
+
+    TEST_CHECK(ingest_ledger_init(&ledger) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 1, &ct[0]) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 2, &ct[1]) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 9, 1, &ct[2]) == RLC_OK);
+    TEST_CHECK(ledger.n_accounts == 2 && ledger.n_readings == 3);
+    test_check_sum(&ledger, 7, &expected, 2);
+    test_check_sum(&ledger, 9, &ct[2], 1);
+    TEST_CHECK(ingest_ledger_get(&ledger, 8, &expected, NULL) == RLC_ERR);
+
+    ingest_ledger_free(&ledger);
+    elgamal_ciphertext_free(&expected);
+    elgamal_ciphertext_free(&ct[0]);
+    elgamal_ciphertext_free(&ct[1]);
+    elgamal_ciphertext_free(&ct[2]);
+}
+
+static void test_ledger_replay(void) {
+    ingest_ledger_t ledger;
+    elgamal_ciphertext_t ct;
+
+    test_encrypt(&ct, 1);
+    TEST_CHECK(ingest_ledger_init(&ledger) == RLC_OK);
+
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 1000, &ct) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 1000, &ct) == INGEST_LEDGER_REPLAY);
+    // The sequence numbers of one customer do not affect another
+    TEST_CHECK(ingest_ledger_add(&ledger, 9, 1000, &ct) == RLC_OK);
+
+    // Out of order within the window, then replayed
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 1000 - INGEST_LEDGER_WINDOW + 1, &ct) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 1000 - INGEST_LEDGER_WINDOW + 1, &ct) == INGEST_LEDGER_REPLAY);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 999, &ct) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 999, &ct) == INGEST_LEDGER_REPLAY);
+
+    // Older than the window
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 1000 - INGEST_LEDGER_WINDOW, &ct) == INGEST_LEDGER_REPLAY);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 0, &ct) == INGEST_LEDGER_REPLAY);
+
+    // Sliding the window forgets what falls out of it and nothing else
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 1001, &ct) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 1001 - INGEST_LEDGER_WINDOW, &ct) == INGEST_LEDGER_REPLAY);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 1000, &ct) == INGEST_LEDGER_REPLAY);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 1002, &ct) == RLC_OK);
+
+    // A jump past the whole window
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 5000, &ct) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 5000 - INGEST_LEDGER_WINDOW + 2, &ct) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 1002, &ct) == INGEST_LEDGER_REPLAY);
+
+    TEST_CHECK(ledger.n_accounts == 2 && ledger.n_readings == 8);
+
+    ingest_ledger_free(&ledger);
+    elgamal_ciphertext_free(&ct);
+}
+
+static void test_ledger_checkpoint(void) {
+    ingest_ledger_t ledger, restored;
+    elgamal_ciphertext_t ct[2], expected;
+    uint8_t *image, *snapshot;
+    size_t len = 0, snapshot_len;
+
+    test_encrypt(&ct[0], 11);
+    test_encrypt(&ct[1], 12);
+    TEST_CHECK(elgamal_ciphertext_init(&expected) == RLC_OK);
+    ec_add(expected.M1, ct[0].M1, ct[1].M1);
+    ec_add(expected.M2, ct[0].M2, ct[1].M2);
+
+    TEST_CHECK(ingest_ledger_init(&ledger) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 1, &ct[0]) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 3, &ct[1]) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 9, 1, &ct[1]) == RLC_OK);
+    TEST_CHECK(ingest_ledger_save(&ledger, TEST_PATH) == RLC_OK);
+
+    // The file is exactly the snapshot image
+    image = test_read(TEST_PATH, &len);
+    TEST_CHECK(image != NULL);
+    TEST_CHECK(len == INGEST_LEDGER_HEADER + 2 * INGEST_LEDGER_RECORD + INGEST_LEDGER_DIGEST);
+    TEST_CHECK(ingest_ledger_snapshot(&ledger, &snapshot, &snapshot_len) == RLC_OK);
+    TEST_CHECK(snapshot_len == len && memcmp(snapshot, image, len) == 0);
+    TEST_CHECK(memcmp(image, INGEST_LEDGER_MAGIC, 8) == 0 && image[11] == INGEST_LEDGER_VERSION);
+    free(snapshot);
+
+    TEST_CHECK(ingest_ledger_init(&restored) == RLC_OK);
+    TEST_CHECK(ingest_ledger_load(&restored, TEST_PATH) == RLC_OK);
+    TEST_CHECK(restored.n_accounts == 2 && restored.n_readings == 3);
+    test_check_sum(&restored, 7, &expected, 2);
+    test_check_sum(&restored, 9, &ct[1], 1);
+
+    // The restored windows reject readings already in the checkpoint
+    TEST_CHECK(ingest_ledger_add(&restored, 7, 3, &ct[0]) == INGEST_LEDGER_REPLAY);
+    TEST_CHECK(ingest_ledger_add(&restored, 9, 1, &ct[0]) == INGEST_LEDGER_REPLAY);
+    TEST_CHECK(ingest_ledger_add(&restored, 7, 2, &ct[0]) == RLC_OK);
+
+    // Only an empty ledger can be restored
+    TEST_CHECK(ingest_ledger_load(&restored, TEST_PATH) == RLC_ERR);
+    TEST_CHECK(ingest_ledger_load(&ledger, TEST_PATH) == RLC_ERR);
+
+    ingest_ledger_free(&restored);
+    ingest_ledger_free(&ledger);
+    free(image);
+    remove(TEST_PATH);
+    elgamal_ciphertext_free(&expected);
+    elgamal_ciphertext_free(&ct[0]);
+    elgamal_ciphertext_free(&ct[1]);
+}
+
+static void test_ledger_corrupt(void) {
+    ingest_ledger_t ledger;
+    elgamal_ciphertext_t ct;
+    uint8_t *image, *bad;
+    size_t len;
+
+    test_encrypt(&ct, 2);
+    TEST_CHECK(ingest_ledger_init(&ledger) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 7, 1, &ct) == RLC_OK);
+    TEST_CHECK(ingest_ledger_add(&ledger, 9, 1, &ct) == RLC_OK);
+    TEST_CHECK(ingest_ledger_snapshot(&ledger, &image, &len) == RLC_OK);
+    ingest_ledger_free(&ledger);
+    elgamal_ciphertext_free(&ct);
+
+    bad = (uint8_t *)malloc(len);
+    TEST_CHECK(bad != NULL);
+    if (image == NULL || bad == NULL) {
+        free(bad);
+        return;
+    }
+
+    // A missing file
+    TEST_CHECK(ingest_ledger_init(&ledger) == RLC_OK);
+    remove(TEST_PATH ".missing");
+    TEST_CHECK(ingest_ledger_load(&ledger, TEST_PATH ".missing") == RLC_ERR);
+    ingest_ledger_free(&ledger);
+
+    // Truncated, down to less than a header
+    test_check_rejected(image, len - 1);
+    test_check_rejected(image, len - INGEST_LEDGER_RECORD);
+    test_check_rejected(image, INGEST_LEDGER_HEADER);
+
+    // A flipped bit anywhere, caught by the digest
+    memcpy(bad, image, len);
+    bad[INGEST_LEDGER_HEADER + 30] ^= 0x01;
+    test_check_rejected(bad, len);
+    memcpy(bad, image, len);
+    bad[len - 1] ^= 0x80;
+    test_check_rejected(bad, len);
+
+    // Header fields changed under a recomputed digest
+    memcpy(bad, image, len);
+    bad[0] = 'X';
+    md_map_sh256(bad + len - INGEST_LEDGER_DIGEST, bad, len - INGEST_LEDGER_DIGEST);
+    test_check_rejected(bad, len);
+
+    memcpy(bad, image, len);
+    bad[11] = INGEST_LEDGER_VERSION - 1;
+    md_map_sh256(bad + len - INGEST_LEDGER_DIGEST, bad, len - INGEST_LEDGER_DIGEST);
+    test_check_rejected(bad, len);
+
+    memcpy(bad, image, len);
+    bad[23]++;
+    md_map_sh256(bad + len - INGEST_LEDGER_DIGEST, bad, len - INGEST_LEDGER_DIGEST);
+    test_check_rejected(bad, len);
+
+    memcpy(bad, image, len);
+    bad[31]++;
+    md_map_sh256(bad + len - INGEST_LEDGER_DIGEST, bad, len - INGEST_LEDGER_DIGEST);
+    test_check_rejected(bad, len);
+
+    // The same customer twice
+    memcpy(bad, image, len);
+    memcpy(bad + INGEST_LEDGER_HEADER + INGEST_LEDGER_RECORD, bad + INGEST_LEDGER_HEADER, 8);
+    md_map_sh256(bad + len - INGEST_LEDGER_DIGEST, bad, len - INGEST_LEDGER_DIGEST);
+    test_check_rejected(bad, len);
+
+    free(bad);
+    free(image);
+}
+
+int main(void) {
+    int result;
+
+    if (core_init() != RLC_OK) {
+        return 1;
+    }
+    ep_param_set(SECG_K256);
+    bn_null(test_s);
+    ec_null(test_B);
+    bn_new(test_s);
+    ec_new(test_B);
+    if (elgamal_keygen(test_s, test_B) != RLC_OK) {
+        return 1;
+    }
+
+    TEST_RUN(test_ledger_fold);
+    TEST_RUN(test_ledger_replay);
+    TEST_RUN(test_ledger_checkpoint);
+    TEST_RUN(test_ledger_corrupt);
+
+    result = test_result();
+    bn_free(test_s);
+    ec_free(test_B);
+    core_clean();
+    return result;
+}
@@ -0,0 +1,129 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <relic.h>
+
+#include "pedersen_batch.h"
+#include "csprng.h"
+#include "secp256k1_generator.h"
+#include "secp256k1_commitment.h"
+#include "test.h"
+
+static secp256k1_context *test_ctx;
+
+/**
+ * Commits to n random values with pedersen_batch_commit and checks every
+ * serialized commitment against secp256k1_pedersen_commit. The first value
+ * is 0 and the second the largest 64-bit one.
+ */
+static void test_compare(const secp256k1_generator *value_gen, size_t n) {
+    secp256k1_pedersen_commitment *commits, expected;
+    uint8_t a[ZKPE_POINT_BYTES], b[ZKPE_POINT_BYTES];
+    pedersen_batch_t batch;
+    uint8_t *blinds;
+    uint64_t *values;
+    size_t i, mismatches = 0;
+
+    commits = (secp256k1_pedersen_commitment *)malloc(n * sizeof(*commits));
+    blinds = (uint8_t *)malloc(n * ZKPE_SCALAR_BYTES);
+    values = (uint64_t *)malloc(n * sizeof(*values));
+    TEST_CHECK(commits != NULL && blinds != NULL && values != NULL);
+    if (commits == NULL || blinds == NULL || values == NULL) {
+        free(commits);
+        free(blinds);
+        free(values);
+        return;
+    }
+
+    csprng_bytes(blinds, n * ZKPE_SCALAR_BYTES);
+    csprng_bytes(values, n * sizeof(*values));
+    for (i = 0; i < n; i++) {
+        // Keep every blinding factor below the group order
+        blinds[i * ZKPE_SCALAR_BYTES] &= 0x7F;
+    }
+    values[0] = 0;
+    if (n > 1) {
+        values[1] = UINT64_MAX;
+    }
+
+    TEST_CHECK(pedersen_batch_init(&batch, test_ctx, value_gen, &secp256k1_generator_const_g) == RLC_OK);
+    TEST_CHECK(pedersen_batch_commit(&batch, test_ctx, commits, blinds, values, n) == RLC_OK);
+    for (i = 0; i < n; i++) {
+        TEST_CHECK(secp256k1_pedersen_commit(test_ctx, &expected, blinds + i * ZKPE_SCALAR_BYTES, values[i], value_gen, &secp256k1_generator_const_g) == 1);
+        TEST_CHECK(secp256k1_pedersen_commitment_serialize(test_ctx, a, &commits[i]) == 1);
+        TEST_CHECK(secp256k1_pedersen_commitment_serialize(test_ctx, b, &expected) == 1);
+        mismatches += memcmp(a, b, ZKPE_POINT_BYTES) != 0;
+    }
+    TEST_CHECK(mismatches == 0);
+    pedersen_batch_free(&batch);
+
+    free(commits);
+    free(blinds);
+    free(values);
+}
+
+static void test_commit_const_h(void) {
+    test_compare(&secp256k1_generator_const_h, 1);
+    test_compare(&secp256k1_generator_const_h, 2);
+    test_compare(&secp256k1_generator_const_h, PEDERSEN_BATCH_CHUNK - 1);
+    test_compare(&secp256k1_generator_const_h, PEDERSEN_BATCH_CHUNK);
+    test_compare(&secp256k1_generator_const_h, PEDERSEN_BATCH_CHUNK + 1);
+    test_compare(&secp256k1_generator_const_h, 2 * PEDERSEN_BATCH_CHUNK + 3);
+}
+
+static void test_commit_generated(void) {
+    unsigned char seed[32];
+    secp256k1_generator gen;
+    int i;
+
+    // Generators derived from seeds have either tag, so both residuosities
+    // of the value generator are decoded
+    for (i = 0; i < 4; i++) {
+        memset(seed, i, sizeof(seed));
+        TEST_CHECK(secp256k1_generator_generate(test_ctx, &gen, seed) == 1);
+        test_compare(&gen, PEDERSEN_BATCH_CHUNK + 1);
+    }
+}
+
+static void test_commit_rejected(void) {
+    secp256k1_pedersen_commitment commits[2];
+    uint8_t blinds[2 * ZKPE_SCALAR_BYTES];
+    uint64_t values[2] = { 1, 2 };
+    pedersen_batch_t batch;
+
+    TEST_CHECK(pedersen_batch_init(&batch, test_ctx, &secp256k1_generator_const_h, &secp256k1_generator_const_g) == RLC_OK);
+
+    // A blinding factor not below the group order, as secp256k1_pedersen_commit
+    memset(blinds, 0x01, sizeof(blinds));
+    memset(blinds + ZKPE_SCALAR_BYTES, 0xFF, ZKPE_SCALAR_BYTES);
+    TEST_CHECK(pedersen_batch_commit(&batch, test_ctx, commits, blinds, values, 2) == RLC_ERR);
+    TEST_CHECK(secp256k1_pedersen_commit(test_ctx, &commits[1], blinds + ZKPE_SCALAR_BYTES, values[1], &secp256k1_generator_const_h, &secp256k1_generator_const_g) == 0);
+
+    // A zero-length batch does nothing
+    TEST_CHECK(pedersen_batch_commit(&batch, test_ctx, commits, blinds, values, 0) == RLC_OK);
+
+    pedersen_batch_free(&batch);
+}
+
+int main(void) {
+    int result;
+
+    if (core_init() != RLC_OK) {
+        return 1;
+    }
+    ep_param_set(SECG_K256);
+    test_ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    if (test_ctx == NULL) {
+        return 1;
+    }
+
+    TEST_RUN(test_commit_const_h);
+    TEST_RUN(test_commit_generated);
+    TEST_RUN(test_commit_rejected);
+
+    result = test_result();
+    secp256k1_context_destroy(test_ctx);
+    core_clean();
+    return result;
+}
@@ -0,0 +1,257 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <relic.h>
+
+#include "elgamal_threshold.h"
+#include "elgamal_dlog.h"
+#include "test.h"
+
+// 3-of-5 sharing of the test key, decrypting readings below TEST_MAX
+#define TEST_N 5
+#define TEST_T 3
+#define TEST_MAX ((uint64_t)1 << 16)
+#define TEST_M 4242
+
+static elgamal_share_t test_shares[TEST_N];
+static elgamal_ciphertext_t test_ct;
+static ec_t test_B;
+
+/**
+ * Partially decrypts the test ciphertext with the shares listed in idx,
+ * checks every proof and combines the partials.
+ *
+ * @return The result of elgamal_threshold_combine, with the plaintext in m.
+ */
+static int test_combine(bn_t m, const size_t *idx, size_t n) {
+    elgamal_partial_t partials[TEST_N];
+    size_t i;
+    int result;
+
+    for (i = 0; i < n; i++) {
+        TEST_CHECK(elgamal_partial_init(&partials[i]) == RLC_OK);
+        TEST_CHECK(elgamal_partial_decrypt(&partials[i], &test_shares[idx[i]], &test_ct) == RLC_OK);
+        TEST_CHECK(elgamal_partial_verify(&partials[i], test_shares[idx[i]].V, &test_ct) == RLC_OK);
+    }
+    result = elgamal_threshold_combine(m, &test_ct, partials, n);
+    for (i = 0; i < n; i++) {
+        elgamal_partial_free(&partials[i]);
+    }
+    return result;
+}
+
+static void test_recover(void) {
+    static const size_t subsets[][TEST_T] = { { 0, 1, 2 }, { 4, 2, 0 }, { 1, 3, 4 }, { 3, 0, 4 } };
+    static const size_t all[TEST_N] = { 4, 3, 2, 1, 0 };
+    static const size_t repeated[TEST_T] = { 1, 2, 1 };
+    size_t i;
+    bn_t m;
+
+    bn_null(m);
+    bn_new(m);
+
+    // Any t shares, in any order, recover the plaintext, and so do all n
+    for (i = 0; i < sizeof(subsets) / sizeof(subsets[0]); i++) {
+        bn_zero(m);
+        TEST_CHECK(test_combine(m, subsets[i], TEST_T) == RLC_OK);
+        TEST_CHECK(bn_cmp_dig(m, TEST_M) == RLC_EQ);
+    }
+    bn_zero(m);
+    TEST_CHECK(test_combine(m, all, TEST_N) == RLC_OK);
+    TEST_CHECK(bn_cmp_dig(m, TEST_M) == RLC_EQ);
+
+    // t - 1 shares are not enough, and a share counted twice is rejected
+    TEST_CHECK(test_combine(m, subsets[1], TEST_T - 1) == RLC_ERR);
+    TEST_CHECK(test_combine(m, repeated, TEST_T) == RLC_ERR);
+    TEST_CHECK(elgamal_threshold_combine(m, &test_ct, NULL, 0) == RLC_ERR);
+
+    bn_free(m);
+}
+
+static void test_split(void) {
+    elgamal_share_t shares[TEST_N];
+    elgamal_partial_t partials[TEST_T];
+    elgamal_ciphertext_t ct;
+    bn_t s, m;
+    ec_t B;
+    size_t i;
+
+    bn_null(s);
+    bn_null(m);
+    ec_null(B);
+    bn_new(s);
+    bn_new(m);
+    ec_new(B);
+    TEST_CHECK(elgamal_ciphertext_init(&ct) == RLC_OK);
+    for (i = 0; i < TEST_N; i++) {
+        TEST_CHECK(elgamal_share_init(&shares[i]) == RLC_OK);
+    }
+
+    // Splitting an existing key keeps ciphertexts made for it decryptable
+    TEST_CHECK(elgamal_keygen(s, B) == RLC_OK);
+    bn_set_dig(m, 77);
+    TEST_CHECK(elgamal_encrypt(B, m, ct.M1, ct.M2) == RLC_OK);
+    TEST_CHECK(elgamal_threshold_split(shares, TEST_N, TEST_T, s) == RLC_OK);
+    for (i = 0; i < TEST_T; i++) {
+        TEST_CHECK(elgamal_partial_init(&partials[i]) == RLC_OK);
+        TEST_CHECK(elgamal_partial_decrypt(&partials[i], &shares[TEST_N - 1 - i], &ct) == RLC_OK);
+    }
+    bn_zero(m);
+    TEST_CHECK(elgamal_threshold_combine(m, &ct, partials, TEST_T) == RLC_OK);
+    TEST_CHECK(bn_cmp_dig(m, 77) == RLC_EQ);
+
+    // Thresholds outside [1, n_shares]
+    TEST_CHECK(elgamal_threshold_split(shares, TEST_N, 0, s) == RLC_ERR);
+    TEST_CHECK(elgamal_threshold_split(shares, TEST_N, TEST_N + 1, s) == RLC_ERR);
+
+    for (i = 0; i < TEST_T; i++) {
+        elgamal_partial_free(&partials[i]);
+    }
+    for (i = 0; i < TEST_N; i++) {
+        elgamal_share_free(&shares[i]);
+    }
+    elgamal_ciphertext_free(&ct);
+    bn_free(s);
+    bn_free(m);
+    ec_free(B);
+}
+
+static void test_partial_verify(void) {
+    elgamal_partial_t partial;
+    elgamal_share_t forged;
+    ec_t P;
+
+    ec_null(P);
+    ec_new(P);
+    ec_curve_get_gen(P);
+    TEST_CHECK(elgamal_partial_init(&partial) == RLC_OK);
+    TEST_CHECK(elgamal_share_init(&forged) == RLC_OK);
+
+    // A partial is only accepted under the key of the share behind it
+    TEST_CHECK(elgamal_partial_decrypt(&partial, &test_shares[1], &test_ct) == RLC_OK);
+    TEST_CHECK(elgamal_partial_verify(&partial, test_shares[1].V, &test_ct) == RLC_OK);
+    TEST_CHECK(elgamal_partial_verify(&partial, test_shares[0].V, &test_ct) == RLC_ERR);
+
+    // D_i made with the wrong share under node 0's index and key
+    forged.index = test_shares[0].index;
+    bn_copy(forged.s, test_shares[1].s);
+    ec_copy(forged.V, test_shares[0].V);
+    TEST_CHECK(elgamal_partial_decrypt(&partial, &forged, &test_ct) == RLC_OK);
+    TEST_CHECK(elgamal_partial_verify(&partial, test_shares[0].V, &test_ct) == RLC_ERR);
+
+    // A valid proof with D_i shifted or claimed by another index
+    TEST_CHECK(elgamal_partial_decrypt(&partial, &test_shares[0], &test_ct) == RLC_OK);
+    partial.index = test_shares[2].index;
+    TEST_CHECK(elgamal_partial_verify(&partial, test_shares[0].V, &test_ct) == RLC_ERR);
+    partial.index = test_shares[0].index;
+    ec_add(partial.D, partial.D, P);
+    ec_norm(partial.D, partial.D);
+    TEST_CHECK(elgamal_partial_verify(&partial, test_shares[0].V, &test_ct) == RLC_ERR);
+
+    elgamal_share_free(&forged);
+    elgamal_partial_free(&partial);
+    ec_free(P);
+}
+
+static void test_share_read(void) {
+    uint8_t buf[ELGAMAL_SHARE_BYTES], bad[ELGAMAL_SHARE_BYTES];
+    elgamal_share_t share;
+
+    TEST_CHECK(elgamal_share_init(&share) == RLC_OK);
+    TEST_CHECK(elgamal_share_write(buf, &test_shares[3]) == RLC_OK);
+    TEST_CHECK(elgamal_share_read(&share, buf) == RLC_OK);
+    TEST_CHECK(share.index == test_shares[3].index);
+    TEST_CHECK(bn_cmp(share.s, test_shares[3].s) == RLC_EQ);
+    TEST_CHECK(ec_cmp(share.V, test_shares[3].V) == RLC_EQ);
+
+    // Index 0 is the secret itself, never a share
+    memcpy(bad, buf, sizeof(bad));
+    memset(bad, 0, 4);
+    TEST_CHECK(elgamal_share_read(&share, bad) == RLC_ERR);
+
+    // s_i not below the group order
+    memcpy(bad, buf, sizeof(bad));
+    memset(bad + 4, 0xFF, ELGAMAL_SCALAR_BYTES);
+    TEST_CHECK(elgamal_share_read(&share, bad) == RLC_ERR);
+
+    // s_i of another share with this V_i
+    TEST_CHECK(elgamal_share_write(bad, &test_shares[2]) == RLC_OK);
+    memcpy(bad + 4 + ELGAMAL_SCALAR_BYTES, buf + 4 + ELGAMAL_SCALAR_BYTES, ELGAMAL_POINT_BYTES);
+    TEST_CHECK(elgamal_share_read(&share, bad) == RLC_ERR);
+
+    elgamal_share_free(&share);
+}
+
+static void test_partial_read(void) {
+    uint8_t buf[ELGAMAL_PARTIAL_BYTES], bad[ELGAMAL_PARTIAL_BYTES];
+    elgamal_partial_t partial, copy;
+
+    TEST_CHECK(elgamal_partial_init(&partial) == RLC_OK);
+    TEST_CHECK(elgamal_partial_init(&copy) == RLC_OK);
+    TEST_CHECK(elgamal_partial_decrypt(&partial, &test_shares[4], &test_ct) == RLC_OK);
+    TEST_CHECK(elgamal_partial_write(buf, &partial) == RLC_OK);
+    TEST_CHECK(elgamal_partial_read(&copy, buf) == RLC_OK);
+    TEST_CHECK(copy.index == partial.index);
+    TEST_CHECK(elgamal_partial_verify(&copy, test_shares[4].V, &test_ct) == RLC_OK);
+
+    memcpy(bad, buf, sizeof(bad));
+    memset(bad, 0, 4);
+    TEST_CHECK(elgamal_partial_read(&copy, bad) == RLC_ERR);
+
+    // e or z not below the group order
+    memcpy(bad, buf, sizeof(bad));
+    memset(bad + 4 + ELGAMAL_POINT_BYTES, 0xFF, ELGAMAL_SCALAR_BYTES);
+    TEST_CHECK(elgamal_partial_read(&copy, bad) == RLC_ERR);
+    memcpy(bad, buf, sizeof(bad));
+    memset(bad + 4 + ELGAMAL_POINT_BYTES + ELGAMAL_SCALAR_BYTES, 0xFF, ELGAMAL_SCALAR_BYTES);
+    TEST_CHECK(elgamal_partial_read(&copy, bad) == RLC_ERR);
+
+    elgamal_partial_free(&copy);
+    elgamal_partial_free(&partial);
+}
+
+int main(void) {
+    int result;
+    size_t i;
+    bn_t m;
+
+    if (core_init() != RLC_OK) {
+        return 1;
+    }
+    ep_param_set(SECG_K256);
+    if (elgamal_dlog_setup(TEST_MAX, 0) != RLC_OK) {
+        return 1;
+    }
+
+    bn_null(m);
+    ec_null(test_B);
+    bn_new(m);
+    ec_new(test_B);
+    for (i = 0; i < TEST_N; i++) {
+        if (elgamal_share_init(&test_shares[i]) != RLC_OK) {
+            return 1;
+        }
+    }
+    bn_set_dig(m, TEST_M);
+    if (elgamal_ciphertext_init(&test_ct) != RLC_OK
+        || elgamal_threshold_keygen(test_shares, TEST_N, TEST_T, test_B) != RLC_OK
+        || elgamal_encrypt(test_B, m, test_ct.M1, test_ct.M2) != RLC_OK) {
+        return 1;
+    }
+
+    TEST_RUN(test_recover);
+    TEST_RUN(test_split);
+    TEST_RUN(test_partial_verify);
+    TEST_RUN(test_share_read);
+    TEST_RUN(test_partial_read);
+
+    result = test_result();
+    for (i = 0; i < TEST_N; i++) {
+        elgamal_share_free(&test_shares[i]);
+    }
+    elgamal_ciphertext_free(&test_ct);
+    bn_free(m);
+    ec_free(test_B);
+    core_clean();
+    return result;
+}
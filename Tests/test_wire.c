@@ -0,0 +1,298 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <relic.h>
+
+#include "wire.h"
+#include "test.h"
+
+#define TEST_PLEN 4
+
+static const uint8_t test_proof[TEST_PLEN] = { 0xAA, 0xBB, 0xCC, 0xDD };
+
+/**
+ * Builds a well-formed bundle by hand: every point carries a valid tag byte
+ * and otherwise counts up, so each field can be recognized after parsing.
+ *
+ * @return The size of the bundle in bytes.
+ */
+static size_t test_bundle(uint8_t *out, uint64_t customer, uint64_t seq) {
+    size_t size = WIRE_BUNDLE_FIXED + TEST_PLEN;
+    uint8_t *zkpe = out + WIRE_BUNDLE_HEADER + WIRE_CIPHERTEXT_BYTES + WIRE_POINT_BYTES;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        out[i] = (uint8_t)i;
+    }
+    out[0] = WIRE_VERSION;
+    out[1] = WIRE_KIND_BUNDLE;
+    out[2] = 0;
+    out[3] = TEST_PLEN;
+    for (i = 0; i < 8; i++) {
+        out[4 + i] = (uint8_t)(customer >> (56 - 8 * i));
+        out[12 + i] = (uint8_t)(seq >> (56 - 8 * i));
+    }
+    out[WIRE_BUNDLE_HEADER] = 0x02;
+    out[WIRE_BUNDLE_HEADER + WIRE_POINT_BYTES] = 0x03;
+    out[WIRE_BUNDLE_HEADER + WIRE_CIPHERTEXT_BYTES] = ZKPE_TAG_COMMITMENT | 1;
+    zkpe[0] = 0x02;
+    zkpe[WIRE_POINT_BYTES] = 0x03;
+    zkpe[2 * WIRE_POINT_BYTES] = 0x02;
+    memcpy(out + WIRE_BUNDLE_FIXED, test_proof, TEST_PLEN);
+
+    return size;
+}
+
+static void test_bundle_parse(void) {
+    uint8_t buf[WIRE_BUNDLE_FIXED + TEST_PLEN + 8];
+    wire_bundle_t bundle;
+    size_t size = test_bundle(buf, 0x0102030405060708ULL, 0x1112131415161718ULL);
+
+    TEST_CHECK(size == 318);
+    TEST_CHECK(wire_bundle_size(TEST_PLEN) == size);
+    TEST_CHECK(wire_bundle_parse(&bundle, buf, size) == size);
+    TEST_CHECK(bundle.customer == 0x0102030405060708ULL);
+    TEST_CHECK(bundle.seq == 0x1112131415161718ULL);
+    TEST_CHECK(bundle.ct == buf + 20);
+    TEST_CHECK(bundle.commit == buf + 86);
+    TEST_CHECK((const uint8_t *)bundle.zkpe == buf + 119);
+    TEST_CHECK(bundle.proof == buf + 314);
+    TEST_CHECK(bundle.plen == TEST_PLEN);
+    TEST_CHECK(memcmp(bundle.proof, test_proof, TEST_PLEN) == 0);
+
+    // Trailing bytes belong to the next bundle and are not consumed
+    TEST_CHECK(wire_bundle_parse(&bundle, buf, sizeof(buf)) == size);
+}
+
+static void test_bundle_malformed(void) {
+    uint8_t good[WIRE_BUNDLE_FIXED + TEST_PLEN];
+    uint8_t buf[WIRE_BUNDLE_FIXED + TEST_PLEN];
+    uint8_t *zkpe = buf + WIRE_BUNDLE_HEADER + WIRE_CIPHERTEXT_BYTES + WIRE_POINT_BYTES;
+    wire_bundle_t bundle;
+    size_t size = test_bundle(good, 7, 1);
+
+    // Truncated anywhere, including inside the fixed part
+    TEST_CHECK(wire_bundle_parse(&bundle, good, size - 1) == 0);
+    TEST_CHECK(wire_bundle_parse(&bundle, good, WIRE_BUNDLE_FIXED - 1) == 0);
+    TEST_CHECK(wire_bundle_parse(&bundle, good, 0) == 0);
+
+    memcpy(buf, good, size);
+    buf[0] = WIRE_VERSION - 1;
+    TEST_CHECK(wire_bundle_parse(&bundle, buf, size) == 0);
+
+    memcpy(buf, good, size);
+    buf[1] = WIRE_KIND_BATCH;
+    TEST_CHECK(wire_bundle_parse(&bundle, buf, size) == 0);
+
+    // A proof length of zero, above MAX_PROOF_SIZE or past the buffer
+    memcpy(buf, good, size);
+    buf[2] = 0;
+    buf[3] = 0;
+    TEST_CHECK(wire_bundle_parse(&bundle, buf, size) == 0);
+    buf[2] = (uint8_t)((MAX_PROOF_SIZE + 1) >> 8);
+    buf[3] = (uint8_t)(MAX_PROOF_SIZE + 1);
+    TEST_CHECK(wire_bundle_parse(&bundle, buf, size) == 0);
+    buf[2] = 0;
+    buf[3] = TEST_PLEN + 1;
+    TEST_CHECK(wire_bundle_parse(&bundle, buf, size) == 0);
+
+    // Tag bytes of M1, M2, the commitment and the ZKPe points
+    memcpy(buf, good, size);
+    buf[WIRE_BUNDLE_HEADER] = 0x04;
+    TEST_CHECK(wire_bundle_parse(&bundle, buf, size) == 0);
+
+    memcpy(buf, good, size);
+    buf[WIRE_BUNDLE_HEADER + WIRE_POINT_BYTES] = 0x00;
+    TEST_CHECK(wire_bundle_parse(&bundle, buf, size) == 0);
+
+    memcpy(buf, good, size);
+    buf[WIRE_BUNDLE_HEADER + WIRE_CIPHERTEXT_BYTES] = 0x02;
+    TEST_CHECK(wire_bundle_parse(&bundle, buf, size) == 0);
+
+    memcpy(buf, good, size);
+    zkpe[0] = 0x08;
+    TEST_CHECK(wire_bundle_parse(&bundle, buf, size) == 0);
+
+    memcpy(buf, good, size);
+    zkpe[WIRE_POINT_BYTES] = 0x01;
+    TEST_CHECK(wire_bundle_parse(&bundle, buf, size) == 0);
+
+    memcpy(buf, good, size);
+    zkpe[2 * WIRE_POINT_BYTES] = 0xFF;
+    TEST_CHECK(wire_bundle_parse(&bundle, buf, size) == 0);
+}
+
+/**
+ * Fills a ZKPe proof with valid tag bytes and otherwise arbitrary content;
+ * the wire format does not look inside it.
+ */
+static void test_zkpe(zkpe_proof_t *zkpe) {
+    memset(zkpe, 0x5A, sizeof(*zkpe));
+    zkpe->T1[0] = 0x02;
+    zkpe->T2[0] = 0x03;
+    zkpe->T3[0] = 0x02;
+}
+
+/**
+ * Writes a batch header announcing count bundles in payload bytes.
+ */
+static void test_batch_header(uint8_t *out, uint32_t count, uint32_t payload) {
+    static const uint8_t header[WIRE_BATCH_HEADER] = {
+        'S', 'M', 'W', 'B', WIRE_VERSION, WIRE_KIND_BATCH, 0, 0
+    };
+    int i;
+
+    memcpy(out, header, WIRE_BATCH_HEADER);
+    for (i = 0; i < 4; i++) {
+        out[8 + i] = (uint8_t)(count >> (24 - 8 * i));
+        out[12 + i] = (uint8_t)(payload >> (24 - 8 * i));
+    }
+}
+
+static void test_batch_read(void) {
+    uint8_t buf[WIRE_BATCH_HEADER + 2 * (WIRE_BUNDLE_FIXED + TEST_PLEN)];
+    wire_batch_reader_t reader;
+    wire_bundle_t bundle;
+    size_t size;
+
+    size = test_bundle(buf + WIRE_BATCH_HEADER, 7, 1);
+    test_bundle(buf + WIRE_BATCH_HEADER + size, 9, 2);
+    test_batch_header(buf, 2, (uint32_t)(2 * size));
+
+    TEST_CHECK(wire_batch_open(&reader, buf, sizeof(buf)) == 1);
+    TEST_CHECK(reader.count == 2);
+    TEST_CHECK(wire_batch_next(&reader, &bundle) == 1);
+    TEST_CHECK(bundle.customer == 7 && bundle.seq == 1);
+    TEST_CHECK(wire_batch_next(&reader, &bundle) == 1);
+    TEST_CHECK(bundle.customer == 9 && bundle.seq == 2);
+    TEST_CHECK(wire_batch_next(&reader, &bundle) == 0);
+    TEST_CHECK(reader.index == reader.count && reader.offset == reader.len);
+
+    // A count above the bundles present stops short of the count
+    test_batch_header(buf, 3, (uint32_t)(2 * size));
+    TEST_CHECK(wire_batch_open(&reader, buf, sizeof(buf)) == 1);
+    while (wire_batch_next(&reader, &bundle)) {}
+    TEST_CHECK(reader.index == 2 && reader.index != reader.count);
+
+    // A payload that cuts the last bundle short
+    test_batch_header(buf, 2, (uint32_t)(2 * size - 1));
+    TEST_CHECK(wire_batch_open(&reader, buf, sizeof(buf)) == 1);
+    TEST_CHECK(wire_batch_next(&reader, &bundle) == 1);
+    TEST_CHECK(wire_batch_next(&reader, &bundle) == 0);
+    TEST_CHECK(reader.index != reader.count);
+}
+
+static void test_batch_malformed(void) {
+    uint8_t buf[WIRE_BATCH_HEADER + WIRE_BUNDLE_FIXED + TEST_PLEN];
+    wire_batch_reader_t reader;
+    size_t size = test_bundle(buf + WIRE_BATCH_HEADER, 7, 1);
+
+    test_batch_header(buf, 1, (uint32_t)size);
+    TEST_CHECK(wire_batch_open(&reader, buf, sizeof(buf)) == 1);
+    TEST_CHECK(wire_batch_open(&reader, buf, WIRE_BATCH_HEADER - 1) == 0);
+
+    // A payload past the end of the buffer
+    test_batch_header(buf, 1, (uint32_t)size + 1);
+    TEST_CHECK(wire_batch_open(&reader, buf, sizeof(buf)) == 0);
+    test_batch_header(buf, 1, UINT32_MAX);
+    TEST_CHECK(wire_batch_open(&reader, buf, sizeof(buf)) == 0);
+
+    test_batch_header(buf, 1, (uint32_t)size);
+    buf[0] = 'X';
+    TEST_CHECK(wire_batch_open(&reader, buf, sizeof(buf)) == 0);
+
+    test_batch_header(buf, 1, (uint32_t)size);
+    buf[4] = WIRE_VERSION + 1;
+    TEST_CHECK(wire_batch_open(&reader, buf, sizeof(buf)) == 0);
+
+    test_batch_header(buf, 1, (uint32_t)size);
+    buf[5] = WIRE_KIND_BUNDLE;
+    TEST_CHECK(wire_batch_open(&reader, buf, sizeof(buf)) == 0);
+
+    test_batch_header(buf, 1, (uint32_t)size);
+    buf[7] = 1;
+    TEST_CHECK(wire_batch_open(&reader, buf, sizeof(buf)) == 0);
+}
+
+static void test_batch_write(void) {
+    static const uint8_t empty[WIRE_BATCH_HEADER] = {
+        'S', 'M', 'W', 'B', WIRE_VERSION, WIRE_KIND_BATCH, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+    uint8_t buf[WIRE_BATCH_HEADER + 2 * (WIRE_BUNDLE_FIXED + TEST_PLEN)];
+    uint8_t commit_bin[WIRE_POINT_BYTES];
+    secp256k1_context *ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    secp256k1_pedersen_commitment commit;
+    unsigned char blind[32] = { 1 };
+    elgamal_ciphertext_t ct;
+    wire_batch_writer_t writer;
+    wire_batch_reader_t reader;
+    wire_bundle_t bundle;
+    zkpe_proof_t zkpe;
+    bn_t s, m;
+    ec_t B;
+    size_t len;
+
+    bn_null(s);
+    bn_null(m);
+    ec_null(B);
+    bn_new(s);
+    bn_new(m);
+    ec_new(B);
+    TEST_CHECK(ctx != NULL);
+    TEST_CHECK(elgamal_ciphertext_init(&ct) == RLC_OK);
+    TEST_CHECK(elgamal_keygen(s, B) == RLC_OK);
+    bn_set_dig(m, 5);
+    TEST_CHECK(elgamal_encrypt(B, m, ct.M1, ct.M2) == RLC_OK);
+    TEST_CHECK(secp256k1_pedersen_commit(ctx, &commit, blind, 5, &secp256k1_generator_const_h, &secp256k1_generator_const_g) == 1);
+    test_zkpe(&zkpe);
+
+    // An empty batch is a bare header
+    wire_batch_writer_init(&writer, buf, sizeof(buf));
+    TEST_CHECK(wire_batch_writer_finish(&writer) == WIRE_BATCH_HEADER);
+    TEST_CHECK(memcmp(buf, empty, WIRE_BATCH_HEADER) == 0);
+
+    wire_batch_writer_init(&writer, buf, sizeof(buf));
+    TEST_CHECK(wire_batch_writer_add(&writer, ctx, 7, 41, &ct, &commit, &zkpe, test_proof, TEST_PLEN) == 1);
+    TEST_CHECK(wire_batch_writer_add(&writer, ctx, 7, 42, &ct, &commit, &zkpe, test_proof, 0) == 0);
+    TEST_CHECK(wire_batch_writer_add(&writer, ctx, 7, 42, &ct, &commit, &zkpe, test_proof, MAX_PROOF_SIZE + 1) == 0);
+    TEST_CHECK(writer.count == 1);
+
+    // A ciphertext with a point at infinity cannot be written
+    ec_set_infty(ct.M2);
+    TEST_CHECK(wire_batch_writer_add(&writer, ctx, 7, 42, &ct, &commit, &zkpe, test_proof, TEST_PLEN) == 0);
+    TEST_CHECK(writer.count == 1);
+
+    len = wire_batch_writer_finish(&writer);
+    TEST_CHECK(len == WIRE_BATCH_HEADER + WIRE_BUNDLE_FIXED + TEST_PLEN);
+    TEST_CHECK(wire_batch_open(&reader, buf, len) == 1);
+    TEST_CHECK(wire_batch_next(&reader, &bundle) == 1);
+    TEST_CHECK(bundle.customer == 7 && bundle.seq == 41 && bundle.plen == TEST_PLEN);
+    TEST_CHECK(memcmp(bundle.proof, test_proof, TEST_PLEN) == 0);
+    TEST_CHECK(memcmp(bundle.zkpe, &zkpe, sizeof(zkpe)) == 0);
+    TEST_CHECK(secp256k1_pedersen_commitment_serialize(ctx, commit_bin, &commit) == 1);
+    TEST_CHECK(memcmp(bundle.commit, commit_bin, WIRE_POINT_BYTES) == 0);
+    TEST_CHECK(wire_batch_next(&reader, &bundle) == 0);
+    TEST_CHECK(reader.index == reader.count && reader.offset == reader.len);
+
+    bn_free(s);
+    bn_free(m);
+    ec_free(B);
+    elgamal_ciphertext_free(&ct);
+    secp256k1_context_destroy(ctx);
+}
+
+int main(void) {
+    if (core_init() != RLC_OK) {
+        return 1;
+    }
+    ep_param_set(SECG_K256);
+
+    TEST_RUN(test_bundle_parse);
+    TEST_RUN(test_bundle_malformed);
+    TEST_RUN(test_batch_read);
+    TEST_RUN(test_batch_malformed);
+    TEST_RUN(test_batch_write);
+
+    core_clean();
+    return test_result();
+}
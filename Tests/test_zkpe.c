@@ -0,0 +1,214 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <relic.h>
+
+#include "zkpe.h"
+#include "secp256k1_generator.h"
+#include "secp256k1_commitment.h"
+#include "test.h"
+
+#define TEST_BATCH 8
+
+/*
+ * One proven reading together with everything its statement points to.
+ */
+typedef struct {
+    elgamal_ciphertext_t ct;
+    uint8_t C[ZKPE_POINT_BYTES];
+    zkpe_statement_t st;
+    zkpe_proof_t proof;
+} test_reading_t;
+
+static secp256k1_context *test_ctx;
+static uint8_t test_H[ZKPE_POINT_BYTES];
+static bn_t test_s;
+static ec_t test_B;
+
+/**
+ * Serializes the commitment value*H + blind*G.
+ */
+static void test_commit(uint8_t out[ZKPE_POINT_BYTES], uint64_t value, const uint8_t blind[ZKPE_SCALAR_BYTES]) {
+    secp256k1_pedersen_commitment commit;
+
+    TEST_CHECK(secp256k1_pedersen_commit(test_ctx, &commit, blind, value, &secp256k1_generator_const_h, &secp256k1_generator_const_g) == 1);
+    TEST_CHECK(secp256k1_pedersen_commitment_serialize(test_ctx, out, &commit) == 1);
+}
+
+/**
+ * Encrypts and commits to value for customer and seq, and proves that both
+ * hide the same value.
+ */
+static void test_reading(test_reading_t *reading, uint64_t value, uint64_t customer, uint64_t seq) {
+    uint8_t blind[ZKPE_SCALAR_BYTES];
+    bn_t m, k, n;
+
+    bn_null(m);
+    bn_null(k);
+    bn_null(n);
+    bn_new(m);
+    bn_new(k);
+    bn_new(n);
+
+    memset(blind, 0, sizeof(blind));
+    blind[0] = 0x11;
+    blind[31] = (uint8_t)(seq + 1);
+    test_commit(reading->C, value, blind);
+
+    bn_set_dig(m, (dig_t)value);
+    ec_curve_get_ord(n);
+    elgamal_rand_mod(k, n);
+    TEST_CHECK(elgamal_ciphertext_init(&reading->ct) == RLC_OK);
+    TEST_CHECK(elgamal_encrypt_k(test_B, m, k, reading->ct.M1, reading->ct.M2) == RLC_OK);
+
+    reading->st.B = (const ec_t *)&test_B;
+    reading->st.ct = &reading->ct;
+    reading->st.H = test_H;
+    reading->st.C = reading->C;
+    reading->st.customer = customer;
+    reading->st.seq = seq;
+    TEST_CHECK(zkpe_prove(&reading->proof, &reading->st, m, k, blind) == RLC_OK);
+
+    bn_free(m);
+    bn_free(k);
+    bn_free(n);
+}
+
+static void test_verify(void) {
+    test_reading_t reading;
+    elgamal_ciphertext_t ct;
+    zkpe_statement_t st;
+    zkpe_proof_t proof;
+    uint8_t C[ZKPE_POINT_BYTES];
+    uint8_t blind[ZKPE_SCALAR_BYTES] = { 0x22 };
+    ec_t P;
+
+    ec_null(P);
+    ec_new(P);
+    ec_curve_get_gen(P);
+    TEST_CHECK(elgamal_ciphertext_init(&ct) == RLC_OK);
+
+    test_reading(&reading, 1234, 7, 42);
+    TEST_CHECK(zkpe_verify(&reading.st, &reading.proof) == RLC_OK);
+
+    // The proof is bound to the customer and the sequence number
+    st = reading.st;
+    st.customer = 8;
+    TEST_CHECK(zkpe_verify(&st, &reading.proof) == RLC_ERR);
+    st = reading.st;
+    st.seq = 43;
+    TEST_CHECK(zkpe_verify(&st, &reading.proof) == RLC_ERR);
+
+    // A commitment to another value, or to the same value with another blind
+    st = reading.st;
+    test_commit(C, 1235, blind);
+    st.C = C;
+    TEST_CHECK(zkpe_verify(&st, &reading.proof) == RLC_ERR);
+    test_commit(C, 1234, blind);
+    TEST_CHECK(zkpe_verify(&st, &reading.proof) == RLC_ERR);
+
+    // M1 or M2 shifted by P
+    st = reading.st;
+    st.ct = &ct;
+    ec_add(ct.M1, reading.ct.M1, P);
+    ec_copy(ct.M2, reading.ct.M2);
+    TEST_CHECK(zkpe_verify(&st, &reading.proof) == RLC_ERR);
+    ec_copy(ct.M1, reading.ct.M1);
+    ec_add(ct.M2, reading.ct.M2, P);
+    TEST_CHECK(zkpe_verify(&st, &reading.proof) == RLC_ERR);
+
+    // Another public key
+    st = reading.st;
+    st.B = (const ec_t *)&P;
+    TEST_CHECK(zkpe_verify(&st, &reading.proof) == RLC_ERR);
+
+    // Tampered responses and commitments of the proof
+    proof = reading.proof;
+    proof.z_m[ZKPE_SCALAR_BYTES - 1] ^= 0x01;
+    TEST_CHECK(zkpe_verify(&reading.st, &proof) == RLC_ERR);
+    proof = reading.proof;
+    proof.z_r[ZKPE_SCALAR_BYTES - 1] ^= 0x01;
+    TEST_CHECK(zkpe_verify(&reading.st, &proof) == RLC_ERR);
+    proof = reading.proof;
+    memcpy(proof.T3, reading.proof.T1, ZKPE_POINT_BYTES);
+    TEST_CHECK(zkpe_verify(&reading.st, &proof) == RLC_ERR);
+
+    // The statement itself is still accepted
+    TEST_CHECK(zkpe_verify(&reading.st, &reading.proof) == RLC_OK);
+
+    elgamal_ciphertext_free(&ct);
+    elgamal_ciphertext_free(&reading.ct);
+    ec_free(P);
+}
+
+static void test_verify_batch(void) {
+    test_reading_t readings[TEST_BATCH];
+    zkpe_statement_t st[TEST_BATCH];
+    zkpe_proof_t proof[TEST_BATCH];
+    unsigned char valid[TEST_BATCH];
+    size_t i;
+
+    for (i = 0; i < TEST_BATCH; i++) {
+        test_reading(&readings[i], 100 + i, 7 + i % 3, i);
+        st[i] = readings[i].st;
+        proof[i] = readings[i].proof;
+    }
+
+    memset(valid, 0xFF, sizeof(valid));
+    TEST_CHECK(zkpe_verify_batch(st, proof, TEST_BATCH, valid) == 0);
+    for (i = 0; i < TEST_BATCH; i++) {
+        TEST_CHECK(valid[i] == 1);
+    }
+
+    // One proof attributed to another customer is isolated by the bisection
+    st[5].customer++;
+    memset(valid, 0xFF, sizeof(valid));
+    TEST_CHECK(zkpe_verify_batch(st, proof, TEST_BATCH, valid) == 1);
+    for (i = 0; i < TEST_BATCH; i++) {
+        TEST_CHECK(valid[i] == (i != 5));
+    }
+
+    // Two swapped proofs fail at both ends of the batch
+    st[5] = readings[5].st;
+    proof[0] = readings[TEST_BATCH - 1].proof;
+    proof[TEST_BATCH - 1] = readings[0].proof;
+    memset(valid, 0xFF, sizeof(valid));
+    TEST_CHECK(zkpe_verify_batch(st, proof, TEST_BATCH, valid) == 2);
+    for (i = 0; i < TEST_BATCH; i++) {
+        TEST_CHECK(valid[i] == (i != 0 && i != TEST_BATCH - 1));
+    }
+
+    for (i = 0; i < TEST_BATCH; i++) {
+        elgamal_ciphertext_free(&readings[i].ct);
+    }
+}
+
+int main(void) {
+    int result;
+
+    if (core_init() != RLC_OK) {
+        return 1;
+    }
+    ep_param_set(SECG_K256);
+    test_ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    if (test_ctx == NULL || secp256k1_generator_serialize(test_ctx, test_H, &secp256k1_generator_const_h) != 1) {
+        return 1;
+    }
+    bn_null(test_s);
+    ec_null(test_B);
+    bn_new(test_s);
+    ec_new(test_B);
+    if (elgamal_keygen(test_s, test_B) != RLC_OK) {
+        return 1;
+    }
+
+    TEST_RUN(test_verify);
+    TEST_RUN(test_verify_batch);
+
+    result = test_result();
+    bn_free(test_s);
+    ec_free(test_B);
+    secp256k1_context_destroy(test_ctx);
+    core_clean();
+    return result;
+}
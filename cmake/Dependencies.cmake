@@ -0,0 +1,111 @@
+# Locates RELIC and secp256k1-zkp, or builds them when SMB_BUILD_DEPS is ON.
+#
+# Both libraries are exposed as imported targets, RELIC::relic and
+# secp256k1::secp256k1, whichever way they were obtained.
+
+option(SMB_BUILD_DEPS "Download and build RELIC and secp256k1-zkp" OFF)
+
+set(RELIC_ROOT "" CACHE PATH "Install prefix of a prebuilt RELIC")
+set(SECP256K1_ROOT "" CACHE PATH "Install prefix of a prebuilt secp256k1-zkp")
+
+# RELIC backend; ARITH=gmp or x64-asm-4l gives the fastest field arithmetic
+set(RELIC_ARITH "x64-asm-4l" CACHE STRING "RELIC arithmetic backend: easy, gmp or x64-asm-4l")
+set_property(CACHE RELIC_ARITH PROPERTY STRINGS easy gmp x64-asm-4l)
+set(RELIC_GIT_TAG "0.6.0" CACHE STRING "RELIC release to build")
+set(SECP256K1_GIT_REPOSITORY "https://github.com/apoelstra/secp256k1-zkp.git" CACHE STRING "secp256k1-zkp repository")
+set(SECP256K1_GIT_TAG "bulletproofs" CACHE STRING "secp256k1-zkp branch with the bulletproof module")
+
+find_library(GMP_LIBRARY gmp)
+
+if(SMB_BUILD_DEPS)
+    include(ExternalProject)
+
+    set(SMB_DEPS_PREFIX "${CMAKE_BINARY_DIR}/deps")
+
+    # secp256k1 over a 256-bit prime with the GLV endomorphism, precomputed
+    # fixed-base tables and thread-local cores for the worker pools
+    set(RELIC_ARGS
+        -DCMAKE_INSTALL_PREFIX=${SMB_DEPS_PREFIX}
+        -DCMAKE_BUILD_TYPE=Release
+        -DCMAKE_POSITION_INDEPENDENT_CODE=ON
+        -DWSIZE=64
+        -DARITH=${RELIC_ARITH}
+        -DFP_PRIME=256
+        -DFP_PMERS=OFF
+        -DFP_QNRES=OFF
+        -DEC_METHD=PRIME
+        -DEC_ENDOM=ON
+        -DEP_ENDOM=ON
+        -DEP_PLAIN=ON
+        -DEP_PRECO=ON
+        "-DEP_METHD=PROJC\;LWNAF\;COMBS\;INTER"
+        -DMULTI=PTHREAD
+        -DALLOC=AUTO
+        -DCHECK=OFF
+        -DVERBS=OFF
+        -DSHLIB=OFF
+        -DSTLIB=ON
+        -DTESTS=0
+        -DBENCH=0)
+    if(SMB_ARCH)
+        list(APPEND RELIC_ARGS "-DCOMP=-O3 -funroll-loops -fomit-frame-pointer -march=${SMB_ARCH}")
+    endif()
+
+    ExternalProject_Add(relic_ext
+        GIT_REPOSITORY https://github.com/relic-toolkit/relic.git
+        GIT_TAG ${RELIC_GIT_TAG}
+        PREFIX ${SMB_DEPS_PREFIX}/relic
+        CMAKE_ARGS ${RELIC_ARGS}
+        BUILD_BYPRODUCTS ${SMB_DEPS_PREFIX}/lib/librelic_s.a)
+
+    ExternalProject_Add(secp256k1_ext
+        GIT_REPOSITORY ${SECP256K1_GIT_REPOSITORY}
+        GIT_TAG ${SECP256K1_GIT_TAG}
+        PREFIX ${SMB_DEPS_PREFIX}/secp256k1
+        BUILD_IN_SOURCE ON
+        CONFIGURE_COMMAND ./autogen.sh
+            COMMAND ./configure --prefix=${SMB_DEPS_PREFIX} --disable-shared --with-pic
+                --enable-experimental --enable-module-generator --enable-module-commitment
+                --enable-module-rangeproof --enable-module-bulletproof
+                --enable-endomorphism --disable-benchmark --disable-tests --disable-exhaustive-tests
+        BUILD_COMMAND make
+        INSTALL_COMMAND make install
+        BUILD_BYPRODUCTS ${SMB_DEPS_PREFIX}/lib/libsecp256k1.a)
+
+    # Imported targets need their include directories to exist at configure time
+    file(MAKE_DIRECTORY ${SMB_DEPS_PREFIX}/include/relic)
+
+    add_library(RELIC::relic STATIC IMPORTED GLOBAL)
+    set_target_properties(RELIC::relic PROPERTIES
+        IMPORTED_LOCATION ${SMB_DEPS_PREFIX}/lib/librelic_s.a
+        INTERFACE_INCLUDE_DIRECTORIES ${SMB_DEPS_PREFIX}/include/relic)
+    add_dependencies(RELIC::relic relic_ext)
+
+    add_library(secp256k1::secp256k1 STATIC IMPORTED GLOBAL)
+    set_target_properties(secp256k1::secp256k1 PROPERTIES
+        IMPORTED_LOCATION ${SMB_DEPS_PREFIX}/lib/libsecp256k1.a
+        INTERFACE_INCLUDE_DIRECTORIES ${SMB_DEPS_PREFIX}/include)
+    add_dependencies(secp256k1::secp256k1 secp256k1_ext)
+else()
+    find_path(RELIC_INCLUDE_DIR relic.h HINTS ${RELIC_ROOT} PATH_SUFFIXES include/relic include REQUIRED)
+    find_library(RELIC_LIBRARY NAMES relic_s relic HINTS ${RELIC_ROOT} PATH_SUFFIXES lib REQUIRED)
+    find_path(SECP256K1_INCLUDE_DIR secp256k1_bulletproofs.h HINTS ${SECP256K1_ROOT} PATH_SUFFIXES include REQUIRED)
+    find_library(SECP256K1_LIBRARY secp256k1 HINTS ${SECP256K1_ROOT} PATH_SUFFIXES lib REQUIRED)
+
+    add_library(RELIC::relic UNKNOWN IMPORTED GLOBAL)
+    set_target_properties(RELIC::relic PROPERTIES
+        IMPORTED_LOCATION ${RELIC_LIBRARY}
+        INTERFACE_INCLUDE_DIRECTORIES ${RELIC_INCLUDE_DIR})
+
+    add_library(secp256k1::secp256k1 UNKNOWN IMPORTED GLOBAL)
+    set_target_properties(secp256k1::secp256k1 PROPERTIES
+        IMPORTED_LOCATION ${SECP256K1_LIBRARY}
+        INTERFACE_INCLUDE_DIRECTORIES ${SECP256K1_INCLUDE_DIR})
+endif()
+
+# A RELIC built on GMP needs it at link time
+if(GMP_LIBRARY)
+    set_property(TARGET RELIC::relic APPEND PROPERTY INTERFACE_LINK_LIBRARIES ${GMP_LIBRARY})
+elseif(RELIC_ARITH STREQUAL "gmp")
+    message(FATAL_ERROR "RELIC_ARITH=gmp requires GMP")
+endif()
@@ -0,0 +1,56 @@
+# Link-time optimization, architecture tuning and profile-guided optimization.
+#
+# A PGO build takes three steps from the same source tree:
+#
+#   cmake -B build-gen -DSMB_PGO=GENERATE -DSMB_PGO_DIR=$PWD/pgo
+#   cmake --build build-gen --target pgo-train
+#   cmake -B build -DSMB_PGO=USE -DSMB_PGO_DIR=$PWD/pgo -DSMB_LTO=ON
+#
+# pgo-train runs the benchmark driver, which exercises every hot path, to
+# collect the profiles. With Clang the raw profiles are merged into
+# SMB_PGO_DIR/default.profdata by the same target.
+
+if(SMB_LTO)
+    include(CheckIPOSupported)
+    check_ipo_supported(RESULT SMB_LTO_SUPPORTED OUTPUT SMB_LTO_ERROR LANGUAGES C)
+    if(NOT SMB_LTO_SUPPORTED)
+        message(FATAL_ERROR "LTO is not supported by this toolchain: ${SMB_LTO_ERROR}")
+    endif()
+endif()
+
+string(TOUPPER "${SMB_PGO}" SMB_PGO)
+if(NOT SMB_PGO MATCHES "^(OFF|GENERATE|USE)$")
+    message(FATAL_ERROR "SMB_PGO must be OFF, GENERATE or USE, not ${SMB_PGO}")
+endif()
+
+set(SMB_PGO_FLAGS "")
+if(SMB_PGO STREQUAL "GENERATE")
+    if(CMAKE_C_COMPILER_ID MATCHES "Clang")
+        set(SMB_PGO_FLAGS "-fprofile-instr-generate=${SMB_PGO_DIR}/%p.profraw")
+    else()
+        set(SMB_PGO_FLAGS "-fprofile-generate=${SMB_PGO_DIR}" -fprofile-update=atomic)
+    endif()
+elseif(SMB_PGO STREQUAL "USE")
+    if(CMAKE_C_COMPILER_ID MATCHES "Clang")
+        if(NOT EXISTS "${SMB_PGO_DIR}/default.profdata")
+            message(FATAL_ERROR "No profile at ${SMB_PGO_DIR}/default.profdata; run the pgo-train target first")
+        endif()
+        set(SMB_PGO_FLAGS "-fprofile-instr-use=${SMB_PGO_DIR}/default.profdata")
+    else()
+        set(SMB_PGO_FLAGS "-fprofile-use=${SMB_PGO_DIR}" -fprofile-partial-training -Wno-missing-profile)
+    endif()
+endif()
+
+# Applies the optimization settings to a target of this project
+function(smb_optimize target)
+    if(SMB_LTO)
+        set_property(TARGET ${target} PROPERTY INTERPROCEDURAL_OPTIMIZATION ON)
+    endif()
+    if(SMB_ARCH)
+        target_compile_options(${target} PRIVATE -march=${SMB_ARCH})
+    endif()
+    if(SMB_PGO_FLAGS)
+        target_compile_options(${target} PRIVATE ${SMB_PGO_FLAGS})
+        target_link_options(${target} PUBLIC ${SMB_PGO_FLAGS})
+    endif()
+endfunction()